@@ -96,6 +96,23 @@ aes_cbc_dec (__m128i * k, u8 * src, u8 * dst, u8 * iv, int count,
     }
 }
 
+static_always_inline __m128i
+aes_cbc_enc (__m128i * k, u8 * src, u8 * dst, __m128i r, int count,
+	     aesni_key_size_t rounds)
+{
+  int i, j;
+
+  for (i = 0; i < count; i += 16)
+    {
+      r ^= _mm_loadu_si128 ((__m128i *) (src + i)) ^ k[0];
+      for (j = 1; j < rounds; j++)
+	r = _mm_aesenc_si128 (r, k[j]);
+      r = _mm_aesenclast_si128 (r, k[j]);
+      _mm_storeu_si128 ((__m128i *) (dst + i), r);
+    }
+  return r;
+}
+
 static_always_inline u32
 aesni_ops_enc_aes_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[],
 		       u32 n_ops, aesni_key_size_t ks)
@@ -198,6 +215,224 @@ more:
   return n_ops;
 }
 
+#if defined (__VAES__)
+/*
+ * VAES multi-buffer CBC encrypt. CBC encryption is serial within a packet,
+ * so up to 16 packets are processed in parallel: each 128-bit lane of the
+ * 4 zmm registers carries the chaining state and key schedule of one
+ * packet.
+ */
+#define AES_CBC_VAES_N_LANES 16
+
+static_always_inline __m512i
+aes_cbc_vaes_load_lanes (u8 ** p, u32 off)
+{
+  __m512i r;
+  r = _mm512_castsi128_si512 (_mm_loadu_si128 ((__m128i *) (p[0] + off)));
+  r = _mm512_inserti32x4 (r, _mm_loadu_si128 ((__m128i *) (p[1] + off)), 1);
+  r = _mm512_inserti32x4 (r, _mm_loadu_si128 ((__m128i *) (p[2] + off)), 2);
+  r = _mm512_inserti32x4 (r, _mm_loadu_si128 ((__m128i *) (p[3] + off)), 3);
+  return r;
+}
+
+static_always_inline void
+aes_cbc_vaes_store_lanes (u8 ** p, u32 off, __m512i r)
+{
+  _mm_storeu_si128 ((__m128i *) (p[0] + off), _mm512_castsi512_si128 (r));
+  _mm_storeu_si128 ((__m128i *) (p[1] + off),
+		    _mm512_extracti32x4_epi32 (r, 1));
+  _mm_storeu_si128 ((__m128i *) (p[2] + off),
+		    _mm512_extracti32x4_epi32 (r, 2));
+  _mm_storeu_si128 ((__m128i *) (p[3] + off),
+		    _mm512_extracti32x4_epi32 (r, 3));
+}
+
+/* replace 128-bit lane 'lane' of a with b */
+static_always_inline __m512i
+aes_cbc_vaes_set_lane (__m512i a, __m128i b, int lane)
+{
+  return _mm512_mask_blend_epi64 ((__mmask8) (3 << (2 * lane)), a,
+				  _mm512_broadcast_i32x4 (b));
+}
+
+static_always_inline u32
+aesni_ops_enc_aes_cbc_vaes (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+			    u32 n_ops, aesni_key_size_t ks)
+{
+  crypto_ia32_main_t *cm = &crypto_ia32_main;
+  crypto_ia32_per_thread_data_t *ptd = vec_elt_at_index (cm->per_thread_data,
+							 vm->thread_index);
+  int rounds = AESNI_KEY_ROUNDS (ks);
+  u8 dummy[8192];
+  u8 *src[AES_CBC_VAES_N_LANES], *dst[AES_CBC_VAES_N_LANES];
+  vnet_crypto_key_index_t key_index[AES_CBC_VAES_N_LANES];
+  u32 len[AES_CBC_VAES_N_LANES] = { };
+  u32 i, j, g, count, n_left = n_ops, active = 0;
+  __m512i r[4] = { }, k[4][rounds + 1];
+
+  for (i = 0; i < AES_CBC_VAES_N_LANES; i++)
+    key_index[i] = ~0;
+
+more:
+  for (i = 0; i < AES_CBC_VAES_N_LANES; i++)
+    if (len[i] == 0)
+      {
+	if (n_left == 0)
+	  {
+	    /* no more work to enqueue, so we are enqueueing dummy buffer */
+	    src[i] = dst[i] = dummy;
+	    len[i] = sizeof (dummy);
+	    active &= ~(1 << i);
+	  }
+	else
+	  {
+	    __m128i iv;
+	    if (ops[0]->flags & VNET_CRYPTO_OP_FLAG_INIT_IV)
+	      {
+		iv = ptd->cbc_iv[i & 3];
+		_mm_storeu_si128 ((__m128i *) ops[0]->iv, iv);
+		ptd->cbc_iv[i & 3] = _mm_aesenc_si128 (iv, iv);
+	      }
+	    else
+	      iv = _mm_loadu_si128 ((__m128i *) ops[0]->iv);
+	    r[i / 4] = aes_cbc_vaes_set_lane (r[i / 4], iv, i & 3);
+	    src[i] = ops[0]->src;
+	    dst[i] = ops[0]->dst;
+	    len[i] = ops[0]->len;
+	    active |= 1 << i;
+	    if (key_index[i] != ops[0]->key_index)
+	      {
+		aes_cbc_key_data_t *kd;
+		key_index[i] = ops[0]->key_index;
+		kd = (aes_cbc_key_data_t *) cm->key_data[key_index[i]];
+		for (j = 0; j < rounds + 1; j++)
+		  k[i / 4][j] = aes_cbc_vaes_set_lane (k[i / 4][j],
+						       kd->encrypt_key[j],
+						       i & 3);
+	      }
+	    ops[0]->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
+	    n_left--;
+	    ops++;
+	  }
+      }
+
+  count = len[0];
+  for (i = 1; i < AES_CBC_VAES_N_LANES; i++)
+    count = clib_min (count, len[i]);
+
+  ASSERT (count % 16 == 0);
+
+  for (i = 0; i < count; i += 16)
+    {
+      for (g = 0; g < 4; g++)
+	r[g] ^= aes_cbc_vaes_load_lanes (src + 4 * g, i) ^ k[g][0];
+
+      for (j = 1; j < rounds; j++)
+	for (g = 0; g < 4; g++)
+	  r[g] = _mm512_aesenc_epi128 (r[g], k[g][j]);
+
+      for (g = 0; g < 4; g++)
+	{
+	  r[g] = _mm512_aesenclast_epi128 (r[g], k[g][j]);
+	  aes_cbc_vaes_store_lanes (dst + 4 * g, i, r[g]);
+	}
+    }
+
+  for (i = 0; i < AES_CBC_VAES_N_LANES; i++)
+    {
+      src[i] += count;
+      dst[i] += count;
+      len[i] -= count;
+    }
+
+  if (n_left > 0)
+    goto more;
+
+  for (i = 0; i < AES_CBC_VAES_N_LANES; i++)
+    if ((active & (1 << i)) && len[i])
+      goto more;
+
+  return n_ops;
+}
+
+/*
+ * CBC decryption is parallel within a packet: decrypt 16 blocks per
+ * iteration with the key schedule broadcast to all lanes. The chaining
+ * value of each block is the previous ciphertext block, shifted in from
+ * the previous register with valignq.
+ */
+static_always_inline void
+aes_cbc_dec_vaes (__m128i * k, u8 * src, u8 * dst, u8 * iv, int count,
+		  aesni_key_size_t rounds)
+{
+  __m512i kb[15], r[4], c[4], f;
+  __m128i r0, c0, f0;
+  int i, g;
+
+  for (i = 0; i < rounds + 1; i++)
+    kb[i] = _mm512_broadcast_i32x4 (k[i]);
+
+  f = _mm512_inserti32x4 (_mm512_setzero_si512 (),
+			  _mm_loadu_si128 ((__m128i *) iv), 3);
+
+  while (count >= 256)
+    {
+      for (g = 0; g < 4; g++)
+	{
+	  c[g] = _mm512_loadu_si512 ((__m512i *) src + g);
+	  r[g] = c[g] ^ kb[0];
+	}
+
+      for (i = 1; i < rounds; i++)
+	for (g = 0; g < 4; g++)
+	  r[g] = _mm512_aesdec_epi128 (r[g], kb[i]);
+
+      for (g = 0; g < 4; g++)
+	{
+	  r[g] = _mm512_aesdeclast_epi128 (r[g], kb[i]);
+	  r[g] ^= _mm512_alignr_epi64 (c[g], g ? c[g - 1] : f, 6);
+	  _mm512_storeu_si512 ((__m512i *) dst + g, r[g]);
+	}
+
+      f = c[3];
+      count -= 256;
+      src += 256;
+      dst += 256;
+    }
+
+  while (count >= 64)
+    {
+      c[0] = _mm512_loadu_si512 ((__m512i *) src);
+      r[0] = c[0] ^ kb[0];
+      for (i = 1; i < rounds; i++)
+	r[0] = _mm512_aesdec_epi128 (r[0], kb[i]);
+      r[0] = _mm512_aesdeclast_epi128 (r[0], kb[i]);
+      r[0] ^= _mm512_alignr_epi64 (c[0], f, 6);
+      _mm512_storeu_si512 ((__m512i *) dst, r[0]);
+      f = c[0];
+      count -= 64;
+      src += 64;
+      dst += 64;
+    }
+
+  f0 = _mm512_extracti32x4_epi32 (f, 3);
+
+  while (count > 0)
+    {
+      c0 = _mm_loadu_si128 (((__m128i *) src));
+      r0 = c0 ^ k[0];
+      for (i = 1; i < rounds; i++)
+	r0 = _mm_aesdec_si128 (r0, k[i]);
+      r0 = _mm_aesdeclast_si128 (r0, k[i]);
+      _mm_storeu_si128 ((__m128i *) dst, r0 ^ f0);
+      f0 = c0;
+      count -= 16;
+      src += 16;
+      dst += 16;
+    }
+}
+#endif
+
 static_always_inline u32
 aesni_ops_dec_aes_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[],
 		       u32 n_ops, aesni_key_size_t ks)
@@ -211,7 +446,12 @@ aesni_ops_dec_aes_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[],
   ASSERT (n_ops >= 1);
 
 decrypt:
+#if defined (__VAES__)
+  aes_cbc_dec_vaes (kd->decrypt_key, op->src, op->dst, op->iv, op->len,
+		    rounds);
+#else
   aes_cbc_dec (kd->decrypt_key, op->src, op->dst, op->iv, op->len, rounds);
+#endif
   op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
 
   if (--n_left)
@@ -224,6 +464,89 @@ decrypt:
   return n_ops;
 }
 
+/*
+ * Chained ops are processed one by one, walking the chunks in runs
+ * of whole blocks; the chaining value is carried over between runs.
+ */
+static_always_inline u32
+aesni_ops_enc_aes_cbc_chained (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+			       vnet_crypto_op_chunk_t * chunks, u32 n_ops,
+			       aesni_key_size_t ks)
+{
+  crypto_ia32_main_t *cm = &crypto_ia32_main;
+  crypto_ia32_per_thread_data_t *ptd = vec_elt_at_index (cm->per_thread_data,
+							 vm->thread_index);
+  int rounds = AESNI_KEY_ROUNDS (ks);
+  crypto_ia32_chunk_iter_t it;
+  aes_cbc_key_data_t *kd;
+  u8 *src, *dst;
+  __m128i r;
+  u32 i, len;
+
+  for (i = 0; i < n_ops; i++)
+    {
+      vnet_crypto_op_t *op = ops[i];
+      kd = (aes_cbc_key_data_t *) cm->key_data[op->key_index];
+
+      if (op->flags & VNET_CRYPTO_OP_FLAG_INIT_IV)
+	{
+	  r = ptd->cbc_iv[0];
+	  _mm_storeu_si128 ((__m128i *) op->iv, r);
+	  ptd->cbc_iv[0] = _mm_aesenc_si128 (r, r);
+	}
+      else
+	r = _mm_loadu_si128 ((__m128i *) op->iv);
+
+      crypto_ia32_chunk_iter_init (&it, chunks, op);
+      while ((len = crypto_ia32_chunk_iter_next (&it, &src, &dst)))
+	{
+	  r = aes_cbc_enc (kd->encrypt_key, src, dst, r, len, rounds);
+	  crypto_ia32_chunk_iter_done (&it);
+	}
+      op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
+    }
+
+  return n_ops;
+}
+
+static_always_inline u32
+aesni_ops_dec_aes_cbc_chained (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+			       vnet_crypto_op_chunk_t * chunks, u32 n_ops,
+			       aesni_key_size_t ks)
+{
+  crypto_ia32_main_t *cm = &crypto_ia32_main;
+  int rounds = AESNI_KEY_ROUNDS (ks);
+  crypto_ia32_chunk_iter_t it;
+  aes_cbc_key_data_t *kd;
+  u8 *src, *dst, iv[16];
+  __m128i next_iv;
+  u32 i, len;
+
+  for (i = 0; i < n_ops; i++)
+    {
+      vnet_crypto_op_t *op = ops[i];
+      kd = (aes_cbc_key_data_t *) cm->key_data[op->key_index];
+      clib_memcpy_fast (iv, op->iv, 16);
+
+      crypto_ia32_chunk_iter_init (&it, chunks, op);
+      while ((len = crypto_ia32_chunk_iter_next (&it, &src, &dst)))
+	{
+	  /* last ciphertext block, before it is overwritten in place */
+	  next_iv = _mm_loadu_si128 ((__m128i *) (src + len - 16));
+#if defined (__VAES__)
+	  aes_cbc_dec_vaes (kd->decrypt_key, src, dst, iv, len, rounds);
+#else
+	  aes_cbc_dec (kd->decrypt_key, src, dst, iv, len, rounds);
+#endif
+	  _mm_storeu_si128 ((__m128i *) iv, next_iv);
+	  crypto_ia32_chunk_iter_done (&it);
+	}
+      op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
+    }
+
+  return n_ops;
+}
+
 static_always_inline void *
 aesni_cbc_key_exp (vnet_crypto_key_t * key, aesni_key_size_t ks)
 {
@@ -237,13 +560,29 @@ aesni_cbc_key_exp (vnet_crypto_key_t * key, aesni_key_size_t ks)
 
 #define foreach_aesni_cbc_handler_type _(128) _(192) _(256)
 
+#if defined (__VAES__)
+#define AESNI_OPS_ENC_AES_CBC aesni_ops_enc_aes_cbc_vaes
+#else
+#define AESNI_OPS_ENC_AES_CBC aesni_ops_enc_aes_cbc
+#endif
+
 #define _(x) \
 static u32 aesni_ops_dec_aes_cbc_##x \
 (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops) \
 { return aesni_ops_dec_aes_cbc (vm, ops, n_ops, AESNI_KEY_##x); } \
 static u32 aesni_ops_enc_aes_cbc_##x \
 (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops) \
-{ return aesni_ops_enc_aes_cbc (vm, ops, n_ops, AESNI_KEY_##x); } \
+{ return AESNI_OPS_ENC_AES_CBC (vm, ops, n_ops, AESNI_KEY_##x); } \
+static u32 aesni_ops_dec_aes_cbc_chained_##x \
+(vlib_main_t * vm, vnet_crypto_op_t * ops[], \
+ vnet_crypto_op_chunk_t * chunks, u32 n_ops) \
+{ return aesni_ops_dec_aes_cbc_chained (vm, ops, chunks, n_ops, \
+					AESNI_KEY_##x); } \
+static u32 aesni_ops_enc_aes_cbc_chained_##x \
+(vlib_main_t * vm, vnet_crypto_op_t * ops[], \
+ vnet_crypto_op_chunk_t * chunks, u32 n_ops) \
+{ return aesni_ops_enc_aes_cbc_chained (vm, ops, chunks, n_ops, \
+					AESNI_KEY_##x); } \
 static void * aesni_cbc_key_exp_##x (vnet_crypto_key_t *key) \
 { return aesni_cbc_key_exp (key, AESNI_KEY_##x); }
 
@@ -253,7 +592,9 @@ foreach_aesni_cbc_handler_type;
 #include <fcntl.h>
 
 clib_error_t *
-#ifdef __AVX512F__
+#if defined (__VAES__)
+crypto_ia32_aesni_cbc_init_vaes (vlib_main_t * vm)
+#elif defined (__AVX512F__)
 crypto_ia32_aesni_cbc_init_avx512 (vlib_main_t * vm)
 #elif __AVX2__
 crypto_ia32_aesni_cbc_init_avx2 (vlib_main_t * vm)
@@ -291,6 +632,12 @@ crypto_ia32_aesni_cbc_init_sse42 (vlib_main_t * vm)
   vnet_crypto_register_ops_handler (vm, cm->crypto_engine_index, \
 				    VNET_CRYPTO_OP_AES_##x##_CBC_DEC, \
 				    aesni_ops_dec_aes_cbc_##x); \
+  vnet_crypto_register_chained_ops_handler \
+    (vm, cm->crypto_engine_index, VNET_CRYPTO_OP_AES_##x##_CBC_ENC, \
+     aesni_ops_enc_aes_cbc_chained_##x); \
+  vnet_crypto_register_chained_ops_handler \
+    (vm, cm->crypto_engine_index, VNET_CRYPTO_OP_AES_##x##_CBC_DEC, \
+     aesni_ops_dec_aes_cbc_chained_##x); \
   cm->key_fn[VNET_CRYPTO_ALG_AES_##x##_CBC] = aesni_cbc_key_exp_##x;
   foreach_aesni_cbc_handler_type;
 #undef _
@@ -413,12 +413,11 @@ aesni_gcm_ghash_last (__m128i T, aes_gcm_key_data_t * kd, __m128i * d,
 
 
 static_always_inline __m128i
-aesni_gcm_enc (__m128i T, aes_gcm_key_data_t * kd, __m128i Y, const u8 * in,
-	       const u8 * out, u32 n_left, int rounds)
+aesni_gcm_enc (__m128i T, aes_gcm_key_data_t * kd, __m128i Y, u32 ctr,
+	       const u8 * in, const u8 * out, u32 n_left, int rounds)
 {
   __m128i *inv = (__m128i *) in, *outv = (__m128i *) out;
   __m128i d[4];
-  u32 ctr = 1;
 
   if (n_left == 0)
     return T;
@@ -519,12 +518,11 @@ aesni_gcm_enc (__m128i T, aes_gcm_key_data_t * kd, __m128i Y, const u8 * in,
 }
 
 static_always_inline __m128i
-aesni_gcm_dec (__m128i T, aes_gcm_key_data_t * kd, __m128i Y, const u8 * in,
-	       const u8 * out, u32 n_left, int rounds)
+aesni_gcm_dec (__m128i T, aes_gcm_key_data_t * kd, __m128i Y, u32 ctr,
+	       const u8 * in, const u8 * out, u32 n_left, int rounds)
 {
   __m128i *inv = (__m128i *) in, *outv = (__m128i *) out;
   __m128i d[8];
-  u32 ctr = 1;
 
   while (n_left >= 128)
     {
@@ -569,18 +567,10 @@ aesni_gcm_dec (__m128i T, aes_gcm_key_data_t * kd, __m128i Y, const u8 * in,
 			 /* with_ghash */ 1, /* is_encrypt */ 0);
 }
 
-static_always_inline int
-aes_gcm (const u8 * in, u8 * out, const u8 * addt, const u8 * iv, u8 * tag,
-	 u32 data_bytes, u32 aad_bytes, u8 tag_len, aes_gcm_key_data_t * kd,
-	 int aes_rounds, int is_encrypt)
+static_always_inline __m128i
+aes_gcm_ghash_aad (aes_gcm_key_data_t * kd, const u8 * addt, u32 aad_bytes)
 {
-  int i;
-  __m128i r, Y0, T = { };
-  ghash_data_t _gd, *gd = &_gd;
-
-  _mm_prefetch (iv, _MM_HINT_T0);
-  _mm_prefetch (in, _MM_HINT_T0);
-  _mm_prefetch (in + CLIB_CACHE_LINE_BYTES, _MM_HINT_T0);
+  __m128i T = { };
 
   /* calculate ghash for AAD - optimized for ipsec common cases */
   if (aad_bytes == 8)
@@ -590,15 +580,17 @@ aes_gcm (const u8 * in, u8 * out, const u8 * addt, const u8 * iv, u8 * tag,
   else
     T = aesni_gcm_ghash (T, kd, (__m128i *) addt, aad_bytes);
 
-  /* initalize counter */
-  Y0 = _mm_loadu_si128 ((__m128i *) iv);
-  Y0 = _mm_insert_epi32 (Y0, clib_host_to_net_u32 (1), 3);
+  return T;
+}
 
-  /* ghash and encrypt/edcrypt  */
-  if (is_encrypt)
-    T = aesni_gcm_enc (T, kd, Y0, in, out, data_bytes, aes_rounds);
-  else
-    T = aesni_gcm_dec (T, kd, Y0, in, out, data_bytes, aes_rounds);
+static_always_inline int
+aes_gcm_tag (__m128i T, aes_gcm_key_data_t * kd, __m128i Y0, u8 * tag,
+	     u32 data_bytes, u32 aad_bytes, u8 tag_len, int aes_rounds,
+	     int is_encrypt)
+{
+  int i;
+  __m128i r;
+  ghash_data_t _gd, *gd = &_gd;
 
   _mm_prefetch (tag, _MM_HINT_T0);
 
@@ -646,6 +638,92 @@ aes_gcm (const u8 * in, u8 * out, const u8 * addt, const u8 * iv, u8 * tag,
   return 1;
 }
 
+static_always_inline int
+aes_gcm (const u8 * in, u8 * out, const u8 * addt, const u8 * iv, u8 * tag,
+	 u32 data_bytes, u32 aad_bytes, u8 tag_len, aes_gcm_key_data_t * kd,
+	 int aes_rounds, int is_encrypt)
+{
+  __m128i Y0, T;
+
+  _mm_prefetch (iv, _MM_HINT_T0);
+  _mm_prefetch (in, _MM_HINT_T0);
+  _mm_prefetch (in + CLIB_CACHE_LINE_BYTES, _MM_HINT_T0);
+
+  T = aes_gcm_ghash_aad (kd, addt, aad_bytes);
+
+  /* initalize counter */
+  Y0 = _mm_loadu_si128 ((__m128i *) iv);
+  Y0 = _mm_insert_epi32 (Y0, clib_host_to_net_u32 (1), 3);
+
+  /* ghash and encrypt/edcrypt  */
+  if (is_encrypt)
+    T = aesni_gcm_enc (T, kd, Y0, 1, in, out, data_bytes, aes_rounds);
+  else
+    T = aesni_gcm_dec (T, kd, Y0, 1, in, out, data_bytes, aes_rounds);
+
+  return aes_gcm_tag (T, kd, Y0, tag, data_bytes, aad_bytes, tag_len,
+		      aes_rounds, is_encrypt);
+}
+
+/*
+ * Chained ops: the data is walked in runs of whole blocks, with the
+ * counter and the GHASH state carried over from one run to the next.
+ */
+static_always_inline int
+aes_gcm_chained (vnet_crypto_op_t * op, vnet_crypto_op_chunk_t * chunks,
+		 aes_gcm_key_data_t * kd, int aes_rounds, int is_encrypt)
+{
+  crypto_ia32_chunk_iter_t it;
+  __m128i Y0, Y, T;
+  u8 *src, *dst;
+  u32 len, ctr = 1;
+
+  T = aes_gcm_ghash_aad (kd, op->aad, op->aad_len);
+
+  Y0 = _mm_loadu_si128 ((__m128i *) op->iv);
+  Y0 = _mm_insert_epi32 (Y0, clib_host_to_net_u32 (1), 3);
+
+  crypto_ia32_chunk_iter_init (&it, chunks, op);
+  while ((len = crypto_ia32_chunk_iter_next (&it, &src, &dst)))
+    {
+      Y = _mm_insert_epi32 (Y0, clib_host_to_net_u32 (ctr), 3);
+      if (is_encrypt)
+	T = aesni_gcm_enc (T, kd, Y, ctr, src, dst, len, aes_rounds);
+      else
+	T = aesni_gcm_dec (T, kd, Y, ctr, src, dst, len, aes_rounds);
+      ctr += len / 16;
+      crypto_ia32_chunk_iter_done (&it);
+    }
+
+  return aes_gcm_tag (T, kd, Y0, op->tag, op->len, op->aad_len, op->tag_len,
+		      aes_rounds, is_encrypt);
+}
+
+static_always_inline u32
+aesni_ops_aes_gcm_chained (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+			   vnet_crypto_op_chunk_t * chunks, u32 n_ops,
+			   aesni_key_size_t ks, int is_encrypt)
+{
+  crypto_ia32_main_t *cm = &crypto_ia32_main;
+  aes_gcm_key_data_t *kd;
+  u32 i, n_fail = 0;
+
+  for (i = 0; i < n_ops; i++)
+    {
+      vnet_crypto_op_t *op = ops[i];
+      kd = (aes_gcm_key_data_t *) cm->key_data[op->key_index];
+      if (aes_gcm_chained (op, chunks, kd, AESNI_KEY_ROUNDS (ks), is_encrypt))
+	op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
+      else
+	{
+	  op->status = VNET_CRYPTO_OP_STATUS_FAIL_BAD_HMAC;
+	  n_fail++;
+	}
+    }
+
+  return n_ops - n_fail;
+}
+
 static_always_inline u32
 aesni_ops_enc_aes_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[],
 		       u32 n_ops, aesni_key_size_t ks)
@@ -728,8 +806,240 @@ aesni_gcm_key_exp (vnet_crypto_key_t * key, aesni_key_size_t ks)
   return kd;
 }
 
+#if defined (__VAES__) && defined (__VPCLMULQDQ__)
+/*
+ * VAES multi-buffer GCM. Up to 4 packets are processed in parallel, each
+ * zmm register carrying 4 consecutive counter blocks of one packet. GHASH
+ * of those 4 blocks is a lane-wise carry-less multiply by H^4..H^1 with a
+ * single reduction. Tails shorter than 64 bytes and the tag are finished
+ * with the single-buffer code above.
+ */
+#define AES_GCM_VAES_N_LANES 4
+
+typedef struct
+{
+  vnet_crypto_op_t *op;
+  aes_gcm_key_data_t *kd;
+  u8 *src, *dst;
+  u32 n_left;
+  /* counter of the first block in Y */
+  u32 ctr;
+  /* counter blocks of the next 4 data blocks */
+  __m512i Y;
+  /* H^4, H^3, H^2, H^1 */
+  __m512i H4;
+  __m128i Y0;
+  __m128i T;
+} aes_gcm_vaes_lane_t;
+
+static_always_inline __m512i
+aes_gcm_vaes_ctr4 (__m128i Y0, u32 ctr)
+{
+  __m512i c = _mm512_set_epi32 (clib_host_to_net_u32 (ctr + 3), 0, 0, 0,
+				clib_host_to_net_u32 (ctr + 2), 0, 0, 0,
+				clib_host_to_net_u32 (ctr + 1), 0, 0, 0,
+				clib_host_to_net_u32 (ctr), 0, 0, 0);
+  return c | _mm512_broadcast_i32x4 (_mm_insert_epi32 (Y0, 0, 3));
+}
+
+static_always_inline __m128i
+aes_gcm_vaes_hxor (__m512i x)
+{
+  __m256i y = _mm512_castsi512_si256 (x) ^ _mm512_extracti64x4_epi64 (x, 1);
+  return _mm256_castsi256_si128 (y) ^ _mm256_extracti128_si256 (y, 1);
+}
+
+static_always_inline __m128i
+aes_gcm_vaes_ghash4 (__m128i T, __m512i d, __m512i H4)
+{
+  ghash_data_t _gd, *gd = &_gd;
+  __m512i x, hi, lo, mid;
+
+  x = _mm512_shuffle_epi8 (d, _mm512_broadcast_i32x4 ((__m128i) bswap_mask));
+  x ^= _mm512_inserti32x4 (_mm512_setzero_si512 (), T, 0);
+
+  hi = _mm512_clmulepi64_epi128 (x, H4, 0x11);
+  lo = _mm512_clmulepi64_epi128 (x, H4, 0x00);
+  mid = _mm512_ternarylogic_epi32 (_mm512_clmulepi64_epi128 (x, H4, 0x01),
+				   _mm512_clmulepi64_epi128 (x, H4, 0x10),
+				   _mm512_setzero_si512 (), 0x96);
+
+  gd->hi = aes_gcm_vaes_hxor (hi);
+  gd->lo = aes_gcm_vaes_hxor (lo);
+  gd->mid = aes_gcm_vaes_hxor (mid);
+  gd->pending = 0;
+  ghash_reduce (gd);
+  ghash_reduce2 (gd);
+  return ghash_final (gd);
+}
+
+static_always_inline void
+aes_gcm_vaes_lane_init (aes_gcm_vaes_lane_t * l, vnet_crypto_op_t * op,
+			aes_gcm_key_data_t * kd)
+{
+  l->op = op;
+  l->kd = kd;
+  l->src = op->src;
+  l->dst = op->dst;
+  l->n_left = op->len;
+  l->T = aes_gcm_ghash_aad (kd, op->aad, op->aad_len);
+  l->Y0 = _mm_loadu_si128 ((__m128i *) op->iv);
+  l->Y0 = _mm_insert_epi32 (l->Y0, clib_host_to_net_u32 (1), 3);
+  l->ctr = 2;
+  l->Y = aes_gcm_vaes_ctr4 (l->Y0, l->ctr);
+  l->H4 = _mm512_castsi128_si512 (kd->Hi[3]);
+  l->H4 = _mm512_inserti32x4 (l->H4, kd->Hi[2], 1);
+  l->H4 = _mm512_inserti32x4 (l->H4, kd->Hi[1], 2);
+  l->H4 = _mm512_inserti32x4 (l->H4, kd->Hi[0], 3);
+}
+
+/* process the remaining < 64 bytes and the tag, returns 0 on tag mismatch */
+static_always_inline int
+aes_gcm_vaes_lane_finish (aes_gcm_vaes_lane_t * l, int rounds,
+			  int is_encrypt)
+{
+  vnet_crypto_op_t *op = l->op;
+  __m128i T, Y;
+
+  /* single-buffer code pre-increments the counter */
+  Y = _mm_insert_epi32 (l->Y0, clib_host_to_net_u32 (l->ctr - 1), 3);
+
+  if (is_encrypt)
+    T = aesni_gcm_enc (l->T, l->kd, Y, l->ctr - 1, l->src, l->dst,
+		       l->n_left, rounds);
+  else
+    T = aesni_gcm_dec (l->T, l->kd, Y, l->ctr - 1, l->src, l->dst,
+		       l->n_left, rounds);
+
+  return aes_gcm_tag (T, l->kd, l->Y0, op->tag, op->len, op->aad_len,
+		      op->tag_len, rounds, is_encrypt);
+}
+
+static_always_inline u32
+aesni_ops_aes_gcm_vaes (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+			u32 n_ops, aesni_key_size_t ks, int is_encrypt)
+{
+  crypto_ia32_main_t *cm = &crypto_ia32_main;
+  int rounds = AESNI_KEY_ROUNDS (ks);
+  aes_gcm_vaes_lane_t lanes[AES_GCM_VAES_N_LANES] = { }, *l;
+  aes_gcm_key_data_t *dummy_kd;
+  __m512i r[AES_GCM_VAES_N_LANES], d, k;
+  __m512i ctr_inc = _mm512_set_epi64 (4ULL << 56, 0, 4ULL << 56, 0,
+				      4ULL << 56, 0, 4ULL << 56, 0);
+  u8 dummy[8192];
+  u32 n_left = n_ops, n_fail = 0, active = 0, count, i, j, off;
+
+  dummy_kd = (aes_gcm_key_data_t *) cm->key_data[ops[0]->key_index];
+
+more:
+  for (i = 0; i < AES_GCM_VAES_N_LANES; i++)
+    {
+      l = lanes + i;
+
+      if ((active & (1 << i)) && l->n_left < 64)
+	{
+	  if (aes_gcm_vaes_lane_finish (l, rounds, is_encrypt))
+	    l->op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
+	  else
+	    {
+	      l->op->status = VNET_CRYPTO_OP_STATUS_FAIL_BAD_HMAC;
+	      n_fail++;
+	    }
+	  active &= ~(1 << i);
+	}
+
+      while ((active & (1 << i)) == 0 && n_left)
+	{
+	  aes_gcm_vaes_lane_init (l, ops[0], (aes_gcm_key_data_t *)
+				  cm->key_data[ops[0]->key_index]);
+	  n_left--;
+	  ops++;
+
+	  if (l->n_left >= 64)
+	    active |= 1 << i;
+	  else if (aes_gcm_vaes_lane_finish (l, rounds, is_encrypt))
+	    l->op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
+	  else
+	    {
+	      l->op->status = VNET_CRYPTO_OP_STATUS_FAIL_BAD_HMAC;
+	      n_fail++;
+	    }
+	}
+
+      if ((active & (1 << i)) == 0)
+	{
+	  /* no more work to enqueue, so we are enqueueing dummy buffer */
+	  l->kd = dummy_kd;
+	  l->src = l->dst = dummy;
+	  l->n_left = sizeof (dummy);
+	}
+    }
+
+  if (active == 0)
+    return n_ops - n_fail;
+
+  count = ~0;
+  for (i = 0; i < AES_GCM_VAES_N_LANES; i++)
+    count = clib_min (count, lanes[i].n_left & ~63);
+
+  for (off = 0; off < count; off += 64)
+    {
+      /* AES rounds */
+      for (i = 0; i < AES_GCM_VAES_N_LANES; i++)
+	r[i] = lanes[i].Y ^ _mm512_broadcast_i32x4 (lanes[i].kd->Ke[0]);
+
+      for (j = 1; j < rounds; j++)
+	for (i = 0; i < AES_GCM_VAES_N_LANES; i++)
+	  r[i] = _mm512_aesenc_epi128 (r[i],
+				       _mm512_broadcast_i32x4 (lanes[i].kd->
+							       Ke[j]));
+
+      for (i = 0; i < AES_GCM_VAES_N_LANES; i++)
+	{
+	  l = lanes + i;
+
+	  /* last round, xor-ing data into the round key */
+	  d = _mm512_loadu_si512 ((__m512i *) (l->src + off));
+	  k = _mm512_broadcast_i32x4 (l->kd->Ke[rounds]);
+	  r[i] = _mm512_aesenclast_epi128 (r[i], k ^ d);
+	  _mm512_storeu_si512 ((__m512i *) (l->dst + off), r[i]);
+
+	  /* GHASH over ciphertext */
+	  l->T = aes_gcm_vaes_ghash4 (l->T, is_encrypt ? r[i] : d, l->H4);
+
+	  /* next 4 counter blocks */
+	  if (PREDICT_TRUE ((u8) l->ctr < 249))
+	    l->Y = _mm512_add_epi64 (l->Y, ctr_inc);
+	  else
+	    l->Y = aes_gcm_vaes_ctr4 (l->Y0, l->ctr + 4);
+	  l->ctr += 4;
+	}
+    }
+
+  for (i = 0; i < AES_GCM_VAES_N_LANES; i++)
+    {
+      lanes[i].src += count;
+      lanes[i].dst += count;
+      lanes[i].n_left -= count;
+    }
+
+  goto more;
+}
+#endif
+
 #define foreach_aesni_gcm_handler_type _(128) _(192) _(256)
 
+#if defined (__VAES__) && defined (__VPCLMULQDQ__)
+#define _(x) \
+static u32 aesni_ops_dec_aes_gcm_##x                                         \
+(vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops)                      \
+{ return aesni_ops_aes_gcm_vaes (vm, ops, n_ops, AESNI_KEY_##x, 0); }        \
+static u32 aesni_ops_enc_aes_gcm_##x                                         \
+(vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops)                      \
+{ return aesni_ops_aes_gcm_vaes (vm, ops, n_ops, AESNI_KEY_##x, 1); }        \
+static void * aesni_gcm_key_exp_##x (vnet_crypto_key_t *key)                 \
+{ return aesni_gcm_key_exp (key, AESNI_KEY_##x); }
+#else
 #define _(x) \
 static u32 aesni_ops_dec_aes_gcm_##x                                         \
 (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops)                      \
@@ -739,12 +1049,30 @@ static u32 aesni_ops_enc_aes_gcm_##x                                         \
 { return aesni_ops_enc_aes_gcm (vm, ops, n_ops, AESNI_KEY_##x); }            \
 static void * aesni_gcm_key_exp_##x (vnet_crypto_key_t *key)                 \
 { return aesni_gcm_key_exp (key, AESNI_KEY_##x); }
+#endif
+
+foreach_aesni_gcm_handler_type;
+#undef _
+
+#define _(x) \
+static u32 aesni_ops_dec_aes_gcm_chained_##x                                 \
+(vlib_main_t * vm, vnet_crypto_op_t * ops[],                                 \
+ vnet_crypto_op_chunk_t * chunks, u32 n_ops)                                 \
+{ return aesni_ops_aes_gcm_chained (vm, ops, chunks, n_ops,                  \
+				    AESNI_KEY_##x, 0); }                     \
+static u32 aesni_ops_enc_aes_gcm_chained_##x                                 \
+(vlib_main_t * vm, vnet_crypto_op_t * ops[],                                 \
+ vnet_crypto_op_chunk_t * chunks, u32 n_ops)                                 \
+{ return aesni_ops_aes_gcm_chained (vm, ops, chunks, n_ops,                  \
+				    AESNI_KEY_##x, 1); }
 
 foreach_aesni_gcm_handler_type;
 #undef _
 
 clib_error_t *
-#ifdef __AVX512F__
+#if defined (__VAES__)
+crypto_ia32_aesni_gcm_init_vaes (vlib_main_t * vm)
+#elif defined (__AVX512F__)
 crypto_ia32_aesni_gcm_init_avx512 (vlib_main_t * vm)
 #elif __AVX2__
 crypto_ia32_aesni_gcm_init_avx2 (vlib_main_t * vm)
@@ -761,6 +1089,12 @@ crypto_ia32_aesni_gcm_init_sse42 (vlib_main_t * vm)
   vnet_crypto_register_ops_handler (vm, cm->crypto_engine_index, \
 				    VNET_CRYPTO_OP_AES_##x##_GCM_DEC, \
 				    aesni_ops_dec_aes_gcm_##x); \
+  vnet_crypto_register_chained_ops_handler \
+    (vm, cm->crypto_engine_index, VNET_CRYPTO_OP_AES_##x##_GCM_ENC, \
+     aesni_ops_enc_aes_gcm_chained_##x); \
+  vnet_crypto_register_chained_ops_handler \
+    (vm, cm->crypto_engine_index, VNET_CRYPTO_OP_AES_##x##_GCM_DEC, \
+     aesni_ops_dec_aes_gcm_chained_##x); \
   cm->key_fn[VNET_CRYPTO_ALG_AES_##x##_GCM] = aesni_gcm_key_exp_##x;
   foreach_aesni_gcm_handler_type;
 #undef _
@@ -35,13 +35,130 @@ typedef struct
 
 extern crypto_ia32_main_t crypto_ia32_main;
 
+/*
+ * Walks the chunks of a chained op in runs which block cipher code can
+ * process as if the data was contiguous: every run except the last one is
+ * a multiple of 16 bytes. A block straddling chunk boundaries is gathered
+ * into the bounce buffer and written back by crypto_ia32_chunk_iter_done.
+ */
+typedef struct
+{
+  vnet_crypto_op_chunk_t *chp;
+  u32 n_chunks;
+  u32 offset;
+  u32 n_left;
+  vnet_crypto_op_chunk_t *bounce_chp;
+  u32 bounce_offset;
+  u32 bounce_len;
+  u8 bounce[16];
+} crypto_ia32_chunk_iter_t;
+
+static_always_inline void
+crypto_ia32_chunk_iter_init (crypto_ia32_chunk_iter_t * it,
+			     vnet_crypto_op_chunk_t * chunks,
+			     vnet_crypto_op_t * op)
+{
+  it->chp = chunks + op->chunk_index;
+  it->n_chunks = op->n_chunks;
+  it->offset = 0;
+  it->n_left = op->len;
+  it->bounce_len = 0;
+}
+
+static_always_inline void
+crypto_ia32_chunk_iter_skip_empty (crypto_ia32_chunk_iter_t * it)
+{
+  while (it->n_chunks > 1 && it->offset == it->chp->len)
+    {
+      it->chp++;
+      it->n_chunks--;
+      it->offset = 0;
+    }
+}
+
+/* returns the length of the next run, 0 once all data was walked */
+static_always_inline u32
+crypto_ia32_chunk_iter_next (crypto_ia32_chunk_iter_t * it, u8 ** src,
+			     u8 ** dst)
+{
+  u32 len, n, n_copy;
+
+  if (it->n_left == 0)
+    return 0;
+
+  crypto_ia32_chunk_iter_skip_empty (it);
+
+  len = it->chp->len - it->offset;
+  if (len >= it->n_left)
+    len = it->n_left;
+  else
+    len &= ~15;
+
+  if (PREDICT_TRUE (len))
+    {
+      *src = it->chp->src + it->offset;
+      *dst = it->chp->dst + it->offset;
+      it->offset += len;
+      it->n_left -= len;
+      it->bounce_len = 0;
+      return len;
+    }
+
+  /* block spans chunks */
+  len = clib_min (16, it->n_left);
+  it->bounce_chp = it->chp;
+  it->bounce_offset = it->offset;
+  it->bounce_len = len;
+
+  for (n = 0; n < len; n += n_copy)
+    {
+      crypto_ia32_chunk_iter_skip_empty (it);
+      n_copy = clib_min (it->chp->len - it->offset, len - n);
+      for (u32 i = 0; i < n_copy; i++)
+	it->bounce[n + i] = it->chp->src[it->offset + i];
+      it->offset += n_copy;
+    }
+
+  it->n_left -= len;
+  *src = *dst = it->bounce;
+  return len;
+}
+
+/* writes back the output of a run which was gathered into the bounce
+   buffer */
+static_always_inline void
+crypto_ia32_chunk_iter_done (crypto_ia32_chunk_iter_t * it)
+{
+  vnet_crypto_op_chunk_t *chp = it->bounce_chp;
+  u32 offset = it->bounce_offset;
+  u32 n, n_copy;
+
+  if (PREDICT_TRUE (it->bounce_len == 0))
+    return;
+
+  for (n = 0; n < it->bounce_len; n += n_copy)
+    {
+      while (offset == chp->len)
+	{
+	  chp++;
+	  offset = 0;
+	}
+      n_copy = clib_min (chp->len - offset, it->bounce_len - n);
+      for (u32 i = 0; i < n_copy; i++)
+	chp->dst[offset + i] = it->bounce[n + i];
+      offset += n_copy;
+    }
+}
+
 clib_error_t *crypto_ia32_aesni_cbc_init_sse42 (vlib_main_t * vm);
 clib_error_t *crypto_ia32_aesni_cbc_init_avx2 (vlib_main_t * vm);
 clib_error_t *crypto_ia32_aesni_cbc_init_avx512 (vlib_main_t * vm);
+clib_error_t *crypto_ia32_aesni_cbc_init_vaes (vlib_main_t * vm);
 
 clib_error_t *crypto_ia32_aesni_gcm_init_sse42 (vlib_main_t * vm);
 clib_error_t *crypto_ia32_aesni_gcm_init_avx2 (vlib_main_t * vm);
 clib_error_t *crypto_ia32_aesni_gcm_init_avx512 (vlib_main_t * vm);
+clib_error_t *crypto_ia32_aesni_gcm_init_vaes (vlib_main_t * vm);
 #endif /* __crypto_ia32_h__ */
 
 /*
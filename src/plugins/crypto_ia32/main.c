@@ -72,6 +72,11 @@ crypto_ia32_init (vlib_main_t * vm)
     vnet_crypto_register_engine (vm, "ia32", 100,
 				 "Intel IA32 ISA Optimized Crypto");
 
+#ifdef CRYPTO_IA32_HAVE_VAES
+  if (clib_cpu_supports_vaes () && clib_cpu_supports_avx512f ())
+    error = crypto_ia32_aesni_cbc_init_vaes (vm);
+  else
+#endif
   if (clib_cpu_supports_avx512f ())
     error = crypto_ia32_aesni_cbc_init_avx512 (vm);
   else if (clib_cpu_supports_avx2 ())
@@ -84,6 +89,12 @@ crypto_ia32_init (vlib_main_t * vm)
 
   if (clib_cpu_supports_pclmulqdq ())
     {
+#ifdef CRYPTO_IA32_HAVE_VAES
+      if (clib_cpu_supports_vaes () && clib_cpu_supports_vpclmulqdq () &&
+	  clib_cpu_supports_avx512f ())
+	error = crypto_ia32_aesni_gcm_init_vaes (vm);
+      else
+#endif
       if (clib_cpu_supports_avx512f ())
 	error = crypto_ia32_aesni_gcm_init_avx512 (vm);
       else if (clib_cpu_supports_avx2 ())
@@ -57,9 +57,56 @@ static openssl_per_thread_data_t *per_thread_data = 0;
   _(SHA384, EVP_sha384) \
   _(SHA512, EVP_sha512)
 
+/*
+ * Run the chunks of a chained op through the cipher in place. EVP only
+ * outputs whole blocks, so a block which straddles chunk boundaries is
+ * gathered in a bounce block and its output scattered back byte by byte.
+ */
+static_always_inline void
+openssl_cipher_chunks (EVP_CIPHER_CTX * ctx, vnet_crypto_op_chunk_t * chp,
+		       u32 n_chunks)
+{
+  u8 bounce[EVP_MAX_BLOCK_LENGTH], *bounce_dst[EVP_MAX_BLOCK_LENGTH];
+  u32 bs = EVP_CIPHER_CTX_block_size (ctx), n_bounce = 0, n, k;
+  int out_len;
+
+  while (n_chunks--)
+    {
+      u8 *src = chp->src, *dst = chp->dst;
+      u32 len = chp->len;
+
+      /* complete the block started by the previous chunks */
+      while (n_bounce && len)
+	{
+	  bounce_dst[n_bounce] = dst++;
+	  bounce[n_bounce++] = *src++;
+	  len--;
+	  if (n_bounce == bs)
+	    {
+	      EVP_CipherUpdate (ctx, bounce, &out_len, bounce, bs);
+	      for (k = 0; k < bs; k++)
+		*bounce_dst[k] = bounce[k];
+	      n_bounce = 0;
+	    }
+	}
+
+      n = len - len % bs;
+      if (n)
+	EVP_CipherUpdate (ctx, dst, &out_len, src, n);
+
+      for (k = n; k < len; k++)
+	{
+	  bounce_dst[n_bounce] = dst + k;
+	  bounce[n_bounce++] = src[k];
+	}
+      chp++;
+    }
+}
+
 static_always_inline u32
-openssl_ops_enc_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
-		     const EVP_CIPHER * cipher)
+openssl_ops_enc_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+		     vnet_crypto_op_chunk_t * chunks, u32 n_ops,
+		     const EVP_CIPHER * cipher, const int is_chained)
 {
   openssl_per_thread_data_t *ptd = vec_elt_at_index (per_thread_data,
 						     vm->thread_index);
@@ -81,17 +128,25 @@ openssl_ops_enc_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
 	RAND_bytes (op->iv, iv_len);
 
       EVP_EncryptInit_ex (ctx, cipher, NULL, key->data, op->iv);
-      EVP_EncryptUpdate (ctx, op->dst, &out_len, op->src, op->len);
-      if (out_len < op->len)
-	EVP_EncryptFinal_ex (ctx, op->dst + out_len, &out_len);
+      /* no padding for chained ops, each update outputs all whole blocks */
+      EVP_CIPHER_CTX_set_padding (ctx, !is_chained);
+      if (is_chained)
+	openssl_cipher_chunks (ctx, chunks + op->chunk_index, op->n_chunks);
+      else
+	{
+	  EVP_EncryptUpdate (ctx, op->dst, &out_len, op->src, op->len);
+	  if (out_len < op->len)
+	    EVP_EncryptFinal_ex (ctx, op->dst + out_len, &out_len);
+	}
       op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
     }
   return n_ops;
 }
 
 static_always_inline u32
-openssl_ops_dec_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
-		     const EVP_CIPHER * cipher)
+openssl_ops_dec_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+		     vnet_crypto_op_chunk_t * chunks, u32 n_ops,
+		     const EVP_CIPHER * cipher, const int is_chained)
 {
   openssl_per_thread_data_t *ptd = vec_elt_at_index (per_thread_data,
 						     vm->thread_index);
@@ -104,22 +159,30 @@ openssl_ops_dec_cbc (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
       int out_len;
 
       EVP_DecryptInit_ex (ctx, cipher, NULL, key->data, op->iv);
-      EVP_DecryptUpdate (ctx, op->dst, &out_len, op->src, op->len);
-      if (out_len < op->len)
-	EVP_DecryptFinal_ex (ctx, op->dst + out_len, &out_len);
+      EVP_CIPHER_CTX_set_padding (ctx, !is_chained);
+      if (is_chained)
+	openssl_cipher_chunks (ctx, chunks + op->chunk_index, op->n_chunks);
+      else
+	{
+	  EVP_DecryptUpdate (ctx, op->dst, &out_len, op->src, op->len);
+	  if (out_len < op->len)
+	    EVP_DecryptFinal_ex (ctx, op->dst + out_len, &out_len);
+	}
       op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
     }
   return n_ops;
 }
 
 static_always_inline u32
-openssl_ops_enc_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
-		     const EVP_CIPHER * cipher)
+openssl_ops_enc_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+		     vnet_crypto_op_chunk_t * chunks, u32 n_ops,
+		     const EVP_CIPHER * cipher, const int is_chained)
 {
   openssl_per_thread_data_t *ptd = vec_elt_at_index (per_thread_data,
 						     vm->thread_index);
   EVP_CIPHER_CTX *ctx = ptd->evp_cipher_ctx;
-  u32 i;
+  vnet_crypto_op_chunk_t *chp;
+  u32 i, j;
   for (i = 0; i < n_ops; i++)
     {
       vnet_crypto_op_t *op = ops[i];
@@ -134,8 +197,18 @@ openssl_ops_enc_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
       EVP_EncryptInit_ex (ctx, 0, 0, key->data, op->iv);
       if (op->aad_len)
 	EVP_EncryptUpdate (ctx, NULL, &len, op->aad, op->aad_len);
-      EVP_EncryptUpdate (ctx, op->dst, &len, op->src, op->len);
-      EVP_EncryptFinal_ex (ctx, op->dst + len, &len);
+      if (is_chained)
+	{
+	  chp = chunks + op->chunk_index;
+	  for (j = 0; j < op->n_chunks; j++)
+	    EVP_EncryptUpdate (ctx, chp[j].dst, &len, chp[j].src, chp[j].len);
+	  EVP_EncryptFinal_ex (ctx, 0, &len);
+	}
+      else
+	{
+	  EVP_EncryptUpdate (ctx, op->dst, &len, op->src, op->len);
+	  EVP_EncryptFinal_ex (ctx, op->dst + len, &len);
+	}
       EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_GET_TAG, op->tag_len, op->tag);
       op->status = VNET_CRYPTO_OP_STATUS_COMPLETED;
     }
@@ -143,13 +216,15 @@ openssl_ops_enc_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
 }
 
 static_always_inline u32
-openssl_ops_dec_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
-		     const EVP_CIPHER * cipher)
+openssl_ops_dec_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+		     vnet_crypto_op_chunk_t * chunks, u32 n_ops,
+		     const EVP_CIPHER * cipher, const int is_chained)
 {
   openssl_per_thread_data_t *ptd = vec_elt_at_index (per_thread_data,
 						     vm->thread_index);
   EVP_CIPHER_CTX *ctx = ptd->evp_cipher_ctx;
-  u32 i, n_fail = 0;
+  vnet_crypto_op_chunk_t *chp;
+  u32 i, j, n_fail = 0;
   for (i = 0; i < n_ops; i++)
     {
       vnet_crypto_op_t *op = ops[i];
@@ -161,7 +236,15 @@ openssl_ops_dec_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
       EVP_DecryptInit_ex (ctx, 0, 0, key->data, op->iv);
       if (op->aad_len)
 	EVP_DecryptUpdate (ctx, 0, &len, op->aad, op->aad_len);
-      EVP_DecryptUpdate (ctx, op->dst, &len, op->src, op->len);
+      if (is_chained)
+	{
+	  chp = chunks + op->chunk_index;
+	  for (j = 0; j < op->n_chunks; j++)
+	    EVP_DecryptUpdate (ctx, chp[j].dst, &len, chp[j].src, chp[j].len);
+	  len = 0;
+	}
+      else
+	EVP_DecryptUpdate (ctx, op->dst, &len, op->src, op->len);
       EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_SET_TAG, op->tag_len, op->tag);
 
       if (EVP_DecryptFinal_ex (ctx, op->dst + len, &len) > 0)
@@ -176,14 +259,16 @@ openssl_ops_dec_gcm (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
 }
 
 static_always_inline u32
-openssl_ops_hmac (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
-		  const EVP_MD * md)
+openssl_ops_hmac (vlib_main_t * vm, vnet_crypto_op_t * ops[],
+		  vnet_crypto_op_chunk_t * chunks, u32 n_ops,
+		  const EVP_MD * md, const int is_chained)
 {
   u8 buffer[64];
   openssl_per_thread_data_t *ptd = vec_elt_at_index (per_thread_data,
 						     vm->thread_index);
   HMAC_CTX *ctx = ptd->hmac_ctx;
-  u32 i, n_fail = 0;
+  vnet_crypto_op_chunk_t *chp;
+  u32 i, j, n_fail = 0;
   for (i = 0; i < n_ops; i++)
     {
       vnet_crypto_op_t *op = ops[i];
@@ -192,7 +277,14 @@ openssl_ops_hmac (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
       size_t sz = op->digest_len ? op->digest_len : EVP_MD_size (md);
 
       HMAC_Init_ex (ctx, key->data, vec_len (key->data), md, NULL);
-      HMAC_Update (ctx, op->src, op->len);
+      if (is_chained)
+	{
+	  chp = chunks + op->chunk_index;
+	  for (j = 0; j < op->n_chunks; j++)
+	    HMAC_Update (ctx, chp[j].src, chp[j].len);
+	}
+      else
+	HMAC_Update (ctx, op->src, op->len);
       HMAC_Final (ctx, buffer, &out_len);
 
       if (op->flags & VNET_CRYPTO_OP_FLAG_HMAC_CHECK)
@@ -214,11 +306,21 @@ openssl_ops_hmac (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops,
 #define _(m, a, b) \
 static u32 \
 openssl_ops_enc_##a (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops) \
-{ return openssl_ops_enc_##m (vm, ops, n_ops, b ()); } \
+{ return openssl_ops_enc_##m (vm, ops, 0, n_ops, b (), 0); } \
 \
 u32 \
 openssl_ops_dec_##a (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops) \
-{ return openssl_ops_dec_##m (vm, ops, n_ops, b ()); }
+{ return openssl_ops_dec_##m (vm, ops, 0, n_ops, b (), 0); } \
+\
+static u32 \
+openssl_ops_enc_chained_##a (vlib_main_t * vm, vnet_crypto_op_t * ops[], \
+			     vnet_crypto_op_chunk_t * chunks, u32 n_ops) \
+{ return openssl_ops_enc_##m (vm, ops, chunks, n_ops, b (), 1); } \
+\
+static u32 \
+openssl_ops_dec_chained_##a (vlib_main_t * vm, vnet_crypto_op_t * ops[], \
+			     vnet_crypto_op_chunk_t * chunks, u32 n_ops) \
+{ return openssl_ops_dec_##m (vm, ops, chunks, n_ops, b (), 1); }
 
 foreach_openssl_evp_op;
 #undef _
@@ -226,7 +328,12 @@ foreach_openssl_evp_op;
 #define _(a, b) \
 static u32 \
 openssl_ops_hmac_##a (vlib_main_t * vm, vnet_crypto_op_t * ops[], u32 n_ops) \
-{ return openssl_ops_hmac (vm, ops, n_ops, b ()); } \
+{ return openssl_ops_hmac (vm, ops, 0, n_ops, b (), 0); } \
+\
+static u32 \
+openssl_ops_hmac_chained_##a (vlib_main_t * vm, vnet_crypto_op_t * ops[], \
+			      vnet_crypto_op_chunk_t * chunks, u32 n_ops) \
+{ return openssl_ops_hmac (vm, ops, chunks, n_ops, b (), 1); }
 
 foreach_openssl_hmac_op;
 #undef _
@@ -247,7 +354,13 @@ crypto_openssl_init (vlib_main_t * vm)
   vnet_crypto_register_ops_handler (vm, eidx, VNET_CRYPTO_OP_##a##_ENC, \
 				    openssl_ops_enc_##a); \
   vnet_crypto_register_ops_handler (vm, eidx, VNET_CRYPTO_OP_##a##_DEC, \
-				    openssl_ops_dec_##a);
+				    openssl_ops_dec_##a); \
+  vnet_crypto_register_chained_ops_handler (vm, eidx, \
+					    VNET_CRYPTO_OP_##a##_ENC, \
+					    openssl_ops_enc_chained_##a); \
+  vnet_crypto_register_chained_ops_handler (vm, eidx, \
+					    VNET_CRYPTO_OP_##a##_DEC, \
+					    openssl_ops_dec_chained_##a);
 
   foreach_openssl_evp_op;
 #undef _
@@ -255,6 +368,9 @@ crypto_openssl_init (vlib_main_t * vm)
 #define _(a, b) \
   vnet_crypto_register_ops_handler (vm, eidx, VNET_CRYPTO_OP_##a##_HMAC, \
 				    openssl_ops_hmac_##a); \
+  vnet_crypto_register_chained_ops_handler (vm, eidx, \
+					    VNET_CRYPTO_OP_##a##_HMAC, \
+					    openssl_ops_hmac_chained_##a);
 
   foreach_openssl_hmac_op;
 #undef _
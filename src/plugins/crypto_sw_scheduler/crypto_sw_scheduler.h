@@ -0,0 +1,71 @@
+/*
+ *------------------------------------------------------------------
+ * Copyright (c) 2019 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *------------------------------------------------------------------
+ */
+
+#ifndef __crypto_sw_scheduler_h__
+#define __crypto_sw_scheduler_h__
+
+#define CRYPTO_SW_SCHEDULER_QUEUE_SIZE VNET_CRYPTO_FRAME_POOL_SIZE
+#define CRYPTO_SW_SCHEDULER_QUEUE_MASK (CRYPTO_SW_SCHEDULER_QUEUE_SIZE - 1)
+
+/*
+ * Frames submitted by one thread, in submission order. Only the owner
+ * moves head (enqueue) and tail (dequeue); crypto workers claim frames
+ * by moving them from pending to work-in-progress.
+ */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile u32 head;
+  volatile u32 tail;
+  vnet_crypto_async_frame_t *jobs[CRYPTO_SW_SCHEDULER_QUEUE_SIZE];
+} crypto_sw_scheduler_queue_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  crypto_sw_scheduler_queue_t queue;
+  u32 last_serve_thread_index;
+  u8 self_crypto_enabled;
+} crypto_sw_scheduler_per_thread_data_t;
+
+/* per-thread frame counters; handoff counts frames processed for
+   another thread */
+typedef enum
+{
+  CRYPTO_SW_SCHEDULER_COUNTER_PROCESSED,
+  CRYPTO_SW_SCHEDULER_COUNTER_HANDOFF,
+  CRYPTO_SW_SCHEDULER_N_COUNTERS,
+} crypto_sw_scheduler_counter_t;
+
+typedef struct
+{
+  u32 crypto_engine_index;
+  crypto_sw_scheduler_per_thread_data_t *per_thread_data;
+  vlib_simple_counter_main_t frame_counters;
+} crypto_sw_scheduler_main_t;
+
+extern crypto_sw_scheduler_main_t crypto_sw_scheduler_main;
+
+#endif /* __crypto_sw_scheduler_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
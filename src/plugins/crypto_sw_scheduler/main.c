@@ -0,0 +1,310 @@
+/*
+ *------------------------------------------------------------------
+ * Copyright (c) 2019 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *------------------------------------------------------------------
+ */
+
+#include <vlib/vlib.h>
+#include <vnet/plugin/plugin.h>
+#include <vnet/crypto/crypto.h>
+#include <vpp/app/version.h>
+
+#include <crypto_sw_scheduler/crypto_sw_scheduler.h>
+
+crypto_sw_scheduler_main_t crypto_sw_scheduler_main;
+
+static int
+crypto_sw_scheduler_frame_enqueue (vlib_main_t * vm,
+				   vnet_crypto_async_frame_t * frame)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  crypto_sw_scheduler_per_thread_data_t *ptd =
+    vec_elt_at_index (cm->per_thread_data, vm->thread_index);
+  crypto_sw_scheduler_queue_t *q = &ptd->queue;
+  u32 head = q->head;
+
+  if (q->jobs[head & CRYPTO_SW_SCHEDULER_QUEUE_MASK])
+    return -1;
+
+  clib_atomic_store_rel_n (&q->jobs[head & CRYPTO_SW_SCHEDULER_QUEUE_MASK],
+			   frame);
+  clib_atomic_store_rel_n (&q->head, head + 1);
+  return 0;
+}
+
+/* claim the oldest pending frame of a thread's queue, if any */
+static_always_inline vnet_crypto_async_frame_t *
+crypto_sw_scheduler_get_pending_frame (crypto_sw_scheduler_queue_t * q)
+{
+  vnet_crypto_async_frame_t *f;
+  u32 head = clib_atomic_load_acq_n (&q->head);
+  u32 i;
+
+  for (i = q->tail; i != head; i++)
+    {
+      f = q->jobs[i & CRYPTO_SW_SCHEDULER_QUEUE_MASK];
+      if (!f || f->state != VNET_CRYPTO_FRAME_STATE_PENDING)
+	continue;
+      if (clib_atomic_bool_cmp_and_swap
+	  (&f->state, VNET_CRYPTO_FRAME_STATE_PENDING,
+	   VNET_CRYPTO_FRAME_STATE_WORK_IN_PROGRESS))
+	return f;
+    }
+
+  return 0;
+}
+
+/* hand the oldest frame back to its owner once it is done */
+static_always_inline vnet_crypto_async_frame_t *
+crypto_sw_scheduler_get_completed_frame (crypto_sw_scheduler_queue_t * q)
+{
+  u32 tail = q->tail;
+  vnet_crypto_async_frame_t *f;
+
+  if (tail == q->head)
+    return 0;
+
+  f = q->jobs[tail & CRYPTO_SW_SCHEDULER_QUEUE_MASK];
+  if (clib_atomic_load_acq_n (&f->state) < VNET_CRYPTO_FRAME_STATE_SUCCESS)
+    return 0;
+
+  q->jobs[tail & CRYPTO_SW_SCHEDULER_QUEUE_MASK] = 0;
+  clib_atomic_store_rel_n (&q->tail, tail + 1);
+  return f;
+}
+
+/*
+ * Called by crypto-dispatch on every thread. Threads with crypto enabled
+ * first process one pending frame from any thread, round robin, then each
+ * thread collects the completed frames it submitted itself.
+ */
+static vnet_crypto_async_frame_t *
+crypto_sw_scheduler_dequeue (vlib_main_t * vm)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  crypto_sw_scheduler_per_thread_data_t *ptd =
+    vec_elt_at_index (cm->per_thread_data, vm->thread_index);
+  u32 n_threads = vec_len (cm->per_thread_data);
+  vnet_crypto_async_frame_t *f;
+  u32 i, ti;
+
+  if (ptd->self_crypto_enabled)
+    {
+      ti = ptd->last_serve_thread_index;
+      for (i = 0; i < n_threads; i++)
+	{
+	  ti = (ti + 1) % n_threads;
+	  f = crypto_sw_scheduler_get_pending_frame
+	    (&cm->per_thread_data[ti].queue);
+	  if (f)
+	    {
+	      vnet_crypto_async_process_frame (vm, f);
+	      vlib_increment_simple_counter
+		(&cm->frame_counters, vm->thread_index,
+		 CRYPTO_SW_SCHEDULER_COUNTER_PROCESSED, 1);
+	      if (ti != vm->thread_index)
+		vlib_increment_simple_counter
+		  (&cm->frame_counters, vm->thread_index,
+		   CRYPTO_SW_SCHEDULER_COUNTER_HANDOFF, 1);
+	      break;
+	    }
+	}
+      ptd->last_serve_thread_index = ti;
+    }
+
+  return crypto_sw_scheduler_get_completed_frame (&ptd->queue);
+}
+
+static clib_error_t *
+sw_scheduler_set_worker_crypto (u32 worker_idx, u8 enabled)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  crypto_sw_scheduler_per_thread_data_t *ptd;
+  u32 count = 0, i = vlib_num_workers ()? 1 : 0;
+
+  if (worker_idx >= vlib_num_workers ())
+    return clib_error_return (0, "invalid worker %u", worker_idx);
+
+  for (; i < tm->n_vlib_mains; i++)
+    {
+      ptd = cm->per_thread_data + i;
+      count += ptd->self_crypto_enabled;
+    }
+
+  ptd = cm->per_thread_data + worker_idx + 1;
+  if (enabled || count > 1)
+    ptd->self_crypto_enabled = enabled;
+  else
+    return clib_error_return (0, "at least one worker must do crypto");
+
+  return 0;
+}
+
+static clib_error_t *
+sw_scheduler_set_worker_crypto_command_fn (vlib_main_t * vm,
+					   unformat_input_t * input,
+					   vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  clib_error_t *error = 0;
+  u32 worker_index = ~0;
+  u8 crypto_enable = ~0;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "worker %u", &worker_index))
+	{
+	  if (unformat (line_input, "crypto"))
+	    {
+	      if (unformat (line_input, "on"))
+		crypto_enable = 1;
+	      else if (unformat (line_input, "off"))
+		crypto_enable = 0;
+	    }
+	}
+      else
+	{
+	  error = clib_error_return (0, "unknown input '%U'",
+				     format_unformat_error, line_input);
+	  goto done;
+	}
+    }
+
+  if (worker_index == ~0 || crypto_enable == (u8) ~ 0)
+    {
+      error = clib_error_return (0, "missing worker index or crypto "
+				 "on|off");
+      goto done;
+    }
+
+  error = sw_scheduler_set_worker_crypto (worker_index, crypto_enable);
+
+done:
+  unformat_free (line_input);
+  return error;
+}
+
+/*?
+ * This command sets whether a worker processes frames of the software
+ * crypto scheduler. Workers with crypto off only forward packets; workers
+ * with no interfaces and crypto on act as dedicated crypto workers.
+ *
+ * @cliexpar
+ * Example of how to set worker crypto processing off:
+ * @cliexstart{set sw_scheduler worker 0 crypto off}
+ * @cliexend
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (cmd_set_sw_scheduler_worker_crypto, static) = {
+  .path = "set sw_scheduler",
+  .short_help = "set sw_scheduler worker <idx> crypto <on|off>",
+  .function = sw_scheduler_set_worker_crypto_command_fn,
+  .is_mp_safe = 1,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+sw_scheduler_show_workers_command_fn (vlib_main_t * vm,
+				      unformat_input_t * input,
+				      vlib_cli_command_t * cmd)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  crypto_sw_scheduler_per_thread_data_t *ptd;
+  u32 i;
+
+  vlib_cli_output (vm, "%-10s%-8s%-12s%-12s%s", "Thread", "Crypto",
+		   "Queued", "Processed", "Handoff");
+  for (i = 0; i < vec_len (cm->per_thread_data); i++)
+    {
+      ptd = cm->per_thread_data + i;
+      vlib_cli_output (vm, "%-10u%-8s%-12u%-12lu%lu", i,
+		       ptd->self_crypto_enabled ? "on" : "off",
+		       ptd->queue.head - ptd->queue.tail,
+		       cm->frame_counters.counters[i]
+		       [CRYPTO_SW_SCHEDULER_COUNTER_PROCESSED],
+		       cm->frame_counters.counters[i]
+		       [CRYPTO_SW_SCHEDULER_COUNTER_HANDOFF]);
+    }
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (cmd_show_sw_scheduler_workers, static) = {
+  .path = "show sw_scheduler workers",
+  .short_help = "show sw_scheduler workers",
+  .function = sw_scheduler_show_workers_command_fn,
+  .is_mp_safe = 1,
+};
+/* *INDENT-ON* */
+
+clib_error_t *
+crypto_sw_scheduler_init (vlib_main_t * vm)
+{
+  crypto_sw_scheduler_main_t *cm = &crypto_sw_scheduler_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  crypto_sw_scheduler_per_thread_data_t *ptd;
+
+  vec_validate_aligned (cm->per_thread_data, tm->n_vlib_mains - 1,
+			CLIB_CACHE_LINE_BYTES);
+
+  cm->frame_counters.name = "sw-scheduler-frames";
+  cm->frame_counters.stat_segment_name = "/crypto/sw_scheduler/frames";
+  vlib_validate_simple_counter (&cm->frame_counters,
+				CRYPTO_SW_SCHEDULER_N_COUNTERS - 1);
+  vlib_zero_simple_counter (&cm->frame_counters,
+			    CRYPTO_SW_SCHEDULER_COUNTER_PROCESSED);
+  vlib_zero_simple_counter (&cm->frame_counters,
+			    CRYPTO_SW_SCHEDULER_COUNTER_HANDOFF);
+
+  /* by default crypto runs on every worker, on main only if alone */
+  /* *INDENT-OFF* */
+  vec_foreach (ptd, cm->per_thread_data)
+    ptd->self_crypto_enabled = (tm->n_vlib_mains == 1 ||
+				ptd != cm->per_thread_data);
+  /* *INDENT-ON* */
+
+  cm->crypto_engine_index =
+    vnet_crypto_register_engine (vm, "sw_scheduler", 100,
+				 "SW Scheduler Async Engine");
+
+  vnet_crypto_register_async_handler (vm, cm->crypto_engine_index,
+				      crypto_sw_scheduler_frame_enqueue,
+				      crypto_sw_scheduler_dequeue);
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_INIT_FUNCTION (crypto_sw_scheduler_init) =
+{
+  .runs_after = VLIB_INITS ("vnet_crypto_init"),
+};
+
+VLIB_PLUGIN_REGISTER () = {
+  .version = VPP_BUILD_VER,
+  .description = "SW Scheduler Crypto Async Engine plugin",
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
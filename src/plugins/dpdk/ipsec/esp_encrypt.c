@@ -21,6 +21,7 @@
 
 #include <vnet/ipsec/ipsec.h>
 #include <vnet/ipsec/esp.h>
+#include <vnet/ipsec/ipsec_tun.h>
 #include <vnet/udp/udp.h>
 #include <dpdk/buffer.h>
 #include <dpdk/ipsec/ipsec.h>
@@ -215,11 +216,12 @@ dpdk_esp_encrypt_inline (vlib_main_t * vm,
 
 	  if (is_tun)
 	    {
-	      u32 tmp;
-	      /* we are on a ipsec tunnel's feature arc */
-	      sa_index0 = *(u32 *) vnet_feature_next_with_data (&tmp, b0,
-								sizeof
-								(sa_index0));
+	      u32 tmp, itpi0;
+	      /* we are on a ipsec tunnel's feature arc, the feature data
+	         is the tunnel protection */
+	      itpi0 = *(u32 *) vnet_feature_next_with_data (&tmp, b0,
+							    sizeof (itpi0));
+	      sa_index0 = ipsec_tun_protect_get_sa_out (itpi0);
 	    }
 	  else
 	    sa_index0 = vnet_buffer (b0)->ipsec.sad_index;
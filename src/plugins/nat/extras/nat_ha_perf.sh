@@ -0,0 +1,190 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2020 Cisco and/or its affiliates.
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at:
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# NAT HA session synchronization throughput, measured on one host.
+#
+# Two VPP instances are connected over memif. The active one creates NAT44
+# sessions from a packet-generator stream and sends them to the passive one,
+# the script reports the number of sessions per second received by the
+# passive one.
+#
+#        active                                passive
+#  ------------------                     ------------------
+#  | pg -> loop0 in |      memif1/0       |                |
+#  |      loop1 out |<------------------->|                |
+#  |   10.0.0.1:1234|      HA sync        |10.0.0.2:2345   |
+#  ------------------                     ------------------
+#
+# Usage: sudo ./nat_ha_perf.sh
+#
+# Environment:
+#   VPP_BIN_DIR    directory with vpp, vppctl and vpp_get_stats (from PATH)
+#   VPP_PLUGIN_DIR plugin directory (vpp default)
+#   SESSIONS       number of sessions to create (default 1000000)
+#   RATE           session setup rate, per second (default 200000)
+#   TIMEOUT        max seconds to wait for sessions on passive (default 60)
+#   HA_SYNC        "nat ha sync" arguments, e.g. "flush-interval 0.1
+#                  delta-refresh on" (default none)
+#   PATH_MTU       HA path MTU (default 1500)
+
+set -e
+
+BIN=${VPP_BIN_DIR:+${VPP_BIN_DIR}/}
+SESSIONS=${SESSIONS:-1000000}
+RATE=${RATE:-200000}
+TIMEOUT=${TIMEOUT:-60}
+PATH_MTU=${PATH_MTU:-1500}
+DIR=$(mktemp -d /tmp/nat-ha-perf.XXXXXX)
+PIDS=""
+
+cleanup ()
+{
+  for pid in ${PIDS}; do
+    kill ${pid} 2>/dev/null || true
+  done
+  rm -rf ${DIR}
+}
+trap cleanup EXIT
+
+# start_vpp <name> <exec-file>
+start_vpp ()
+{
+  local plugin_path=""
+
+  if [ -n "${VPP_PLUGIN_DIR}" ]; then
+    plugin_path="path ${VPP_PLUGIN_DIR}"
+  fi
+
+  ${BIN}vpp "unix { nodaemon cli-listen ${DIR}/$1-cli.sock
+                    log ${DIR}/$1.log exec $2 }
+             api-segment { prefix nat-ha-perf-$1 }
+             statseg { socket-name ${DIR}/$1-stats.sock }
+             plugins { ${plugin_path}
+                       plugin default { disable }
+                       plugin memif_plugin.so { enable }
+                       plugin ping_plugin.so { enable }
+                       plugin nat_plugin.so { enable } }
+             nat { max translations per user 100000
+                   translation hash buckets 1048576
+                   translation hash memory 536870912 }" \
+    > ${DIR}/$1.out 2>&1 &
+  PIDS="${PIDS} $!"
+}
+
+# vppctl <name> <cli>
+vppctl ()
+{
+  local name=$1
+
+  shift
+  ${BIN}vppctl -s ${DIR}/${name}-cli.sock "$@"
+}
+
+# counter <name> <stat-name>, sum over threads
+counter ()
+{
+  ${BIN}vpp_get_stats socket-name ${DIR}/$1-stats.sock dump "^$2\$" |
+    awk '{ sum += $(NF - 2) } END { print sum + 0 }'
+}
+
+cat > ${DIR}/active.conf <<EOF
+create memif socket id 1 filename ${DIR}/memif.sock
+create interface memif id 0 socket-id 1 master
+set interface ip address memif1/0 10.0.0.1/24
+set interface state memif1/0 up
+create loopback interface mac 02:fe:00:00:00:01
+create loopback interface mac 02:fe:00:00:00:02
+set interface ip address loop0 172.16.1.1/24
+set interface ip address loop1 10.15.7.1/24
+set interface state loop0 up
+set interface state loop1 up
+ip route add 2.0.0.0/8 via 10.15.7.2 loop1
+set interface nat44 in loop0 out loop1
+nat44 add address 10.15.7.100 - 10.15.7.131
+nat ha listener 10.0.0.1:1234 path-mtu ${PATH_MTU}
+nat ha failover 10.0.0.2:2345
+packet-generator new {
+  name sessions
+  limit ${SESSIONS}
+  rate ${RATE}
+  size 64-64
+  interface loop0
+  node ethernet-input
+  data { IP4: 02:fe:00:00:00:03 -> 02:fe:00:00:00:01
+         UDP: 172.16.1.2 - 172.16.1.251 -> 2.2.2.2
+         UDP: 1024 - 65535 -> 53
+         incrementing 8
+  }
+}
+EOF
+
+cat > ${DIR}/passive.conf <<EOF
+create memif socket id 1 filename ${DIR}/memif.sock
+create interface memif id 0 socket-id 1 slave
+set interface ip address memif1/0 10.0.0.2/24
+set interface state memif1/0 up
+create loopback interface mac 02:fe:00:00:00:01
+create loopback interface mac 02:fe:00:00:00:02
+set interface ip address loop0 172.16.1.1/24
+set interface ip address loop1 10.15.7.1/24
+set interface state loop0 up
+set interface state loop1 up
+set interface nat44 in loop0 out loop1
+nat44 add address 10.15.7.100 - 10.15.7.131
+nat ha listener 10.0.0.2:2345 path-mtu ${PATH_MTU}
+EOF
+
+if [ -n "${HA_SYNC}" ]; then
+  echo "nat ha sync ${HA_SYNC}" >> ${DIR}/active.conf
+  echo "nat ha sync ${HA_SYNC}" >> ${DIR}/passive.conf
+fi
+
+start_vpp active ${DIR}/active.conf
+start_vpp passive ${DIR}/passive.conf
+
+for i in $(seq 1 30); do
+  if vppctl active show memif memif1/0 2>/dev/null | grep -q "connected"; then
+    break
+  fi
+  sleep 1
+done
+vppctl active show memif memif1/0 | grep -q "connected" ||
+  { echo "memif not connected, see ${DIR}/*.out"; exit 1; }
+vppctl active ping 10.0.0.2 repeat 1 > /dev/null
+
+echo "sessions ${SESSIONS} rate ${RATE}/s ${HA_SYNC}"
+
+start=$(date +%s.%N)
+vppctl active packet-generator enable-stream sessions
+
+recv=0
+end=$(echo "${start} + ${TIMEOUT}" | bc)
+while [ ${recv} -lt ${SESSIONS} ] &&
+      [ $(echo "$(date +%s.%N) < ${end}" | bc) -eq 1 ]; do
+  sleep 0.1
+  recv=$(counter passive /nat44/ha/add-event-recv)
+done
+elapsed=$(echo "$(date +%s.%N) - ${start}" | bc)
+
+echo "active:"
+for c in add-event-send msg-send bytes-send retry-count missed-count; do
+  printf "  %-20s %s\n" ${c} $(counter active /nat44/ha/${c})
+done
+echo "passive:"
+for c in add-event-recv ack-send; do
+  printf "  %-20s %s\n" ${c} $(counter passive /nat44/ha/${c})
+done
+printf "replicated %s sessions in %.2fs, %.0f sessions/s\n" \
+  ${recv} ${elapsed} $(echo "${recv} / ${elapsed}" | bc -l)
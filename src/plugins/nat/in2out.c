@@ -282,11 +282,9 @@ slow_path (snat_main_t * sm, vlib_buffer_t * b0,
       (sm, *key0, &key1, 0, 0, 0, 0, 0, &identity_nat))
     {
       /* Try to create dynamic translation */
-      if (snat_alloc_outside_address_and_port (sm->addresses, rx_fib_index0,
-					       thread_index, &key1,
-					       sm->port_per_thread,
-					       sm->per_thread_data
-					       [thread_index].snat_thread_index))
+      if (nat44_user_alloc_outside_address_and_port (sm, &key0->addr,
+						     rx_fib_index0,
+						     thread_index, &key1))
 	{
 	  b0->error = node->errors[SNAT_IN2OUT_ERROR_OUT_OF_PORTS];
 	  return SNAT_IN2OUT_NEXT_DROP;
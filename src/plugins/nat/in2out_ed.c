@@ -227,10 +227,9 @@ slow_path_ed (snat_main_t * sm,
       (sm, key0, &key1, 0, 0, 0, &lb, 0, &identity_nat))
     {
       /* Try to create dynamic translation */
-      if (snat_alloc_outside_address_and_port (sm->addresses, rx_fib_index,
-					       thread_index, &key1,
-					       sm->port_per_thread,
-					       tsm->snat_thread_index))
+      if (nat44_user_alloc_outside_address_and_port (sm, &key0.addr,
+						     rx_fib_index,
+						     thread_index, &key1))
 	{
 	  nat_elog_notice ("addresses exhausted");
 	  b->error = node->errors[NAT_IN2OUT_ED_ERROR_OUT_OF_PORTS];
@@ -333,6 +332,7 @@ slow_path_ed (snat_main_t * sm,
 					       &ctx))
     nat_elog_notice ("out2in-ed key add failed");
 
+  nat44_session_update_end (s);
   *sessionp = s;
 
   /* log NAT event */
@@ -417,6 +417,7 @@ nat_session_alloc_or_recycle (snat_main_t * sm, snat_user_t * u,
     {
       pool_get (tsm->sessions, s);
       clib_memset (s, 0, sizeof (*s));
+      nat44_session_timer_start_new (sm, s, thread_index);
 
       /* Create list elts */
       pool_get (tsm->list_pool, per_user_translation_list_elt);
@@ -464,6 +465,7 @@ nat_ed_session_alloc (snat_main_t * sm, snat_user_t * u, u32 thread_index,
     {
       clib_dlist_addtail (tsm->list_pool,
 			  u->sessions_per_user_list_head_index, oldest_index);
+      nat44_session_update_begin (s);
       nat_free_session_data (sm, s, thread_index, 0);
       if (snat_is_session_static (s))
 	u->nstaticsessions--;
@@ -494,8 +496,18 @@ nat_ed_session_alloc (snat_main_t * sm, snat_user_t * u, u32 thread_index,
       else
 	{
 	alloc_new:
+	  if (PREDICT_FALSE (sm->ed_shared_lookup))
+	    {
+	      uword will_expand;
+
+	      pool_get_will_expand (tsm->sessions, will_expand);
+	      if (will_expand)
+		return 0;
+	    }
 	  pool_get (tsm->sessions, s);
-	  clib_memset (s, 0, sizeof (*s));
+	  nat44_session_update_begin (s);
+	  clib_memset (s, 0, STRUCT_OFFSET_OF (snat_session_t, version));
+	  nat44_session_timer_start_new (sm, s, thread_index);
 
 	  /* Create list elts */
 	  pool_get (tsm->list_pool, per_user_translation_list_elt);
@@ -548,6 +560,307 @@ snat_add_del_addr_to_fib (ip4_address_t * addr, u8 p_len, u32 sw_if_index,
     fib_table_entry_delete (fib_index, &prefix, FIB_SOURCE_PLUGIN_LOW);
 }
 
+/* first port of a port block */
+static_always_inline u16
+nat_port_block_start (snat_main_t * sm, u32 block_index)
+{
+  return 1024 +
+    (block_index / sm->port_blocks_per_thread) * sm->port_per_thread +
+    (block_index % sm->port_blocks_per_thread) * sm->port_block_size;
+}
+
+static_always_inline u64
+nat_port_block_key (snat_main_t * sm, snat_address_t * a, u32 block_index)
+{
+  return (((u64) a->addr.as_u32 << 32) |
+	  ((u64) (a - sm->addresses) << 16) | block_index);
+}
+
+static snat_address_t *
+nat_port_block_address (snat_main_t * sm, u64 key, u32 * block_index)
+{
+  u32 address_index = (key >> 16) & 0xffff;
+  snat_address_t *a;
+
+  *block_index = key & 0xffff;
+
+  /* the address may have moved in, or gone from, the addresses */
+  if (address_index >= vec_len (sm->addresses))
+    return 0;
+  a = vec_elt_at_index (sm->addresses, address_index);
+  if (a->addr.as_u32 != (u32) (key >> 32) ||
+      *block_index >= vec_len (a->port_blocks))
+    return 0;
+
+  return a;
+}
+
+static void
+nat_port_blocks_free (snat_address_t * a)
+{
+  nat_port_block_t *pb;
+
+  vec_foreach (pb, a->port_blocks) clib_bitmap_free (pb->busy_ports);
+  vec_free (a->port_blocks);
+}
+
+static void
+nat_port_block_log (snat_main_t * sm, u32 thread_index, snat_address_t * a,
+		    u32 block_index, u8 is_add)
+{
+  nat_port_block_t *pb = vec_elt_at_index (a->port_blocks, block_index);
+  u16 start = nat_port_block_start (sm, block_index);
+  u16 end = start + sm->port_block_size - 1;
+
+  nat_ipfix_logging_nat44_port_block (thread_index, pb->in_addr.as_u32,
+				      a->addr.as_u32, start, end,
+				      pb->fib_index, is_add);
+  nat_syslog_nat44_port_block (pb->fib_index, &pb->in_addr, &a->addr,
+			       start, end, is_add);
+}
+
+/**
+ * @brief Lay out the port blocks of the NAT addresses and rebuild the free
+ * block lists of the threads. Blocks assigned to subscribers are kept.
+ * Addresses bound to a tenant VRF are not used for port blocks.
+ */
+static void
+nat_port_blocks_update (snat_main_t * sm)
+{
+  snat_main_per_thread_data_t *tsm;
+  snat_address_t *a;
+  u64 user_key, block, *users = 0, *blocks = 0;
+  u32 n_blocks, block_index, thread_index, ii;
+
+  /* *INDENT-OFF* */
+  vec_foreach (tsm, sm->per_thread_data)
+    {
+      vec_reset_length (tsm->free_port_blocks);
+      vec_reset_length (tsm->reserved_port_blocks);
+    }
+
+  if (sm->addr_and_port_alloc_alg != NAT_ADDR_AND_PORT_ALLOC_ALG_PORT_BLOCK)
+    {
+      vec_foreach (a, sm->addresses)
+        nat_port_blocks_free (a);
+      vec_foreach (tsm, sm->per_thread_data)
+        hash_free (tsm->port_block_by_user);
+      return;
+    }
+
+  ASSERT (vec_len (sm->addresses) <= 0xffff);
+  n_blocks = sm->num_snat_thread * sm->port_blocks_per_thread;
+
+  vec_foreach (a, sm->addresses)
+    {
+      vec_validate (a->port_blocks, n_blocks - 1);
+      if (a->fib_index != ~0)
+        continue;
+
+      for (block_index = 0; block_index < n_blocks; block_index++)
+        {
+          if (a->port_blocks[block_index].is_assigned)
+            continue;
+
+          /* the thread that owns the block's ports */
+          if (sm->num_workers > 1)
+            thread_index = sm->first_worker_index +
+              sm->workers[block_index / sm->port_blocks_per_thread];
+          else
+            thread_index = vec_len (sm->per_thread_data) - 1;
+          tsm = vec_elt_at_index (sm->per_thread_data, thread_index);
+          vec_add1 (tsm->free_port_blocks,
+                    nat_port_block_key (sm, a, block_index));
+        }
+    }
+
+  /*
+   * the assigned blocks of addresses that moved in the addresses are
+   * found again, those of addresses that are gone are forgotten
+   */
+  vec_foreach (tsm, sm->per_thread_data)
+    {
+      vec_reset_length (users);
+      vec_reset_length (blocks);
+      hash_foreach (user_key, block, tsm->port_block_by_user,
+      ({
+        if (!nat_port_block_address (sm, block, &block_index))
+          {
+            vec_add1 (users, user_key);
+            vec_add1 (blocks, block);
+          }
+      }));
+      vec_foreach_index (ii, users)
+        {
+          hash_unset (tsm->port_block_by_user, users[ii]);
+          block_index = blocks[ii] & 0xffff;
+          vec_foreach (a, sm->addresses)
+            {
+              if (a->addr.as_u32 == (u32) (blocks[ii] >> 32) &&
+                  block_index < vec_len (a->port_blocks))
+                {
+                  hash_set (tsm->port_block_by_user, users[ii],
+                            nat_port_block_key (sm, a, block_index));
+                  break;
+                }
+            }
+        }
+    }
+  /* *INDENT-ON* */
+
+  vec_free (users);
+  vec_free (blocks);
+}
+
+/**
+ * @brief Take a free port from a port block.
+ * The search is bounded by the size of the block.
+ */
+static int
+nat_port_block_alloc_port (snat_main_t * sm, snat_address_t * a,
+			   u32 block_index, u32 thread_index,
+			   snat_session_key_t * k)
+{
+  nat_port_block_t *pb = vec_elt_at_index (a->port_blocks, block_index);
+  uword port, end, *busy;
+
+  port = nat_port_block_start (sm, block_index);
+  end = port + sm->port_block_size;
+
+  switch (k->protocol)
+    {
+#define _(N, j, n, s) \
+    case SNAT_PROTOCOL_##N: \
+      busy = a->busy_##n##_port_bitmap; \
+      break;
+      foreach_snat_protocol
+#undef _
+    default:
+      nat_elog_info ("unknown protocol");
+      return 1;
+    }
+
+  while (port < end && clib_bitmap_get_no_check (busy, port))
+    port++;
+  if (port == end)
+    return 1;
+
+  clib_bitmap_set_no_check (busy, port, 1);
+  pb->busy_ports =
+    clib_bitmap_set (pb->busy_ports,
+		     k->protocol * sm->port_block_size +
+		     port - nat_port_block_start (sm, block_index), 1);
+  switch (k->protocol)
+    {
+#define _(N, j, n, s) \
+    case SNAT_PROTOCOL_##N: \
+      a->busy_##n##_ports_per_thread[thread_index]++; \
+      a->busy_##n##_ports++; \
+      break;
+      foreach_snat_protocol
+#undef _
+    default:
+      break;
+    }
+
+  pb->n_busy++;
+  k->addr = a->addr;
+  k->port = clib_host_to_net_u16 (port);
+  return 0;
+}
+
+/**
+ * @brief Find the port block a port was taken from.
+ * @return block index, or ~0 if the port is not one taken from an
+ * assigned block (e.g. static mapping or synced from the HA active)
+ */
+static u32
+nat_port_block_of_port (snat_main_t * sm, snat_address_t * a,
+			u32 protocol, u16 port, u32 * bit)
+{
+  nat_port_block_t *pb;
+  u32 block_index, offset;
+
+  if (port < 1024 || !sm->port_block_size)
+    return ~0;
+
+  offset = port - 1024;
+  block_index = (offset % sm->port_per_thread) / sm->port_block_size;
+  if (block_index >= sm->port_blocks_per_thread)
+    return ~0;
+  block_index += (offset / sm->port_per_thread) * sm->port_blocks_per_thread;
+  if (block_index >= vec_len (a->port_blocks))
+    return ~0;
+
+  pb = vec_elt_at_index (a->port_blocks, block_index);
+  *bit = protocol * sm->port_block_size +
+    port - nat_port_block_start (sm, block_index);
+  if (!pb->is_assigned || !clib_bitmap_get (pb->busy_ports, *bit))
+    return ~0;
+
+  return block_index;
+}
+
+int
+nat_port_block_is_block_port (ip4_address_t * addr, u32 protocol, u16 port)
+{
+  snat_main_t *sm = &snat_main;
+  snat_address_t *a;
+  u32 bit;
+
+  if (sm->addr_and_port_alloc_alg != NAT_ADDR_AND_PORT_ALLOC_ALG_PORT_BLOCK)
+    return 0;
+
+  /* *INDENT-OFF* */
+  vec_foreach (a, sm->addresses)
+    {
+      if (a->addr.as_u32 == addr->as_u32)
+        return nat_port_block_of_port (sm, a, protocol,
+                                       clib_net_to_host_u16 (port),
+                                       &bit) != ~0;
+    }
+  /* *INDENT-ON* */
+
+  return 0;
+}
+
+/**
+ * @brief A port of a port block is no longer used.
+ * The block is released when its last port is.
+ */
+static void
+nat_port_block_free_port (snat_main_t * sm, snat_address_t * a,
+			  u32 thread_index, u32 protocol, u16 port)
+{
+  snat_main_per_thread_data_t *tsm = &sm->per_thread_data[thread_index];
+  snat_user_key_t u_key;
+  nat_port_block_t *pb;
+  u32 block_index, bit;
+  uword *p;
+  u64 block;
+
+  block_index = nat_port_block_of_port (sm, a, protocol, port, &bit);
+  if (block_index == ~0)
+    return;
+
+  pb = vec_elt_at_index (a->port_blocks, block_index);
+  pb->busy_ports = clib_bitmap_set (pb->busy_ports, bit, 0);
+  if (--pb->n_busy)
+    return;
+
+  block = nat_port_block_key (sm, a, block_index);
+  u_key.addr = pb->in_addr;
+  u_key.fib_index = pb->fib_index;
+  p = hash_get (tsm->port_block_by_user, u_key.as_u64);
+  if (p && p[0] == block)
+    hash_unset (tsm->port_block_by_user, u_key.as_u64);
+
+  nat_port_block_log (sm, thread_index, a, block_index, 0);
+  pb->is_assigned = 0;
+  if (a->fib_index == ~0)
+    vec_add1 (tsm->free_port_blocks, block);
+}
+
 int
 snat_add_address (snat_main_t * sm, ip4_address_t * addr, u32 vrf_id,
 		  u8 twice_nat)
@@ -580,6 +893,7 @@ snat_add_address (snat_main_t * sm, ip4_address_t * addr, u32 vrf_id,
 					 FIB_SOURCE_PLUGIN_LOW);
   else
     ap->fib_index = ~0;
+  ap->port_blocks = 0;
 #define _(N, i, n, s) \
   clib_bitmap_alloc (ap->busy_##n##_port_bitmap, 65535); \
   ap->busy_##n##_ports = 0; \
@@ -590,6 +904,8 @@ snat_add_address (snat_main_t * sm, ip4_address_t * addr, u32 vrf_id,
     if (twice_nat)
     return 0;
 
+  nat_port_blocks_update (sm);
+
   /* Add external address to FIB */
   /* *INDENT-OFF* */
   pool_foreach (i, sm->interfaces,
@@ -1714,6 +2030,7 @@ snat_del_address (snat_main_t * sm, ip4_address_t addr, u8 delete_sm,
       /* *INDENT-ON* */
     }
 
+  nat_port_blocks_free (a);
 #define _(N, i, n, s) \
   clib_bitmap_free (a->busy_##n##_port_bitmap); \
   vec_free (a->busy_##n##_ports_per_thread);
@@ -1727,6 +2044,8 @@ snat_del_address (snat_main_t * sm, ip4_address_t addr, u8 delete_sm,
   else
     vec_del1 (sm->addresses, i);
 
+  nat_port_blocks_update (sm);
+
   /* Delete external address from FIB */
   /* *INDENT-OFF* */
   pool_foreach (interface, sm->interfaces,
@@ -2169,6 +2488,11 @@ snat_set_workers (uword * bitmap)
   if (clib_bitmap_last_set (bitmap) >= sm->num_workers)
     return VNET_API_ERROR_INVALID_WORKER;
 
+  /* the port blocks are laid out by the ports of each worker */
+  if (sm->addr_and_port_alloc_alg == NAT_ADDR_AND_PORT_ALLOC_ALG_PORT_BLOCK
+      && vec_len (sm->addresses))
+    return VNET_API_ERROR_UNSUPPORTED;
+
   vec_free (sm->workers);
   /* *INDENT-OFF* */
   clib_bitmap_foreach (i, bitmap,
@@ -2182,6 +2506,8 @@ snat_set_workers (uword * bitmap)
 
   sm->port_per_thread = (0xffff - 1024) / _vec_len (sm->workers);
   sm->num_snat_thread = _vec_len (sm->workers);
+  if (sm->port_block_size)
+    sm->port_blocks_per_thread = sm->port_per_thread / sm->port_block_size;
 
   return 0;
 }
@@ -2300,6 +2626,7 @@ snat_init (vlib_main_t * vm)
   uword *bitmap = 0;
   u32 i;
   ip4_add_del_interface_address_callback_t cb4;
+  snat_main_per_thread_data_t *tsm;
   vlib_node_t *node;
 
   sm->vlib_main = vm;
@@ -2407,6 +2734,15 @@ snat_init (vlib_main_t * vm)
 
   vec_validate (sm->per_thread_data, tm->n_vlib_mains - 1);
 
+  /* *INDENT-OFF* */
+  vec_foreach (tsm, sm->per_thread_data)
+    {
+      tw_timer_wheel_init_16t_2w_512sl (&tsm->sessions_tw, 0,
+                                        NAT44_SESSION_TW_TICK, ~0);
+      tsm->sessions_tw.last_run_time = vlib_time_now (vm);
+    }
+  /* *INDENT-ON* */
+
   /* Use all available workers by default */
   if (sm->num_workers > 1)
     {
@@ -2446,6 +2782,14 @@ snat_init (vlib_main_t * vm)
   sm->total_sessions.stat_segment_name = "/nat44/total-sessions";
   vlib_validate_simple_counter (&sm->total_sessions, 0);
   vlib_zero_simple_counter (&sm->total_sessions, 0);
+  sm->expired_sessions.name = "expired-sessions";
+  sm->expired_sessions.stat_segment_name = "/nat44/expired-sessions";
+  vlib_validate_simple_counter (&sm->expired_sessions, 0);
+  vlib_zero_simple_counter (&sm->expired_sessions, 0);
+  sm->session_occupancy.name = "session-occupancy";
+  sm->session_occupancy.stat_segment_name = "/nat44/session-occupancy";
+  vlib_validate_simple_counter (&sm->session_occupancy, 0);
+  vlib_zero_simple_counter (&sm->session_occupancy, 0);
 
   /* Init IPFIX logging */
   snat_ipfix_logging_init (vm);
@@ -2506,6 +2850,10 @@ snat_free_outside_address_and_port (snat_address_t * addresses,
       nat_elog_info ("unknown protocol");
       return;
     }
+
+  if (a->port_blocks)
+    nat_port_block_free_port (&snat_main, a, thread_index, k->protocol,
+			      port_host_byte_order);
 }
 
 static int
@@ -2902,6 +3250,81 @@ exhausted:
   return 1;
 }
 
+int
+nat44_user_alloc_outside_address_and_port (snat_main_t * sm,
+					   ip4_address_t * in_addr,
+					   u32 fib_index,
+					   u32 thread_index,
+					   snat_session_key_t * k)
+{
+  snat_main_per_thread_data_t *tsm = &sm->per_thread_data[thread_index];
+  snat_user_key_t u_key;
+  nat_port_block_t *pb;
+  snat_address_t *a;
+  u32 block_index, n_tries;
+  uword *p;
+  u64 block;
+
+  if (sm->addr_and_port_alloc_alg != NAT_ADDR_AND_PORT_ALLOC_ALG_PORT_BLOCK)
+    return snat_alloc_outside_address_and_port (sm->addresses, fib_index,
+						thread_index, k,
+						sm->port_per_thread,
+						tsm->snat_thread_index);
+
+  u_key.addr = *in_addr;
+  u_key.fib_index = fib_index;
+
+  /* a port from the subscriber's current block */
+  p = hash_get (tsm->port_block_by_user, u_key.as_u64);
+  if (p)
+    {
+      a = nat_port_block_address (sm, p[0], &block_index);
+      if (a && !nat_port_block_alloc_port (sm, a, block_index, thread_index,
+					   k))
+	return 0;
+    }
+
+  /*
+   * none or it is full, assign the subscriber another. a block whose
+   * every port is reserved, by static mappings, is set aside and tried
+   * again only once the free ones are used up
+   */
+  n_tries = vec_len (tsm->free_port_blocks) +
+    vec_len (tsm->reserved_port_blocks);
+  for (; n_tries; n_tries--)
+    {
+      if (!vec_len (tsm->free_port_blocks))
+	{
+	  u64 *tmp = tsm->free_port_blocks;
+	  tsm->free_port_blocks = tsm->reserved_port_blocks;
+	  tsm->reserved_port_blocks = tmp;
+	}
+      block = vec_pop (tsm->free_port_blocks);
+      a = nat_port_block_address (sm, block, &block_index);
+      ASSERT (a);
+
+      pb = vec_elt_at_index (a->port_blocks, block_index);
+      pb->n_busy = 0;
+
+      if (nat_port_block_alloc_port (sm, a, block_index, thread_index, k))
+	{
+	  vec_add1 (tsm->reserved_port_blocks, block);
+	  continue;
+	}
+
+      pb->in_addr = *in_addr;
+      pb->fib_index = fib_index;
+      pb->is_assigned = 1;
+      hash_set (tsm->port_block_by_user, u_key.as_u64, block);
+      nat_port_block_log (sm, thread_index, a, block_index, 1);
+
+      return 0;
+    }
+
+  snat_ipfix_logging_addresses_exhausted (thread_index, 0);
+  return 1;
+}
+
 void
 nat44_add_del_address_dpo (ip4_address_t addr, u8 is_add)
 {
@@ -3665,6 +4088,8 @@ nat_ha_sadd_ed_cb (ip4_address_t * in_addr, u16 in_port,
 	      s->out2in.fib_index, out_port, eh_port);
   if (clib_bihash_add_del_16_8 (&tsm->out2in_ed, &kv, 1))
     nat_elog_warn ("out2in key add failed");
+
+  nat44_session_update_end (s);
 }
 
 void
@@ -3753,6 +4178,7 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
   u32 nat64_bib_memory_size = 128 << 20;
   u32 nat64_st_buckets = 2048;
   u32 nat64_st_memory_size = 256 << 20;
+  u8 nat64_shared_lookup = 0;
   u8 static_mapping_only = 0;
   u8 static_mapping_connection_tracking = 0;
   snat_main_per_thread_data_t *tsm;
@@ -3761,6 +4187,7 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
   sm->deterministic = 0;
   sm->out2in_dpo = 0;
   sm->endpoint_dependent = 0;
+  sm->ed_shared_lookup = 0;
 
   while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
@@ -3802,12 +4229,18 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
       else if (unformat (input, "nat64 st hash memory %d",
 			 &nat64_st_memory_size))
 	;
+      else if (unformat (input, "nat64 shared-lookup"))
+	nat64_shared_lookup = 1;
       else if (unformat (input, "out2in dpo"))
 	sm->out2in_dpo = 1;
       else if (unformat (input, "dslite ce"))
 	dslite_set_ce (dm, 1);
       else if (unformat (input, "endpoint-dependent"))
-	sm->endpoint_dependent = 1;
+	{
+	  sm->endpoint_dependent = 1;
+	  if (unformat (input, "shared-lookup"))
+	    sm->ed_shared_lookup = 1;
+	}
       else
 	return clib_error_return (0, "unknown input '%U'",
 				  format_unformat_error, input);
@@ -3850,6 +4283,8 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
 
   nat64_set_hash (nat64_bib_buckets, nat64_bib_memory_size, nat64_st_buckets,
 		  nat64_st_memory_size);
+  if (nat64_shared_lookup)
+    nat64_set_out2in_shared_lookup ();
 
   if (sm->deterministic)
     {
@@ -3917,6 +4352,10 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
                                          translation_memory_size);
                   clib_bihash_set_kvp_format_fn_16_8 (&tsm->out2in_ed,
                                                       format_ed_session_kvp);
+
+                  /* other workers read the sessions, the pool must not move */
+                  if (sm->ed_shared_lookup)
+                    pool_alloc (tsm->sessions, sm->max_translations);
                 }
               else
                 {
@@ -4280,6 +4719,7 @@ nat_set_alloc_addr_and_port_mape (u16 psid, u16 psid_offset, u16 psid_length)
   sm->psid = psid;
   sm->psid_offset = psid_offset;
   sm->psid_length = psid_length;
+  nat_port_blocks_update (sm);
 }
 
 void
@@ -4291,6 +4731,29 @@ nat_set_alloc_addr_and_port_range (u16 start_port, u16 end_port)
   sm->alloc_addr_and_port = nat_alloc_addr_and_port_range;
   sm->start_port = start_port;
   sm->end_port = end_port;
+  nat_port_blocks_update (sm);
+}
+
+int
+nat_set_alloc_addr_and_port_block (u16 block_size)
+{
+  snat_main_t *sm = &snat_main;
+
+  if (!block_size || block_size > sm->port_per_thread)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  /* the assigned blocks would have to be moved */
+  if (vec_len (sm->addresses))
+    return VNET_API_ERROR_UNSUPPORTED;
+
+  sm->addr_and_port_alloc_alg = NAT_ADDR_AND_PORT_ALLOC_ALG_PORT_BLOCK;
+  /* for the pools that are not allocated per subscriber */
+  sm->alloc_addr_and_port = nat_alloc_addr_and_port_default;
+  sm->port_block_size = block_size;
+  sm->port_blocks_per_thread = sm->port_per_thread / block_size;
+  nat_port_blocks_update (sm);
+
+  return 0;
 }
 
 void
@@ -4300,8 +4763,148 @@ nat_set_alloc_addr_and_port_default (void)
 
   sm->addr_and_port_alloc_alg = NAT_ADDR_AND_PORT_ALLOC_ALG_DEFAULT;
   sm->alloc_addr_and_port = nat_alloc_addr_and_port_default;
+  nat_port_blocks_update (sm);
+}
+
+/**
+ * @brief Check a session whose expiry timer has expired.
+ * Free it if it has been idle for its timeout, otherwise restart the timer
+ * for the time remaining.
+ */
+static int
+nat44_session_expire_one (snat_main_t * sm, u32 thread_index,
+			  u32 session_index, f64 now)
+{
+  snat_main_per_thread_data_t *tsm = &sm->per_thread_data[thread_index];
+  snat_session_t *s;
+  f64 expire;
+
+  /* freed, or freed and reused, since its timer expired */
+  if (pool_is_free_index (tsm->sessions, session_index))
+    return 0;
+  s = pool_elt_at_index (tsm->sessions, session_index);
+  if (~0 != s->expire_timer_handle)
+    return 0;
+
+  expire = s->last_heard + (f64) nat44_session_get_timeout (sm, s);
+  if (now < expire)
+    {
+      nat44_session_timer_start (sm, s, thread_index,
+				 (u32) ((expire - now) /
+					NAT44_SESSION_TW_TICK) + 1);
+      return 0;
+    }
+
+  nat_free_session_data (sm, s, thread_index, 0);
+  nat44_delete_session (sm, s, thread_index);
+  return 1;
+}
+
+/**
+ * @brief Per worker expiry of NAT44 sessions.
+ * At most NAT44_SESSION_EXPIRE_BATCH expired sessions are checked per
+ * dispatch; if more remain the node interrupts itself to continue on the
+ * next.
+ */
+static uword
+nat44_session_expire_worker_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
+				vlib_frame_t * f)
+{
+  snat_main_t *sm = &snat_main;
+  u32 thread_index = vm->thread_index;
+  snat_main_per_thread_data_t *tsm = &sm->per_thread_data[thread_index];
+  f64 now = vlib_time_now (vm);
+  u32 n_left, n_expired = 0;
+
+  if (vec_len (tsm->expired_sessions) < NAT44_SESSION_EXPIRE_BATCH)
+    {
+      u32 ii = vec_len (tsm->expired_sessions);
+
+      /* the user handle of timer 0 is the session index */
+      tsm->expired_sessions =
+	tw_timer_expire_timers_vec_16t_2w_512sl (&tsm->sessions_tw, now,
+						 tsm->expired_sessions);
+
+      /* the timers are gone, their handles may be reused */
+      for (; ii < vec_len (tsm->expired_sessions); ii++)
+	pool_elt_at_index (tsm->sessions,
+			   tsm->expired_sessions[ii])->expire_timer_handle =
+	  ~0;
+    }
+
+  n_left = clib_min (vec_len (tsm->expired_sessions),
+		     NAT44_SESSION_EXPIRE_BATCH);
+
+  while (n_left--)
+    n_expired += nat44_session_expire_one (sm, thread_index,
+					   vec_pop (tsm->expired_sessions),
+					   now);
+
+  if (vec_len (tsm->expired_sessions))
+    vlib_node_set_interrupt_pending (vm, rt->node_index);
+
+  vlib_increment_simple_counter (&sm->expired_sessions, thread_index, 0,
+				 n_expired);
+  vlib_set_simple_counter (&sm->session_occupancy, thread_index, 0,
+			   sm->max_translations ?
+			   ((u64) pool_elts (tsm->sessions) * 100) /
+			   sm->max_translations : 0);
+
+  return 0;
 }
 
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (nat44_session_expire_worker_node, static) = {
+    .function = nat44_session_expire_worker_fn,
+    .type = VLIB_NODE_TYPE_INPUT,
+    .state = VLIB_NODE_STATE_INTERRUPT,
+    .name = "nat44-session-expire-worker",
+};
+/* *INDENT-ON* */
+
+/**
+ * @brief Centralized process to drive the per worker session expiry, once
+ * every tick of the timer wheels.
+ */
+static uword
+nat44_session_expire_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
+			 vlib_frame_t * f)
+{
+  snat_main_t *sm = &snat_main;
+  snat_main_per_thread_data_t *tsm;
+  vlib_main_t *worker_vm;
+  int i, n_vms;
+
+  while (1)
+    {
+      vlib_process_suspend (vm, NAT44_SESSION_TW_TICK);
+
+      n_vms = clib_max (vec_len (vlib_mains), 1);
+      for (i = 0; i < n_vms; i++)
+	{
+	  worker_vm = (vec_len (vlib_mains) ? vlib_mains[i] : vm);
+	  if (!worker_vm || i >= vec_len (sm->per_thread_data))
+	    continue;
+
+	  tsm = &sm->per_thread_data[i];
+	  if (pool_elts (tsm->sessions) || vec_len (tsm->expired_sessions))
+	    vlib_node_set_interrupt_pending (worker_vm,
+					     nat44_session_expire_worker_node.
+					     index);
+	}
+    }
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (nat44_session_expire_node, static) = {
+    .function = nat44_session_expire_fn,
+    .type = VLIB_NODE_TYPE_PROCESS,
+    .name = "nat44-session-expire",
+};
+/* *INDENT-ON* */
+
 VLIB_NODE_FN (nat_default_node) (vlib_main_t * vm,
 				 vlib_node_runtime_t * node,
 				 vlib_frame_t * frame)
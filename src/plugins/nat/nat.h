@@ -28,6 +28,7 @@
 #include <vppinfra/bihash_16_8.h>
 #include <vppinfra/dlist.h>
 #include <vppinfra/error.h>
+#include <vppinfra/tw_timer_16t_2w_512sl.h>
 #include <vlibapi/api.h>
 #include <vlib/log.h>
 
@@ -37,6 +38,13 @@
 #define SNAT_TCP_ESTABLISHED_TIMEOUT 7440
 #define SNAT_ICMP_TIMEOUT 60
 
+/* session expiry timer wheel tick, in seconds */
+#define NAT44_SESSION_TW_TICK 1.0
+/* longest interval the timer wheel can hold, in ticks */
+#define NAT44_SESSION_TW_MAX_TICKS ((512 * 512) - 1)
+/* maximum number of expired sessions freed per dispatch */
+#define NAT44_SESSION_EXPIRE_BATCH 256
+
 /* number of worker handoff frame queue elements */
 #define NAT_FQ_NELTS 64
 
@@ -172,7 +180,8 @@ typedef enum nat_config_flags_t_
 #define foreach_nat_addr_and_port_alloc_alg \
   _(0, DEFAULT, "default")         \
   _(1, MAPE, "map-e")              \
-  _(2, RANGE, "port-range")
+  _(2, RANGE, "port-range")        \
+  _(3, PORT_BLOCK, "port-block")
 
 typedef enum
 {
@@ -338,8 +347,18 @@ typedef CLIB_PACKED(struct
   u32 i2o_fin_seq;
   u32 o2i_fin_seq;
 
+  /* Expiry timer handle, ~0 when expired and not yet checked */
+  u32 expire_timer_handle;
+
   /* user index */
   u32 user_index;
+
+  /*
+   * Odd whilst the owner tears the session down or sets it up, bumped
+   * on each, so other workers can read it consistently; kept last so a
+   * reset of the session leaves it be
+   */
+  u32 version;
 }) snat_session_t;
 /* *INDENT-ON* */
 
@@ -353,10 +372,27 @@ typedef struct
   u32 nstaticsessions;
 } snat_user_t;
 
+/* Block of outside ports assigned to a subscriber (port-block allocation) */
+typedef struct
+{
+  /* subscriber address and FIB index */
+  ip4_address_t in_addr;
+  u32 fib_index;
+  /* number of ports in use, all protocols */
+  u32 n_busy;
+  /* non-zero when assigned to a subscriber */
+  u8 is_assigned;
+  /* ports taken from the block, by protocol * block size + offset; ports
+     also set in the address' bitmaps by others (HA) are not */
+  uword *busy_ports;
+} nat_port_block_t;
+
 typedef struct
 {
   ip4_address_t addr;
   u32 fib_index;
+  /* port blocks, port-block allocation only */
+  nat_port_block_t *port_blocks;
 /* *INDENT-OFF* */
 #define _(N, i, n, s) \
   u16 busy_##n##_ports; \
@@ -513,6 +549,23 @@ typedef struct
   /* Pool of doubly-linked list elements */
   dlist_elt_t *list_pool;
 
+  /* Session expiry timers */
+  tw_timer_wheel_16t_2w_512sl_t sessions_tw;
+
+  /* Sessions whose timer has expired, to be checked for idleness */
+  u32 *expired_sessions;
+
+  /* Unassigned port blocks of the thread, port-block allocation only.
+     Each is the outside address in the upper 32 bits, its index in
+     the addresses in the next 16 and the block index in the lower 16 */
+  u64 *free_port_blocks;
+  /* Unassigned port blocks found with every port reserved, tried again
+     once the free ones are used up */
+  u64 *reserved_port_blocks;
+
+  /* Port block currently assigned to a subscriber, by user key */
+  uword *port_block_by_user;
+
   /* NAT thread index */
   u32 snat_thread_index;
 
@@ -589,6 +642,9 @@ typedef struct snat_main_s
   /* Port range parameters */
   u16 start_port;
   u16 end_port;
+  /* Port block parameters */
+  u16 port_block_size;
+  u16 port_blocks_per_thread;
 
   /* vector of outside fibs */
   nat_outside_fib_t *outside_fibs;
@@ -661,6 +717,8 @@ typedef struct snat_main_s
   u8 deterministic;
   u8 out2in_dpo;
   u8 endpoint_dependent;
+  /* any worker may translate out2in with the owner's ED session */
+  u8 ed_shared_lookup;
   u32 translation_buckets;
   u32 translation_memory_size;
   u32 max_translations;
@@ -685,6 +743,8 @@ typedef struct snat_main_s
   /* counters/gauges */
   vlib_simple_counter_main_t total_users;
   vlib_simple_counter_main_t total_sessions;
+  vlib_simple_counter_main_t expired_sessions;
+  vlib_simple_counter_main_t session_occupancy;
 
   /* API message ID base */
   u16 msg_id_base;
@@ -1342,6 +1402,33 @@ void nat_set_alloc_addr_and_port_mape (u16 psid, u16 psid_offset,
  */
 void nat_set_alloc_addr_and_port_range (u16 start_port, u16 end_port);
 
+/**
+ * @brief Set address and port assignment algorithm for port blocks
+ *
+ * Each subscriber is assigned blocks of ports, from which its sessions
+ * take theirs; allocation and release of a block is logged, not of each
+ * session. Must be set before any NAT address is added.
+ *
+ * @param block_size number of ports in a block
+ *
+ * @return 0 on success, non-zero value otherwise
+ */
+int nat_set_alloc_addr_and_port_block (u16 block_size);
+
+/**
+ * @brief Check whether an outside port was taken from a port block
+ *
+ * Sessions on such ports are logged per block, not per session.
+ *
+ * @param addr     outside IPv4 address
+ * @param protocol NAT transport protocol
+ * @param port     outside port (network byte order)
+ *
+ * @return 1 if the port is one of an assigned port block, 0 otherwise
+ */
+int nat_port_block_is_block_port (ip4_address_t * addr, u32 protocol,
+				  u16 port);
+
 /**
  * @brief Set address and port assignment algorithm to default/standard
  */
@@ -1377,6 +1464,23 @@ int snat_alloc_outside_address_and_port (snat_address_t * addresses,
 					 u16 port_per_thread,
 					 u32 snat_thread_index);
 
+/**
+ * @brief Alloc outside address and port for a subscriber's session
+ *
+ * @param sm           snat global configuration data
+ * @param in_addr      subscriber (inside) address
+ * @param fib_index    FIB table index
+ * @param thread_index thread index
+ * @param k            allocated address and port pair
+ *
+ * @return 0 on success, non-zero value otherwise
+ */
+int nat44_user_alloc_outside_address_and_port (snat_main_t * sm,
+					       ip4_address_t * in_addr,
+					       u32 fib_index,
+					       u32 thread_index,
+					       snat_session_key_t * k);
+
 /**
  * @brief Match NAT44 static mapping.
  *
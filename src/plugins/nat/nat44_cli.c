@@ -254,7 +254,8 @@ nat44_set_alloc_addr_and_port_alg_command_fn (vlib_main_t * vm,
   unformat_input_t _line_input, *line_input = &_line_input;
   snat_main_t *sm = &snat_main;
   clib_error_t *error = 0;
-  u32 psid, psid_offset, psid_length, port_start, port_end;
+  u32 psid, psid_offset, psid_length, port_start, port_end, block_size;
+  int rv;
 
   if (sm->deterministic)
     return clib_error_return (0, UNSUPPORTED_IN_DET_MODE_STR);
@@ -287,6 +288,27 @@ nat44_set_alloc_addr_and_port_alg_command_fn (vlib_main_t * vm,
 	  nat_set_alloc_addr_and_port_range ((u16) port_start,
 					     (u16) port_end);
 	}
+      else if (unformat (line_input, "port-block size %d", &block_size))
+	{
+	  if (block_size > 0xffff)
+	    rv = VNET_API_ERROR_INVALID_VALUE;
+	  else
+	    rv = nat_set_alloc_addr_and_port_block ((u16) block_size);
+	  if (rv == VNET_API_ERROR_UNSUPPORTED)
+	    {
+	      error =
+		clib_error_return (0,
+				   "Port blocks must be set before NAT "
+				   "addresses are added");
+	      goto done;
+	    }
+	  else if (rv)
+	    {
+	      error = clib_error_return (0, "The block size must be between "
+					 "1 and %d", sm->port_per_thread);
+	      goto done;
+	    }
+	}
       else
 	{
 	  error = clib_error_return (0, "unknown input '%U'",
@@ -307,6 +329,7 @@ nat44_show_alloc_addr_and_port_alg_command_fn (vlib_main_t * vm,
 					       vlib_cli_command_t * cmd)
 {
   snat_main_t *sm = &snat_main;
+  snat_main_per_thread_data_t *tsm;
 
   if (sm->deterministic)
     return clib_error_return (0, UNSUPPORTED_IN_DET_MODE_STR);
@@ -324,6 +347,22 @@ nat44_show_alloc_addr_and_port_alg_command_fn (vlib_main_t * vm,
       vlib_cli_output (vm, "  start-port %d end-port %d", sm->start_port,
 		       sm->end_port);
       break;
+    case NAT_ADDR_AND_PORT_ALLOC_ALG_PORT_BLOCK:
+      vlib_cli_output (vm, "  block size %d, %d blocks per thread",
+		       sm->port_block_size, sm->port_blocks_per_thread);
+      /* *INDENT-OFF* */
+      vec_foreach (tsm, sm->per_thread_data)
+        {
+          if (!vec_len (tsm->free_port_blocks) &&
+              !hash_elts (tsm->port_block_by_user))
+            continue;
+          vlib_cli_output (vm, "  thread %d: %d free blocks, %d subscribers",
+                           tsm - sm->per_thread_data,
+                           vec_len (tsm->free_port_blocks),
+                           hash_elts (tsm->port_block_by_user));
+        }
+      /* *INDENT-ON* */
+      break;
     default:
       break;
     }
@@ -421,6 +460,48 @@ done:
   return error;
 }
 
+static clib_error_t *
+nat_ha_sync_command_fn (vlib_main_t * vm, unformat_input_t * input,
+			vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  f64 flush_interval;
+  u8 delta_refresh;
+  int rv;
+  clib_error_t *error = 0;
+
+  /* Get a line of input. */
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  nat_ha_get_sync_params (&flush_interval, &delta_refresh);
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "flush-interval %f", &flush_interval))
+	;
+      else if (unformat (line_input, "delta-refresh on"))
+	delta_refresh = 1;
+      else if (unformat (line_input, "delta-refresh off"))
+	delta_refresh = 0;
+      else
+	{
+	  error = clib_error_return (0, "unknown input '%U'",
+				     format_unformat_error, line_input);
+	  goto done;
+	}
+    }
+
+  rv = nat_ha_set_sync_params (flush_interval, delta_refresh);
+  if (rv)
+    error = clib_error_return (0, "flush-interval must be > 0 and <= 1sec");
+
+done:
+  unformat_free (line_input);
+
+  return error;
+}
+
 static clib_error_t *
 nat_ha_listener_command_fn (vlib_main_t * vm, unformat_input_t * input,
 			    vlib_cli_command_t * cmd)
@@ -466,7 +547,8 @@ nat_show_ha_command_fn (vlib_main_t * vm, unformat_input_t * input,
   ip4_address_t addr;
   u16 port;
   u32 path_mtu, session_refresh_interval, resync_ack_missed;
-  u8 in_resync;
+  u8 in_resync, delta_refresh;
+  f64 flush_interval;
 
   nat_ha_get_listener (&addr, &port, &path_mtu);
   if (!port)
@@ -488,6 +570,11 @@ nat_show_ha_command_fn (vlib_main_t * vm, unformat_input_t * input,
   else
     vlib_cli_output (vm, "  NA\n");
 
+  nat_ha_get_sync_params (&flush_interval, &delta_refresh);
+  vlib_cli_output (vm, "SYNC:\n");
+  vlib_cli_output (vm, "  flush-interval %.3fsec delta-refresh %s\n",
+		   flush_interval, delta_refresh ? "on" : "off");
+
   nat_ha_get_resync_status (&in_resync, &resync_ack_missed);
   vlib_cli_output (vm, "RESYNC:\n");
   if (in_resync)
@@ -2012,6 +2099,9 @@ VLIB_CLI_COMMAND (snat_ipfix_logging_enable_disable_command, static) = {
  *  vpp# nat addr-port-assignment-alg map-e psid 10 psid-offset 6 psid-len 6
  * For port range use:
  *  vpp# nat addr-port-assignment-alg port-range <start-port> - <end-port>
+ * To assign each subscriber blocks of ports, logged per block rather than
+ * per session, use (before any NAT address is added):
+ *  vpp# nat addr-port-assignment-alg port-block size 512
  * To set standard (default) address and port assignment algorithm use:
  *  vpp# nat addr-port-assignment-alg default
  * @cliexend
@@ -2098,6 +2188,22 @@ VLIB_CLI_COMMAND (nat_show_ha_command, static) = {
     .function = nat_show_ha_command_fn,
 };
 
+/*?
+ * @cliexpar
+ * @cliexstart{nat ha sync}
+ * Set HA event batching. Partially filled HA messages are sent and
+ * non-ACKed messages scanned for retry every flush-interval (default 1sec).
+ * With delta-refresh on, session refresh events following an event with the
+ * same outside address and fib index omit them (failover must support it):
+ *  vpp# nat ha sync flush-interval 0.1 delta-refresh on
+ * @cliexend
+?*/
+VLIB_CLI_COMMAND (nat_ha_sync_command, static) = {
+    .path = "nat ha sync",
+    .short_help = "nat ha sync [flush-interval <sec>] [delta-refresh on|off]",
+    .function = nat_ha_sync_command_fn,
+};
+
 /*?
  * @cliexpar
  * @cliexstart{nat ha flush}
@@ -31,12 +31,14 @@ typedef struct
   u32 trace_index;
   u8 in2out;
   u8 output;
+  u8 translated;
 } nat44_handoff_trace_t;
 
 #define foreach_nat44_handoff_error                       \
 _(CONGESTION_DROP, "congestion drop")                     \
 _(SAME_WORKER, "same worker")                             \
-_(DO_HANDOFF, "do handoff")
+_(DO_HANDOFF, "do handoff")                               \
+_(SHARED_LOOKUP, "translated without handoff")
 
 typedef enum
 {
@@ -63,6 +65,10 @@ format_nat44_handoff_trace (u8 * s, va_list * args)
 
   tag = t->in2out ? "IN2OUT" : "OUT2IN";
   output = t->output ? "OUTPUT-FEATURE" : "";
+  if (t->translated)
+    return format (s, "NAT44_%s_WORKER_HANDOFF: translated with session "
+		   "of worker %d", tag, t->next_worker_index);
+
   s =
     format (s, "NAT44_%s_WORKER_HANDOFF %s: next-worker %d trace index %d",
 	    tag, output, t->next_worker_index, t->trace_index);
@@ -222,6 +228,7 @@ nat44_worker_handoff_fn_inline (vlib_main_t * vm,
 	      t->trace_index = vlib_buffer_get_trace_index (b[0]);
 	      t->in2out = is_in2out;
 	      t->output = is_output;
+	      t->translated = 0;
 
 	      b += 1;
 	      ti += 1;
@@ -249,6 +256,244 @@ nat44_worker_handoff_fn_inline (vlib_main_t * vm,
 }
 
 
+/**
+ * @brief Translate with the session of another worker.
+ * Only packets that would not change the session are translated: TCP
+ * and UDP, not fragmented, and for TCP an established session and no
+ * SYN, FIN or RST. The session is only read, except for its last heard
+ * time; its owner updates its counters, state and LRU position.
+ * The owner may free and reuse the session while it is read, the session
+ * pools are preallocated so the memory remains. The session's version is
+ * read before and after its translation, and the packet is handed off if
+ * the owner was changing the session or changed it meanwhile.
+ *
+ * @return 1 if translated
+ */
+static_always_inline int
+nat44_ed_out2in_shared_translate (snat_main_t * sm, vlib_buffer_t * b,
+				  ip4_header_t * ip, u32 rx_fib_index,
+				  f64 now, u32 * owner)
+{
+  snat_main_per_thread_data_t *tsm;
+  clib_bihash_kv_16_8_t kv, value;
+  u32 old_addr, new_addr, fib_index;
+  u16 old_port, new_port, ext_port;
+  ip4_address_t ext_addr;
+  udp_header_t *udp;
+  tcp_header_t *tcp;
+  snat_session_t *s;
+  u8 twice_nat;
+  ip_csum_t sum;
+  u32 version;
+
+  if (PREDICT_FALSE (ip->protocol != IP_PROTOCOL_TCP &&
+		     ip->protocol != IP_PROTOCOL_UDP))
+    return 0;
+  if (PREDICT_FALSE (ip4_is_fragment (ip) || ip->ttl == 1))
+    return 0;
+
+  udp = ip4_next_header (ip);
+  tcp = (tcp_header_t *) udp;
+
+  if (ip->protocol == IP_PROTOCOL_TCP &&
+      (tcp->flags & (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST)))
+    return 0;
+
+  make_ed_kv (&kv, &ip->dst_address, &ip->src_address, ip->protocol,
+	      rx_fib_index, udp->dst_port, udp->src_port);
+
+  /* *INDENT-OFF* */
+  vec_foreach (tsm, sm->per_thread_data)
+    {
+      if (!clib_bihash_search_16_8 (&tsm->out2in_ed, &kv, &value))
+        goto found;
+    }
+  /* *INDENT-ON* */
+  return 0;
+
+found:
+  if (PREDICT_FALSE (value.value >= vec_len (tsm->sessions)))
+    return 0;
+
+  s = tsm->sessions + value.value;
+
+  version = clib_atomic_load_acq_n (&s->version);
+  if (PREDICT_FALSE (version & 1))
+    return 0;
+
+  new_addr = s->in2out.addr.as_u32;
+  new_port = s->in2out.port;
+  fib_index = s->in2out.fib_index;
+  twice_nat = is_twice_nat_session (s);
+  ext_addr = s->ext_host_nat_addr;
+  ext_port = s->ext_host_nat_port;
+
+  if (PREDICT_FALSE (s->state ||
+		     s->out2in.addr.as_u32 != ip->dst_address.as_u32 ||
+		     s->out2in.port != udp->dst_port ||
+		     s->ext_host_addr.as_u32 != ip->src_address.as_u32 ||
+		     s->ext_host_port != udp->src_port))
+    return 0;
+
+  /* the reads above are done before the version is read again */
+  CLIB_MEMORY_BARRIER ();
+  if (PREDICT_FALSE (clib_atomic_load_acq_n (&s->version) != version))
+    return 0;
+
+  *owner = sm->first_worker_index + tsm->thread_index;
+
+  old_addr = ip->dst_address.as_u32;
+  ip->dst_address.as_u32 = new_addr;
+  vnet_buffer (b)->sw_if_index[VLIB_TX] = fib_index;
+  vnet_buffer (b)->snat.flags = 0;
+
+  sum = ip->checksum;
+  sum = ip_csum_update (sum, old_addr, new_addr, ip4_header_t, dst_address);
+  if (PREDICT_FALSE (twice_nat))
+    sum = ip_csum_update (sum, ip->src_address.as_u32, ext_addr.as_u32,
+			  ip4_header_t, src_address);
+  ip->checksum = ip_csum_fold (sum);
+
+  old_port = udp->dst_port;
+  udp->dst_port = new_port;
+
+  if (ip->protocol == IP_PROTOCOL_TCP || udp->checksum)
+    {
+      sum = (ip->protocol == IP_PROTOCOL_TCP ? tcp->checksum : udp->checksum);
+      sum = ip_csum_update (sum, old_addr, new_addr, ip4_header_t,
+			    dst_address);
+      sum = ip_csum_update (sum, old_port, new_port, ip4_header_t, length);
+      if (PREDICT_FALSE (twice_nat))
+	{
+	  sum = ip_csum_update (sum, ip->src_address.as_u32,
+				ext_addr.as_u32, ip4_header_t, src_address);
+	  sum = ip_csum_update (sum, udp->src_port, ext_port, ip4_header_t,
+				length);
+	}
+      if (ip->protocol == IP_PROTOCOL_TCP)
+	tcp->checksum = ip_csum_fold (sum);
+      else
+	udp->checksum = ip_csum_fold (sum);
+    }
+  if (PREDICT_FALSE (twice_nat))
+    {
+      udp->src_port = ext_port;
+      ip->src_address.as_u32 = ext_addr.as_u32;
+    }
+
+  /*
+   * keep the session alive, if it is still the same one; a racing store
+   * by the owner is as recent
+   */
+  if (PREDICT_TRUE (clib_atomic_load_acq_n (&s->version) == version))
+    s->last_heard = now;
+
+  return 1;
+}
+
+/**
+ * @brief ED out2in with shared session lookup.
+ * Packets that match an established session of any worker are translated
+ * here and continue on the feature arc, the rest are handed off to the
+ * owner as usual.
+ */
+static inline uword
+nat44_ed_out2in_shared_fn_inline (vlib_main_t * vm,
+				  vlib_node_runtime_t * node,
+				  vlib_frame_t * frame)
+{
+  u32 n_left_from, *from, n_enq, n_handoff = 0, n_local = 0;
+  u32 same_worker = 0, do_handoff = 0;
+  u32 handoff_bis[VLIB_FRAME_SIZE], local_bis[VLIB_FRAME_SIZE];
+  u16 thread_indices[VLIB_FRAME_SIZE], nexts[VLIB_FRAME_SIZE];
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b = bufs;
+  u32 thread_index = vm->thread_index;
+  snat_main_t *sm = &snat_main;
+  f64 now = vlib_time_now (vm);
+
+  from = vlib_frame_vector_args (frame);
+  n_left_from = frame->n_vectors;
+
+  vlib_get_buffers (vm, from, b, n_left_from);
+
+  while (n_left_from > 0)
+    {
+      u32 sw_if_index0, rx_fib_index0, next0, ti0;
+      ip4_header_t *ip0;
+      u8 translated0;
+
+      if (PREDICT_TRUE (n_left_from >= 2))
+	{
+	  vlib_prefetch_buffer_header (b[1], STORE);
+	  CLIB_PREFETCH (&b[1]->data, CLIB_CACHE_LINE_BYTES, STORE);
+	}
+
+      ip0 = vlib_buffer_get_current (b[0]);
+      sw_if_index0 = vnet_buffer (b[0])->sw_if_index[VLIB_RX];
+      rx_fib_index0 = ip4_fib_table_get_index_for_sw_if_index (sw_if_index0);
+
+      translated0 = nat44_ed_out2in_shared_translate (sm, b[0], ip0,
+						      rx_fib_index0, now,
+						      &ti0);
+      if (translated0)
+	{
+	  vnet_feature_next (&next0, b[0]);
+	  local_bis[n_local] = from[0];
+	  nexts[n_local] = next0;
+	  n_local++;
+	}
+      else
+	{
+	  ti0 = sm->worker_out2in_cb (ip0, rx_fib_index0, 0);
+	  handoff_bis[n_handoff] = from[0];
+	  thread_indices[n_handoff] = ti0;
+	  n_handoff++;
+
+	  if (ti0 == thread_index)
+	    same_worker++;
+	  else
+	    do_handoff++;
+	}
+
+      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
+			 (b[0]->flags & VLIB_BUFFER_IS_TRACED)))
+	{
+	  nat44_handoff_trace_t *t =
+	    vlib_add_trace (vm, node, b[0], sizeof (*t));
+	  t->next_worker_index = ti0;
+	  t->trace_index = vlib_buffer_get_trace_index (b[0]);
+	  t->in2out = 0;
+	  t->output = 0;
+	  t->translated = translated0;
+	}
+
+      b += 1;
+      from += 1;
+      n_left_from -= 1;
+    }
+
+  if (n_local)
+    vlib_buffer_enqueue_to_next (vm, node, local_bis, nexts, n_local);
+
+  if (n_handoff)
+    {
+      n_enq = vlib_buffer_enqueue_to_thread (vm, sm->fq_out2in_index,
+					     handoff_bis, thread_indices,
+					     n_handoff, 1);
+      if (n_enq < n_handoff)
+	vlib_node_increment_counter (vm, node->node_index,
+				     NAT44_HANDOFF_ERROR_CONGESTION_DROP,
+				     n_handoff - n_enq);
+    }
+
+  vlib_node_increment_counter (vm, node->node_index,
+			       NAT44_HANDOFF_ERROR_SHARED_LOOKUP, n_local);
+  vlib_node_increment_counter (vm, node->node_index,
+			       NAT44_HANDOFF_ERROR_SAME_WORKER, same_worker);
+  vlib_node_increment_counter (vm, node->node_index,
+			       NAT44_HANDOFF_ERROR_DO_HANDOFF, do_handoff);
+  return frame->n_vectors;
+}
 
 VLIB_NODE_FN (snat_in2out_worker_handoff_node) (vlib_main_t * vm,
 						vlib_node_runtime_t * node,
@@ -293,6 +538,11 @@ VLIB_NODE_FN (snat_out2in_worker_handoff_node) (vlib_main_t * vm,
 						vlib_node_runtime_t * node,
 						vlib_frame_t * frame)
 {
+  snat_main_t *sm = &snat_main;
+
+  if (sm->endpoint_dependent && sm->ed_shared_lookup)
+    return nat44_ed_out2in_shared_fn_inline (vm, node, frame);
+
   return nat44_worker_handoff_fn_inline (vm, node, frame, 0, 0);
 }
 
@@ -281,6 +281,10 @@ nat64_init (vlib_main_t * vm)
   nm->total_sessions.stat_segment_name = "/nat64/total-sessions";
   vlib_validate_simple_counter (&nm->total_sessions, 0);
   vlib_zero_simple_counter (&nm->total_sessions, 0);
+  nm->expired_sessions.name = "expired-sessions";
+  nm->expired_sessions.stat_segment_name = "/nat64/expired-sessions";
+  vlib_validate_simple_counter (&nm->expired_sessions, 0);
+  vlib_zero_simple_counter (&nm->expired_sessions, 0);
 
   return 0;
 }
@@ -311,6 +315,28 @@ nat64_set_hash (u32 bib_buckets, u32 bib_memory_size, u32 st_buckets,
   /* *INDENT-ON* */
 }
 
+void
+nat64_set_out2in_shared_lookup (void)
+{
+  nat64_main_t *nm = &nat64_main;
+  nat64_db_t *db;
+
+  nm->out2in_shared_lookup = 1;
+
+  /* other workers read the TCP and UDP entries, the pools must not move;
+     the entries never outnumber the limits. They also update the session
+     expire and version word atomically, it must be 8-byte aligned */
+  /* *INDENT-OFF* */
+  vec_foreach (db, nm->db)
+    {
+      pool_alloc (db->bib._tcp_bib, db->bib.limit);
+      pool_alloc (db->bib._udp_bib, db->bib.limit);
+      pool_alloc_aligned (db->st._tcp_st, db->st.limit, sizeof (u64));
+      pool_alloc_aligned (db->st._udp_st, db->st.limit, sizeof (u64));
+    }
+  /* *INDENT-ON* */
+}
+
 int
 nat64_add_del_pool_addr (u32 thread_index,
 			 ip4_address_t * addr, u32 vrf_id, u8 is_add)
@@ -897,12 +923,13 @@ nat64_session_reset_timeout (nat64_db_st_entry_t * ste, vlib_main_t * vm)
 {
   nat64_main_t *nm = &nat64_main;
   u32 now = (u32) vlib_time_now (vm);
+  u32 timeout, expire;
 
   switch (ip_proto_to_snat_proto (ste->proto))
     {
     case SNAT_PROTOCOL_ICMP:
-      ste->expire = now + nm->icmp_timeout;
-      return;
+      timeout = nm->icmp_timeout;
+      break;
     case SNAT_PROTOCOL_TCP:
       {
 	switch (ste->tcp_state)
@@ -913,22 +940,32 @@ nat64_session_reset_timeout (nat64_db_st_entry_t * ste, vlib_main_t * vm)
 	  case NAT64_TCP_STATE_V6_FIN_RCV:
 	  case NAT64_TCP_STATE_V6_FIN_V4_FIN_RCV:
 	  case NAT64_TCP_STATE_TRANS:
-	    ste->expire = now + nm->tcp_trans_timeout;
-	    return;
+	    timeout = nm->tcp_trans_timeout;
+	    break;
 	  case NAT64_TCP_STATE_ESTABLISHED:
-	    ste->expire = now + nm->tcp_est_timeout;
-	    return;
+	    timeout = nm->tcp_est_timeout;
+	    break;
 	  default:
 	    return;
 	  }
+	break;
       }
     case SNAT_PROTOCOL_UDP:
-      ste->expire = now + nm->udp_timeout;
-      return;
+      timeout = nm->udp_timeout;
+      break;
     default:
-      ste->expire = now + nm->udp_timeout;
-      return;
+      timeout = nm->udp_timeout;
+      break;
     }
+
+  expire = now + timeout;
+
+  /* the timer is not restarted as the session is used, only when it would
+     fire too late */
+  if (~0 == ste->expire_timer_handle || expire < ste->expire)
+    nat64_db_st_entry_timer_start (&nm->db[vm->thread_index], ste, timeout);
+
+  ste->expire = expire;
 }
 
 void
@@ -1199,7 +1236,10 @@ nat64_extract_ip4 (ip6_address_t * ip6, ip4_address_t * ip4, u32 fib_index)
 }
 
 /**
- * @brief Per worker process checking expire time for NAT64 sessions.
+ * @brief Per worker expiry of NAT64 sessions.
+ * At most NAT64_DB_ST_EXPIRE_BATCH expired sessions are checked per
+ * dispatch; if more remain the node interrupts itself to continue on the
+ * next.
  */
 static uword
 nat64_expire_worker_walk_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
@@ -1208,9 +1248,14 @@ nat64_expire_worker_walk_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
   nat64_main_t *nm = &nat64_main;
   u32 thread_index = vm->thread_index;
   nat64_db_t *db = &nm->db[thread_index];
-  u32 now = (u32) vlib_time_now (vm);
+  u32 n_expired;
+
+  n_expired = nad64_db_st_free_expired (thread_index, db, vlib_time_now (vm));
+  if (vec_len (db->st.expired))
+    vlib_node_set_interrupt_pending (vm, rt->node_index);
 
-  nad64_db_st_free_expired (thread_index, db, now);
+  vlib_increment_simple_counter (&nm->expired_sessions, thread_index, 0,
+				 n_expired);
   vlib_set_simple_counter (&nm->total_bibs, thread_index, 0,
 			   db->bib.bib_entries_num);
   vlib_set_simple_counter (&nm->total_sessions, thread_index, 0,
@@ -1233,7 +1278,8 @@ VLIB_REGISTER_NODE (nat64_expire_worker_walk_node, static) = {
 static vlib_node_registration_t nat64_expire_walk_node;
 
 /**
- * @brief Centralized process to drive per worker expire walk.
+ * @brief Centralized process to drive per worker session expiry, once
+ * every tick of the timer wheels.
  */
 static uword
 nat64_expire_walk_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
@@ -1262,7 +1308,7 @@ nat64_expire_walk_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
     {
       if (nm->total_enabled_count)
 	{
-	  vlib_process_wait_for_event_or_clock (vm, 10.0);
+	  vlib_process_wait_for_event_or_clock (vm, NAT64_DB_ST_TW_TICK);
 	  event_type = vlib_process_get_events (vm, &event_data);
 	}
       else
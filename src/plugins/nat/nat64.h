@@ -86,6 +86,9 @@ typedef struct
   u32 fq_in2out_index;
   u32 fq_out2in_index;
 
+  /** any worker may translate out2in with the owner's session */
+  u8 out2in_shared_lookup;
+
   /** Pool of static BIB entries to be added/deleted in worker threads */
   nat64_static_bib_to_update_t *static_bibs;
 
@@ -109,6 +112,7 @@ typedef struct
   /* counters/gauges */
   vlib_simple_counter_main_t total_bibs;
   vlib_simple_counter_main_t total_sessions;
+  vlib_simple_counter_main_t expired_sessions;
 
   /** node index **/
   u32 error_node_index;
@@ -291,6 +295,9 @@ u32 nat64_get_tcp_est_timeout (void);
 /**
  * @brief Reset NAT64 session timeout.
  *
+ * Starts the session expiry timer if it is not running, or restarts it if
+ * the session now expires earlier.
+ *
  * @param ste Session table entry.
  * @param vm VLIB main.
  **/
@@ -364,6 +371,16 @@ void nat64_extract_ip4 (ip6_address_t * ip6, ip4_address_t * ip4,
 void nat64_set_hash (u32 bib_buckets, u32 bib_memory_size, u32 st_buckets,
 		     u32 st_memory_size);
 
+/**
+ * @brief Let any worker translate out2in TCP and UDP packets of
+ * established sessions with the session of their owner, instead of
+ * handing them off.
+ *
+ * The TCP and UDP BIB and session pools are allocated up front to the
+ * limits, so call after nat64_set_hash.
+ */
+void nat64_set_out2in_shared_lookup (void);
+
 /**
  * @brief Get worker thread index for NAT64 in2out.
  *
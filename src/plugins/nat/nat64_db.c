@@ -22,6 +22,24 @@
 #include <nat/nat_syslog.h>
 #include <vnet/fib/fib_table.h>
 
+/**
+ * @brief Maximum number of entries of a lookup hash.
+ * Keep the load factor at most 10, and the entries within the hash memory.
+ * The pages of a bucket double as it grows, so allow for twice the
+ * key-value pairs.
+ */
+static u32
+nat64_db_limit (u32 buckets, u32 memory_size, uword kv_size)
+{
+  u64 bucket_bytes = (u64) buckets * sizeof (u64);
+  u64 limit = 10 * (u64) buckets;
+
+  if (memory_size <= bucket_bytes)
+    return 0;
+
+  return clib_min (limit, (memory_size - bucket_bytes) / (2 * kv_size));
+}
+
 int
 nat64_db_init (nat64_db_t * db, u32 bib_buckets, u32 bib_memory_size,
 	       u32 st_buckets, u32 st_memory_size,
@@ -39,13 +57,22 @@ nat64_db_init (nat64_db_t * db, u32 bib_buckets, u32 bib_memory_size,
   clib_bihash_init_48_8 (&db->st.out2in, "st-out2in", st_buckets,
 			 st_memory_size);
 
+  tw_timer_wheel_init_16t_2w_512sl (&db->st.tw, 0, NAT64_DB_ST_TW_TICK, ~0);
+  db->st.tw.last_run_time = vlib_time_now (vlib_get_main ());
+  db->st.expired = 0;
+
   db->free_addr_port_cb = free_addr_port_cb;
-  db->bib.limit = 10 * bib_buckets;
+  db->bib.limit = nat64_db_limit (bib_buckets, bib_memory_size,
+				  sizeof (clib_bihash_kv_24_8_t));
   db->bib.bib_entries_num = 0;
-  db->st.limit = 10 * st_buckets;
+  db->st.limit = nat64_db_limit (st_buckets, st_memory_size,
+				 sizeof (clib_bihash_kv_48_8_t));
   db->st.st_entries_num = 0;
   db->addr_free = 0;
 
+  if (!db->bib.limit || !db->st.limit)
+    return 1;
+
   return 0;
 }
 
@@ -372,6 +399,28 @@ nat64_db_st_walk (nat64_db_t * db, u8 proto,
     }
 }
 
+/*
+ * The owner is about to create or free a session; other workers reading it
+ * for the shared out2in lookup see the version change and do not use it
+ */
+static_always_inline void
+nat64_db_st_entry_update_begin (nat64_db_st_entry_t * ste)
+{
+  if (ste->version & 1)
+    return;
+  clib_atomic_store_rel_n (&ste->version, ste->version + 1);
+  CLIB_MEMORY_STORE_BARRIER ();
+}
+
+/* The session is complete, other workers may use it */
+static_always_inline void
+nat64_db_st_entry_update_end (nat64_db_st_entry_t * ste)
+{
+  if (!(ste->version & 1))
+    return;
+  clib_atomic_store_rel_n (&ste->version, ste->version + 1);
+}
+
 nat64_db_st_entry_t *
 nat64_db_st_entry_create (u32 thread_index, nat64_db_t * db,
 			  nat64_db_bib_entry_t * bibe,
@@ -412,13 +461,17 @@ nat64_db_st_entry_create (u32 thread_index, nat64_db_t * db,
 
   db->st.st_entries_num++;
 
-  clib_memset (ste, 0, sizeof (*ste));
+  nat64_db_st_entry_update_begin (ste);
+  clib_memset (ste, 0, STRUCT_OFFSET_OF (nat64_db_st_entry_t, expire));
+  ste->expire = 0;
   ste->in_r_addr.as_u64[0] = in_r_addr->as_u64[0];
   ste->in_r_addr.as_u64[1] = in_r_addr->as_u64[1];
   ste->out_r_addr.as_u32 = out_r_addr->as_u32;
   ste->r_port = r_port;
   ste->bibe_index = bibe - bib;
   ste->proto = bibe->proto;
+  ste->expire_timer_handle = ~0;
+  nat64_db_st_entry_update_end (ste);
 
   /* increment session number for BIB entry */
   bibe->ses_num++;
@@ -497,8 +550,12 @@ nat64_db_st_entry_free (u32 thread_index,
 
   bibe = pool_elt_at_index (bib, ste->bibe_index);
 
+  nat64_db_st_entry_update_begin (ste);
   db->st.st_entries_num--;
 
+  if (~0 != ste->expire_timer_handle)
+    tw_timer_stop_16t_2w_512sl (&db->st.tw, ste->expire_timer_handle);
+
   /* delete hash lookup */
   clib_memset (&ste_key, 0, sizeof (ste_key));
   ste_key.l_addr.as_u64[0] = bibe->in_addr.as_u64[0];
@@ -647,38 +704,114 @@ nat64_db_st_entry_by_index (nat64_db_t * db, u8 proto, u32 ste_index)
   return pool_elt_at_index (st, ste_index);
 }
 
-void
-nad64_db_st_free_expired (u32 thread_index, nat64_db_t * db, u32 now)
-{
-  u32 *ste_to_be_free = 0, *ste_index;
-  nat64_db_st_entry_t *st, *ste;
+/* expiry timer user handle, the timer id above the session index */
+#define nat64_db_st_timer_id(h) ((h) >> 28)
+#define nat64_db_st_timer_index(h) ((h) & ((1 << 28) - 1))
 
+static_always_inline nat64_db_st_entry_t *
+nat64_db_st_by_timer_id (nat64_db_t * db, u32 timer_id)
+{
+  switch (timer_id)
+    {
 /* *INDENT-OFF* */
 #define _(N, i, n, s) \
-  st = db->st._##n##_st; \
-  pool_foreach (ste, st, ({\
-    if (i == SNAT_PROTOCOL_TCP && !ste->tcp_state) \
-      continue; \
-    if (ste->expire < now) \
-      vec_add1 (ste_to_be_free, ste - st); \
-  })); \
-  vec_foreach (ste_index, ste_to_be_free) \
-    nat64_db_st_entry_free (thread_index, db, \
-                            pool_elt_at_index(st, ste_index[0])); \
-  vec_free (ste_to_be_free); \
-  ste_to_be_free = 0;
-  foreach_snat_protocol
+    case SNAT_PROTOCOL_##N: \
+      return db->st._##n##_st;
+      foreach_snat_protocol
 #undef _
-  st = db->st._unk_proto_st;
-  pool_foreach (ste, st, ({
-    if (ste->expire < now)
-      vec_add1 (ste_to_be_free, ste - st);
-  }));
-  vec_foreach (ste_index, ste_to_be_free)
-    nat64_db_st_entry_free (thread_index, db,
-                            pool_elt_at_index(st, ste_index[0]));
-  vec_free (ste_to_be_free);
 /* *INDENT-ON* */
+    default:
+      return db->st._unk_proto_st;
+    }
+}
+
+void
+nat64_db_st_entry_timer_start (nat64_db_t * db, nat64_db_st_entry_t * ste,
+			       u32 ticks)
+{
+  u32 proto, timer_id;
+  nat64_db_st_entry_t *st;
+
+  proto = ip_proto_to_snat_proto (ste->proto);
+  timer_id = (proto == ~0 ? NAT64_DB_ST_TIMER_UNK_PROTO : proto);
+  st = nat64_db_st_by_timer_id (db, timer_id);
+
+  if (~0 != ste->expire_timer_handle)
+    tw_timer_stop_16t_2w_512sl (&db->st.tw, ste->expire_timer_handle);
+
+  ticks = clib_max (ticks, 1);
+  ticks = clib_min (ticks, NAT64_DB_ST_TW_MAX_TICKS);
+  ste->expire_timer_handle =
+    tw_timer_start_16t_2w_512sl (&db->st.tw, ste - st, timer_id, ticks);
+}
+
+/**
+ * @brief Check a session whose expiry timer has expired.
+ * Free it if its expire time has passed, otherwise restart the timer for
+ * the time remaining. TCP sessions in the closed state do not expire.
+ */
+static int
+nat64_db_st_expire_one (u32 thread_index, nat64_db_t * db, u32 handle,
+			u32 now)
+{
+  u32 timer_id = nat64_db_st_timer_id (handle);
+  u32 ste_index = nat64_db_st_timer_index (handle);
+  nat64_db_st_entry_t *st, *ste;
+
+  st = nat64_db_st_by_timer_id (db, timer_id);
+
+  /* freed, or freed and reused, since its timer expired */
+  if (pool_is_free_index (st, ste_index))
+    return 0;
+  ste = pool_elt_at_index (st, ste_index);
+  if (~0 != ste->expire_timer_handle)
+    return 0;
+
+  if (timer_id == SNAT_PROTOCOL_TCP && !ste->tcp_state)
+    return 0;
+
+  if (ste->expire >= now)
+    {
+      nat64_db_st_entry_timer_start (db, ste, ste->expire - now + 1);
+      return 0;
+    }
+
+  nat64_db_st_entry_free (thread_index, db, ste);
+  return 1;
+}
+
+u32
+nad64_db_st_free_expired (u32 thread_index, nat64_db_t * db, f64 now)
+{
+  u32 n_left, n_expired = 0;
+
+  if (vec_len (db->st.expired) < NAT64_DB_ST_EXPIRE_BATCH)
+    {
+      u32 ii = vec_len (db->st.expired);
+
+      db->st.expired =
+	tw_timer_expire_timers_vec_16t_2w_512sl (&db->st.tw, now,
+						 db->st.expired);
+
+      /* the timers are gone, their handles may be reused */
+      for (; ii < vec_len (db->st.expired); ii++)
+	{
+	  u32 handle = db->st.expired[ii];
+	  nat64_db_st_entry_t *st;
+
+	  st = nat64_db_st_by_timer_id (db, nat64_db_st_timer_id (handle));
+	  pool_elt_at_index (st, nat64_db_st_timer_index (handle))->
+	    expire_timer_handle = ~0;
+	}
+    }
+
+  n_left = clib_min (vec_len (db->st.expired), NAT64_DB_ST_EXPIRE_BATCH);
+
+  while (n_left--)
+    n_expired += nat64_db_st_expire_one (thread_index, db,
+					 vec_pop (db->st.expired), (u32) now);
+
+  return n_expired;
 }
 
 void
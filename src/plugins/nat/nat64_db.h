@@ -21,8 +21,19 @@
 
 #include <vppinfra/bihash_24_8.h>
 #include <vppinfra/bihash_48_8.h>
+#include <vppinfra/tw_timer_16t_2w_512sl.h>
 #include <nat/nat.h>
 
+/* session expiry timer wheel tick, in seconds */
+#define NAT64_DB_ST_TW_TICK 1.0
+/* longest interval the timer wheel can hold, in ticks */
+#define NAT64_DB_ST_TW_MAX_TICKS ((512 * 512) - 1)
+/* maximum number of expired sessions checked per call */
+#define NAT64_DB_ST_EXPIRE_BATCH 256
+/* expiry timer id of unknown protocol sessions, the others use their
+   SNAT protocol */
+#define NAT64_DB_ST_TIMER_UNK_PROTO 3
+
 
 typedef struct
 {
@@ -98,9 +109,23 @@ typedef CLIB_PACKED(struct
   ip4_address_t out_r_addr;
   u16 r_port;
   u32 bibe_index;
-  u32 expire;
+  /* Expiry timer handle, ~0 when not running */
+  u32 expire_timer_handle;
   u8 proto;
   u8 tcp_state;
+  /* Last, 8-byte aligned in the pool: the version is kept across entry
+     reuse, and expire is only updated by other workers while the version
+     is unchanged */
+  union
+  {
+    struct
+    {
+      u32 expire;
+      /* Odd while the owner creates or frees the entry */
+      u32 version;
+    };
+    u64 expire_version;
+  };
 }) nat64_db_st_entry_t;
 /* *INDENT-ON* */
 
@@ -119,6 +144,12 @@ typedef struct
   clib_bihash_48_8_t in2out;
   clib_bihash_48_8_t out2in;
 
+  /* Session expiry timers, the user handle is the session index */
+  tw_timer_wheel_16t_2w_512sl_t tw;
+
+  /* Sessions whose timer has expired, to be checked */
+  u32 *expired;
+
   u32 limit;
   u32 st_entries_num;
 } nat64_db_st_t;
@@ -144,6 +175,9 @@ typedef struct nat64_db_s
 /**
  * @brief Initialize NAT64 DB.
  *
+ * The maximum number of BIB and session table entries is 10 per hash
+ * bucket, lowered to what the hash memory can hold.
+ *
  * @param db NAT64 DB.
  * @param bib_buckets Number of BIB hash buckets.
  * @param bib_memory_size Memory size of BIB hash.
@@ -314,14 +348,33 @@ typedef int (*nat64_db_st_walk_fn_t) (nat64_db_st_entry_t * ste, void *ctx);
 void nat64_db_st_walk (nat64_db_t * db, u8 proto,
 		       nat64_db_st_walk_fn_t fn, void *ctx);
 
+/**
+ * @brief Start session table entry expiry timer.
+ *
+ * The timer is not restarted as the session is used; when it expires the
+ * session is checked and the timer restarted for the time remaining.
+ *
+ * @param db NAT64 DB.
+ * @param ste Session table entry.
+ * @param ticks Timer interval in ticks of NAT64_DB_ST_TW_TICK.
+ */
+void nat64_db_st_entry_timer_start (nat64_db_t * db,
+				    nat64_db_st_entry_t * ste, u32 ticks);
+
 /**
  * @brief Free expired session entries in session tables.
  *
+ * Collects the sessions whose expiry timer has expired and checks at most
+ * NAT64_DB_ST_EXPIRE_BATCH of them; the rest stay in db->st.expired for
+ * the next call.
+ *
  * @param thread_index thread index.
  * @param db NAT64 DB.
  * @param now Current time.
+ *
+ * @returns number of session entries freed.
  */
-void nad64_db_st_free_expired (u32 thread_index, nat64_db_t * db, u32 now);
+u32 nad64_db_st_free_expired (u32 thread_index, nat64_db_t * db, f64 now);
 
 /**
  * @brief Free sessions using specific outside address.
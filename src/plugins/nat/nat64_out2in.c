@@ -949,7 +949,8 @@ VLIB_REGISTER_NODE (nat64_out2in_reass_node) = {
 #define foreach_nat64_out2in_handoff_error                       \
 _(CONGESTION_DROP, "congestion drop")                            \
 _(SAME_WORKER, "same worker")                                    \
-_(DO_HANDOFF, "do handoff")
+_(DO_HANDOFF, "do handoff")                                      \
+_(SHARED_LOOKUP, "translated without handoff")
 
 typedef enum
 {
@@ -965,9 +966,17 @@ static char *nat64_out2in_handoff_error_strings[] = {
 #undef _
 };
 
+typedef enum
+{
+  NAT64_OUT2IN_HANDOFF_NEXT_DROP,
+  NAT64_OUT2IN_HANDOFF_NEXT_IP6_LOOKUP,
+  NAT64_OUT2IN_HANDOFF_N_NEXT,
+} nat64_out2in_handoff_next_t;
+
 typedef struct
 {
   u32 next_worker_index;
+  u8 translated;
 } nat64_out2in_handoff_trace_t;
 
 static u8 *
@@ -978,12 +987,281 @@ format_nat64_out2in_handoff_trace (u8 * s, va_list * args)
   nat64_out2in_handoff_trace_t *t =
     va_arg (*args, nat64_out2in_handoff_trace_t *);
 
+  if (t->translated)
+    return format (s, "NAT64-OUT2IN-HANDOFF: translated with session of "
+		   "worker %d", t->next_worker_index);
+
   s =
     format (s, "NAT64-OUT2IN-HANDOFF: next-worker %d", t->next_worker_index);
 
   return s;
 }
 
+typedef struct nat64_out2in_shared_ctx_t_
+{
+  ip6_address_t src_address;
+  ip6_address_t dst_address;
+  u16 dst_port;
+  u32 fib_index;
+  vlib_buffer_t *b;
+} nat64_out2in_shared_ctx_t;
+
+static int
+nat64_out2in_shared_set_cb (ip4_header_t * ip4, ip6_header_t * ip6,
+			    void *arg)
+{
+  nat64_out2in_shared_ctx_t *ctx = arg;
+  udp_header_t *udp = ip4_next_header (ip4);
+  tcp_header_t *tcp = ip4_next_header (ip4);
+  u16 *checksum;
+  ip_csum_t csum;
+
+  ip6->src_address.as_u64[0] = ctx->src_address.as_u64[0];
+  ip6->src_address.as_u64[1] = ctx->src_address.as_u64[1];
+  ip6->dst_address.as_u64[0] = ctx->dst_address.as_u64[0];
+  ip6->dst_address.as_u64[1] = ctx->dst_address.as_u64[1];
+
+  checksum = (ip4->protocol == IP_PROTOCOL_UDP ?
+	      &udp->checksum : &tcp->checksum);
+  csum = ip_csum_sub_even (*checksum, udp->dst_port);
+  csum = ip_csum_add_even (csum, ctx->dst_port);
+  *checksum = ip_csum_fold (csum);
+  udp->dst_port = ctx->dst_port;
+
+  vnet_buffer (ctx->b)->sw_if_index[VLIB_TX] = ctx->fib_index;
+
+  return 0;
+}
+
+/**
+ * @brief Translate with the session of another worker.
+ * Only packets that would not change the session are translated: TCP
+ * and UDP, not fragmented, and for TCP an established session and no
+ * SYN, FIN or RST. The session is only read, except for its expire time;
+ * its owner updates its state and expires it.
+ * The owner may free and reuse the session while it is read, the TCP and
+ * UDP pools are preallocated so the memory remains. The session's version
+ * is read before and after the translation, and the packet is only changed
+ * if it did not change. The expire time is swapped together with the
+ * version, so it is not written once the session is freed or reused.
+ *
+ * @return 1 if translated
+ */
+static_always_inline int
+nat64_out2in_shared_translate (nat64_main_t * nm, vlib_buffer_t * b,
+			       ip4_header_t * ip, u32 owner, u32 now)
+{
+  nat64_out2in_shared_ctx_t ctx;
+  nat64_db_st_entry_key_t ste_key;
+  clib_bihash_kv_48_8_t kv, value;
+  nat64_db_st_entry_t *st, *ste;
+  nat64_db_bib_entry_t *bib, *bibe;
+  u32 bibe_index, timeout;
+  udp_header_t *udp;
+  tcp_header_t *tcp;
+  nat64_db_t *db;
+  union
+  {
+    struct
+    {
+      u32 expire;
+      u32 version;
+    };
+    u64 as_u64;
+  } ev, new_ev;
+
+  if (PREDICT_FALSE (ip->protocol != IP_PROTOCOL_TCP &&
+		     ip->protocol != IP_PROTOCOL_UDP))
+    return 0;
+  if (PREDICT_FALSE (ip4_is_fragment (ip)))
+    return 0;
+  if (PREDICT_FALSE (owner >= vec_len (nm->db)))
+    return 0;
+
+  udp = ip4_next_header (ip);
+  tcp = (tcp_header_t *) udp;
+  db = &nm->db[owner];
+
+  if (ip->protocol == IP_PROTOCOL_TCP)
+    {
+      if (tcp->flags & (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST))
+	return 0;
+      st = db->st._tcp_st;
+      bib = db->bib._tcp_bib;
+      timeout = nm->tcp_est_timeout;
+    }
+  else
+    {
+      st = db->st._udp_st;
+      bib = db->bib._udp_bib;
+      timeout = nm->udp_timeout;
+    }
+
+  clib_memset (&ste_key, 0, sizeof (ste_key));
+  ste_key.l_addr.ip4.as_u32 = ip->dst_address.as_u32;
+  ste_key.r_addr.ip4.as_u32 = ip->src_address.as_u32;
+  ste_key.l_port = udp->dst_port;
+  ste_key.r_port = udp->src_port;
+  ste_key.proto = ip->protocol;
+  kv.key[0] = ste_key.as_u64[0];
+  kv.key[1] = ste_key.as_u64[1];
+  kv.key[2] = ste_key.as_u64[2];
+  kv.key[3] = ste_key.as_u64[3];
+  kv.key[4] = ste_key.as_u64[4];
+  kv.key[5] = ste_key.as_u64[5];
+
+  if (clib_bihash_search_48_8 (&db->st.out2in, &kv, &value))
+    return 0;
+
+  if (PREDICT_FALSE (value.value >= vec_len (st)))
+    return 0;
+  ste = st + value.value;
+
+  /* odd while the owner creates or frees the session */
+  ev.as_u64 = clib_atomic_load_acq_n (&ste->expire_version);
+  if (PREDICT_FALSE (ev.version & 1))
+    return 0;
+
+  bibe_index = ste->bibe_index;
+  if (PREDICT_FALSE (bibe_index >= vec_len (bib)))
+    return 0;
+  bibe = bib + bibe_index;
+
+  ctx.src_address.as_u64[0] = ste->in_r_addr.as_u64[0];
+  ctx.src_address.as_u64[1] = ste->in_r_addr.as_u64[1];
+  ctx.dst_address.as_u64[0] = bibe->in_addr.as_u64[0];
+  ctx.dst_address.as_u64[1] = bibe->in_addr.as_u64[1];
+  ctx.dst_port = bibe->in_port;
+  ctx.fib_index = bibe->fib_index;
+  ctx.b = b;
+
+  if (PREDICT_FALSE (ste->proto != ip->protocol ||
+		     ste->bibe_index != bibe_index ||
+		     ste->out_r_addr.as_u32 != ip->src_address.as_u32 ||
+		     ste->r_port != udp->src_port ||
+		     bibe->proto != ip->protocol ||
+		     bibe->out_addr.as_u32 != ip->dst_address.as_u32 ||
+		     bibe->out_port != udp->dst_port))
+    return 0;
+  if (ip->protocol == IP_PROTOCOL_TCP &&
+      ste->tcp_state != NAT64_TCP_STATE_ESTABLISHED)
+    return 0;
+
+  /* the reads above are done before the version is read again */
+  CLIB_MEMORY_BARRIER ();
+  if (PREDICT_FALSE (clib_atomic_load_acq_n (&ste->version) != ev.version))
+    return 0;
+
+  ip4_to_ip6_tcp_udp (b, nat64_out2in_shared_set_cb, &ctx);
+
+  /* keep the session alive if it is still the one read; the swap fails if
+     the owner freed it or stored an expire time, which is as recent */
+  new_ev.version = ev.version;
+  new_ev.expire = now + timeout;
+  if (new_ev.expire > ev.expire)
+    clib_atomic_cmp_and_swap (&ste->expire_version, ev.as_u64,
+			      new_ev.as_u64);
+
+  return 1;
+}
+
+/**
+ * @brief Out2in handoff with shared session lookup.
+ * Packets that match an established session of their owner are translated
+ * here and go to ip6-lookup, the rest are handed off to the owner as usual.
+ */
+static inline uword
+nat64_out2in_shared_fn_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
+			       vlib_frame_t * frame)
+{
+  nat64_main_t *nm = &nat64_main;
+  u32 n_left_from, *from, n_enq, n_handoff = 0, n_local = 0;
+  u32 same_worker = 0, do_handoff = 0;
+  u32 handoff_bis[VLIB_FRAME_SIZE], local_bis[VLIB_FRAME_SIZE];
+  u16 thread_indices[VLIB_FRAME_SIZE];
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b = bufs;
+  u32 thread_index = vm->thread_index;
+  u32 now = (u32) vlib_time_now (vm);
+
+  from = vlib_frame_vector_args (frame);
+  n_left_from = frame->n_vectors;
+
+  vlib_get_buffers (vm, from, b, n_left_from);
+
+  while (n_left_from > 0)
+    {
+      ip4_header_t *ip0;
+      u32 ti0;
+      u8 translated0 = 0;
+
+      if (PREDICT_TRUE (n_left_from >= 2))
+	{
+	  vlib_prefetch_buffer_header (b[1], STORE);
+	  CLIB_PREFETCH (&b[1]->data, CLIB_CACHE_LINE_BYTES, STORE);
+	}
+
+      ip0 = vlib_buffer_get_current (b[0]);
+      ti0 = nat64_get_worker_out2in (ip0);
+
+      if (ti0 != thread_index)
+	translated0 = nat64_out2in_shared_translate (nm, b[0], ip0, ti0, now);
+
+      if (translated0)
+	local_bis[n_local++] = from[0];
+      else
+	{
+	  handoff_bis[n_handoff] = from[0];
+	  thread_indices[n_handoff] = ti0;
+	  n_handoff++;
+
+	  if (ti0 == thread_index)
+	    same_worker++;
+	  else
+	    do_handoff++;
+	}
+
+      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE) &&
+			 (b[0]->flags & VLIB_BUFFER_IS_TRACED)))
+	{
+	  nat64_out2in_handoff_trace_t *t =
+	    vlib_add_trace (vm, node, b[0], sizeof (*t));
+	  t->next_worker_index = ti0;
+	  t->translated = translated0;
+	}
+
+      b += 1;
+      from += 1;
+      n_left_from -= 1;
+    }
+
+  if (n_local)
+    vlib_buffer_enqueue_to_single_next (vm, node, local_bis,
+					NAT64_OUT2IN_HANDOFF_NEXT_IP6_LOOKUP,
+					n_local);
+
+  if (n_handoff)
+    {
+      n_enq = vlib_buffer_enqueue_to_thread (vm, nm->fq_out2in_index,
+					     handoff_bis, thread_indices,
+					     n_handoff, 1);
+      if (n_enq < n_handoff)
+	vlib_node_increment_counter (vm, node->node_index,
+				     NAT64_OUT2IN_HANDOFF_ERROR_CONGESTION_DROP,
+				     n_handoff - n_enq);
+    }
+
+  vlib_node_increment_counter (vm, node->node_index,
+			       NAT64_OUT2IN_HANDOFF_ERROR_SHARED_LOOKUP,
+			       n_local);
+  vlib_node_increment_counter (vm, node->node_index,
+			       NAT64_OUT2IN_HANDOFF_ERROR_SAME_WORKER,
+			       same_worker);
+  vlib_node_increment_counter (vm, node->node_index,
+			       NAT64_OUT2IN_HANDOFF_ERROR_DO_HANDOFF,
+			       do_handoff);
+  return frame->n_vectors;
+}
+
 VLIB_NODE_FN (nat64_out2in_handoff_node) (vlib_main_t * vm,
 					  vlib_node_runtime_t * node,
 					  vlib_frame_t * frame)
@@ -996,6 +1274,9 @@ VLIB_NODE_FN (nat64_out2in_handoff_node) (vlib_main_t * vm,
   u32 thread_index = vm->thread_index;
   u32 do_handoff = 0, same_worker = 0;
 
+  if (nm->out2in_shared_lookup)
+    return nat64_out2in_shared_fn_inline (vm, node, frame);
+
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
   vlib_get_buffers (vm, from, bufs, n_left_from);
@@ -1024,6 +1305,7 @@ VLIB_NODE_FN (nat64_out2in_handoff_node) (vlib_main_t * vm,
 	  nat64_out2in_handoff_trace_t *t =
 	    vlib_add_trace (vm, node, b[0], sizeof (*t));
 	  t->next_worker_index = ti[0];
+	  t->translated = 0;
 	}
 
       n_left_from -= 1;
@@ -1058,10 +1340,11 @@ VLIB_REGISTER_NODE (nat64_out2in_handoff_node) = {
   .n_errors = ARRAY_LEN(nat64_out2in_handoff_error_strings),
   .error_strings = nat64_out2in_handoff_error_strings,
 
-  .n_next_nodes = 1,
+  .n_next_nodes = NAT64_OUT2IN_HANDOFF_N_NEXT,
 
   .next_nodes = {
-    [0] = "error-drop",
+    [NAT64_OUT2IN_HANDOFF_NEXT_DROP] = "error-drop",
+    [NAT64_OUT2IN_HANDOFF_NEXT_IP6_LOOKUP] = "ip6-lookup",
   },
 };
 /* *INDENT-ON* */
@@ -17,9 +17,14 @@
 #include <vnet/udp/udp.h>
 #include <nat/nat.h>
 #include <vppinfra/atomics.h>
+#include <vppinfra/fifo.h>
 
 /* number of retries */
 #define NAT_HA_RETRIES 3
+/* number of seconds to wait for ACK before retry */
+#define NAT_HA_RESEND_TIMEOUT 2.0
+/* number of sessions sent per worker dispatch during HA resync */
+#define NAT_HA_RESYNC_BATCH 1024
 
 #define foreach_nat_ha_counter           \
 _(RECV_ADD, "add-event-recv", 0)         \
@@ -31,7 +36,10 @@ _(SEND_REFRESH, "refresh-event-send", 5) \
 _(RECV_ACK, "ack-recv", 6)               \
 _(SEND_ACK, "ack-send", 7)               \
 _(RETRY_COUNT, "retry-count", 8)         \
-_(MISSED_COUNT, "missed-count", 9)
+_(MISSED_COUNT, "missed-count", 9)       \
+_(SEND_MSG, "msg-send", 10)              \
+_(SEND_BYTES, "bytes-send", 11)          \
+_(SEND_RESYNC, "resync-event-send", 12)
 
 /* NAT HA protocol version */
 #define NAT_HA_VERSION 0x01
@@ -45,6 +53,7 @@ typedef enum
   NAT_HA_ADD = 1,
   NAT_HA_DEL,
   NAT_HA_REFRESH,
+  NAT_HA_REFRESH_DELTA,
 } nat_ha_event_type_t;
 
 /* NAT HA protocol header */
@@ -83,6 +92,21 @@ typedef struct
   u64 total_bytes;
 } __attribute__ ((packed)) nat_ha_event_t;
 
+/* NAT HA protocol compact session refresh event data, outside address and
+   fib index are the same as in the previous event of the message */
+typedef struct
+{
+  /* event type */
+  u8 event_type;
+  /* session data */
+  u8 protocol;
+  u16 out_port;
+  u32 eh_addr;
+  u16 eh_port;
+  u32 total_pkts;
+  u64 total_bytes;
+} __attribute__ ((packed)) nat_ha_refresh_delta_event_t;
+
 typedef enum
 {
 #define _(N, s, v) NAT_HA_COUNTER_##N = v,
@@ -117,8 +141,23 @@ typedef struct
   u16 state_sync_count;
   /* next event offset */
   u32 state_sync_next_event_offset;
+  /* outside address and fib index of the last full event in the message */
+  u32 state_sync_out_addr;
+  u32 state_sync_fib_index;
+  /* 1 if the message holds a resync event */
+  u8 state_sync_resync;
   /* data waiting for ACK */
   nat_ha_resend_entry_t *resend_queue;
+  /* resend queue entry index by sequence number */
+  uword *resend_queue_by_seq;
+  /* sequence numbers of data waiting for ACK in retry timer order */
+  u32 *resend_fifo;
+  /* 1 if flush interval expired */
+  u8 flush_pending;
+  /* 1 if HA resync session walk in progress */
+  u8 resync_walk;
+  /* next session index to send during HA resync */
+  u32 resync_next_index;
 } nat_ha_per_thread_data_t;
 
 /* NAT HA settings */
@@ -134,6 +173,10 @@ typedef struct nat_ha_main_s
   u32 state_sync_path_mtu;
   /* number of seconds after which to send session counters refresh */
   u32 session_refresh_interval;
+  /* number of seconds after which to send partially filled message */
+  f64 flush_interval;
+  /* 1 if compact session refresh events are sent */
+  u8 delta_refresh;
   /* counters */
   vlib_simple_counter_main_t counters[NAT_HA_N_COUNTERS];
   vlib_main_t *vlib_main;
@@ -188,53 +231,98 @@ nat_ha_resync_fin (void)
     ha->event_callback (ha->client_index, ha->pid, ha->resync_ack_missed);
 }
 
+/* add complete HA NAT message to the frame waiting to be sent */
+static void
+nat_ha_frame_add (vlib_main_t * vm, nat_ha_per_thread_data_t * td, u32 bi)
+{
+  vlib_frame_t *f;
+  u32 *to_next;
+
+  f = td->state_sync_frame;
+  if (PREDICT_FALSE (f == 0))
+    {
+      f = td->state_sync_frame =
+	vlib_get_frame_to_node (vm, ip4_lookup_node.index);
+      /* send it at the latest in the next dispatch */
+      vlib_node_set_interrupt_pending (vm, nat_ha_worker_node.index);
+    }
+
+  to_next = vlib_frame_vector_args (f);
+  to_next[f->n_vectors++] = bi;
+
+  if (PREDICT_FALSE (f->n_vectors == VLIB_FRAME_SIZE))
+    {
+      vlib_put_frame_to_node (vm, ip4_lookup_node.index, f);
+      td->state_sync_frame = 0;
+    }
+}
+
+/* send HA NAT messages waiting in the frame */
+static void
+nat_ha_frame_put (vlib_main_t * vm, nat_ha_per_thread_data_t * td)
+{
+  if (!td->state_sync_frame)
+    return;
+
+  vlib_put_frame_to_node (vm, ip4_lookup_node.index, td->state_sync_frame);
+  td->state_sync_frame = 0;
+}
+
 /* cache HA NAT data waiting for ACK */
 static int
-nat_ha_resend_queue_add (u32 seq, u8 * data, u8 data_len, u8 is_resync,
+nat_ha_resend_queue_add (u32 seq, u8 * data, u32 data_len, u8 is_resync,
 			 u32 thread_index)
 {
   nat_ha_main_t *ha = &nat_ha_main;
   nat_ha_per_thread_data_t *td = &ha->per_thread_data[thread_index];
   nat_ha_resend_entry_t *entry;
-  f64 now = vlib_time_now (ha->vlib_main);
+  f64 now = vlib_time_now (vlib_mains[thread_index]);
 
-  vec_add2 (td->resend_queue, entry, 1);
+  pool_get (td->resend_queue, entry);
   clib_memset (entry, 0, sizeof (*entry));
-  entry->retry_timer = now + 2.0;
+  entry->retry_timer = now + NAT_HA_RESEND_TIMEOUT;
   entry->seq = seq;
   entry->is_resync = is_resync;
   vec_add (entry->data, data, data_len);
+  hash_set (td->resend_queue_by_seq, seq, entry - td->resend_queue);
+  clib_fifo_add1 (td->resend_fifo, seq);
 
   return 0;
 }
 
+static void
+nat_ha_resend_queue_del (nat_ha_per_thread_data_t * td,
+			 nat_ha_resend_entry_t * entry)
+{
+  hash_unset (td->resend_queue_by_seq, entry->seq);
+  vec_free (entry->data);
+  pool_put (td->resend_queue, entry);
+}
+
 static_always_inline void
 nat_ha_ack_recv (u32 seq, u32 thread_index)
 {
   nat_ha_main_t *ha = &nat_ha_main;
   nat_ha_per_thread_data_t *td = &ha->per_thread_data[thread_index];
-  u32 i;
-
-  vec_foreach_index (i, td->resend_queue)
-  {
-    if (td->resend_queue[i].seq != seq)
-      continue;
-
-    vlib_increment_simple_counter (&ha->counters[NAT_HA_COUNTER_RECV_ACK],
-				   thread_index, 0, 1);
-    /* ACK received remove cached data */
-    if (td->resend_queue[i].is_resync)
-      {
-	clib_atomic_fetch_sub (&ha->resync_ack_count, 1);
-	nat_ha_resync_fin ();
-      }
-    vec_free (td->resend_queue[i].data);
-    vec_del1 (td->resend_queue, i);
-    nat_elog_debug_X1 ("ACK for seq %d received", "i4",
-		       clib_net_to_host_u32 (seq));
+  nat_ha_resend_entry_t *entry;
+  uword *p;
 
+  p = hash_get (td->resend_queue_by_seq, seq);
+  if (!p)
     return;
-  }
+
+  entry = pool_elt_at_index (td->resend_queue, p[0]);
+  vlib_increment_simple_counter (&ha->counters[NAT_HA_COUNTER_RECV_ACK],
+				 thread_index, 0, 1);
+  /* ACK received remove cached data */
+  if (entry->is_resync)
+    {
+      clib_atomic_fetch_sub (&ha->resync_ack_count, 1);
+      nat_ha_resync_fin ();
+    }
+  nat_ha_resend_queue_del (td, entry);
+  nat_elog_debug_X1 ("ACK for seq %d received", "i4",
+		     clib_net_to_host_u32 (seq));
 }
 
 /* scan non-ACKed HA NAT for retry */
@@ -243,70 +331,73 @@ nat_ha_resend_scan (f64 now, u32 thread_index)
 {
   nat_ha_main_t *ha = &nat_ha_main;
   nat_ha_per_thread_data_t *td = &ha->per_thread_data[thread_index];
-  u32 i, *del, *to_delete = 0;
-  vlib_main_t *vm = ha->vlib_main;
+  nat_ha_resend_entry_t *entry;
+  vlib_main_t *vm = vlib_mains[thread_index];
   vlib_buffer_t *b = 0;
-  vlib_frame_t *f;
-  u32 bi, *to_next;
+  u32 bi, seq;
   ip4_header_t *ip;
+  uword *p;
+
+  /* entries are queued in retry timer order, stop at first not expired */
+  while (clib_fifo_elts (td->resend_fifo))
+    {
+      seq = *clib_fifo_head (td->resend_fifo);
+      p = hash_get (td->resend_queue_by_seq, seq);
+      /* already ACKed */
+      if (!p)
+	{
+	  clib_fifo_sub1 (td->resend_fifo, seq);
+	  continue;
+	}
+
+      entry = pool_elt_at_index (td->resend_queue, p[0]);
+      if (entry->retry_timer > now)
+	break;
 
-  vec_foreach_index (i, td->resend_queue)
-  {
-    if (td->resend_queue[i].retry_timer > now)
-      continue;
-
-    /* maximum retry reached delete cached data */
-    if (td->resend_queue[i].retry_count >= NAT_HA_RETRIES)
-      {
-	nat_elog_notice_X1 ("seq %d missed", "i4",
-			    clib_net_to_host_u32 (td->resend_queue[i].seq));
-	if (td->resend_queue[i].is_resync)
-	  {
-	    clib_atomic_fetch_add (&ha->resync_ack_missed, 1);
-	    clib_atomic_fetch_sub (&ha->resync_ack_count, 1);
-	    nat_ha_resync_fin ();
-	  }
-	vec_add1 (to_delete, i);
-	vlib_increment_simple_counter (&ha->counters
-				       [NAT_HA_COUNTER_MISSED_COUNT],
-				       thread_index, 0, 1);
-	continue;
-      }
-
-    /* retry to send non-ACKed data */
-    nat_elog_debug_X1 ("state sync seq %d resend", "i4",
-		       clib_net_to_host_u32 (td->resend_queue[i].seq));
-    td->resend_queue[i].retry_count++;
-    vlib_increment_simple_counter (&ha->counters[NAT_HA_COUNTER_RETRY_COUNT],
-				   thread_index, 0, 1);
-    if (vlib_buffer_alloc (vm, &bi, 1) != 1)
-      {
-	nat_elog_warn ("HA NAT state sync can't allocate buffer");
-	return;
-      }
-    b = vlib_get_buffer (vm, bi);
-    b->current_length = vec_len (td->resend_queue[i].data);
-    b->flags |= VLIB_BUFFER_TOTAL_LENGTH_VALID;
-    b->flags |= VNET_BUFFER_F_LOCALLY_ORIGINATED;
-    vnet_buffer (b)->sw_if_index[VLIB_RX] = 0;
-    vnet_buffer (b)->sw_if_index[VLIB_TX] = 0;
-    ip = vlib_buffer_get_current (b);
-    clib_memcpy (ip, td->resend_queue[i].data,
-		 vec_len (td->resend_queue[i].data));
-    f = vlib_get_frame_to_node (vm, ip4_lookup_node.index);
-    to_next = vlib_frame_vector_args (f);
-    to_next[0] = bi;
-    f->n_vectors = 1;
-    vlib_put_frame_to_node (vm, ip4_lookup_node.index, f);
-    td->resend_queue[i].retry_timer = now + 2.0;
-  }
-
-  vec_foreach (del, to_delete)
-  {
-    vec_free (td->resend_queue[*del].data);
-    vec_del1 (td->resend_queue, *del);
-  }
-  vec_free (to_delete);
+      /* maximum retry reached delete cached data */
+      if (entry->retry_count >= NAT_HA_RETRIES)
+	{
+	  nat_elog_notice_X1 ("seq %d missed", "i4",
+			      clib_net_to_host_u32 (entry->seq));
+	  if (entry->is_resync)
+	    {
+	      clib_atomic_fetch_add (&ha->resync_ack_missed, 1);
+	      clib_atomic_fetch_sub (&ha->resync_ack_count, 1);
+	      nat_ha_resync_fin ();
+	    }
+	  clib_fifo_sub1 (td->resend_fifo, seq);
+	  nat_ha_resend_queue_del (td, entry);
+	  vlib_increment_simple_counter (&ha->counters
+					 [NAT_HA_COUNTER_MISSED_COUNT],
+					 thread_index, 0, 1);
+	  continue;
+	}
+
+      /* retry to send non-ACKed data */
+      if (vlib_buffer_alloc (vm, &bi, 1) != 1)
+	{
+	  nat_elog_warn ("HA NAT state sync can't allocate buffer");
+	  break;
+	}
+      nat_elog_debug_X1 ("state sync seq %d resend", "i4",
+			 clib_net_to_host_u32 (entry->seq));
+      entry->retry_count++;
+      vlib_increment_simple_counter (&ha->counters
+				     [NAT_HA_COUNTER_RETRY_COUNT],
+				     thread_index, 0, 1);
+      b = vlib_get_buffer (vm, bi);
+      b->current_length = vec_len (entry->data);
+      b->flags |= VLIB_BUFFER_TOTAL_LENGTH_VALID;
+      b->flags |= VNET_BUFFER_F_LOCALLY_ORIGINATED;
+      vnet_buffer (b)->sw_if_index[VLIB_RX] = 0;
+      vnet_buffer (b)->sw_if_index[VLIB_TX] = 0;
+      ip = vlib_buffer_get_current (b);
+      clib_memcpy (ip, entry->data, vec_len (entry->data));
+      nat_ha_frame_add (vm, td, bi);
+      entry->retry_timer = now + NAT_HA_RESEND_TIMEOUT;
+      clib_fifo_sub1 (td->resend_fifo, seq);
+      clib_fifo_add1 (td->resend_fifo, seq);
+    }
 }
 
 void
@@ -322,6 +413,8 @@ nat_ha_init (vlib_main_t * vm, nat_ha_sadd_cb_t sadd_cb,
   ha->src_port = 0;
   ha->dst_ip_address.as_u32 = 0;
   ha->dst_port = 0;
+  ha->flush_interval = 1.0;
+  ha->delta_refresh = 0;
   ha->in_resync = 0;
   ha->resync_ack_count = 0;
   ha->resync_ack_missed = 0;
@@ -417,6 +510,30 @@ nat_ha_get_failover (ip4_address_t * addr, u16 * port,
   *session_refresh_interval = ha->session_refresh_interval;
 }
 
+int
+nat_ha_set_sync_params (f64 flush_interval, u8 delta_refresh)
+{
+  nat_ha_main_t *ha = &nat_ha_main;
+
+  /* non-ACKed data is scanned for retry on flush */
+  if (flush_interval <= 0 || flush_interval > 1.0)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  ha->flush_interval = flush_interval;
+  ha->delta_refresh = delta_refresh;
+
+  return 0;
+}
+
+void
+nat_ha_get_sync_params (f64 * flush_interval, u8 * delta_refresh)
+{
+  nat_ha_main_t *ha = &nat_ha_main;
+
+  *flush_interval = ha->flush_interval;
+  *delta_refresh = ha->delta_refresh;
+}
+
 static_always_inline void
 nat_ha_recv_add (nat_ha_event_t * event, f64 now, u32 thread_index)
 {
@@ -480,26 +597,66 @@ nat_ha_recv_refresh (nat_ha_event_t * event, f64 now, u32 thread_index)
 	       thread_index);
 }
 
-/* process received NAT HA event */
 static_always_inline void
-nat_ha_event_process (nat_ha_event_t * event, f64 now, u32 thread_index)
+nat_ha_recv_refresh_delta (nat_ha_refresh_delta_event_t * event,
+			   nat_ha_event_t * last, u32 thread_index)
+{
+  nat_ha_main_t *ha = &nat_ha_main;
+  ip4_address_t out_addr, eh_addr;
+  u32 fib_index, total_pkts;
+  u64 total_bytes;
+
+  vlib_increment_simple_counter (&ha->counters[NAT_HA_COUNTER_RECV_REFRESH],
+				 thread_index, 0, 1);
+
+  out_addr.as_u32 = last->out_addr;
+  eh_addr.as_u32 = event->eh_addr;
+  fib_index = clib_net_to_host_u32 (last->fib_index);
+  total_pkts = clib_net_to_host_u32 (event->total_pkts);
+  total_bytes = clib_net_to_host_u64 (event->total_bytes);
+
+  ha->sref_cb (&out_addr, event->out_port, &eh_addr, event->eh_port,
+	       event->protocol, fib_index, total_pkts, total_bytes,
+	       thread_index);
+}
+
+/* process received NAT HA event, returns event length or 0 if malformed */
+static_always_inline u32
+nat_ha_event_process (u8 * data, u32 len, nat_ha_event_t ** last, f64 now,
+		      u32 thread_index)
 {
-  switch (event->event_type)
+  nat_ha_event_t *event = (nat_ha_event_t *) data;
+
+  switch (data[0])
     {
     case NAT_HA_ADD:
+      if (len < sizeof (nat_ha_event_t))
+	return 0;
       nat_ha_recv_add (event, now, thread_index);
       break;
     case NAT_HA_DEL:
+      if (len < sizeof (nat_ha_event_t))
+	return 0;
       nat_ha_recv_del (event, thread_index);
       break;
     case NAT_HA_REFRESH:
+      if (len < sizeof (nat_ha_event_t))
+	return 0;
       nat_ha_recv_refresh (event, now, thread_index);
       break;
+    case NAT_HA_REFRESH_DELTA:
+      if (len < sizeof (nat_ha_refresh_delta_event_t) || !*last)
+	return 0;
+      nat_ha_recv_refresh_delta ((nat_ha_refresh_delta_event_t *) data,
+				 *last, thread_index);
+      return sizeof (nat_ha_refresh_delta_event_t);
     default:
-      nat_elog_notice_X1 ("Unsupported HA event type %d", "i4",
-			  event->event_type);
-      break;
+      nat_elog_notice_X1 ("Unsupported HA event type %d", "i4", data[0]);
+      return 0;
     }
+
+  *last = event;
+  return sizeof (nat_ha_event_t);
 }
 
 static inline void
@@ -548,8 +705,7 @@ nat_ha_header_create (vlib_buffer_t * b, u32 * offset, u32 thread_index)
 }
 
 static inline void
-nat_ha_send (vlib_frame_t * f, vlib_buffer_t * b, u8 is_resync,
-	     u32 thread_index)
+nat_ha_send (vlib_buffer_t * b, u8 is_resync, u32 thread_index)
 {
   nat_ha_main_t *ha = &nat_ha_main;
   nat_ha_per_thread_data_t *td = &ha->per_thread_data[thread_index];
@@ -571,7 +727,43 @@ nat_ha_send (vlib_frame_t * f, vlib_buffer_t * b, u8 is_resync,
   nat_ha_resend_queue_add (h->sequence_number, (u8 *) ip, b->current_length,
 			   is_resync, thread_index);
 
-  vlib_put_frame_to_node (vm, ip4_lookup_node.index, f);
+  vlib_increment_simple_counter (&ha->counters[NAT_HA_COUNTER_SEND_MSG],
+				 thread_index, 0, 1);
+  vlib_increment_simple_counter (&ha->counters[NAT_HA_COUNTER_SEND_BYTES],
+				 thread_index, 0, b->current_length);
+
+  nat_ha_frame_add (vm, td, vlib_get_buffer_index (vm, b));
+}
+
+/* write NAT HA protocol event to the message, returns event length */
+static_always_inline u32
+nat_ha_event_write (nat_ha_per_thread_data_t * td, u8 * data,
+		    nat_ha_event_t * event)
+{
+  nat_ha_main_t *ha = &nat_ha_main;
+  nat_ha_refresh_delta_event_t *delta;
+
+  /* refresh of session with same outside address and fib index as the
+     previous event, send only what differs */
+  if (ha->delta_refresh && event->event_type == NAT_HA_REFRESH
+      && event->out_addr == td->state_sync_out_addr
+      && event->fib_index == td->state_sync_fib_index)
+    {
+      delta = (nat_ha_refresh_delta_event_t *) data;
+      delta->event_type = NAT_HA_REFRESH_DELTA;
+      delta->protocol = event->protocol;
+      delta->out_port = event->out_port;
+      delta->eh_addr = event->eh_addr;
+      delta->eh_port = event->eh_port;
+      delta->total_pkts = event->total_pkts;
+      delta->total_bytes = event->total_bytes;
+      return sizeof (*delta);
+    }
+
+  clib_memcpy_fast (data, event, sizeof (*event));
+  td->state_sync_out_addr = event->out_addr;
+  td->state_sync_fib_index = event->fib_index;
+  return sizeof (*event);
 }
 
 /* add NAT HA protocol event */
@@ -583,15 +775,17 @@ nat_ha_event_add (nat_ha_event_t * event, u8 do_flush, u32 thread_index,
   nat_ha_per_thread_data_t *td = &ha->per_thread_data[thread_index];
   vlib_main_t *vm = vlib_mains[thread_index];
   vlib_buffer_t *b = 0;
-  vlib_frame_t *f;
-  u32 bi = ~0, offset;
+  u32 bi = ~0, offset, len;
 
   b = td->state_sync_buffer;
 
   if (PREDICT_FALSE (b == 0))
     {
       if (do_flush)
-	return;
+	{
+	  nat_ha_frame_put (vm, td);
+	  return;
+	}
 
       if (vlib_buffer_alloc (vm, &bi, 1) != 1)
 	{
@@ -606,30 +800,21 @@ nat_ha_event_add (nat_ha_event_t * event, u8 do_flush, u32 thread_index,
     }
   else
     {
-      bi = vlib_get_buffer_index (vm, b);
       offset = td->state_sync_next_event_offset;
     }
 
-  f = td->state_sync_frame;
-  if (PREDICT_FALSE (f == 0))
+  if (PREDICT_FALSE (td->state_sync_count == 0))
     {
-      u32 *to_next;
-      f = vlib_get_frame_to_node (vm, ip4_lookup_node.index);
-      td->state_sync_frame = f;
-      to_next = vlib_frame_vector_args (f);
-      to_next[0] = bi;
-      f->n_vectors = 1;
+      nat_ha_header_create (b, &offset, thread_index);
+      td->state_sync_fib_index = ~0;
     }
 
-  if (PREDICT_FALSE (td->state_sync_count == 0))
-    nat_ha_header_create (b, &offset, thread_index);
-
   if (PREDICT_TRUE (do_flush == 0))
     {
-      clib_memcpy_fast (b->data + offset, event, sizeof (*event));
-      offset += sizeof (*event);
+      len = nat_ha_event_write (td, b->data + offset, event);
+      offset += len;
       td->state_sync_count++;
-      b->current_length += sizeof (*event);
+      b->current_length += len;
 
       switch (event->event_type)
 	{
@@ -651,16 +836,27 @@ nat_ha_event_add (nat_ha_event_t * event, u8 do_flush, u32 thread_index,
 	default:
 	  break;
 	}
+      if (is_resync)
+	{
+	  vlib_increment_simple_counter (&ha->counters
+					 [NAT_HA_COUNTER_SEND_RESYNC],
+					 thread_index, 0, 1);
+	  td->state_sync_resync = 1;
+	}
     }
 
   if (PREDICT_FALSE
       (do_flush || offset + (sizeof (*event)) > ha->state_sync_path_mtu))
     {
-      nat_ha_send (f, b, is_resync, thread_index);
+      /* resync if any event of the message is, not just the last one */
+      is_resync = td->state_sync_resync;
+      nat_ha_send (b, is_resync, thread_index);
       td->state_sync_buffer = 0;
-      td->state_sync_frame = 0;
       td->state_sync_count = 0;
+      td->state_sync_resync = 0;
       offset = 0;
+      if (do_flush)
+	nat_ha_frame_put (vm, td);
       if (is_resync)
 	{
 	  clib_atomic_fetch_add (&ha->resync_ack_count, 1);
@@ -757,16 +953,72 @@ nat_ha_sref (ip4_address_t * out_addr, u16 out_port, ip4_address_t * eh_addr,
   nat_ha_event_add (&event, 0, thread_index, 0);
 }
 
+/* send next batch of thread's sessions during HA resync */
+static void
+nat_ha_resync_walk (vlib_main_t * vm, u32 thread_index)
+{
+  nat_ha_main_t *ha = &nat_ha_main;
+  nat_ha_per_thread_data_t *td = &ha->per_thread_data[thread_index];
+  snat_main_t *sm = &snat_main;
+  snat_main_per_thread_data_t *tsm;
+  snat_session_t *s;
+  u32 i, n_sent = 0;
+
+  if (thread_index < vec_len (sm->per_thread_data))
+    {
+      tsm = vec_elt_at_index (sm->per_thread_data, thread_index);
+      for (i = td->resync_next_index; i < vec_len (tsm->sessions); i++)
+	{
+	  if (n_sent == NAT_HA_RESYNC_BATCH)
+	    break;
+	  if (pool_is_free_index (tsm->sessions, i))
+	    continue;
+	  s = pool_elt_at_index (tsm->sessions, i);
+	  nat_ha_sadd (&s->in2out.addr, s->in2out.port, &s->out2in.addr,
+		       s->out2in.port, &s->ext_host_addr, s->ext_host_port,
+		       &s->ext_host_nat_addr, s->ext_host_nat_port,
+		       s->in2out.protocol, s->in2out.fib_index, s->flags,
+		       thread_index, 1);
+	  n_sent++;
+	}
+      td->resync_next_index = i;
+      /* continue in the next dispatch */
+      if (i < vec_len (tsm->sessions))
+	{
+	  vlib_node_set_interrupt_pending (vm, nat_ha_worker_node.index);
+	  return;
+	}
+    }
+
+  td->resync_walk = 0;
+  nat_ha_event_add (0, 1, thread_index, 1);
+  clib_atomic_fetch_sub (&ha->resync_ack_count, 1);
+  nat_ha_resync_fin ();
+}
+
 /* per thread process waiting for interrupt */
 static uword
 nat_ha_worker_fn (vlib_main_t * vm, vlib_node_runtime_t * rt,
 		  vlib_frame_t * f)
 {
+  nat_ha_main_t *ha = &nat_ha_main;
   u32 thread_index = vm->thread_index;
-  /* flush HA NAT data under construction */
-  nat_ha_event_add (0, 1, thread_index, 0);
-  /* scan if we need to resend some non-ACKed data */
-  nat_ha_resend_scan (vlib_time_now (vm), thread_index);
+  nat_ha_per_thread_data_t *td = &ha->per_thread_data[thread_index];
+
+  if (td->resync_walk)
+    nat_ha_resync_walk (vm, thread_index);
+
+  if (td->flush_pending)
+    {
+      td->flush_pending = 0;
+      /* flush HA NAT data under construction */
+      nat_ha_event_add (0, 1, thread_index, 0);
+      /* scan if we need to resend some non-ACKed data */
+      nat_ha_resend_scan (vlib_time_now (vm), thread_index);
+    }
+
+  /* send complete messages */
+  nat_ha_frame_put (vm, td);
   return 0;
 }
 
@@ -796,7 +1048,7 @@ nat_ha_process (vlib_main_t * vm, vlib_node_runtime_t * rt, vlib_frame_t * f)
 
   while (1)
     {
-      vlib_process_wait_for_event_or_clock (vm, 1.0);
+      vlib_process_wait_for_event_or_clock (vm, ha->flush_interval);
       event_type = vlib_process_get_events (vm, &event_data);
       vec_reset_length (event_data);
       for (ti = 0; ti < vec_len (vlib_mains); ti++)
@@ -804,6 +1056,7 @@ nat_ha_process (vlib_main_t * vm, vlib_node_runtime_t * rt, vlib_frame_t * f)
 	  if (ti >= vec_len (ha->per_thread_data))
 	    continue;
 
+	  ha->per_thread_data[ti].flush_pending = 1;
 	  vlib_node_set_interrupt_pending (vlib_mains[ti],
 					   nat_ha_worker_node.index);
 	}
@@ -820,6 +1073,36 @@ VLIB_REGISTER_NODE (nat_ha_process_node) = {
 };
 /* *INDENT-ON* */
 
+int
+nat_ha_resync (u32 client_index, u32 pid,
+	       nat_ha_resync_event_cb_t event_callback)
+{
+  nat_ha_main_t *ha = &nat_ha_main;
+  u32 ti;
+
+  if (ha->in_resync)
+    return VNET_API_ERROR_IN_PROGRESS;
+
+  ha->in_resync = 1;
+  /* each thread holds one until it has sent all its sessions */
+  ha->resync_ack_count = vec_len (ha->per_thread_data);
+  ha->resync_ack_missed = 0;
+  ha->event_callback = event_callback;
+  ha->client_index = client_index;
+  ha->pid = pid;
+
+  /* threads send their own sessions in batches, see nat_ha_resync_walk */
+  for (ti = 0; ti < vec_len (ha->per_thread_data); ti++)
+    {
+      ha->per_thread_data[ti].resync_next_index = 0;
+      ha->per_thread_data[ti].resync_walk = 1;
+      vlib_node_set_interrupt_pending (vlib_mains[ti],
+				       nat_ha_worker_node.index);
+    }
+
+  return 0;
+}
+
 void
 nat_ha_get_resync_status (u8 * in_resync, u32 * resync_ack_missed)
 {
@@ -858,7 +1141,8 @@ typedef enum
 
 #define foreach_nat_ha_error   \
 _(PROCESSED, "pkts-processed") \
-_(BAD_VERSION, "bad-version")
+_(BAD_VERSION, "bad-version")  \
+_(BAD_EVENT, "bad-event")
 
 typedef enum
 {
@@ -899,10 +1183,11 @@ nat_ha_node_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
 
       while (n_left_from > 0 && n_left_to_next > 0)
 	{
-	  u32 bi0, next0, src_addr0, dst_addr0;;
+	  u32 bi0, next0, src_addr0, dst_addr0, len0;
 	  vlib_buffer_t *b0;
 	  nat_ha_message_header_t *h0;
-	  nat_ha_event_t *e0;
+	  nat_ha_event_t *last0;
+	  u8 *e0, *end0;
 	  u16 event_count0, src_port0, dst_port0, old_len0;
 	  ip4_header_t *ip0;
 	  udp_header_t *udp0;
@@ -939,14 +1224,23 @@ nat_ha_node_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
 	      goto done0;
 	    }
 
-	  e0 = (nat_ha_event_t *) (h0 + 1);
+	  e0 = (u8 *) (h0 + 1);
+	  end0 = (u8 *) ip0 + clib_net_to_host_u16 (ip0->length);
+	  last0 = 0;
 
 	  /* process each event */
 	  while (event_count0)
 	    {
-	      nat_ha_event_process (e0, now, thread_index);
+	      len0 = end0 > e0 ? end0 - e0 : 0;
+	      len0 = nat_ha_event_process (e0, len0, &last0, now,
+					   thread_index);
+	      if (PREDICT_FALSE (!len0))
+		{
+		  b0->error = node->errors[NAT_HA_ERROR_BAD_EVENT];
+		  goto done0;
+		}
 	      event_count0--;
-	      e0 = (nat_ha_event_t *) ((u8 *) e0 + sizeof (nat_ha_event_t));
+	      e0 += len0;
 	    }
 
 	  next0 = NAT_HA_NEXT_IP4_LOOKUP;
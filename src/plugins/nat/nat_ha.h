@@ -79,6 +79,23 @@ int nat_ha_set_failover (ip4_address_t * addr, u16 port,
 void nat_ha_get_failover (ip4_address_t * addr, u16 * port,
 			  u32 * session_refresh_interval);
 
+/**
+ * @brief Set HA event batching
+ *
+ * @param flush_interval number of seconds after which to send partially
+ *                       filled HA message and scan for retry
+ * @param delta_refresh 1 to send compact session refresh events (peer must
+ *                      support them)
+ *
+ * @returns 0 on success, non-zero value otherwise.
+ */
+int nat_ha_set_sync_params (f64 flush_interval, u8 delta_refresh);
+
+/**
+ * @brief Get HA event batching settings
+ */
+void nat_ha_get_sync_params (f64 * flush_interval, u8 * delta_refresh);
+
 /**
  * @brief Create session add HA event
  *
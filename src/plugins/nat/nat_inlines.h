@@ -285,6 +285,71 @@ nat44_delete_user_with_no_session (snat_main_t * sm, snat_user_t * u,
     }
 }
 
+/** \brief Start the session's expiry timer.
+    The timer is not restarted as the session is used; when it expires the
+    session is checked and the timer restarted for the time remaining.
+*/
+always_inline void
+nat44_session_timer_start (snat_main_t * sm, snat_session_t * s,
+			   u32 thread_index, u32 ticks)
+{
+  snat_main_per_thread_data_t *tsm = &sm->per_thread_data[thread_index];
+
+  ticks = clib_max (ticks, 1);
+  ticks = clib_min (ticks, NAT44_SESSION_TW_MAX_TICKS);
+  s->expire_timer_handle =
+    tw_timer_start_16t_2w_512sl (&tsm->sessions_tw, s - tsm->sessions, 0,
+				 ticks);
+}
+
+/** \brief Start the expiry timer of a new session.
+    Its protocol is not known yet, so use the shortest timeout.
+*/
+always_inline void
+nat44_session_timer_start_new (snat_main_t * sm, snat_session_t * s,
+			       u32 thread_index)
+{
+  u32 timeout;
+
+  timeout = clib_min (sm->icmp_timeout, sm->udp_timeout);
+  timeout = clib_min (timeout, sm->tcp_transitory_timeout);
+
+  nat44_session_timer_start (sm, s, thread_index, timeout);
+}
+
+always_inline void
+nat44_session_timer_stop (snat_main_t * sm, snat_session_t * s,
+			  u32 thread_index)
+{
+  snat_main_per_thread_data_t *tsm = &sm->per_thread_data[thread_index];
+
+  if (~0 != s->expire_timer_handle)
+    tw_timer_stop_16t_2w_512sl (&tsm->sessions_tw, s->expire_timer_handle);
+  s->expire_timer_handle = ~0;
+}
+
+/*
+ * The owner is about to change a session's translation; readers that
+ * start now or overlap see the version change and do not use it
+ */
+always_inline void
+nat44_session_update_begin (snat_session_t * s)
+{
+  if (s->version & 1)
+    return;
+  clib_atomic_store_rel_n (&s->version, s->version + 1);
+  CLIB_MEMORY_STORE_BARRIER ();
+}
+
+/* The session's translation is complete, readers may use it */
+always_inline void
+nat44_session_update_end (snat_session_t * s)
+{
+  if (!(s->version & 1))
+    return;
+  clib_atomic_store_rel_n (&s->version, s->version + 1);
+}
+
 always_inline void
 nat44_delete_session (snat_main_t * sm, snat_session_t * ses,
 		      u32 thread_index)
@@ -299,6 +364,8 @@ nat44_delete_session (snat_main_t * sm, snat_session_t * ses,
   };
   const u8 u_static = snat_is_session_static (ses);
 
+  nat44_session_update_begin (ses);
+  nat44_session_timer_stop (sm, ses, thread_index);
   clib_dlist_remove (tsm->list_pool, ses->per_user_index);
   pool_put_index (tsm->list_pool, ses->per_user_index);
   pool_put (tsm->sessions, ses);
@@ -29,6 +29,8 @@ typedef enum {
   NAT64_BIB_DELETE = 11,
   NAT_PORTS_EXHAUSTED = 12,
   QUOTA_EXCEEDED = 13,
+  NAT_PORT_BLOCK_ALLOC = 16,
+  NAT_PORT_BLOCK_DEALLOC = 17,
 } nat_event_t;
 
 typedef enum {
@@ -51,6 +53,7 @@ typedef struct {
   vlib_buffer_t *max_frags_ip6_buffer;
   vlib_buffer_t *nat64_bib_buffer;
   vlib_buffer_t *nat64_ses_buffer;
+  vlib_buffer_t *port_block_buffer;
 
   /** frames containing ipfix buffers */
   vlib_frame_t *nat44_session_frame;
@@ -62,6 +65,7 @@ typedef struct {
   vlib_frame_t *max_frags_ip6_frame;
   vlib_frame_t *nat64_bib_frame;
   vlib_frame_t *nat64_ses_frame;
+  vlib_frame_t *port_block_frame;
 
   /** next record offset */
   u32 nat44_session_next_record_offset;
@@ -73,6 +77,7 @@ typedef struct {
   u32 max_frags_ip6_next_record_offset;
   u32 nat64_bib_next_record_offset;
   u32 nat64_ses_next_record_offset;
+  u32 port_block_next_record_offset;
 
 } snat_ipfix_per_thread_data_t;
 
@@ -97,6 +102,10 @@ typedef struct {
   u16 max_frags_ip6_template_id;
   u16 nat64_bib_template_id;
   u16 nat64_ses_template_id;
+  u16 port_block_template_id;
+
+  /** port block template registered */
+  u8 port_block_template;
 
   /** stream index */
   u32 stream_index;
@@ -145,5 +154,9 @@ void nat_ipfix_logging_nat64_bib(u32 thread_index,
                                  ip4_address_t * nat_src_ip, u8 proto,
                                  u16 src_port, u16 nat_src_port,
                                  u32 vrf_id, u8 is_create);
+void nat_ipfix_logging_nat44_port_block(u32 thread_index, u32 src_ip,
+                                        u32 nat_src_ip, u16 start_port,
+                                        u16 end_port, u32 vrf_id,
+                                        u8 is_create);
 
 #endif /* __included_nat_ipfix_logging_h__ */
@@ -31,14 +31,18 @@
 
 #define SADD_SDEL_SEVERITY SYSLOG_SEVERITY_INFORMATIONAL
 #define APMADD_APMDEL_SEVERITY SYSLOG_SEVERITY_INFORMATIONAL
+#define PBADD_PBDEL_SEVERITY SYSLOG_SEVERITY_INFORMATIONAL
 
 #define SADD_MSGID "SADD"
 #define SDEL_MSGID "SDEL"
 #define APMADD_MSGID "APMADD"
 #define APMDEL_MSGID "APMDEL"
+#define PBADD_MSGID "PBADD"
+#define PBDEL_MSGID "PBDEL"
 
 #define NSESS_SDID "nsess"
 #define NAPMAP_SDID "napmap"
+#define NPB_SDID "npb"
 
 #define SSUBIX_SDPARAM_NAME "SSUBIX"
 #define SVLAN_SDPARAM_NAME "SVLAN"
@@ -52,6 +56,8 @@
 #define XSPORT_SDPARAM_NAME "XSPORT"
 #define XDADDR_SDPARAM_NAME "XDADDR"
 #define XDPORT_SDPARAM_NAME "XDPORT"
+#define XSPORTS_SDPARAM_NAME "XSPORTS"
+#define XSPORTE_SDPARAM_NAME "XSPORTE"
 #define PROTO_SDPARAM_NAME "PROTO"
 #define SV6ENC_SDPARAM_NAME "SV6ENC"
 
@@ -73,6 +79,10 @@ nat_syslog_nat44_apmap (u32 ssubix, u32 sfibix, ip4_address_t * isaddr,
   if (syslog_severity_filter_block (APMADD_APMDEL_SEVERITY))
     return;
 
+  /* logged per port block instead */
+  if (!sv6enc && nat_port_block_is_block_port (xsaddr, proto, xsport))
+    return;
+
   syslog_msg_init (&syslog_msg, NAT_FACILITY, APMADD_APMDEL_SEVERITY,
 		   NAT_APPNAME, is_add ? APMADD_MSGID : APMDEL_MSGID);
 
@@ -143,6 +153,42 @@ nat_syslog_dslite_apmdel (u32 ssubix, ip6_address_t * sv6enc,
 			  proto, 0, sv6enc);
 }
 
+void
+nat_syslog_nat44_port_block (u32 sfibix, ip4_address_t * isaddr,
+			     ip4_address_t * xsaddr, u16 start_port,
+			     u16 end_port, u8 is_add)
+{
+  syslog_msg_t syslog_msg;
+  fib_table_t *fib;
+
+  if (!syslog_is_enabled ())
+    return;
+
+  if (syslog_severity_filter_block (PBADD_PBDEL_SEVERITY))
+    return;
+
+  fib = fib_table_get (sfibix, FIB_PROTOCOL_IP4);
+
+  syslog_msg_init (&syslog_msg, NAT_FACILITY, PBADD_PBDEL_SEVERITY,
+		   NAT_APPNAME, is_add ? PBADD_MSGID : PBDEL_MSGID);
+
+  syslog_msg_sd_init (&syslog_msg, NPB_SDID);
+  syslog_msg_add_sd_param (&syslog_msg, SVLAN_SDPARAM_NAME, "%d",
+			   fib->ft_table_id);
+  syslog_msg_add_sd_param (&syslog_msg, IATYP_SDPARAM_NAME, IATYP_IPV4);
+  syslog_msg_add_sd_param (&syslog_msg, ISADDR_SDPARAM_NAME, "%U",
+			   format_ip4_address, isaddr);
+  syslog_msg_add_sd_param (&syslog_msg, XATYP_SDPARAM_NAME, IATYP_IPV4);
+  syslog_msg_add_sd_param (&syslog_msg, XSADDR_SDPARAM_NAME, "%U",
+			   format_ip4_address, xsaddr);
+  syslog_msg_add_sd_param (&syslog_msg, XSPORTS_SDPARAM_NAME, "%d",
+			   start_port);
+  syslog_msg_add_sd_param (&syslog_msg, XSPORTE_SDPARAM_NAME, "%d",
+			   end_port);
+
+  syslog_msg_send (&syslog_msg);
+}
+
 static inline void
 nat_syslog_nat44_sess (u32 ssubix, u32 sfibix, ip4_address_t * isaddr,
 		       u16 isport, ip4_address_t * xsaddr, u16 xsport,
@@ -159,6 +205,10 @@ nat_syslog_nat44_sess (u32 ssubix, u32 sfibix, ip4_address_t * isaddr,
   if (syslog_severity_filter_block (SADD_SDEL_SEVERITY))
     return;
 
+  /* logged per port block instead */
+  if (!is_twicenat && nat_port_block_is_block_port (xsaddr, proto, xsport))
+    return;
+
   fib = fib_table_get (sfibix, FIB_PROTOCOL_IP4);
 
   syslog_msg_init (&syslog_msg, NAT_FACILITY, SADD_SDEL_SEVERITY, NAT_APPNAME,
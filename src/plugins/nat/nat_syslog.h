@@ -30,6 +30,10 @@ void nat_syslog_nat44_apmdel (u32 ssubix, u32 sfibix, ip4_address_t * isaddr,
 			      u16 isport, ip4_address_t * xsaddr, u16 xsport,
 			      snat_protocol_t proto);
 
+void nat_syslog_nat44_port_block (u32 sfibix, ip4_address_t * isaddr,
+				  ip4_address_t * xsaddr, u16 start_port,
+				  u16 end_port, u8 is_add);
+
 void
 nat_syslog_dslite_apmadd (u32 ssubix, ip6_address_t * sv6enc,
 			  ip4_address_t * isaddr, u16 isport,
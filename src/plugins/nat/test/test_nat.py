@@ -27,6 +27,7 @@ from io import BytesIO
 from vpp_papi import VppEnum
 from vpp_ip_route import VppIpRoute, VppRoutePath, FibPathType
 from vpp_neighbor import VppNeighbor
+from vpp_papi_provider import CliFailedCommandError
 from scapy.all import bind_layers, Packet, ByteEnumField, ShortField, \
     IPField, IntField, LongField, XByteField, FlagsField, FieldLenField, \
     PacketListField
@@ -57,6 +58,23 @@ class Event(Packet):
         return "", s
 
 
+# NAT HA protocol compact session refresh event data, outside address and
+# fib index are the same as in the previous event of the message
+class RefreshDeltaEvent(Packet):
+    name = "Refresh delta event"
+    fields_desc = [ByteEnumField("event_type", 4, {4: "refresh-delta"}),
+                   ByteEnumField("protocol", None,
+                                 {0: "udp", 1: "tcp", 2: "icmp"}),
+                   ShortField("out_port", None),
+                   IPField("eh_addr", None),
+                   ShortField("eh_port", None),
+                   IntField("total_pkts", 0),
+                   LongField("total_bytes", 0)]
+
+    def extract_padding(self, s):
+        return "", s
+
+
 # NAT HA protocol header
 class HANATStateSync(Packet):
     name = "HA NAT state sync"
@@ -110,6 +128,7 @@ class MethodHolder(VppTestCase):
                                       path_mtu=512)
         self.vapi.nat_ha_set_failover(ip_address='0.0.0.0', port=0,
                                       session_refresh_interval=10)
+        self.vapi.cli("nat ha sync flush-interval 1 delta-refresh off")
 
         interfaces = self.vapi.nat44_interface_dump()
         for intf in interfaces:
@@ -178,6 +197,55 @@ class MethodHolder(VppTestCase):
         self.vapi.nat_set_addr_and_port_alloc_alg()
         self.vapi.nat_set_mss_clamping(enable=0, mss_value=1500)
 
+    def clear_nat64(self):
+        """
+        Clear NAT64 configuration.
+        """
+        self.vapi.nat_ipfix_enable_disable(domain_id=self.ipfix_domain_id,
+                                           src_port=self.ipfix_src_port,
+                                           enable=0)
+        self.ipfix_src_port = 4739
+        self.ipfix_domain_id = 1
+
+        self.vapi.syslog_set_filter(
+            self.SYSLOG_SEVERITY.SYSLOG_API_SEVERITY_EMERG)
+
+        self.vapi.nat_set_timeouts(udp=300, tcp_established=7440,
+                                   tcp_transitory=240, icmp=60)
+
+        interfaces = self.vapi.nat64_interface_dump()
+        for intf in interfaces:
+            self.vapi.nat64_add_del_interface(is_add=0, flags=intf.flags,
+                                              sw_if_index=intf.sw_if_index)
+
+        bib = self.vapi.nat64_bib_dump(proto=255)
+        for bibe in bib:
+            if bibe.flags & self.config_flags.NAT_IS_STATIC:
+                self.vapi.nat64_add_del_static_bib(i_addr=bibe.i_addr,
+                                                   o_addr=bibe.o_addr,
+                                                   i_port=bibe.i_port,
+                                                   o_port=bibe.o_port,
+                                                   proto=bibe.proto,
+                                                   vrf_id=bibe.vrf_id,
+                                                   is_add=0)
+
+        adresses = self.vapi.nat64_pool_addr_dump()
+        for addr in adresses:
+            self.vapi.nat64_add_del_pool_addr_range(start_addr=addr.address,
+                                                    end_addr=addr.address,
+                                                    vrf_id=addr.vrf_id,
+                                                    is_add=0)
+
+        prefixes = self.vapi.nat64_prefix_dump()
+        for prefix in prefixes:
+            self.vapi.nat64_add_del_prefix(prefix=str(prefix.prefix),
+                                           vrf_id=prefix.vrf_id, is_add=0)
+
+        bibs = self.statistics.get_counter('/nat64/total-bibs')
+        self.assertEqual(bibs[0][0], 0)
+        sessions = self.statistics.get_counter('/nat64/total-sessions')
+        self.assertEqual(sessions[0][0], 0)
+
     def nat44_add_static_mapping(self, local_ip, external_ip='0.0.0.0',
                                  local_port=0, external_port=0, vrf_id=0,
                                  is_add=1, external_sw_if_index=0xFFFFFFFF,
@@ -3827,6 +3895,157 @@ class TestNAT44(MethodHolder):
             self.assertGreaterEqual(tcp.sport, 1025)
             self.assertLessEqual(tcp.sport, 1027)
 
+    def verify_syslog_port_block(self, data, start, is_add=True):
+        message = data.decode('utf-8')
+        try:
+            message = SyslogMessage.parse(message)
+        except ParseError as e:
+            self.logger.error(e)
+            raise
+        else:
+            self.assertEqual(message.severity, SyslogSeverity.info)
+            self.assertEqual(message.appname, 'NAT')
+            self.assertEqual(message.msgid, 'PBADD' if is_add else 'PBDEL')
+            sd_params = message.sd.get('npb')
+            self.assertTrue(sd_params is not None)
+            self.assertEqual(sd_params.get('IATYP'), 'IPv4')
+            self.assertEqual(sd_params.get('ISADDR'), self.pg0.remote_ip4)
+            self.assertEqual(sd_params.get('XATYP'), 'IPv4')
+            self.assertEqual(sd_params.get('XSADDR'), self.nat_addr)
+            self.assertEqual(sd_params.get('XSPORTS'), "%d" % start)
+            self.assertEqual(sd_params.get('XSPORTE'), "%d" % (start + 63))
+            self.assertEqual(sd_params.get('SVLAN'), '0')
+
+    def test_port_block(self):
+        """ Port block address and port allocation """
+        self.ipfix_domain_id = 10
+        self.ipfix_src_port = 20202
+        collector_port = 30303
+        bind_layers(UDP, IPFIX, dport=30303)
+        self.vapi.cli("nat addr-port-assignment-alg port-block size 64")
+        self.nat44_add_address(self.nat_addr)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg0.sw_if_index,
+            flags=flags, is_add=1)
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg1.sw_if_index,
+            is_add=1)
+        self.vapi.set_ipfix_exporter(collector_address=self.pg3.remote_ip4,
+                                     src_address=self.pg3.local_ip4,
+                                     path_mtu=512,
+                                     template_interval=10,
+                                     collector_port=collector_port)
+        self.vapi.nat_ipfix_enable_disable(domain_id=self.ipfix_domain_id,
+                                           src_port=self.ipfix_src_port,
+                                           enable=1)
+        self.vapi.syslog_set_filter(
+            self.SYSLOG_SEVERITY.SYSLOG_API_SEVERITY_INFO)
+        self.vapi.syslog_set_sender(self.pg3.local_ip4, self.pg3.remote_ip4)
+
+        pkts = []
+        for port in range(0, 5):
+            p = (Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+                 IP(src=self.pg0.remote_ip4, dst=self.pg1.remote_ip4) /
+                 TCP(sport=1125 + port))
+            pkts.append(p)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg1.get_capture(len(pkts))
+
+        # all the sessions of the subscriber take ports from one block
+        blocks = set((p[TCP].sport - 1024) // 64 for p in capture)
+        self.assertEqual(len(blocks), 1)
+        self.assertEqual(len(set(p[TCP].sport for p in capture)), len(pkts))
+
+        # blocks cannot be resized once NAT addresses are in use
+        with self.assertRaises(CliFailedCommandError):
+            self.vapi.cli("nat addr-port-assignment-alg port-block size 32")
+        self.assertIn("block size 64",
+                      self.vapi.cli("show nat addr-port-assignment-alg"))
+
+        # releasing the last port of the block releases the block
+        start = 1024 + blocks.pop() * 64
+        self.nat44_add_address(self.nat_addr, is_add=0)
+        self.vapi.ipfix_flush()
+
+        # 9 templates, 1 data set and the PBADD and PBDEL messages
+        capture = self.pg3.get_capture(12)
+        syslog = [p for p in capture if p[UDP].dport != collector_port]
+        # the sessions are not logged one by one
+        self.assertEqual(len(syslog), 2)
+        self.verify_syslog_port_block(syslog[0][Raw].load, start)
+        self.verify_syslog_port_block(syslog[1][Raw].load, start, False)
+
+        ipfix = IPFIXDecoder()
+        capture = [p for p in capture if p[UDP].dport == collector_port]
+        for p in capture:
+            self.assertTrue(p.haslayer(IPFIX))
+            self.assertEqual(p[UDP].sport, self.ipfix_src_port)
+            self.assertEqual(p[IPFIX].observationDomainID,
+                             self.ipfix_domain_id)
+            if p.haslayer(Template):
+                ipfix.add_template(p.getlayer(Template))
+        records = []
+        for p in capture:
+            if p.haslayer(Data):
+                records.extend(ipfix.decode_data_set(p.getlayer(Set)))
+        # natEvent 16 and 17 only, no NAT44 session create/delete
+        self.assertEqual([scapy.compat.orb(r[230]) for r in records],
+                         [16, 17])
+        for record in records:
+            # sourceIPv4Address
+            self.assertEqual(self.pg0.remote_ip4n, record[8])
+            # postNATSourceIPv4Address
+            self.assertEqual(socket.inet_pton(socket.AF_INET, self.nat_addr),
+                             record[225])
+            # portRangeStart
+            self.assertEqual(struct.pack("!H", start), record[361])
+            # portRangeEnd
+            self.assertEqual(struct.pack("!H", start + 63), record[362])
+
+    def test_port_block_static_mapping(self):
+        """ Port block allocation logs static mapping sessions """
+        self.vapi.cli("nat addr-port-assignment-alg port-block size 64")
+        self.nat44_add_address(self.nat_addr)
+        self.nat44_add_static_mapping(self.pg0.remote_ip4, self.nat_addr,
+                                      self.tcp_port_in, self.tcp_port_out,
+                                      proto=IP_PROTOS.tcp)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg0.sw_if_index,
+            flags=flags, is_add=1)
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg1.sw_if_index,
+            is_add=1)
+        self.vapi.syslog_set_filter(
+            self.SYSLOG_SEVERITY.SYSLOG_API_SEVERITY_INFO)
+        self.vapi.syslog_set_sender(self.pg3.local_ip4, self.pg3.remote_ip4)
+
+        # the port is not taken from a block, the session is logged
+        p = (Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+             IP(src=self.pg0.remote_ip4, dst=self.pg1.remote_ip4) /
+             TCP(sport=self.tcp_port_in, dport=20))
+        self.pg0.add_stream(p)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg1.get_capture(1)
+        self.assertEqual(capture[0][TCP].sport, self.tcp_port_out)
+        capture = self.pg3.get_capture(1)
+        self.verify_syslog_apmap(capture[0][Raw].load)
+
+        # invalid block sizes are refused, not truncated
+        self.nat44_add_static_mapping(self.pg0.remote_ip4, self.nat_addr,
+                                      self.tcp_port_in, self.tcp_port_out,
+                                      proto=IP_PROTOS.tcp, is_add=0)
+        self.nat44_add_address(self.nat_addr, is_add=0)
+        with self.assertRaises(CliFailedCommandError):
+            self.vapi.cli("nat addr-port-assignment-alg port-block "
+                          "size 65537")
+        self.assertIn("block size 64",
+                      self.vapi.cli("show nat addr-port-assignment-alg"))
+
     def test_ipfix_max_frags(self):
         """ IPFIX logging maximum fragments pending reassembly exceeded """
         self.nat44_add_address(self.nat_addr)
@@ -4179,6 +4398,65 @@ class TestNAT44(MethodHolder):
         stats = self.statistics.get_counter('/nat44/ha/ack-recv')
         self.assertEqual(stats[0][0], 2)
 
+    def test_ha_resync(self):
+        """ Resync existing HA sessions to new failover (active) """
+        self.nat44_add_address(self.nat_addr)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg0.sw_if_index,
+            flags=flags, is_add=1)
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg1.sw_if_index,
+            is_add=1)
+        self.vapi.nat_ha_set_listener(ip_address=self.pg3.local_ip4,
+                                      port=12345,
+                                      path_mtu=512)
+        bind_layers(UDP, HANATStateSync, sport=12345)
+
+        # create sessions before failover is known
+        pkts = self.create_stream_in(self.pg0, self.pg1)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg1.get_capture(len(pkts))
+        self.verify_capture_out(capture)
+
+        # new failover, existing sessions sent in bulk
+        self.vapi.nat_ha_set_failover(ip_address=self.pg3.remote_ip4,
+                                      port=12346, session_refresh_interval=10)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.vapi.nat_ha_resync(want_resync_event=0)
+        capture = self.pg3.get_capture(1)
+        p = capture[0]
+        self.assert_packet_checksums_valid(p)
+        try:
+            hanat = p[HANATStateSync]
+        except IndexError:
+            self.logger.error(ppp("Invalid packet:", p))
+            raise
+        else:
+            self.assertEqual(hanat.count, 3)
+            seq = hanat.sequence_number
+            for event in hanat.events:
+                self.assertEqual(event.event_type, 1)
+                self.assertEqual(event.in_addr, self.pg0.remote_ip4)
+                self.assertEqual(event.out_addr, self.nat_addr)
+        stats = self.statistics.get_counter('/nat44/ha/resync-event-send')
+        self.assertEqual(stats[0][0], 3)
+        self.assertIn("in progress", self.vapi.cli("show nat ha"))
+
+        # resync done when ACK received
+        ack = (Ether(dst=self.pg3.local_mac, src=self.pg3.remote_mac) /
+               IP(src=self.pg3.remote_ip4, dst=self.pg3.local_ip4) /
+               UDP(sport=12346, dport=12345) /
+               HANATStateSync(sequence_number=seq, flags='ACK'))
+        self.pg3.add_stream(ack)
+        self.pg_start()
+        stats = self.statistics.get_counter('/nat44/ha/ack-recv')
+        self.assertEqual(stats[0][0], 1)
+        self.assertIn("completed (0 ACK missed)",
+                      self.vapi.cli("show nat ha"))
+
     def test_ha_recv(self):
         """ Receive HA session synchronization events (passive) """
         self.nat44_add_address(self.nat_addr)
@@ -4367,39 +4645,236 @@ class TestNAT44(MethodHolder):
             self.assertEqual(tcp.sport, self.tcp_external_port)
             self.assertEqual(tcp.dport, self.tcp_port_in)
 
-    def tearDown(self):
-        super(TestNAT44, self).tearDown()
-        self.clear_nat44()
-        self.vapi.cli("clear logging")
-
-    def show_commands_at_teardown(self):
-        self.logger.info(self.vapi.cli("show nat44 addresses"))
-        self.logger.info(self.vapi.cli("show nat44 interfaces"))
-        self.logger.info(self.vapi.cli("show nat44 static mappings"))
-        self.logger.info(self.vapi.cli("show nat44 interface address"))
-        self.logger.info(self.vapi.cli("show nat44 sessions detail"))
-        self.logger.info(self.vapi.cli("show nat virtual-reassembly"))
-        self.logger.info(self.vapi.cli("show nat44 hash tables detail"))
-        self.logger.info(self.vapi.cli("show nat timeouts"))
-        self.logger.info(
-            self.vapi.cli("show nat addr-port-assignment-alg"))
-        self.logger.info(self.vapi.cli("show nat ha"))
-
-
-class TestNAT44EndpointDependent(MethodHolder):
-    """ Endpoint-Dependent mapping and filtering test cases """
+    def decode_ha_events(self, p):
+        """ Decode HA message events, full and delta refresh ones """
+        data = scapy.compat.raw(p[IP])[28:]
+        count = struct.unpack("!H", data[2:4])[0]
+        events = []
+        offset = 12
+        for i in range(count):
+            if scapy.compat.orb(data[offset]) == 4:
+                events.append(RefreshDeltaEvent(data[offset:offset + 22]))
+                offset += 22
+            else:
+                events.append(Event(data[offset:offset + 44]))
+                offset += 44
+        self.assertEqual(offset, len(data))
+        return events
 
-    @classmethod
-    def setUpConstants(cls):
-        super(TestNAT44EndpointDependent, cls).setUpConstants()
-        cls.vpp_cmdline.extend(["nat", "{", "endpoint-dependent", "}"])
+    def test_ha_send_delta_refresh(self):
+        """ Send HA delta refresh events in flush interval batches """
+        self.nat44_add_address(self.nat_addr)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg0.sw_if_index,
+            flags=flags, is_add=1)
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg1.sw_if_index,
+            is_add=1)
+        self.vapi.nat_ha_set_listener(ip_address=self.pg3.local_ip4,
+                                      port=12345,
+                                      path_mtu=512)
+        self.vapi.nat_ha_set_failover(ip_address=self.pg3.remote_ip4,
+                                      port=12346, session_refresh_interval=1)
+        self.vapi.cli("nat ha sync flush-interval 0.2 delta-refresh on")
+        self.assertIn("flush-interval 0.200sec delta-refresh on",
+                      self.vapi.cli("show nat ha"))
+        bind_layers(UDP, HANATStateSync, sport=12345)
 
-    @classmethod
-    def setUpClass(cls):
-        super(TestNAT44EndpointDependent, cls).setUpClass()
-        cls.vapi.cli("set log class nat level debug")
-        try:
-            cls.tcp_port_in = 6303
+        # create sessions, events are sent in one message without flush
+        pkts = self.create_stream_in(self.pg0, self.pg1)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg1.get_capture(len(pkts))
+        self.verify_capture_out(capture)
+        capture = self.pg3.get_capture(1)
+        p = capture[0]
+        self.assert_packet_checksums_valid(p)
+        events = self.decode_ha_events(p)
+        self.assertEqual(len(events), 3)
+        for event in events:
+            self.assertEqual(event.event_type, 1)
+        seq = p[HANATStateSync].sequence_number
+        ack = (Ether(dst=self.pg3.local_mac, src=self.pg3.remote_mac) /
+               IP(src=self.pg3.remote_ip4, dst=self.pg3.local_ip4) /
+               UDP(sport=12346, dport=12345) /
+               HANATStateSync(sequence_number=seq, flags='ACK'))
+        self.pg3.add_stream(ack)
+        self.pg_start()
+        stats = self.statistics.get_counter('/nat44/ha/ack-recv')
+        self.assertEqual(stats[0][0], 1)
+
+        # session counters refresh, only the first event carries the
+        # outside address and fib index
+        sleep(2)
+        pkts = self.create_stream_out(self.pg1)
+        self.pg1.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg0.get_capture(len(pkts))
+        capture = self.pg3.get_capture(1)
+        p = capture[0]
+        self.assert_packet_checksums_valid(p)
+        self.assertEqual(len(scapy.compat.raw(p[IP])), 28 + 12 + 44 + 2 * 22)
+        events = self.decode_ha_events(p)
+        self.assertEqual([e.event_type for e in events], [3, 4, 4])
+        self.assertEqual(events[0].out_addr, self.nat_addr)
+        self.assertEqual(events[0].fib_index, 0)
+        self.assertEqual(set(e.out_port for e in events),
+                         set([self.tcp_port_out, self.udp_port_out,
+                              self.icmp_id_out]))
+        for event in events:
+            self.assertEqual(event.eh_addr, self.pg1.remote_ip4)
+            self.assertEqual(event.total_pkts, 2)
+            self.assertGreater(event.total_bytes, 0)
+        stats = self.statistics.get_counter('/nat44/ha/refresh-event-send')
+        self.assertEqual(stats[0][0], 3)
+
+    def test_ha_recv_delta_refresh(self):
+        """ Receive HA delta refresh events (passive) """
+        self.nat44_add_address(self.nat_addr)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg0.sw_if_index,
+            flags=flags, is_add=1)
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg1.sw_if_index,
+            is_add=1)
+        self.vapi.nat_ha_set_listener(ip_address=self.pg3.local_ip4,
+                                      port=12345,
+                                      path_mtu=512)
+        bind_layers(UDP, HANATStateSync, sport=12345)
+
+        self.tcp_port_out = random.randint(1025, 65535)
+        self.udp_port_out = random.randint(1025, 65535)
+
+        # send HA session add events to failover/passive
+        p = (Ether(dst=self.pg3.local_mac, src=self.pg3.remote_mac) /
+             IP(src=self.pg3.remote_ip4, dst=self.pg3.local_ip4) /
+             UDP(sport=12346, dport=12345) /
+             HANATStateSync(sequence_number=1, events=[
+                 Event(event_type='add', protocol='tcp',
+                       in_addr=self.pg0.remote_ip4, out_addr=self.nat_addr,
+                       in_port=self.tcp_port_in, out_port=self.tcp_port_out,
+                       eh_addr=self.pg1.remote_ip4,
+                       ehn_addr=self.pg1.remote_ip4,
+                       eh_port=self.tcp_external_port,
+                       ehn_port=self.tcp_external_port, fib_index=0),
+                 Event(event_type='add', protocol='udp',
+                       in_addr=self.pg0.remote_ip4, out_addr=self.nat_addr,
+                       in_port=self.udp_port_in, out_port=self.udp_port_out,
+                       eh_addr=self.pg1.remote_ip4,
+                       ehn_addr=self.pg1.remote_ip4,
+                       eh_port=self.udp_external_port,
+                       ehn_port=self.udp_external_port, fib_index=0)]))
+        self.pg3.add_stream(p)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg3.get_capture(1)
+
+        # full refresh event followed by a delta one
+        refresh = Event(event_type='refresh', protocol='tcp',
+                        in_addr=self.pg0.remote_ip4, out_addr=self.nat_addr,
+                        in_port=self.tcp_port_in, out_port=self.tcp_port_out,
+                        eh_addr=self.pg1.remote_ip4,
+                        ehn_addr=self.pg1.remote_ip4,
+                        eh_port=self.tcp_external_port,
+                        ehn_port=self.tcp_external_port, fib_index=0,
+                        total_bytes=1024, total_pkts=2)
+        delta = RefreshDeltaEvent(protocol='udp', out_port=self.udp_port_out,
+                                  eh_addr=self.pg1.remote_ip4,
+                                  eh_port=self.udp_external_port,
+                                  total_bytes=2048, total_pkts=4)
+        p = (Ether(dst=self.pg3.local_mac, src=self.pg3.remote_mac) /
+             IP(src=self.pg3.remote_ip4, dst=self.pg3.local_ip4) /
+             UDP(sport=12346, dport=12345) /
+             HANATStateSync(sequence_number=2, count=2) /
+             Raw(scapy.compat.raw(refresh) + scapy.compat.raw(delta)))
+        self.pg3.add_stream(p)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        # receive ACK
+        capture = self.pg3.get_capture(1)
+        p = capture[0]
+        try:
+            hanat = p[HANATStateSync]
+        except IndexError:
+            self.logger.error(ppp("Invalid packet:", p))
+            raise
+        else:
+            self.assertEqual(hanat.sequence_number, 2)
+            self.assertEqual(hanat.flags, 'ACK')
+        stats = self.statistics.get_counter('/nat44/ha/refresh-event-recv')
+        self.assertEqual(stats[0][0], 2)
+        users = self.vapi.nat44_user_dump()
+        self.assertEqual(len(users), 1)
+        sessions = self.vapi.nat44_user_session_dump(users[0].ip_address,
+                                                     users[0].vrf_id)
+        self.assertEqual(len(sessions), 2)
+        for session in sessions:
+            if session.protocol == IP_PROTOS.tcp:
+                self.assertEqual(session.total_bytes, 1024)
+                self.assertEqual(session.total_pkts, 2)
+            else:
+                self.assertEqual(session.total_bytes, 2048)
+                self.assertEqual(session.total_pkts, 4)
+
+        # truncated delta event and delta event without a previous full
+        # event are dropped and not ACKed
+        pkts = [(Ether(dst=self.pg3.local_mac, src=self.pg3.remote_mac) /
+                 IP(src=self.pg3.remote_ip4, dst=self.pg3.local_ip4) /
+                 UDP(sport=12346, dport=12345) /
+                 HANATStateSync(sequence_number=3, count=2) /
+                 Raw(scapy.compat.raw(refresh) +
+                     scapy.compat.raw(delta)[:10])),
+                (Ether(dst=self.pg3.local_mac, src=self.pg3.remote_mac) /
+                 IP(src=self.pg3.remote_ip4, dst=self.pg3.local_ip4) /
+                 UDP(sport=12346, dport=12345) /
+                 HANATStateSync(sequence_number=4, count=1) /
+                 Raw(scapy.compat.raw(delta)))]
+        self.pg3.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg3.assert_nothing_captured()
+        stats = self.statistics.get_err_counter('/err/nat-ha/bad-event')
+        self.assertEqual(stats, 2)
+        stats = self.statistics.get_counter('/nat44/ha/ack-send')
+        self.assertEqual(stats[0][0], 2)
+
+    def tearDown(self):
+        super(TestNAT44, self).tearDown()
+        self.clear_nat44()
+        self.vapi.cli("clear logging")
+
+    def show_commands_at_teardown(self):
+        self.logger.info(self.vapi.cli("show nat44 addresses"))
+        self.logger.info(self.vapi.cli("show nat44 interfaces"))
+        self.logger.info(self.vapi.cli("show nat44 static mappings"))
+        self.logger.info(self.vapi.cli("show nat44 interface address"))
+        self.logger.info(self.vapi.cli("show nat44 sessions detail"))
+        self.logger.info(self.vapi.cli("show nat virtual-reassembly"))
+        self.logger.info(self.vapi.cli("show nat44 hash tables detail"))
+        self.logger.info(self.vapi.cli("show nat timeouts"))
+        self.logger.info(
+            self.vapi.cli("show nat addr-port-assignment-alg"))
+        self.logger.info(self.vapi.cli("show nat ha"))
+
+
+class TestNAT44EndpointDependent(MethodHolder):
+    """ Endpoint-Dependent mapping and filtering test cases """
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestNAT44EndpointDependent, cls).setUpConstants()
+        cls.vpp_cmdline.extend(["nat", "{", "endpoint-dependent", "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestNAT44EndpointDependent, cls).setUpClass()
+        cls.vapi.cli("set log class nat level debug")
+        try:
+            cls.tcp_port_in = 6303
             cls.tcp_port_out = 6303
             cls.udp_port_in = 6304
             cls.udp_port_out = 6304
@@ -6818,6 +7293,46 @@ class TestNAT44EndpointDependent(MethodHolder):
             nsessions = nsessions + user.nsessions
         self.assertLess(nsessions, 2 * max_sessions)
 
+    @unittest.skipUnless(running_extended_tests, "part of extended tests")
+    def test_session_expire(self):
+        """ NAT44 session expiry without traffic """
+        self.nat44_add_address(self.nat_addr)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg0.sw_if_index,
+            flags=flags, is_add=1)
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg1.sw_if_index,
+            is_add=1)
+        self.vapi.nat_set_timeouts(udp=300, tcp_established=7440,
+                                   tcp_transitory=240, icmp=2)
+
+        expired = self.statistics.get_counter('/nat44/expired-sessions')
+        expired = sum(sum(c) for c in expired)
+
+        max_sessions = 100
+        pkts = []
+        for i in range(0, max_sessions):
+            src = "10.10.%u.%u" % ((i & 0xFF00) >> 8, i & 0xFF)
+            p = (Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+                 IP(src=src, dst=self.pg1.remote_ip4) /
+                 ICMP(id=1025, type='echo-request'))
+            pkts.append(p)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(max_sessions)
+
+        sleep(5)
+
+        nsessions = 0
+        users = self.vapi.nat44_user_dump()
+        for user in users:
+            nsessions = nsessions + user.nsessions
+        self.assertEqual(nsessions, 0)
+        stats = self.statistics.get_counter('/nat44/expired-sessions')
+        self.assertEqual(sum(sum(c) for c in stats) - expired, max_sessions)
+
     @unittest.skipUnless(running_extended_tests, "part of extended tests")
     def test_session_rst_timeout(self):
         """ NAT44 session RST timeouts """
@@ -6980,6 +7495,88 @@ class TestNAT44EndpointDependent(MethodHolder):
         self.logger.info(self.vapi.cli("show nat timeouts"))
 
 
+class TestNAT44EDSharedLookup(MethodHolder):
+    """ NAT44 Endpoint-Dependent shared session lookup Test Cases """
+
+    worker_config = "workers 2"
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestNAT44EDSharedLookup, cls).setUpConstants()
+        cls.vpp_cmdline.extend(["nat", "{", "endpoint-dependent",
+                                "shared-lookup", "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestNAT44EDSharedLookup, cls).setUpClass()
+
+        cls.tcp_port_in = 6303
+        cls.tcp_port_out = 6303
+        cls.udp_port_in = 6304
+        cls.udp_port_out = 6304
+        cls.icmp_id_in = 6305
+        cls.icmp_id_out = 6305
+        cls.nat_addr = '10.0.0.3'
+
+        cls.create_pg_interfaces(range(2))
+        cls.interfaces = list(cls.pg_interfaces)
+
+        for i in cls.interfaces:
+            i.admin_up()
+            i.config_ip4()
+            i.resolve_arp()
+
+    @classmethod
+    def tearDownClass(cls):
+        super(TestNAT44EDSharedLookup, cls).tearDownClass()
+
+    def test_dynamic(self):
+        """ NAT44 ED shared lookup translates return traffic in place """
+
+        self.nat44_add_address(self.nat_addr)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg0.sw_if_index,
+            flags=flags, is_add=1)
+        self.vapi.nat44_interface_add_del_feature(
+            sw_if_index=self.pg1.sw_if_index,
+            is_add=1)
+
+        # in2out
+        pkts = self.create_stream_in(self.pg0, self.pg1)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg1.get_capture(len(pkts))
+        self.verify_capture_out(capture)
+
+        # out2in; the UDP session is established and is translated
+        # without handoff, the TCP SYNs and the ICMP are handed off
+        node = '/err/nat44-out2in-worker-handoff/'
+        sharedn = self.statistics.get_err_counter(
+            node + 'translated without handoff')
+
+        pkts = self.create_stream_out(self.pg1)
+        self.pg1.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg0.get_capture(len(pkts))
+        self.verify_capture_in(capture, self.pg0)
+
+        err = self.statistics.get_err_counter(
+            node + 'translated without handoff')
+        self.assertEqual(err - sharedn, 1)
+
+    def tearDown(self):
+        super(TestNAT44EDSharedLookup, self).tearDown()
+        if not self.vpp_dead:
+            self.clear_nat44()
+
+    def show_commands_at_teardown(self):
+        self.logger.info(self.vapi.cli("show nat44 sessions detail"))
+        self.logger.info(self.vapi.cli("show errors"))
+
+
 class TestNAT44Out2InDPO(MethodHolder):
     """ NAT44 Test Cases using out2in DPO """
 
@@ -8179,6 +8776,40 @@ class TestNAT64(MethodHolder):
         ses_num_after_timeout = self.nat64_get_ses_num()
         self.assertEqual(ses_num_before_timeout - ses_num_after_timeout, 2)
 
+    def test_session_expire(self):
+        """ NAT64 session expiry by timer """
+        self.icmp_id_in = 1234
+        self.vapi.nat64_add_del_pool_addr_range(start_addr=self.nat_addr,
+                                                end_addr=self.nat_addr,
+                                                vrf_id=0xFFFFFFFF,
+                                                is_add=1)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat64_add_del_interface(is_add=1, flags=flags,
+                                          sw_if_index=self.pg0.sw_if_index)
+        self.vapi.nat64_add_del_interface(is_add=1, flags=0,
+                                          sw_if_index=self.pg1.sw_if_index)
+        self.vapi.nat_set_timeouts(udp=300, tcp_established=7440,
+                                   tcp_transitory=240, icmp=2)
+
+        expired = self.statistics.get_counter('/nat64/expired-sessions')
+        expired = sum(sum(c) for c in expired)
+
+        pkts = self.create_stream_in_ip6(self.pg0, self.pg1)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(len(pkts))
+
+        ses_num_before_timeout = self.nat64_get_ses_num()
+
+        sleep(5)
+
+        # only the ICMP session expired
+        ses_num_after_timeout = self.nat64_get_ses_num()
+        self.assertEqual(ses_num_before_timeout - ses_num_after_timeout, 1)
+        stats = self.statistics.get_counter('/nat64/expired-sessions')
+        self.assertEqual(sum(sum(c) for c in stats) - expired, 1)
+
     def test_icmp_error(self):
         """ NAT64 ICMP Error message translation """
         self.tcp_port_in = 6303
@@ -9154,67 +9785,207 @@ class TestNAT64(MethodHolder):
         st = self.vapi.nat64_st_dump(proto=255)
         return len(st)
 
-    def clear_nat64(self):
-        """
-        Clear NAT64 configuration.
-        """
-        self.vapi.nat_ipfix_enable_disable(domain_id=self.ipfix_domain_id,
-                                           src_port=self.ipfix_src_port,
-                                           enable=0)
-        self.ipfix_src_port = 4739
-        self.ipfix_domain_id = 1
+    def tearDown(self):
+        super(TestNAT64, self).tearDown()
+        if not self.vpp_dead:
+            self.clear_nat64()
 
-        self.vapi.syslog_set_filter(
-            self.SYSLOG_SEVERITY.SYSLOG_API_SEVERITY_EMERG)
+    def show_commands_at_teardown(self):
+        self.logger.info(self.vapi.cli("show nat64 pool"))
+        self.logger.info(self.vapi.cli("show nat64 interfaces"))
+        self.logger.info(self.vapi.cli("show nat64 prefix"))
+        self.logger.info(self.vapi.cli("show nat64 bib all"))
+        self.logger.info(self.vapi.cli("show nat64 session table all"))
+        self.logger.info(self.vapi.cli("show nat virtual-reassembly"))
 
-        self.vapi.nat_set_timeouts(udp=300, tcp_established=7440,
-                                   tcp_transitory=240, icmp=60)
 
-        interfaces = self.vapi.nat64_interface_dump()
-        for intf in interfaces:
-            self.vapi.nat64_add_del_interface(is_add=0, flags=intf.flags,
-                                              sw_if_index=intf.sw_if_index)
+class TestNAT64SharedLookup(MethodHolder):
+    """ NAT64 shared out2in session lookup Test Cases """
 
-        bib = self.vapi.nat64_bib_dump(proto=255)
-        for bibe in bib:
-            if bibe.flags & self.config_flags.NAT_IS_STATIC:
-                self.vapi.nat64_add_del_static_bib(i_addr=bibe.i_addr,
-                                                   o_addr=bibe.o_addr,
-                                                   i_port=bibe.i_port,
-                                                   o_port=bibe.o_port,
-                                                   proto=bibe.proto,
-                                                   vrf_id=bibe.vrf_id,
-                                                   is_add=0)
+    worker_config = "workers 2"
 
-        adresses = self.vapi.nat64_pool_addr_dump()
-        for addr in adresses:
-            self.vapi.nat64_add_del_pool_addr_range(start_addr=addr.address,
-                                                    end_addr=addr.address,
-                                                    vrf_id=addr.vrf_id,
-                                                    is_add=0)
+    @classmethod
+    def setUpConstants(cls):
+        super(TestNAT64SharedLookup, cls).setUpConstants()
+        cls.vpp_cmdline.extend(["nat", "{", "nat64 shared-lookup", "}"])
 
-        prefixes = self.vapi.nat64_prefix_dump()
-        for prefix in prefixes:
-            self.vapi.nat64_add_del_prefix(prefix=str(prefix.prefix),
-                                           vrf_id=prefix.vrf_id, is_add=0)
+    @classmethod
+    def setUpClass(cls):
+        super(TestNAT64SharedLookup, cls).setUpClass()
+
+        cls.tcp_port_in = 6303
+        cls.tcp_port_out = 6303
+        cls.udp_port_in = 6304
+        cls.udp_port_out = 6304
+        cls.icmp_id_in = 6305
+        cls.icmp_id_out = 6305
+        cls.nat_addr = '10.0.0.3'
+        cls.ipfix_src_port = 4739
+        cls.ipfix_domain_id = 1
+
+        cls.create_pg_interfaces(range(2))
+
+        cls.pg0.admin_up()
+        cls.pg0.config_ip6()
+        cls.pg0.configure_ipv6_neighbors()
+
+        cls.pg1.admin_up()
+        cls.pg1.config_ip4()
+        cls.pg1.resolve_arp()
+
+    @classmethod
+    def tearDownClass(cls):
+        super(TestNAT64SharedLookup, cls).tearDownClass()
 
+    def test_dynamic(self):
+        """ NAT64 shared lookup translates return traffic in place """
+
+        self.vapi.nat64_add_del_pool_addr_range(start_addr=self.nat_addr,
+                                                end_addr=self.nat_addr,
+                                                vrf_id=0xFFFFFFFF,
+                                                is_add=1)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat64_add_del_interface(is_add=1, flags=flags,
+                                          sw_if_index=self.pg0.sw_if_index)
+        self.vapi.nat64_add_del_interface(is_add=1, flags=0,
+                                          sw_if_index=self.pg1.sw_if_index)
+
+        # in2out
+        pkts = self.create_stream_in_ip6(self.pg0, self.pg1)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg1.get_capture(len(pkts))
+        self.verify_capture_out(capture, nat_ip=self.nat_addr,
+                                dst_ip=self.pg1.remote_ip4)
+
+        # out2in; the UDP session is established and is translated
+        # without handoff, the TCP SYNs, which establish the TCP session,
+        # and the ICMP are handed off
+        node = '/err/nat64-out2in-handoff/'
+        sharedn = self.statistics.get_err_counter(
+            node + 'translated without handoff')
+
+        pkts = self.create_stream_out(self.pg1, dst_ip=self.nat_addr)
+        self.pg1.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg0.get_capture(len(pkts))
+        ip = IPv6(src=''.join(['64:ff9b::', self.pg1.remote_ip4]))
+        self.verify_capture_in_ip6(capture, ip[IPv6].src, self.pg0.remote_ip6)
+
+        err = self.statistics.get_err_counter(
+            node + 'translated without handoff')
+        self.assertEqual(err - sharedn, 1)
+
+        # data of the established TCP session is translated without handoff
+        p = (Ether(dst=self.pg1.local_mac, src=self.pg1.remote_mac) /
+             IP(src=self.pg1.remote_ip4, dst=self.nat_addr) /
+             TCP(sport=20, dport=self.tcp_port_out, flags='A') /
+             Raw(b'\xa5' * 100))
+        self.pg1.add_stream(p)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg0.get_capture(1)
+        p = capture[0]
+        try:
+            self.assertEqual(p[IPv6].src, ip[IPv6].src)
+            self.assertEqual(p[IPv6].dst, self.pg0.remote_ip6)
+            self.assertEqual(p[TCP].sport, 20)
+            self.assertEqual(p[TCP].dport, self.tcp_port_in)
+            self.assertEqual(p[Raw].load, b'\xa5' * 100)
+            self.assert_packet_checksums_valid(p)
+        except:
+            self.logger.error(ppp("Unexpected or invalid packet:", p))
+            raise
+
+        err = self.statistics.get_err_counter(
+            node + 'translated without handoff')
+        self.assertEqual(err - sharedn, 2)
+
+    def tearDown(self):
+        super(TestNAT64SharedLookup, self).tearDown()
+        if not self.vpp_dead:
+            self.clear_nat64()
+
+    def show_commands_at_teardown(self):
+        self.logger.info(self.vapi.cli("show nat64 session table all"))
+        self.logger.info(self.vapi.cli("show errors"))
+
+
+class TestNAT64HashLimit(MethodHolder):
+    """ NAT64 BIB and session table limits Test Cases """
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestNAT64HashLimit, cls).setUpConstants()
+        # 1 bucket would allow 10 BIB entries, but the hash memory left
+        # after the bucket holds 4 (2 key-value pairs each)
+        cls.vpp_cmdline.extend(["nat", "{", "nat64 bib hash buckets 1",
+                                "nat64 bib hash memory 264", "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestNAT64HashLimit, cls).setUpClass()
+
+        cls.nat_addr = '10.0.0.3'
+        cls.ipfix_src_port = 4739
+        cls.ipfix_domain_id = 1
+
+        cls.create_pg_interfaces(range(2))
+
+        cls.pg0.admin_up()
+        cls.pg0.config_ip6()
+        cls.pg0.configure_ipv6_neighbors()
+
+        cls.pg1.admin_up()
+        cls.pg1.config_ip4()
+        cls.pg1.resolve_arp()
+
+    @classmethod
+    def tearDownClass(cls):
+        super(TestNAT64HashLimit, cls).tearDownClass()
+
+    def test_bib_limit(self):
+        """ NAT64 BIB limit derived from the hash memory """
+        max_bibs = 4
+        remote_host_ip6 = self.compose_ip6(self.pg1.remote_ip4,
+                                           '64:ff9b::',
+                                           96)
+
+        self.vapi.nat64_add_del_pool_addr_range(start_addr=self.nat_addr,
+                                                end_addr=self.nat_addr,
+                                                vrf_id=0xFFFFFFFF,
+                                                is_add=1)
+        flags = self.config_flags.NAT_IS_INSIDE
+        self.vapi.nat64_add_del_interface(is_add=1, flags=flags,
+                                          sw_if_index=self.pg0.sw_if_index)
+        self.vapi.nat64_add_del_interface(is_add=1, flags=0,
+                                          sw_if_index=self.pg1.sw_if_index)
+
+        pkts = []
+        for i in range(0, max_bibs + 1):
+            p = (Ether(src=self.pg0.remote_mac, dst=self.pg0.local_mac) /
+                 IPv6(src=self.pg0.remote_ip6, dst=remote_host_ip6) /
+                 TCP(sport=12345 + i, dport=80))
+            pkts.append(p)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(max_bibs)
+
+        bibs = self.vapi.nat64_bib_dump(proto=255)
+        self.assertEqual(len(bibs), max_bibs)
         bibs = self.statistics.get_counter('/nat64/total-bibs')
-        self.assertEqual(bibs[0][0], 0)
-        sessions = self.statistics.get_counter('/nat64/total-sessions')
-        self.assertEqual(sessions[0][0], 0)
+        self.assertEqual(bibs[0][0], max_bibs)
 
     def tearDown(self):
-        super(TestNAT64, self).tearDown()
+        super(TestNAT64HashLimit, self).tearDown()
         if not self.vpp_dead:
             self.clear_nat64()
 
     def show_commands_at_teardown(self):
-        self.logger.info(self.vapi.cli("show nat64 pool"))
-        self.logger.info(self.vapi.cli("show nat64 interfaces"))
-        self.logger.info(self.vapi.cli("show nat64 prefix"))
         self.logger.info(self.vapi.cli("show nat64 bib all"))
-        self.logger.info(self.vapi.cli("show nat64 session table all"))
-        self.logger.info(self.vapi.cli("show nat virtual-reassembly"))
 
 
 class TestDSlite(MethodHolder):
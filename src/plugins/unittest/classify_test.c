@@ -0,0 +1,438 @@
+/*
+ * Copyright (c) 2020 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vlib/vlib.h>
+#include <vnet/classify/vnet_classify.h>
+
+/* The packet bytes matched; the IPv4 source address of an ethernet frame */
+#define CLASSIFY_TEST_MATCH_N_VECTORS 3
+#define CLASSIFY_TEST_SRC_OFFSET 26
+#define CLASSIFY_TEST_PKT_SIZE (CLASSIFY_TEST_MATCH_N_VECTORS * sizeof (u32x4))
+
+typedef struct
+{
+  u32 n_tables;
+  u32 n_sessions;
+  u32 n_packets;
+  u32 n_iterations;
+  u32 seed;
+
+  /* the chain, first table first */
+  u32 *table_indices;
+
+  /* the packets, and the entry each matched */
+  u8 *packets;
+  vnet_classify_entry_t **walk_results;
+  vnet_classify_entry_t **chain_results;
+} classify_chain_test_t;
+
+static void
+classify_test_set_src (u8 * pkt, u32 table, u32 session)
+{
+  u32 src = clib_host_to_net_u32 ((table << 24) | session);
+
+  clib_memcpy (pkt + CLASSIFY_TEST_SRC_OFFSET, &src, sizeof (src));
+}
+
+static int
+classify_test_chain_create (classify_chain_test_t * ct, u32 n_tables)
+{
+  vnet_classify_main_t *cm = &vnet_classify_main;
+  u8 *mask = 0, *match = 0;
+  u32 ti, next, ii;
+  int rv;
+
+  vec_validate_aligned (mask, CLASSIFY_TEST_PKT_SIZE - 1, sizeof (u32x4));
+  vec_validate_aligned (match, CLASSIFY_TEST_PKT_SIZE - 1, sizeof (u32x4));
+  clib_memset (mask + CLASSIFY_TEST_SRC_OFFSET, 0xff, sizeof (u32));
+
+  /* built from the tail, each table's next is the one before */
+  next = ~0;
+  for (ti = n_tables; ti > 0; ti--)
+    {
+      u32 table_index = ~0;
+
+      rv = vnet_classify_add_del_table (cm, mask, ct->n_sessions,
+					(ct->n_sessions + 1024) << 8,
+					0 /* skip */ ,
+					CLASSIFY_TEST_MATCH_N_VECTORS,
+					next, ~0 /* miss */ , &table_index,
+					0, 0, 1 /* is_add */ , 0);
+      if (rv)
+	return (rv);
+
+      for (ii = 0; ii < ct->n_sessions; ii++)
+	{
+	  classify_test_set_src (match, ti - 1, ii);
+	  rv = vnet_classify_add_del_session (cm, table_index, match,
+					      0 /* hit next */ ,
+					      ii /* opaque */ ,
+					      0, 0, 0, 1 /* is_add */ );
+	  if (rv)
+	    return (rv);
+	}
+
+      vec_insert_elts (ct->table_indices, &table_index, 1, 0);
+      next = table_index;
+    }
+
+  vec_free (mask);
+  vec_free (match);
+
+  return (0);
+}
+
+/*
+ * The walk, one packet at a time; as the nodes do without the
+ * chain-lookup.
+ */
+static void
+classify_test_walk (classify_chain_test_t * ct)
+{
+  vnet_classify_main_t *cm = &vnet_classify_main;
+  vnet_classify_table_t *t;
+  vnet_classify_entry_t *e;
+  u32 ii;
+  u8 *h;
+
+  for (ii = 0; ii < ct->n_packets; ii++)
+    {
+      h = ct->packets + ii * CLASSIFY_TEST_PKT_SIZE;
+      t = pool_elt_at_index (cm->tables, ct->table_indices[0]);
+
+      while (1)
+	{
+	  e = vnet_classify_find_entry_inline
+	    (t, h, vnet_classify_hash_packet_inline (t, h), 0);
+
+	  if (e || t->next_table_index == ~0)
+	    break;
+
+	  t = pool_elt_at_index (cm->tables, t->next_table_index);
+	}
+      ct->walk_results[ii] = e;
+    }
+}
+
+/*
+ * The chain-lookup, a frame's worth of packets at a time; as the nodes do
+ */
+static void
+classify_test_chain (classify_chain_test_t * ct)
+{
+  u64 hashes[VLIB_FRAME_SIZE][VNET_CLASSIFY_CHAIN_MAX];
+  vnet_classify_main_t *cm = &vnet_classify_main;
+  u8 *h[VNET_CLASSIFY_CHAIN_MAX];
+  vnet_classify_chain_t chain;
+  u32 ii, jj, n, pos, base;
+  vnet_classify_entry_t *e;
+  vnet_classify_table_t *t;
+
+  vnet_classify_chain_init (cm, &chain, ct->table_indices[0]);
+
+  for (base = 0; base < ct->n_packets; base += VLIB_FRAME_SIZE)
+    {
+      n = clib_min (VLIB_FRAME_SIZE, ct->n_packets - base);
+
+      for (ii = 0; ii < n; ii++)
+	{
+	  for (jj = 0; jj < chain.n_tables; jj++)
+	    h[jj] = ct->packets + (base + ii) * CLASSIFY_TEST_PKT_SIZE;
+	  vnet_classify_chain_hash (&chain, h, hashes[ii]);
+	}
+      for (ii = 0; ii < n; ii++)
+	{
+	  if (ii + 3 < n)
+	    vnet_classify_chain_prefetch_entries (&chain, hashes[ii + 3]);
+
+	  for (jj = 0; jj < chain.n_tables; jj++)
+	    h[jj] = ct->packets + (base + ii) * CLASSIFY_TEST_PKT_SIZE;
+	  e = vnet_classify_chain_find_entry (&chain, h, hashes[ii], 0, &pos);
+
+	  t = chain.tables[pos];
+	  while (!e && t->next_table_index != ~0)
+	    {
+	      t = pool_elt_at_index (cm->tables, t->next_table_index);
+	      e = vnet_classify_find_entry_inline
+		(t, h[0], vnet_classify_hash_packet_inline (t, h[0]), 0);
+	    }
+	  ct->chain_results[base + ii] = e;
+	}
+    }
+}
+
+static int
+classify_test_chain_length (vlib_main_t * vm,
+			    classify_chain_test_t * ct, u32 n_tables)
+{
+  vnet_classify_main_t *cm = &vnet_classify_main;
+  u64 start, clocks[2];
+  u32 ii, n_hits;
+  f64 mpps[2];
+  int rv, res;
+
+  res = 0;
+  rv = classify_test_chain_create (ct, n_tables);
+  if (rv)
+    {
+      vlib_cli_output (vm, "table create failed: %d", rv);
+      return (1);
+    }
+
+  /* the packets hit uniformly over the tables, with a few misses */
+  for (ii = 0; ii < ct->n_packets; ii++)
+    classify_test_set_src (ct->packets + ii * CLASSIFY_TEST_PKT_SIZE,
+			   random_u32 (&ct->seed) % (n_tables + 1),
+			   random_u32 (&ct->seed) % ct->n_sessions);
+
+  clocks[0] = clocks[1] = 0;
+  for (ii = 0; ii < ct->n_iterations; ii++)
+    {
+      start = clib_cpu_time_now ();
+      classify_test_walk (ct);
+      clocks[0] += clib_cpu_time_now () - start;
+
+      start = clib_cpu_time_now ();
+      classify_test_chain (ct);
+      clocks[1] += clib_cpu_time_now () - start;
+    }
+
+  n_hits = 0;
+  for (ii = 0; ii < ct->n_packets; ii++)
+    {
+      n_hits += (NULL != ct->walk_results[ii]);
+      if (ct->walk_results[ii] != ct->chain_results[ii])
+	{
+	  vlib_cli_output (vm, "chain:%d packet:%d walk:%p chain:%p",
+			   n_tables, ii, ct->walk_results[ii],
+			   ct->chain_results[ii]);
+	  res = 1;
+	  break;
+	}
+    }
+
+  for (ii = 0; ii < 2; ii++)
+    mpps[ii] = ((f64) ct->n_packets * ct->n_iterations /
+		((f64) clocks[ii] / vm->clib_time.clocks_per_second)) / 1e6;
+
+  vlib_cli_output (vm, "%8d %8d %12.2f %12.2f %12.2f %12.2f",
+		   n_tables, n_hits,
+		   (f64) clocks[0] / (ct->n_packets * ct->n_iterations),
+		   mpps[0],
+		   (f64) clocks[1] / (ct->n_packets * ct->n_iterations),
+		   mpps[1]);
+
+  vnet_classify_add_del_table (cm, 0, 0, 0, 0, 0, 0, 0,
+			       &ct->table_indices[0], 0, 0,
+			       0 /* is_add */ , 1 /* del_chain */ );
+  vec_reset_length (ct->table_indices);
+
+  return (res);
+}
+
+static clib_error_t *
+test_classify_chain_command_fn (vlib_main_t * vm,
+				unformat_input_t * input,
+				vlib_cli_command_t * cmd)
+{
+  classify_chain_test_t _ct = { 0 }, *ct = &_ct;
+  u32 n_tables;
+  int res;
+
+  ct->n_tables = VNET_CLASSIFY_CHAIN_MAX;
+  ct->n_sessions = 1024;
+  ct->n_packets = 16 * VLIB_FRAME_SIZE;
+  ct->n_iterations = 10;
+  ct->seed = 0xdeaddabe;
+  res = 0;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "tables %d", &ct->n_tables))
+	;
+      else if (unformat (input, "sessions %d", &ct->n_sessions))
+	;
+      else if (unformat (input, "packets %d", &ct->n_packets))
+	;
+      else if (unformat (input, "iterations %d", &ct->n_iterations))
+	;
+      else if (unformat (input, "seed %d", &ct->seed))
+	;
+      else
+	return clib_error_return (0, "unknown input '%U'",
+				  format_unformat_error, input);
+    }
+
+  if (0 == ct->n_tables || 0 == ct->n_sessions || 0 == ct->n_packets ||
+      ct->n_tables > 255)
+    return clib_error_return (0, "invalid parameters");
+
+  vec_validate_aligned (ct->packets,
+			ct->n_packets * CLASSIFY_TEST_PKT_SIZE - 1,
+			CLIB_CACHE_LINE_BYTES);
+  vec_validate (ct->walk_results, ct->n_packets - 1);
+  vec_validate (ct->chain_results, ct->n_packets - 1);
+
+  vlib_cli_output (vm, "%8s %8s %12s %12s %12s %12s",
+		   "tables", "hits", "walk clk/pkt", "walk Mpps",
+		   "chain clk/pkt", "chain Mpps");
+
+  for (n_tables = 1; n_tables <= ct->n_tables; n_tables++)
+    res |= classify_test_chain_length (vm, ct, n_tables);
+
+  vec_free (ct->packets);
+  vec_free (ct->walk_results);
+  vec_free (ct->chain_results);
+  vec_free (ct->table_indices);
+
+  if (res)
+    return clib_error_return (0, "Classify chain test failed");
+
+  vlib_cli_output (vm, "Classify chain test passed");
+  return (NULL);
+}
+
+/*?
+ * Compare, for chains of 1 up to N tables, the classify lookup by a
+ * walk of the chain against the lookup in one pass over the chain.
+ * Both must give the same results. Reports the clocks per packet and
+ * the packets per second of each.
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_classify_chain_command, static) =
+{
+  .path = "test classify chain",
+  .short_help = "test classify chain [tables <n>] [sessions <n>] "
+                "[packets <n>] [iterations <n>] [seed <n>]",
+  .function = test_classify_chain_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+test_classify_grow_command_fn (vlib_main_t * vm,
+			       unformat_input_t * input,
+			       vlib_cli_command_t * cmd)
+{
+  vnet_classify_main_t *cm = &vnet_classify_main;
+  u32 n_sessions, nbuckets, table_index, ii;
+  u8 *mask = 0, *match = 0;
+  vnet_classify_table_t *t;
+  vnet_classify_entry_t *e;
+  f64 per_hit, per_miss;
+  clib_error_t *error;
+  int rv;
+
+  n_sessions = 10000;
+  nbuckets = 2;
+  table_index = ~0;
+  error = NULL;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "sessions %d", &n_sessions))
+	;
+      else if (unformat (input, "buckets %d", &nbuckets))
+	;
+      else
+	return clib_error_return (0, "unknown input '%U'",
+				  format_unformat_error, input);
+    }
+
+  vec_validate_aligned (mask, CLASSIFY_TEST_PKT_SIZE - 1, sizeof (u32x4));
+  vec_validate_aligned (match, CLASSIFY_TEST_PKT_SIZE - 1, sizeof (u32x4));
+  clib_memset (mask + CLASSIFY_TEST_SRC_OFFSET, 0xff, sizeof (u32));
+
+  rv = vnet_classify_add_del_table (cm, mask, nbuckets, 64 << 20,
+				    0 /* skip */ ,
+				    CLASSIFY_TEST_MATCH_N_VECTORS,
+				    ~0 /* next */ , ~0 /* miss */ ,
+				    &table_index, 0, 0, 1 /* is_add */ , 0);
+  if (rv)
+    {
+      error = clib_error_return (0, "table create failed: %d", rv);
+      goto done;
+    }
+  t = pool_elt_at_index (cm->tables, table_index);
+
+  for (ii = 0; ii < n_sessions; ii++)
+    {
+      classify_test_set_src (match, 0, ii);
+      rv = vnet_classify_add_del_session (cm, table_index, match,
+					  0 /* hit next */ ,
+					  ii /* opaque */ ,
+					  0, 0, 0, 1 /* is_add */ );
+      if (rv)
+	{
+	  error = clib_error_return (0, "session %d add failed: %d", ii, rv);
+	  goto done;
+	}
+    }
+
+  /* all the sessions are found, each where it was added */
+  for (ii = 0; ii < n_sessions; ii++)
+    {
+      classify_test_set_src (match, 0, ii);
+      e = vnet_classify_find_entry
+	(t, match, vnet_classify_hash_packet (t, match), 0);
+      if (!e || e->opaque_index != ii)
+	{
+	  error = clib_error_return (0, "session %d not found", ii);
+	  goto done;
+	}
+    }
+
+  vnet_classify_table_probe_stats (t, &per_hit, &per_miss);
+  vlib_cli_output (vm, "sessions %d buckets %d -> %d, grown %d times, "
+		   "linear buckets %d, avg probes per hit %.2f per miss %.2f",
+		   n_sessions, nbuckets, t->nbuckets, t->n_grows,
+		   t->linear_buckets, per_hit, per_miss);
+
+  if (n_sessions > VNET_CLASSIFY_GROW_LOAD * nbuckets && 0 == t->n_grows)
+    error = clib_error_return (0, "table did not grow");
+
+done:
+  if (table_index != ~0)
+    vnet_classify_add_del_table (cm, 0, 0, 0, 0, 0, 0, 0, &table_index,
+				 0, 0, 0 /* is_add */ , 0);
+  vec_free (mask);
+  vec_free (match);
+
+  if (error)
+    return error;
+
+  vlib_cli_output (vm, "Classify grow test passed");
+  return (NULL);
+}
+
+/*?
+ * Add sessions to a table with too few buckets, so that it grows, then
+ * check that all the sessions are found.
+ ?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_classify_grow_command, static) =
+{
+  .path = "test classify grow",
+  .short_help = "test classify grow [sessions <n>] [buckets <n>]",
+  .function = test_classify_grow_command_fn,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -45,6 +45,8 @@ typedef struct
   u32 rounds;
   u32 buffer_size;
   u32 n_buffers;
+  u8 per_engine;
+  u32 *sizes;
 
   unittest_crypto_test_registration_t *test_registrations;
 } crypto_test_main_t;
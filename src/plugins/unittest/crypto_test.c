@@ -30,6 +30,108 @@ sort_registrations (void *a0, void *a1)
   return (strncmp (r0[0]->name, r1[0]->name, 256));
 }
 
+static void
+test_crypto_print_results (vlib_main_t * vm, crypto_test_main_t * tm,
+			   unittest_crypto_test_registration_t ** rv,
+			   vnet_crypto_op_t * ops, char *chained_engine)
+{
+  unittest_crypto_test_registration_t *r;
+  vnet_crypto_op_t *op;
+  u8 *s = 0, *err = 0;
+
+  /* *INDENT-OFF* */
+  vec_foreach (op, ops)
+    {
+      int fail = 0;
+      r = rv[op->user_data];
+      unittest_crypto_test_data_t *exp_pt = 0, *exp_ct = 0;
+      unittest_crypto_test_data_t *exp_digest = 0, *exp_tag = 0;
+
+      switch (vnet_crypto_get_op_type (op->op))
+	{
+	case VNET_CRYPTO_OP_TYPE_AEAD_ENCRYPT:
+	  exp_tag = &r->tag;
+          /* fall through */
+	case VNET_CRYPTO_OP_TYPE_ENCRYPT:
+	  exp_ct = &r->ciphertext;
+	  break;
+	case VNET_CRYPTO_OP_TYPE_AEAD_DECRYPT:
+	case VNET_CRYPTO_OP_TYPE_DECRYPT:
+	  exp_pt = &r->plaintext;
+	  break;
+	case VNET_CRYPTO_OP_TYPE_HMAC:
+	  exp_digest = &r->digest;
+	  break;
+	default:
+	  break;
+	}
+
+      vec_reset_length (err);
+
+      if (op->status != VNET_CRYPTO_OP_STATUS_COMPLETED)
+	err = format (err, "%sengine error: %U", vec_len (err) ? ", " : "",
+		      format_vnet_crypto_op_status, op->status);
+
+      if (exp_ct && memcmp (op->dst, exp_ct->data, exp_ct->length) != 0)
+	err = format (err, "%sciphertext mismatch",
+		      vec_len (err) ? ", " : "");
+
+      if (exp_pt && memcmp (op->dst, exp_pt->data, exp_pt->length) != 0)
+	err = format (err, "%splaintext mismatch", vec_len (err) ? ", " : "");
+
+      if (exp_tag && memcmp (op->tag, exp_tag->data, exp_tag->length) != 0)
+	err = format (err, "%stag mismatch", vec_len (err) ? ", " : "");
+
+      if (exp_digest &&
+	  memcmp (op->digest, exp_digest->data, exp_digest->length) != 0)
+	err = format (err, "%sdigest mismatch", vec_len (err) ? ", " : "");
+
+      vec_reset_length (s);
+      if (chained_engine)
+	s = format (s, "%s (%U, chained %s)", r->name, format_vnet_crypto_op,
+		    op->op, chained_engine);
+      else
+	s = format (s, "%s (%U)", r->name, format_vnet_crypto_op, op->op);
+
+      if (vec_len (err))
+	fail = 1;
+
+      vlib_cli_output (vm, "%-60v%s%v", s, vec_len (err) ? "FAIL: " : "OK",
+		       err);
+      if (tm->verbose)
+	{
+	  if (tm->verbose == 2)
+	    fail = 1;
+
+	  if (exp_ct && fail)
+	    vlib_cli_output (vm, "Expected ciphertext:\n%U"
+			     "\nCalculated ciphertext:\n%U",
+			     format_hexdump, exp_ct->data, exp_ct->length,
+			     format_hexdump, op->dst, exp_ct->length);
+	  if (exp_pt && fail)
+	    vlib_cli_output (vm, "Expected plaintext:\n%U"
+			     "\nCalculated plaintext:\n%U",
+			     format_hexdump, exp_pt->data, exp_pt->length,
+			     format_hexdump, op->dst, exp_pt->length);
+	  if (r->tag.length && fail)
+	    vlib_cli_output (vm, "Expected tag:\n%U"
+			     "\nCalculated tag:\n%U",
+			     format_hexdump, r->tag.data, r->tag.length,
+			     format_hexdump, op->tag, op->tag_len);
+	  if (exp_digest && fail)
+	    vlib_cli_output (vm, "Expected digest:\n%U"
+			     "\nCalculated Digest:\n%U",
+			     format_hexdump, exp_digest->data,
+			     exp_digest->length, format_hexdump, op->digest,
+			     op->digest_len);
+	}
+    }
+  /* *INDENT-ON* */
+
+  vec_free (err);
+  vec_free (s);
+}
+
 static clib_error_t *
 test_crypto (vlib_main_t * vm, crypto_test_main_t * tm)
 {
@@ -37,9 +139,11 @@ test_crypto (vlib_main_t * vm, crypto_test_main_t * tm)
   unittest_crypto_test_registration_t *r = tm->test_registrations;
   unittest_crypto_test_registration_t **rv = 0;
   vnet_crypto_alg_data_t *ad;
-  vnet_crypto_op_t *ops = 0, *op;
+  vnet_crypto_op_t *ops = 0, *op, *chained_ops = 0, *cop;
+  vnet_crypto_op_chunk_t *chunks = 0;
+  vnet_crypto_engine_t *e;
   vnet_crypto_key_index_t *key_indices = 0;
-  u8 *computed_data = 0, *s = 0, *err = 0;
+  u8 *computed_data = 0, *chained_data = 0;
   u32 computed_data_total_len = 0, n_ops = 0;
   u32 i;
 
@@ -171,100 +275,79 @@ test_crypto (vlib_main_t * vm, crypto_test_main_t * tm)
   /* *INDENT-ON* */
 
   vnet_crypto_process_ops (vm, ops, vec_len (ops));
+  test_crypto_print_results (vm, tm, rv, ops, /* chained_engine */ 0);
 
+  /* same tests again, with the data split in chunks of uneven length,
+     through the chained ops handlers of every engine that has them */
+  vec_validate_aligned (chained_data, vec_len (computed_data) - 1,
+			CLIB_CACHE_LINE_BYTES);
   /* *INDENT-OFF* */
-  vec_foreach (op, ops)
+  vec_foreach (e, cm->engines)
     {
-      int fail = 0;
-      r = rv[op->user_data];
-      unittest_crypto_test_data_t *exp_pt = 0, *exp_ct = 0;
-      unittest_crypto_test_data_t *exp_digest = 0, *exp_tag = 0;
+      vec_reset_length (chained_ops);
+      vec_reset_length (chunks);
+      clib_memset (chained_data, 0, vec_len (chained_data));
 
-      switch (vnet_crypto_get_op_type (op->op))
+      vec_foreach (op, ops)
 	{
-	case VNET_CRYPTO_OP_TYPE_AEAD_ENCRYPT:
-	  exp_tag = &r->tag;
-          /* fall through */
-	case VNET_CRYPTO_OP_TYPE_ENCRYPT:
-	  exp_ct = &r->ciphertext;
-	  break;
-	case VNET_CRYPTO_OP_TYPE_AEAD_DECRYPT:
-	case VNET_CRYPTO_OP_TYPE_DECRYPT:
-	  exp_pt = &r->plaintext;
-	  break;
-	case VNET_CRYPTO_OP_TYPE_HMAC:
-	  exp_digest = &r->digest;
-	  break;
-	default:
-	  break;
-	}
-
-      vec_reset_length (err);
-
-      if (op->status != VNET_CRYPTO_OP_STATUS_COMPLETED)
-	err = format (err, "%sengine error: %U", vec_len (err) ? ", " : "",
-		      format_vnet_crypto_op_status, op->status);
-
-      if (exp_ct && memcmp (op->dst, exp_ct->data, exp_ct->length) != 0)
-	err = format (err, "%sciphertext mismatch",
-		      vec_len (err) ? ", " : "");
-
-      if (exp_pt && memcmp (op->dst, exp_pt->data, exp_pt->length) != 0)
-	err = format (err, "%splaintext mismatch", vec_len (err) ? ", " : "");
-
-      if (exp_tag && memcmp (op->tag, exp_tag->data, exp_tag->length) != 0)
-	err = format (err, "%stag mismatch", vec_len (err) ? ", " : "");
+	  vnet_crypto_op_type_t type = vnet_crypto_get_op_type (op->op);
+	  vnet_crypto_op_chunk_t *ch;
+	  u32 offset = 0, chunk_sz;
 
-      if (exp_digest &&
-	  memcmp (op->digest, exp_digest->data, exp_digest->length) != 0)
-	err = format (err, "%sdigest mismatch", vec_len (err) ? ", " : "");
-
-      vec_reset_length (s);
-      s = format (s, "%s (%U)", r->name, format_vnet_crypto_op, op->op);
+	  if (e->chained_ops_handlers[op->op] == 0)
+	    continue;
 
-      if (vec_len (err))
-	fail = 1;
+	  vec_add2_aligned (chained_ops, cop, 1, CLIB_CACHE_LINE_BYTES);
+	  cop[0] = op[0];
+	  cop->flags |= VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS;
+	  cop->status = VNET_CRYPTO_OP_STATUS_PENDING;
+	  if (type == VNET_CRYPTO_OP_TYPE_HMAC)
+	    {
+	      cop->dst = 0;
+	      cop->digest = chained_data + (op->digest - computed_data);
+	    }
+	  else
+	    cop->dst = chained_data + (op->dst - computed_data);
+	  if (type == VNET_CRYPTO_OP_TYPE_AEAD_ENCRYPT)
+	    cop->tag = chained_data + (op->tag - computed_data);
+
+	  cop->chunk_index = vec_len (chunks);
+	  cop->n_chunks = 0;
+	  do
+	    {
+	      chunk_sz = clib_min (7 * (1 + 2 * cop->n_chunks),
+				   op->len - offset);
+	      vec_add2 (chunks, ch, 1);
+	      ch->src = op->src + offset;
+	      ch->dst = cop->dst ? cop->dst + offset : 0;
+	      ch->len = chunk_sz;
+	      offset += chunk_sz;
+	      cop->n_chunks++;
+	    }
+	  while (offset < op->len);
+	}
 
-      vlib_cli_output (vm, "%-60v%s%v", s, vec_len (err) ? "FAIL: " : "OK",
-		       err);
-      if (tm->verbose)
-	{
-	  if (tm->verbose == 2)
-	    fail = 1;
+      /* call the engine directly, one op at a time, so every engine is
+         tested and not only the active one */
+      vec_foreach (cop, chained_ops)
+	e->chained_ops_handlers[cop->op] (vm, &cop, chunks, 1);
 
-	  if (exp_ct && fail)
-	    vlib_cli_output (vm, "Expected ciphertext:\n%U"
-			     "\nCalculated ciphertext:\n%U",
-			     format_hexdump, exp_ct->data, exp_ct->length,
-			     format_hexdump, op->dst, exp_ct->length);
-	  if (exp_pt && fail)
-	    vlib_cli_output (vm, "Expected plaintext:\n%U"
-			     "\nCalculated plaintext:\n%U",
-			     format_hexdump, exp_pt->data, exp_pt->length,
-			     format_hexdump, op->dst, exp_pt->length);
-	  if (r->tag.length && fail)
-	    vlib_cli_output (vm, "Expected tag:\n%U"
-			     "\nCalculated tag:\n%U",
-			     format_hexdump, r->tag.data, r->tag.length,
-			     format_hexdump, op->tag, op->tag_len);
-	  if (exp_digest && fail)
-	    vlib_cli_output (vm, "Expected digest:\n%U"
-			     "\nCalculated Digest:\n%U",
-			     format_hexdump, exp_digest->data,
-			     exp_digest->length, format_hexdump, op->digest,
-			     op->digest_len);
-	}
+      if (vec_len (chained_ops))
+	test_crypto_print_results (vm, tm, rv, chained_ops, e->name);
     }
+  /* *INDENT-ON* */
 
+  /* *INDENT-OFF* */
   vec_foreach_index (i, key_indices)
     vnet_crypto_key_del (vm, key_indices[i]);
   /* *INDENT-ON* */
 
   vec_free (computed_data);
+  vec_free (chained_data);
   vec_free (ops);
-  vec_free (err);
+  vec_free (chained_ops);
+  vec_free (chunks);
   vec_free (rv);
-  vec_free (s);
   return 0;
 }
 
@@ -473,6 +556,196 @@ done:
   return err;
 }
 
+static_always_inline u64
+test_crypto_perf_run (vlib_main_t * vm, vnet_crypto_ops_handler_t * fn,
+		      vnet_crypto_op_t ** ops, u32 n_ops, u32 rounds)
+{
+  u64 t0 = clib_cpu_time_now ();
+  u32 i, j, n;
+
+  for (i = 0; i < rounds; i++)
+    for (j = 0; j < n_ops; j += n)
+      {
+	n = clib_min (n_ops - j, VLIB_FRAME_SIZE);
+	fn (vm, ops + j, n);
+      }
+
+  return clib_cpu_time_now () - t0;
+}
+
+/*
+ * Call the ops handlers of each engine directly, bypassing engine
+ * selection, and report the best of 5 runs in ticks per byte and per
+ * packet for a range of packet sizes.
+ */
+static clib_error_t *
+test_crypto_perf_engines (vlib_main_t * vm, crypto_test_main_t * tm)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_alg_data_t *ad = vec_elt_at_index (cm->algs, tm->alg);
+  static u32 default_sizes[] = { 64, 128, 256, 512, 1024, 1500, 2048 };
+  vnet_crypto_op_id_t id1 = 0, id2 = 0;
+  vnet_crypto_key_index_t key_index = ~0;
+  vnet_crypto_op_t *ops = 0, **ops1 = 0, **ops2 = 0, *op;
+  vnet_crypto_engine_t *e;
+  u32 *buffer_indices = 0, *sizes = 0, *size;
+  u32 n_buffers, n_alloc = 0, warmup_rounds, rounds;
+  u32 max_size = vlib_buffer_get_default_data_size (vm);
+  clib_error_t *err = 0;
+  u64 seed = clib_cpu_time_now ();
+  u8 key[32];
+  int i, j;
+
+  rounds = tm->rounds ? tm->rounds : 100;
+  n_buffers = tm->n_buffers ? tm->n_buffers : 256;
+  warmup_rounds = tm->warmup_rounds ? tm->warmup_rounds : 100;
+
+  if (ad->op_by_type[VNET_CRYPTO_OP_TYPE_AEAD_ENCRYPT])
+    {
+      id1 = ad->op_by_type[VNET_CRYPTO_OP_TYPE_AEAD_ENCRYPT];
+      id2 = ad->op_by_type[VNET_CRYPTO_OP_TYPE_AEAD_DECRYPT];
+    }
+  else if (ad->op_by_type[VNET_CRYPTO_OP_TYPE_ENCRYPT])
+    {
+      id1 = ad->op_by_type[VNET_CRYPTO_OP_TYPE_ENCRYPT];
+      id2 = ad->op_by_type[VNET_CRYPTO_OP_TYPE_DECRYPT];
+    }
+  else
+    id1 = ad->op_by_type[VNET_CRYPTO_OP_TYPE_HMAC];
+
+  if (id1 == 0)
+    return clib_error_return (0, "no ops for alg %U",
+			      format_vnet_crypto_alg, tm->alg);
+
+  if (tm->sizes)
+    sizes = vec_dup (tm->sizes);
+  else
+    for (i = 0; i < ARRAY_LEN (default_sizes); i++)
+      vec_add1 (sizes, default_sizes[i]);
+
+  vec_foreach (size, sizes)
+  {
+    /* ciphers without AEAD work on whole blocks */
+    if (ad->op_by_type[VNET_CRYPTO_OP_TYPE_ENCRYPT])
+      size[0] = round_pow2 (size[0], 16);
+    if (size[0] == 0 || size[0] > max_size)
+      {
+	err = clib_error_return (0, "size must be between 1 and %u",
+				 max_size);
+	goto done;
+      }
+  }
+
+  vec_validate_aligned (buffer_indices, n_buffers - 1, CLIB_CACHE_LINE_BYTES);
+  vec_validate_aligned (ops, 2 * n_buffers - 1, CLIB_CACHE_LINE_BYTES);
+
+  n_alloc = vlib_buffer_alloc (vm, buffer_indices, n_buffers);
+  if (n_alloc != n_buffers)
+    {
+      err = clib_error_return (0, "buffer alloc failure");
+      goto done;
+    }
+
+  for (i = 0; i < sizeof (key); i++)
+    key[i] = i;
+
+  key_index = vnet_crypto_key_add (vm, tm->alg, key,
+				   test_crypto_get_key_sz (tm->alg));
+
+  for (i = 0; i < n_buffers; i++)
+    {
+      vlib_buffer_t *b = vlib_get_buffer (vm, buffer_indices[i]);
+
+      for (j = 0; j < 2; j++)
+	{
+	  op = ops + 2 * i + j;
+	  vnet_crypto_op_init (op, j ? id2 : id1);
+	  op->src = op->dst = b->data;
+	  op->key_index = key_index;
+	  op->iv = b->data - 64;
+	  op->tag = b->data - 32;
+	  op->tag_len = 16;
+	  op->aad = b->data - VLIB_BUFFER_PRE_DATA_SIZE;
+	  op->aad_len = 8;
+	  op->digest = b->data - VLIB_BUFFER_PRE_DATA_SIZE;
+	}
+      vec_add1 (ops1, ops + 2 * i);
+      vec_add1 (ops2, ops + 2 * i + 1);
+
+      for (j = -VLIB_BUFFER_PRE_DATA_SIZE; j < max_size; j += 8)
+	*(u64 *) (b->data + j) = 1 + random_u64 (&seed);
+    }
+
+  vlib_cli_output (vm, "%U: n_buffers %u rounds %u warmup-rounds %u",
+		   format_vnet_crypto_alg, tm->alg, n_buffers, rounds,
+		   warmup_rounds);
+  vlib_cli_output (vm, "   cpu-freq %.2f GHz",
+		   (f64) vm->clib_time.clocks_per_second * 1e-9);
+  vlib_cli_output (vm, "%-12s%-8s%-24s%s", "Engine", "Size",
+		   id2 ? "Encrypt" : "Hash", id2 ? "Decrypt" : "");
+  vlib_cli_output (vm, "%-20s%-12s%-12s%-12s%s", "", "ticks/byte",
+		   "ticks/pkt", id2 ? "ticks/byte" : "", id2 ? "ticks/pkt" : "");
+
+  /* *INDENT-OFF* */
+  vec_foreach (e, cm->engines)
+    {
+      if (e->ops_handlers[id1] == 0 || (id2 && e->ops_handlers[id2] == 0))
+	continue;
+
+      vec_foreach (size, sizes)
+	{
+	  u64 t1 = ~0ULL, t2 = ~0ULL;
+	  f64 n_bytes = (f64) size[0] * n_buffers * rounds;
+
+	  for (i = 0; i < 2 * n_buffers; i++)
+	    ops[i].len = size[0];
+
+	  test_crypto_perf_run (vm, e->ops_handlers[id1], ops1, n_buffers,
+				warmup_rounds);
+	  if (id2)
+	    test_crypto_perf_run (vm, e->ops_handlers[id2], ops2, n_buffers,
+				  warmup_rounds);
+
+	  for (i = 0; i < 5; i++)
+	    {
+	      t1 = clib_min (t1, test_crypto_perf_run (vm,
+						       e->ops_handlers[id1],
+						       ops1, n_buffers,
+						       rounds));
+	      if (id2)
+		t2 = clib_min (t2, test_crypto_perf_run (vm,
+							 e->ops_handlers[id2],
+							 ops2, n_buffers,
+							 rounds));
+	    }
+
+	  if (id2)
+	    vlib_cli_output (vm, "%-12s%-8u%-12.3f%-12.1f%-12.3f%.1f", e->name,
+			     size[0], t1 / n_bytes,
+			     t1 * size[0] / n_bytes, t2 / n_bytes,
+			     t2 * size[0] / n_bytes);
+	  else
+	    vlib_cli_output (vm, "%-12s%-8u%-12.3f%.1f", e->name, size[0],
+			     t1 / n_bytes, t1 * size[0] / n_bytes);
+	}
+    }
+  /* *INDENT-ON* */
+
+done:
+  if (n_alloc)
+    vlib_buffer_free (vm, buffer_indices, n_alloc);
+
+  if (key_index != ~0)
+    vnet_crypto_key_del (vm, key_index);
+
+  vec_free (buffer_indices);
+  vec_free (sizes);
+  vec_free (ops);
+  vec_free (ops1);
+  vec_free (ops2);
+  return err;
+}
+
 static clib_error_t *
 test_crypto_command_fn (vlib_main_t * vm,
 			unformat_input_t * input, vlib_cli_command_t * cmd)
@@ -480,8 +753,10 @@ test_crypto_command_fn (vlib_main_t * vm,
   crypto_test_main_t *tm = &crypto_test_main;
   unittest_crypto_test_registration_t *tr;
   int is_perf = 0;
+  u32 size;
 
   tr = tm->test_registrations;
+  vec_free (tm->sizes);
   memset (tm, 0, sizeof (crypto_test_main_t));
   tm->test_registrations = tr;
   tm->alg = ~0;
@@ -503,12 +778,18 @@ test_crypto_command_fn (vlib_main_t * vm,
 	;
       else if (unformat (input, "buffer-size %u", &tm->buffer_size))
 	;
+      else if (unformat (input, "per-engine"))
+	tm->per_engine = 1;
+      else if (unformat (input, "size %u", &size))
+	vec_add1 (tm->sizes, size);
       else
 	return clib_error_return (0, "unknown input '%U'",
 				  format_unformat_error, input);
     }
 
-  if (is_perf)
+  if (is_perf && tm->per_engine)
+    return test_crypto_perf_engines (vm, tm);
+  else if (is_perf)
     return test_crypto_perf (vm, tm);
   else
     return test_crypto (vm, tm);
@@ -518,7 +799,9 @@ test_crypto_command_fn (vlib_main_t * vm,
 VLIB_CLI_COMMAND (test_crypto_command, static) =
 {
   .path = "test crypto",
-  .short_help = "test crypto",
+  .short_help = "test crypto [verbose|detail] [perf <alg> [per-engine] "
+    "[size <n>]... [buffers <n>] [rounds <n>] [warmup-rounds <n>] "
+    "[buffer-size <n>]]",
   .function = test_crypto_command_fn,
 };
 /* *INDENT-ON* */
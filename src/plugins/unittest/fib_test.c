@@ -7477,15 +7477,25 @@ static const fib_node_vft_t fib_test_child_vft = {
  */
 f64 fib_walk_process_queues(vlib_main_t * vm,
                             const f64 quota);
+f64 fib_walk_process_queues_yield(vlib_main_t * vm,
+                                  const f64 quota,
+                                  const f64 yield_quota,
+                                  int (*api_pending)(void));
 u32 fib_walk_queue_get_size(fib_walk_priority_t prio);
 
+static int
+fib_test_walk_api_pending (void)
+{
+    return (1);
+}
+
 static int
 fib_test_walk (void)
 {
     fib_node_back_walk_ctx_t high_ctx = {}, low_ctx = {};
+    u32 ii, res, n_visits;
     fib_node_test_t *tc;
     vlib_main_t *vm;
-    u32 ii, res;
 
     res = 0;
     vm = vlib_get_main();
@@ -7550,6 +7560,39 @@ fib_test_walk (void)
                  ii, vec_len(tc->ctxs));
     }
 
+    /*
+     * with API messages waiting, the quantum is cut short after the
+     * yield quota, though the walk has plenty left of its own
+     */
+    fib_walk_async(FIB_NODE_TYPE_TEST, PARENT_INDEX,
+                   FIB_WALK_PRIORITY_HIGH, &high_ctx);
+    fib_walk_process_queues_yield(vm, 1, 0, fib_test_walk_api_pending);
+
+    n_visits = 0;
+    FOR_EACH_TEST_CHILD(tc)
+    {
+        n_visits += vec_len(tc->ctxs);
+    }
+    FIB_TEST(1 == n_visits, "%d child visits before yielding to the API",
+             n_visits);
+    FIB_TEST(1 == fib_walk_queue_get_size(FIB_WALK_PRIORITY_HIGH),
+             "Walk still queued after yielding to the API");
+
+    /*
+     * without, the walk finishes; each child visited once
+     */
+    fib_walk_process_queues_yield(vm, 1, 0, NULL);
+
+    FOR_EACH_TEST_CHILD(tc)
+    {
+        FIB_TEST(1 == vec_len(tc->ctxs),
+                 "%d child visitsed %d times",
+                 ii, vec_len(tc->ctxs));
+        vec_free(tc->ctxs);
+    }
+    FIB_TEST(0 == fib_walk_queue_get_size(FIB_WALK_PRIORITY_HIGH),
+             "Queue is empty post walk");
+
     /*
      * schedule a low and hig priority walk. expect the high to be performed
      * before the low.
@@ -10517,6 +10560,752 @@ fib_test_sticky (void)
     return 0;
 }
 
+static u32
+fib_test_lb_n_buckets_to (const load_balance_t *lb,
+                          adj_index_t ai)
+{
+    u32 ii, n;
+
+    for (n = ii = 0; ii < lb->lb_n_buckets; ii++)
+    {
+        if (load_balance_get_bucket_i(lb, ii)->dpoi_index == ai)
+            n++;
+    }
+    return (n);
+}
+
+/*
+ * A resilient load-balance moves only the flows of a path that is removed
+ */
+static int
+fib_test_resilient (void)
+{
+#define N_RES_PATHS 4
+    index_t snap[LB_RESILIENT_N_BUCKETS], lbi;
+    fib_route_path_t *r_paths = NULL, *r_last;
+    const load_balance_resilient_t *lbr;
+    test_main_t *tm = &test_main;
+    adj_index_t ais[N_RES_PATHS];
+    dpo_id_t dpo = DPO_INVALID;
+    const load_balance_t *lb;
+    u32 ii, lb_count, n_moved;
+    fib_node_index_t fei;
+    int res = 0;
+    fib_prefix_t pfx = {
+        .fp_len = 32,
+        .fp_proto = FIB_PROTOCOL_IP4,
+        .fp_addr = {
+            .ip4.as_u32 = clib_host_to_net_u32(0x01020304),
+        },
+    };
+
+    lb_count = pool_elts(load_balance_pool);
+
+    for (ii = 0; ii < N_RES_PATHS; ii++)
+    {
+        fib_route_path_t r_path = {
+            .frp_proto = DPO_PROTO_IP4,
+            .frp_addr = {
+                .ip4.as_u32 = clib_host_to_net_u32(0x0a0a0a02 + ii),
+            },
+            .frp_sw_if_index = tm->hw[0]->sw_if_index,
+            .frp_weight = 1,
+            .frp_fib_index = ~0,
+        };
+        vec_add1(r_paths, r_path);
+
+        ais[ii] = adj_nbr_add_or_lock(FIB_PROTOCOL_IP4,
+                                      VNET_LINK_IP4,
+                                      &r_path.frp_addr,
+                                      tm->hw[0]->sw_if_index);
+    }
+
+    /*
+     * all paths; the buckets are shared evenly
+     */
+    fei = fib_table_entry_path_add2(0, &pfx, FIB_SOURCE_API,
+                                    FIB_ENTRY_FLAG_RESILIENT, r_paths);
+    fib_entry_contribute_forwarding(fei, FIB_FORW_CHAIN_TYPE_UNICAST_IP4, &dpo);
+    lbi = dpo.dpoi_index;
+    lb = load_balance_get(lbi);
+    lbr = load_balance_resilient_get(lbi);
+
+    FIB_TEST((lb->lb_flags & LOAD_BALANCE_FLAG_RESILIENT),
+             "LB is resilient");
+    FIB_TEST((NULL != lbr), "LB has bucket ownership");
+    FIB_TEST((LB_RESILIENT_N_BUCKETS == lb->lb_n_buckets),
+             "LB has %d buckets", lb->lb_n_buckets);
+    for (ii = 0; ii < N_RES_PATHS; ii++)
+    {
+        FIB_TEST((LB_RESILIENT_N_BUCKETS / N_RES_PATHS ==
+                  fib_test_lb_n_buckets_to(lb, ais[ii])),
+                 "path %d has %d buckets", ii,
+                 fib_test_lb_n_buckets_to(lb, ais[ii]));
+    }
+    for (ii = 0; ii < LB_RESILIENT_N_BUCKETS; ii++)
+        snap[ii] = load_balance_get_bucket_i(lb, ii)->dpoi_index;
+
+    /*
+     * remove the last path. only its buckets move.
+     */
+    r_last = vec_dup(r_paths);
+    vec_delete(r_last, N_RES_PATHS - 1, 0);
+    fib_table_entry_path_remove2(0, &pfx, FIB_SOURCE_API, r_last);
+    fib_entry_contribute_forwarding(fei, FIB_FORW_CHAIN_TYPE_UNICAST_IP4, &dpo);
+    FIB_TEST((lbi == dpo.dpoi_index), "same LB");
+    lb = load_balance_get(lbi);
+    lbr = load_balance_resilient_get(lbi);
+
+    FIB_TEST((0 == fib_test_lb_n_buckets_to(lb, ais[N_RES_PATHS - 1])),
+             "removed path has no buckets");
+    for (ii = 0; ii < LB_RESILIENT_N_BUCKETS; ii++)
+    {
+        if (snap[ii] != ais[N_RES_PATHS - 1])
+            FIB_TEST((snap[ii] == load_balance_get_bucket_i(lb, ii)->dpoi_index),
+                     "bucket %d unmoved", ii);
+        snap[ii] = load_balance_get_bucket_i(lb, ii)->dpoi_index;
+    }
+    for (ii = 0; ii < N_RES_PATHS - 1; ii++)
+    {
+        FIB_TEST((lbr->lbr_paths[ii].lbrp_target ==
+                  fib_test_lb_n_buckets_to(lb, ais[ii])),
+                 "path %d has its share", ii);
+    }
+    FIB_TEST((LB_RESILIENT_N_BUCKETS / N_RES_PATHS ==
+              lbr->lbr_n_moved_removed),
+             "moved %d buckets of removed path", lbr->lbr_n_moved_removed);
+
+    /*
+     * add the path back. no bucket moves until the scan.
+     */
+    fib_table_entry_path_add2(0, &pfx, FIB_SOURCE_API,
+                              FIB_ENTRY_FLAG_RESILIENT, r_last);
+    lb = load_balance_get(lbi);
+
+    for (ii = 0; ii < LB_RESILIENT_N_BUCKETS; ii++)
+    {
+        FIB_TEST((snap[ii] == load_balance_get_bucket_i(lb, ii)->dpoi_index),
+                 "bucket %d unmoved on path add", ii);
+    }
+
+    /*
+     * the even buckets are in use. the scan gives idle buckets only
+     * to the added path, until it has its share.
+     */
+    for (ii = 0; ii < LB_RESILIENT_N_BUCKETS; ii += 2)
+        load_balance_resilient_mark_active(lb, ii);
+
+    n_moved = load_balance_resilient_scan();
+
+    FIB_TEST((LB_RESILIENT_N_BUCKETS / N_RES_PATHS == n_moved),
+             "scan moved %d buckets", n_moved);
+    for (ii = 0; ii < N_RES_PATHS; ii++)
+    {
+        FIB_TEST((LB_RESILIENT_N_BUCKETS / N_RES_PATHS ==
+                  fib_test_lb_n_buckets_to(lb, ais[ii])),
+                 "path %d has %d buckets after scan", ii,
+                 fib_test_lb_n_buckets_to(lb, ais[ii]));
+    }
+    for (ii = 0; ii < LB_RESILIENT_N_BUCKETS; ii++)
+    {
+        if (snap[ii] != load_balance_get_bucket_i(lb, ii)->dpoi_index)
+        {
+            FIB_TEST((ii & 1), "active bucket %d unmoved", ii);
+            FIB_TEST((ais[N_RES_PATHS - 1] ==
+                      load_balance_get_bucket_i(lb, ii)->dpoi_index),
+                     "bucket %d to added path", ii);
+        }
+    }
+    FIB_TEST((0 == load_balance_resilient_scan()), "balanced scan moves none");
+
+    dpo_reset(&dpo);
+    fib_table_entry_delete(0, &pfx, FIB_SOURCE_API);
+
+    FIB_TEST((NULL == load_balance_resilient_get(lbi)), "no ownership");
+    FIB_TEST((0 == pool_elts(load_balance_resilient_pool)),
+             "no leaked resilient state");
+
+    for (ii = 0; ii < N_RES_PATHS; ii++)
+        adj_unlock(ais[ii]);
+    vec_free(r_paths);
+    vec_free(r_last);
+
+    FIB_TEST(lb_count == pool_elts(load_balance_pool), "no leaked LBs");
+
+    return (res);
+}
+
+static void
+fib_test_walk_drain (vlib_main_t *vm)
+{
+    while (fib_walk_queue_get_size(FIB_WALK_PRIORITY_HIGH) ||
+           fib_walk_queue_get_size(FIB_WALK_PRIORITY_LOW))
+    {
+        fib_walk_process_queues(vm, 1);
+    }
+}
+
+/*
+ * count the entries whose forwarding, as the data-plane sees it, uses
+ * the adjacency
+ */
+static u32
+fib_test_pic_n_via (fib_node_index_t *feis,
+                    adj_index_t ai)
+{
+    const load_balance_t *lb;
+    fib_node_index_t *fei;
+    const dpo_id_t *dpo;
+    u32 n, bucket;
+
+    n = 0;
+    vec_foreach(fei, feis)
+    {
+        dpo = fib_entry_contribute_ip_forwarding(*fei);
+        lb = load_balance_get(dpo->dpoi_index);
+
+        for (bucket = 0; bucket < lb->lb_n_buckets; bucket++)
+        {
+            if (load_balance_get_fwd_bucket(lb, bucket)->dpoi_index == ai)
+            {
+                n++;
+                break;
+            }
+        }
+    }
+    return (n);
+}
+
+/*
+ * Prefix independent convergence (PIC) edge.
+ * Many prefixes share a path-list of two attached next-hops. When one of
+ * the next-hop's interface goes down the data-plane converges when the
+ * shared load-balance map is updated, in a time independent of the
+ * number of prefixes. The control-plane convergence, the re-evaluation of
+ * each entry by the async walk, follows.
+ */
+static int
+fib_test_pic (vlib_main_t *vm,
+              u32 n_prefixes)
+{
+    fib_node_index_t *feis = NULL, fei;
+    fib_route_path_t *r_paths = NULL;
+    test_main_t *tm = &test_main;
+    u32 ii, lb_count, pl_count;
+    const load_balance_t *lb;
+    clib_error_t *error;
+    adj_index_t ais[2];
+    f64 start, dp, cp;
+    fib_prefix_t pfx;
+    int res;
+
+    res = 0;
+    lb_count = pool_elts(load_balance_pool);
+    pl_count = fib_path_list_pool_size();
+
+    for (ii = 0; ii < 2; ii++)
+    {
+        fib_route_path_t r_path = {
+            .frp_proto = DPO_PROTO_IP4,
+            .frp_addr = {
+                .ip4.as_u32 = clib_host_to_net_u32(0x0a0a0a01 + (ii << 8)),
+            },
+            .frp_sw_if_index = tm->hw[ii]->sw_if_index,
+            .frp_weight = 1,
+            .frp_fib_index = ~0,
+        };
+        vec_add1(r_paths, r_path);
+
+        ais[ii] = adj_nbr_add_or_lock(FIB_PROTOCOL_IP4,
+                                      VNET_LINK_IP4,
+                                      &r_path.frp_addr,
+                                      tm->hw[ii]->sw_if_index);
+    }
+
+    for (ii = 0; ii < n_prefixes; ii++)
+    {
+        pfx.fp_proto = FIB_PROTOCOL_IP4;
+        pfx.fp_len = 32;
+        pfx.fp_addr.ip4.as_u32 = clib_host_to_net_u32(0xc8000000 + ii);
+
+        fei = fib_table_entry_path_add2(0, &pfx, FIB_SOURCE_API,
+                                        FIB_ENTRY_FLAG_NONE, r_paths);
+        vec_add1(feis, fei);
+    }
+    fib_test_walk_drain(vm);
+
+    lb = load_balance_get(fib_entry_contribute_ip_forwarding(feis[0])->dpoi_index);
+    FIB_TEST((n_prefixes < 64 || (lb->lb_flags & LOAD_BALANCE_FLAG_USES_MAP)),
+             "LB uses map");
+    FIB_TEST((n_prefixes == fib_test_pic_n_via(feis, ais[1])),
+             "all prefixes via both paths");
+
+    /*
+     * shut the interface of the 2nd path. data-plane convergence is
+     * complete when the shutdown returns.
+     */
+    start = vlib_time_now(vm);
+    error = vnet_sw_interface_set_flags(vnet_get_main(),
+                                        tm->hw[1]->sw_if_index,
+                                        ~VNET_SW_INTERFACE_FLAG_ADMIN_UP);
+    dp = vlib_time_now(vm) - start;
+    FIB_TEST((NULL == error), "Interface shutdown OK");
+
+    FIB_TEST((n_prefixes < 64 || 0 == fib_test_pic_n_via(feis, ais[1])),
+             "data-plane converged: %d prefixes via down path",
+             fib_test_pic_n_via(feis, ais[1]));
+    lb = load_balance_get(fib_entry_contribute_ip_forwarding(feis[0])->dpoi_index);
+    FIB_TEST((n_prefixes < 64 || 2 == lb->lb_n_buckets),
+             "entries not yet re-evaluated");
+
+    start = vlib_time_now(vm);
+    fib_test_walk_drain(vm);
+    cp = vlib_time_now(vm) - start;
+
+    FIB_TEST((0 == fib_test_pic_n_via(feis, ais[1])),
+             "control-plane converged");
+    FIB_TEST((n_prefixes == fib_test_pic_n_via(feis, ais[0])),
+             "all prefixes via the up path");
+
+    vlib_cli_output(vm, "PIC edge: %d prefixes", n_prefixes);
+    vlib_cli_output(vm, "  data-plane convergence:    %.6f secs", dp);
+    vlib_cli_output(vm, "  control-plane convergence: %.6f secs", cp);
+
+    /*
+     * restore the path
+     */
+    error = vnet_sw_interface_set_flags(vnet_get_main(),
+                                        tm->hw[1]->sw_if_index,
+                                        VNET_SW_INTERFACE_FLAG_ADMIN_UP);
+    FIB_TEST((NULL == error), "Interface bringup OK");
+    fib_test_walk_drain(vm);
+    FIB_TEST((n_prefixes == fib_test_pic_n_via(feis, ais[1])),
+             "all prefixes via both paths");
+
+    /*
+     * cleanup
+     */
+    for (ii = 0; ii < n_prefixes; ii++)
+    {
+        pfx.fp_proto = FIB_PROTOCOL_IP4;
+        pfx.fp_len = 32;
+        pfx.fp_addr.ip4.as_u32 = clib_host_to_net_u32(0xc8000000 + ii);
+
+        fib_table_entry_delete(0, &pfx, FIB_SOURCE_API);
+    }
+    for (ii = 0; ii < 2; ii++)
+        adj_unlock(ais[ii]);
+    vec_free(r_paths);
+    vec_free(feis);
+
+    FIB_TEST(lb_count == pool_elts(load_balance_pool), "no leaked LBs");
+    FIB_TEST(pl_count == fib_path_list_pool_size(), "no leaked PLs");
+
+    return (res);
+}
+
+/*
+ * Test, and compare the performance of, the IPv6 forwarding lookup by
+ * binary search on prefix lengths against the hash per-prefix length.
+ */
+static int
+fib_test_ip6_lookup (vlib_main_t *vm,
+                     u32 n_routes,
+                     u32 n_lookups)
+{
+    /*
+     * roughly the spread of prefix lengths in the IPv6 DFZ
+     */
+    static const u8 lens[] = {
+        16, 19, 20, 22, 24, 26, 28, 29, 29, 30, 31, 32, 32, 32, 32,
+        33, 34, 35, 36, 36, 37, 38, 40, 40, 41, 42, 44, 44, 45, 46,
+        47, 48, 48, 48, 48, 48, 48, 48, 52, 56, 60, 64, 96, 127, 128,
+    };
+    u32 *lbs_hash = NULL, *lbs_bsl = NULL, *lbs_x4 = NULL;
+    ip6_address_t *dsts = NULL, *addrs = NULL;
+    u32 fib_index, ii, jj, kk, seed, n_bad;
+    const ip6_address_t *mask;
+    u64 clocks[3], start;
+    ip6_fib_bsl_t *bsl;
+    fib_prefix_t pfx;
+    u8 *plens = NULL;
+    int res;
+
+    res = 0;
+    seed = 0xdeadbeef;
+    fib_index = fib_table_find_or_create_and_lock(FIB_PROTOCOL_IP6, 1001,
+                                                  FIB_SOURCE_API);
+
+    /*
+     * random global unicast prefixes, each its own load-balance
+     */
+    vec_validate(addrs, n_routes - 1);
+    vec_validate(plens, n_routes - 1);
+    for (ii = 0; ii < n_routes; ii++)
+    {
+        for (jj = 0; jj < 4; jj++)
+            addrs[ii].as_u32[jj] = random_u32(&seed);
+        addrs[ii].as_u8[0] = 0x20 | (addrs[ii].as_u8[0] & 0x1f);
+        plens[ii] = lens[random_u32(&seed) % ARRAY_LEN(lens)];
+
+        pfx.fp_proto = FIB_PROTOCOL_IP6;
+        pfx.fp_len = plens[ii];
+        pfx.fp_addr.ip6 = addrs[ii];
+        ip6_address_mask(&pfx.fp_addr.ip6, &ip6_main.fib_masks[pfx.fp_len]);
+
+        fib_table_entry_special_add(fib_index, &pfx, FIB_SOURCE_API,
+                                    FIB_ENTRY_FLAG_DROP);
+    }
+
+    /*
+     * half the destinations within a route, half anywhere
+     */
+    vec_validate(dsts, n_lookups - 1);
+    for (ii = 0; ii < n_lookups; ii++)
+    {
+        for (jj = 0; jj < 4; jj++)
+            dsts[ii].as_u32[jj] = random_u32(&seed);
+
+        if (ii & 1)
+        {
+            jj = random_u32(&seed) % n_routes;
+            mask = &ip6_main.fib_masks[plens[jj]];
+            for (kk = 0; kk < 2; kk++)
+                dsts[ii].as_u64[kk] =
+                    ((dsts[ii].as_u64[kk] & ~mask->as_u64[kk]) |
+                     (addrs[jj].as_u64[kk] & mask->as_u64[kk]));
+        }
+    }
+    vec_validate(lbs_hash, n_lookups - 1);
+    vec_validate(lbs_bsl, n_lookups - 1);
+    vec_validate(lbs_x4, n_lookups - 1);
+
+    FIB_TEST((NULL == ip6_fib_table_get_bsl(fib_index)),
+             "hash lookup by default");
+
+    start = clib_cpu_time_now();
+    vec_foreach_index(ii, dsts)
+    {
+        lbs_hash[ii] = ip6_fib_table_fwding_lookup_hash(fib_index, &dsts[ii]);
+    }
+    clocks[0] = clib_cpu_time_now() - start;
+
+    ip6_fib_table_set_fwding_algo(fib_index, IP6_FIB_FWDING_ALGO_BSL);
+    FIB_TEST((NULL == ip6_fib_table_get_bsl(fib_index)),
+             "binary-search not ready before the build");
+    ip6_fib_bsl_sync();
+    bsl = ip6_fib_table_get_bsl(fib_index);
+    FIB_TEST((NULL != bsl), "binary-search built");
+
+    start = clib_cpu_time_now();
+    vec_foreach_index(ii, dsts)
+    {
+        lbs_bsl[ii] = ip6_fib_bsl_lookup(bsl, &dsts[ii]);
+    }
+    clocks[1] = clib_cpu_time_now() - start;
+
+    start = clib_cpu_time_now();
+    for (ii = 0; ii + 4 <= n_lookups; ii += 4)
+    {
+        const ip6_address_t *d4[4] = {
+            &dsts[ii], &dsts[ii + 1], &dsts[ii + 2], &dsts[ii + 3],
+        };
+        ip6_fib_bsl_lookup_x4(bsl, d4, &lbs_x4[ii]);
+    }
+    for (; ii < n_lookups; ii++)
+    {
+        lbs_x4[ii] = ip6_fib_bsl_lookup(bsl, &dsts[ii]);
+    }
+    clocks[2] = clib_cpu_time_now() - start;
+
+    n_bad = 0;
+    vec_foreach_index(ii, dsts)
+    {
+        if (lbs_hash[ii] != lbs_bsl[ii] || lbs_hash[ii] != lbs_x4[ii])
+        {
+            if (!n_bad)
+                fformat(stderr, "%U: hash:%d binary-search:%d x4:%d\n",
+                        format_ip6_address, &dsts[ii], lbs_hash[ii],
+                        lbs_bsl[ii], lbs_x4[ii]);
+            n_bad++;
+        }
+    }
+    FIB_TEST((0 == n_bad), "binary-search and hash agree: %d differ", n_bad);
+
+    vlib_cli_output(vm, "ip6 lookup: %d routes, %d lengths, %d lookups",
+                    n_routes, vec_len(bsl->ifb_lengths), n_lookups);
+    vlib_cli_output(vm, "  hash:             %8.2f clocks/lookup",
+                    (f64) clocks[0] / n_lookups);
+    vlib_cli_output(vm, "  binary-search:    %8.2f clocks/lookup",
+                    (f64) clocks[1] / n_lookups);
+    vlib_cli_output(vm, "  binary-search x4: %8.2f clocks/lookup",
+                    (f64) clocks[2] / n_lookups);
+    vlib_cli_output(vm, "  %d markers, built in %.6fs",
+                    bsl->ifb_n_markers, bsl->ifb_build_time);
+
+    /*
+     * a change drops the table back to the hash until it is rebuilt
+     */
+    pfx.fp_proto = FIB_PROTOCOL_IP6;
+    pfx.fp_len = 128;
+    pfx.fp_addr.ip6 = dsts[0];
+    fib_table_entry_special_add(fib_index, &pfx, FIB_SOURCE_API,
+                                FIB_ENTRY_FLAG_DROP);
+    FIB_TEST((NULL == ip6_fib_table_get_bsl(fib_index)),
+             "binary-search invalidated by a change");
+    FIB_TEST((ip6_fib_table_fwding_lookup(fib_index, &dsts[0]) ==
+              ip6_fib_table_fwding_lookup_hash(fib_index, &dsts[0])),
+             "hash lookup whilst invalid");
+    ip6_fib_bsl_sync();
+    bsl = ip6_fib_table_get_bsl(fib_index);
+    FIB_TEST((NULL != bsl), "binary-search rebuilt");
+    FIB_TEST((ip6_fib_bsl_lookup(bsl, &dsts[0]) ==
+              ip6_fib_table_fwding_lookup_hash(fib_index, &dsts[0])),
+             "new route found by binary-search");
+    FIB_TEST((lbs_hash[0] != ip6_fib_bsl_lookup(bsl, &dsts[0])),
+             "new route is not the old match");
+
+    /*
+     * cleanup
+     */
+    ip6_fib_table_set_fwding_algo(fib_index, IP6_FIB_FWDING_ALGO_HASH);
+    FIB_TEST((NULL == ip6_fib_table_get_bsl(fib_index)), "back to hash");
+    fib_table_flush(fib_index, FIB_PROTOCOL_IP6, FIB_SOURCE_API);
+    fib_table_unlock(fib_index, FIB_PROTOCOL_IP6, FIB_SOURCE_API);
+    ip6_fib_bsl_sync();
+
+    vec_free(dsts);
+    vec_free(addrs);
+    vec_free(plens);
+    vec_free(lbs_hash);
+    vec_free(lbs_bsl);
+    vec_free(lbs_x4);
+
+    return (res);
+}
+
+/*
+ * Compare, and time, the staged mtrie lookup of a frame of packets
+ * against the lookup of each packet in turn
+ */
+static int
+fib_test_ip4_lookup (vlib_main_t *vm,
+                     u32 n_routes,
+                     u32 n_lookups)
+{
+    const ip4_fib_mtrie_t *mtries[VLIB_FRAME_SIZE];
+    ip4_fib_mtrie_leaf_t leaves[VLIB_FRAME_SIZE];
+    u32 *lbs_single = NULL, *lbs_staged = NULL, *fibs = NULL;
+    ip4_address_t *dsts = NULL, *addrs = NULL;
+    u32 fib_index, ii, jj, n, seed, n_bad;
+    u32 fib_indices[2];
+    u64 clocks[2], start;
+    fib_prefix_t pfx;
+    u8 *plens = NULL;
+    int res;
+
+    res = 0;
+    seed = 0xdeadbeef;
+    fib_index = fib_table_find_or_create_and_lock(FIB_PROTOCOL_IP4, 1001,
+                                                  FIB_SOURCE_API);
+    fib_indices[0] = fib_index;
+    fib_indices[1] = 0;
+
+    /*
+     * a new table starts with a compressed mtrie root, that is expanded
+     * once there are enough routes
+     */
+    FIB_TEST((0 == ip4_main.mtrie_expand_n_plies ||
+              ip4_fib_mtrie_is_compressed(&ip4_fib_get(fib_index)->mtrie)),
+             "new table's mtrie is compressed");
+    FIB_TEST((0 == ip4_main.mtrie_expand_n_plies ||
+              ip4_fib_mtrie_memory_usage(&ip4_fib_get(fib_index)->mtrie) <
+              sizeof(ip4_fib_mtrie_16_ply_t)),
+             "new table's mtrie is small: %U",
+             format_ip4_fib_mtrie_summary, &ip4_fib_get(fib_index)->mtrie);
+
+    /*
+     * nested routes at each ply boundary, and the ply in between, are
+     * found through the compressed 8-8-8-8 root
+     */
+    {
+        static const u8 lens[] = { 8, 16, 24, 32 };
+        ip4_address_t probe;
+        fib_node_index_t fei;
+        u32 lbs[ARRAY_LEN(lens)], lb_default;
+
+        probe.as_u32 = clib_host_to_net_u32(0x0b010101);
+        lb_default = ip4_fib_forwarding_lookup(fib_index, &probe);
+        for (ii = 0; ii < ARRAY_LEN(lens); ii++)
+        {
+            pfx.fp_proto = FIB_PROTOCOL_IP4;
+            pfx.fp_len = lens[ii];
+            pfx.fp_addr.ip4.as_u32 =
+                clib_host_to_net_u32(0x0a010101) &
+                ip4_main.fib_masks[lens[ii]];
+
+            fei = fib_table_entry_special_add(fib_index, &pfx,
+                                              FIB_SOURCE_API,
+                                              FIB_ENTRY_FLAG_DROP);
+            lbs[ii] = fib_entry_contribute_ip_forwarding(fei)->dpoi_index;
+        }
+        FIB_TEST((0 == ip4_main.mtrie_expand_n_plies ||
+                  ip4_fib_mtrie_is_compressed(&ip4_fib_get(fib_index)->mtrie)),
+                 "mtrie compressed with %d routes", ARRAY_LEN(lens));
+
+        /*
+         * 10.1.1.1 hits the /32, 10.1.1.2 the /24, 10.1.2.1 the /16,
+         * 10.2.1.1 the /8 and 11.1.1.1 none
+         */
+        probe.as_u32 = clib_host_to_net_u32(0x0a010101);
+        FIB_TEST((lbs[3] == ip4_fib_forwarding_lookup(fib_index, &probe)),
+                 "compressed lookup %U is the /32",
+                 format_ip4_address, &probe);
+        probe.as_u32 = clib_host_to_net_u32(0x0a010102);
+        FIB_TEST((lbs[2] == ip4_fib_forwarding_lookup(fib_index, &probe)),
+                 "compressed lookup %U is the /24",
+                 format_ip4_address, &probe);
+        probe.as_u32 = clib_host_to_net_u32(0x0a010201);
+        FIB_TEST((lbs[1] == ip4_fib_forwarding_lookup(fib_index, &probe)),
+                 "compressed lookup %U is the /16",
+                 format_ip4_address, &probe);
+        probe.as_u32 = clib_host_to_net_u32(0x0a020101);
+        FIB_TEST((lbs[0] == ip4_fib_forwarding_lookup(fib_index, &probe)),
+                 "compressed lookup %U is the /8",
+                 format_ip4_address, &probe);
+        probe.as_u32 = clib_host_to_net_u32(0x0b010101);
+        FIB_TEST((lb_default == ip4_fib_forwarding_lookup(fib_index, &probe)),
+                 "compressed lookup %U is the default",
+                 format_ip4_address, &probe);
+
+        for (ii = 0; ii < ARRAY_LEN(lens); ii++)
+        {
+            pfx.fp_len = lens[ii];
+            pfx.fp_addr.ip4.as_u32 =
+                clib_host_to_net_u32(0x0a010101) &
+                ip4_main.fib_masks[lens[ii]];
+            fib_table_entry_special_remove(fib_index, &pfx, FIB_SOURCE_API);
+        }
+        probe.as_u32 = clib_host_to_net_u32(0x0a010101);
+        FIB_TEST((lb_default == ip4_fib_forwarding_lookup(fib_index, &probe)),
+                 "compressed lookup %U is the default once removed",
+                 format_ip4_address, &probe);
+    }
+
+    /*
+     * random prefixes, mostly /24 and longer than /16 so most lookups
+     * need all three stages
+     */
+    vec_validate(addrs, n_routes - 1);
+    vec_validate(plens, n_routes - 1);
+    for (ii = 0; ii < n_routes; ii++)
+    {
+        addrs[ii].as_u32 = random_u32(&seed);
+        plens[ii] = 24;
+        if (ii & 1)
+            plens[ii] = 8 + random_u32(&seed) % 25;
+
+        pfx.fp_proto = FIB_PROTOCOL_IP4;
+        pfx.fp_len = plens[ii];
+        pfx.fp_addr.ip4.as_u32 =
+            addrs[ii].as_u32 & ip4_main.fib_masks[pfx.fp_len];
+
+        fib_table_entry_special_add(fib_index, &pfx, FIB_SOURCE_API,
+                                    FIB_ENTRY_FLAG_DROP);
+    }
+
+    FIB_TEST((n_routes < 1000 ||
+              !ip4_fib_mtrie_is_compressed(&ip4_fib_get(fib_index)->mtrie)),
+             "mtrie expanded: %U",
+             format_ip4_fib_mtrie_summary, &ip4_fib_get(fib_index)->mtrie);
+
+    /*
+     * half the destinations within a route, half anywhere. every 8th
+     * frame has some packets in the default table, so the frames are
+     * not all in one table
+     */
+    vec_validate(dsts, n_lookups - 1);
+    vec_validate(fibs, n_lookups - 1);
+    for (ii = 0; ii < n_lookups; ii++)
+    {
+        dsts[ii].as_u32 = random_u32(&seed);
+        fibs[ii] = fib_indices[((ii / VLIB_FRAME_SIZE) % 8 == 7 &&
+                                (ii % 3) == 0)];
+
+        if (ii & 1)
+        {
+            jj = random_u32(&seed) % n_routes;
+            dsts[ii].as_u32 =
+                ((dsts[ii].as_u32 & ~ip4_main.fib_masks[plens[jj]]) |
+                 (addrs[jj].as_u32 & ip4_main.fib_masks[plens[jj]]));
+        }
+    }
+    vec_validate(lbs_single, n_lookups - 1);
+    vec_validate(lbs_staged, n_lookups - 1);
+
+    start = clib_cpu_time_now();
+    for (ii = 0; ii < n_lookups; ii++)
+    {
+        lbs_single[ii] = ip4_fib_forwarding_lookup(fibs[ii], &dsts[ii]);
+    }
+    clocks[0] = clib_cpu_time_now() - start;
+
+    start = clib_cpu_time_now();
+    for (ii = 0; ii < n_lookups; ii += n)
+    {
+        n = clib_min(VLIB_FRAME_SIZE, n_lookups - ii);
+
+        for (jj = 0; jj < n; jj++)
+        {
+            mtries[jj] = &ip4_fib_get(fibs[ii + jj])->mtrie;
+        }
+        ip4_fib_mtrie_lookup_n(mtries, &dsts[ii], leaves, n);
+
+        for (jj = 0; jj < n; jj++)
+        {
+            lbs_staged[ii + jj] = ip4_fib_mtrie_leaf_get_adj_index(leaves[jj]);
+        }
+    }
+    clocks[1] = clib_cpu_time_now() - start;
+
+    n_bad = 0;
+    vec_foreach_index(ii, dsts)
+    {
+        if (lbs_single[ii] != lbs_staged[ii])
+        {
+            if (!n_bad)
+                fformat(stderr, "%U: single:%d staged:%d\n",
+                        format_ip4_address, &dsts[ii], lbs_single[ii],
+                        lbs_staged[ii]);
+            n_bad++;
+        }
+    }
+    FIB_TEST((0 == n_bad), "staged and single lookups agree: %d differ",
+             n_bad);
+
+    vlib_cli_output(vm, "ip4 lookup: %d routes, %d lookups",
+                    n_routes, n_lookups);
+    vlib_cli_output(vm, "  single: %8.2f clocks/lookup",
+                    (f64) clocks[0] / n_lookups);
+    vlib_cli_output(vm, "  staged: %8.2f clocks/lookup",
+                    (f64) clocks[1] / n_lookups);
+
+    /*
+     * cleanup
+     */
+    fib_table_flush(fib_index, FIB_PROTOCOL_IP4, FIB_SOURCE_API);
+    fib_table_unlock(fib_index, FIB_PROTOCOL_IP4, FIB_SOURCE_API);
+
+    vec_free(dsts);
+    vec_free(addrs);
+    vec_free(plens);
+    vec_free(fibs);
+    vec_free(lbs_single);
+    vec_free(lbs_staged);
+
+    return (res);
+}
+
 static clib_error_t *
 fib_test (vlib_main_t * vm,
           unformat_input_t * input,
@@ -10578,6 +11367,47 @@ fib_test (vlib_main_t * vm,
     {
         res += fib_test_sticky();
     }
+    else if (unformat (input, "resilient"))
+    {
+        res += fib_test_resilient();
+    }
+    else if (unformat (input, "pic"))
+    {
+        u32 n_prefixes = 1000;
+
+        unformat (input, "prefixes %d", &n_prefixes);
+        res += fib_test_pic(vm, n_prefixes);
+    }
+    else if (unformat (input, "ip4-lookup"))
+    {
+        u32 n_routes = 100000, n_lookups = 1000000;
+
+        while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+        {
+            if (unformat (input, "routes %d", &n_routes))
+                ;
+            else if (unformat (input, "lookups %d", &n_lookups))
+                ;
+            else
+                break;
+        }
+        res += fib_test_ip4_lookup(vm, n_routes, n_lookups);
+    }
+    else if (unformat (input, "ip6-lookup"))
+    {
+        u32 n_routes = 100000, n_lookups = 1000000;
+
+        while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+        {
+            if (unformat (input, "routes %d", &n_routes))
+                ;
+            else if (unformat (input, "lookups %d", &n_lookups))
+                ;
+            else
+                break;
+        }
+        res += fib_test_ip6_lookup(vm, n_routes, n_lookups);
+    }
     else
     {
         res += fib_test_v4();
@@ -10587,6 +11417,10 @@ fib_test (vlib_main_t * vm,
         res += fib_test_pref();
         res += fib_test_label();
         res += fib_test_inherit();
+        res += fib_test_resilient();
+        res += fib_test_pic(vm, 1000);
+        res += fib_test_ip4_lookup(vm, 2000, 20000);
+        res += fib_test_ip6_lookup(vm, 2000, 20000);
         res += lfib_test();
 
         /*
@@ -39,6 +39,7 @@ test_ipsec_command_fn (vlib_main_t * vm,
   if (~0 != sa_id)
     {
       ipsec_main_t *im = &ipsec_main;
+      ipsec_per_thread_data_t *ptd;
       ipsec_sa_t *sa;
       u32 sa_index;
 
@@ -48,6 +49,14 @@ test_ipsec_command_fn (vlib_main_t * vm,
       sa->seq = seq_num & 0xffffffff;
       sa->seq_hi = seq_num >> 32;
 
+      /* the workers' reserved blocks are behind the new number */
+      vec_foreach (ptd, im->ptd)
+      {
+	if (sa_index < vec_len (ptd->seq_blocks))
+	  clib_memset (vec_elt_at_index (ptd->seq_blocks, sa_index), 0,
+		       sizeof (ipsec_sa_seq_block_t));
+      }
+
       ipsec_sa_unlock (sa_index);
     }
   else
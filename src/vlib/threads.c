@@ -1586,6 +1586,38 @@ vlib_worker_thread_barrier_release (vlib_main_t * vm)
 
 }
 
+/**
+ * Wait until each worker has been once round its main loop, so that
+ * none can still be using what was unlinked before the call. The
+ * workers are not stopped. Returns at once when the barrier is held.
+ */
+void
+vlib_worker_wait_one_loop (void)
+{
+  u32 *counts = 0;
+  int ii;
+
+  if (vec_len (vlib_mains) < 2)
+    return;
+
+  ASSERT (vlib_get_thread_index () == 0);
+
+  if (vlib_worker_threads[0].recursion_level > 0)
+    return;
+
+  vec_validate (counts, vec_len (vlib_mains) - 1);
+
+  for (ii = 1; ii < vec_len (vlib_mains); ii++)
+    counts[ii] = clib_atomic_load_acq_n (&vlib_mains[ii]->main_loop_count);
+
+  for (ii = 1; ii < vec_len (vlib_mains); ii++)
+    while (counts[ii] ==
+	   clib_atomic_load_acq_n (&vlib_mains[ii]->main_loop_count))
+      CLIB_PAUSE ();
+
+  vec_free (counts);
+}
+
 /*
  * Check the frame queue to see if any frames are available.
  * If so, pull the packets off the frames and put them to
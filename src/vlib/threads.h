@@ -208,6 +208,7 @@ void vlib_worker_thread_barrier_sync_int (vlib_main_t * vm,
 void vlib_worker_thread_barrier_release (vlib_main_t * vm);
 void vlib_worker_thread_initial_barrier_sync_and_release (vlib_main_t * vm);
 void vlib_worker_thread_node_refork (void);
+void vlib_worker_wait_one_loop (void);
 
 static_always_inline uword
 vlib_get_thread_index (void)
@@ -113,6 +113,23 @@ memclnt_queue_callback (vlib_main_t * vm)
     }
 }
 
+/*
+ * Are there messages waiting on the API input queues. Unlike
+ * vm->api_queue_nonempty, which is set once a main loop, this reads the
+ * queues, so a process can poll it part way through its quantum.
+ */
+int
+vl_mem_api_queue_nonempty (void)
+{
+  int i;
+
+  for (i = 0; i < vec_len (vl_api_queue_cursizes); i++)
+    if (*vl_api_queue_cursizes[i])
+      return 1;
+
+  return 0;
+}
+
 /*
  * vl_api_memclnt_create_internal
  */
@@ -36,6 +36,7 @@ int vl_mem_api_handle_rpc (vlib_main_t * vm, vlib_node_runtime_t * node);
 
 vl_api_registration_t *vl_mem_api_client_index_to_registration (u32 handle);
 void vl_mem_api_enable_disable (vlib_main_t * vm, int yesno);
+int vl_mem_api_queue_nonempty (void);
 u32 vl_api_memclnt_create_internal (char *, svm_queue_t *);
 
 static inline u32
@@ -301,10 +301,162 @@ ip_classify_inline (vlib_main_t * vm,
   return frame->n_vectors;
 }
 
+/*
+ * The lookup in one pass over the table chain; see vnet_classify.h.
+ * The stages are per-frame: all the hashes, and so the bucket prefetches,
+ * are done before any entry is prefetched or compared.
+ */
+static_always_inline uword
+ip_classify_chain_inline (vlib_main_t * vm,
+			  vlib_node_runtime_t * node,
+			  vlib_frame_t * frame, int is_ip4)
+{
+  u64 hashes[VLIB_FRAME_SIZE][VNET_CLASSIFY_CHAIN_MAX];
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE];
+  u16 nexts[VLIB_FRAME_SIZE];
+  vnet_classify_main_t *vcm = &vnet_classify_main;
+  vnet_classify_chain_t chain, pchain;
+  u8 *h[VNET_CLASSIFY_CHAIN_MAX];
+  f64 now = vlib_time_now (vm);
+  u32 hits = 0;
+  u32 misses = 0;
+  u32 chain_hits = 0;
+  u32 i, j, n_vectors, n_next, *from;
+
+  n_next = is_ip4 ? IP4_LOOKUP_N_NEXT : IP6_LOOKUP_N_NEXT;
+
+  from = vlib_frame_vector_args (frame);
+  n_vectors = frame->n_vectors;
+  vlib_get_buffers (vm, from, bufs, n_vectors);
+
+  /* First pass: compute the hashes in all tables */
+  chain.table_index = ~0;
+  chain.n_tables = pchain.n_tables = 0;
+
+  for (i = 0; i < n_vectors; i++)
+    {
+      u32 table_index0;
+
+      if (i + 2 < n_vectors)
+	{
+	  vlib_prefetch_buffer_header (bufs[i + 2], STORE);
+	  CLIB_PREFETCH (bufs[i + 2]->data, CLIB_CACHE_LINE_BYTES, LOAD);
+	}
+
+      table_index0 =
+	classify_dpo_get (vnet_buffer (bufs[i])->ip.adj_index[VLIB_TX])->
+	cd_table_index;
+      vnet_buffer (bufs[i])->l2_classify.table_index = table_index0;
+
+      if (PREDICT_FALSE (table_index0 == ~0))
+	continue;
+
+      if (table_index0 != chain.table_index)
+	vnet_classify_chain_init (vcm, &chain, table_index0);
+
+      for (j = 0; j < chain.n_tables; j++)
+	h[j] = bufs[i]->data;
+
+      vnet_classify_chain_hash (&chain, h, hashes[i]);
+    }
+
+  /* Second pass: prefetch the entries, then compare */
+  chain.table_index = pchain.table_index = ~0;
+
+  for (i = 0; i < n_vectors; i++)
+    {
+      u32 next0 = IP_LOOKUP_NEXT_DROP;
+      vnet_classify_table_t *t0;
+      vnet_classify_entry_t *e0;
+      u32 table_index0, pos0;
+      vlib_buffer_t *b0;
+
+      /* Stride 3 seems to work best */
+      if (i + 3 < n_vectors)
+	{
+	  table_index0 = vnet_buffer (bufs[i + 3])->l2_classify.table_index;
+
+	  if (PREDICT_TRUE (table_index0 != ~0))
+	    {
+	      if (table_index0 != pchain.table_index)
+		vnet_classify_chain_init (vcm, &pchain, table_index0);
+	      vnet_classify_chain_prefetch_entries (&pchain, hashes[i + 3]);
+	    }
+	}
+
+      b0 = bufs[i];
+      table_index0 = vnet_buffer (b0)->l2_classify.table_index;
+      e0 = 0;
+      t0 = 0;
+      vnet_buffer (b0)->l2_classify.opaque_index = ~0;
+
+      if (PREDICT_TRUE (table_index0 != ~0))
+	{
+	  if (table_index0 != chain.table_index)
+	    vnet_classify_chain_init (vcm, &chain, table_index0);
+
+	  for (j = 0; j < chain.n_tables; j++)
+	    h[j] = b0->data;
+
+	  e0 = vnet_classify_chain_find_entry (&chain, h, hashes[i], now,
+					       &pos0);
+	  t0 = chain.tables[pos0];
+
+	  /* the remainder of a chain longer than one pass is walked */
+	  while (!e0 && t0->next_table_index != ~0)
+	    {
+	      t0 = pool_elt_at_index (vcm->tables, t0->next_table_index);
+	      e0 = vnet_classify_find_entry
+		(t0, b0->data, vnet_classify_hash_packet (t0, b0->data), now);
+	    }
+
+	  if (e0)
+	    {
+	      vnet_buffer (b0)->l2_classify.opaque_index = e0->opaque_index;
+	      vlib_buffer_advance (b0, e0->advance);
+	      next0 = (e0->next_index < node->n_next_nodes) ?
+		e0->next_index : next0;
+	      hits++;
+	      if (t0 != chain.tables[0])
+		chain_hits++;
+	    }
+	  else
+	    {
+	      next0 = (t0->miss_next_index < n_next) ?
+		t0->miss_next_index : next0;
+	      misses++;
+	    }
+	}
+
+      if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
+			 && (b0->flags & VLIB_BUFFER_IS_TRACED)))
+	{
+	  ip_classify_trace_t *t = vlib_add_trace (vm, node, b0, sizeof (*t));
+	  t->next_index = next0;
+	  t->table_index = t0 ? t0 - vcm->tables : ~0;
+	  t->entry_index = e0 ? e0 - t0->entries : ~0;
+	}
+
+      nexts[i] = next0;
+    }
+
+  vlib_buffer_enqueue_to_next (vm, node, from, nexts, n_vectors);
+
+  vlib_node_increment_counter (vm, node->node_index,
+			       IP_CLASSIFY_ERROR_MISS, misses);
+  vlib_node_increment_counter (vm, node->node_index,
+			       IP_CLASSIFY_ERROR_HIT, hits);
+  vlib_node_increment_counter (vm, node->node_index,
+			       IP_CLASSIFY_ERROR_CHAIN_HIT, chain_hits);
+  return n_vectors;
+}
+
 VLIB_NODE_FN (ip4_classify_node) (vlib_main_t * vm,
 				  vlib_node_runtime_t * node,
 				  vlib_frame_t * frame)
 {
+  if (vnet_classify_main.chain_lookup)
+    return ip_classify_chain_inline (vm, node, frame, 1 /* is_ip4 */ );
   return ip_classify_inline (vm, node, frame, 1 /* is_ip4 */ );
 }
 
@@ -326,6 +478,8 @@ VLIB_NODE_FN (ip6_classify_node) (vlib_main_t * vm,
 				  vlib_node_runtime_t * node,
 				  vlib_frame_t * frame)
 {
+  if (vnet_classify_main.chain_lookup)
+    return ip_classify_chain_inline (vm, node, frame, 0 /* is_ip4 */ );
   return ip_classify_inline (vm, node, frame, 0 /* is_ip4 */ );
 }
 
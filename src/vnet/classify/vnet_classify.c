@@ -25,6 +25,24 @@
  * @brief N-tuple classifier
  */
 
+/*
+ * The out-of-line hash and match, used by the control plane and the
+ * nodes that do not inline them, are built for each CPU variant, so
+ * they get the wide vector paths of the one they run on.
+ */
+CLIB_MARCH_FN (vnet_classify_hash_packet, u64, vnet_classify_table_t * t,
+	       u8 * h)
+{
+  return vnet_classify_hash_packet_inline (t, h);
+}
+
+CLIB_MARCH_FN (vnet_classify_find_entry, vnet_classify_entry_t *,
+	       vnet_classify_table_t * t, u8 * h, u64 hash, f64 now)
+{
+  return vnet_classify_find_entry_inline (t, h, hash, now);
+}
+
+#ifndef CLIB_MARCH_VARIANT
 vnet_classify_main_t vnet_classify_main;
 
 #if VALIDATION_SCAFFOLDING
@@ -145,6 +163,7 @@ vnet_classify_new_table (vnet_classify_main_t * cm,
   t->match_n_vectors = match_n_vectors;
   t->skip_n_vectors = skip_n_vectors;
   t->entries_per_page = 2;
+  t->grow_threshold = VNET_CLASSIFY_GROW_LOAD * nbuckets;
 
 #if USE_DLMALLOC == 0
   t->mheap = mheap_alloc (0 /* use VM */ , memory_size);
@@ -189,7 +208,8 @@ vnet_classify_delete_table_index (vnet_classify_main_t * cm,
 }
 
 static vnet_classify_entry_t *
-vnet_classify_entry_alloc (vnet_classify_table_t * t, u32 log2_pages)
+vnet_classify_entry_alloc_i (vnet_classify_table_t * t, u32 log2_pages,
+			     int may_fail)
 {
   vnet_classify_entry_t *rv = 0;
   u32 required_length;
@@ -206,8 +226,14 @@ vnet_classify_entry_alloc (vnet_classify_table_t * t, u32 log2_pages)
 
       vec_validate (t->freelists, log2_pages);
 
-      rv = clib_mem_alloc_aligned (required_length, CLIB_CACHE_LINE_BYTES);
+      if (may_fail)
+	rv = clib_mem_alloc_aligned_or_null (required_length,
+					     CLIB_CACHE_LINE_BYTES);
+      else
+	rv = clib_mem_alloc_aligned (required_length, CLIB_CACHE_LINE_BYTES);
       clib_mem_set_heap (oldheap);
+      if (rv == 0)
+	return 0;
       goto initialize;
     }
   rv = t->freelists[log2_pages];
@@ -220,6 +246,12 @@ initialize:
   return rv;
 }
 
+static vnet_classify_entry_t *
+vnet_classify_entry_alloc (vnet_classify_table_t * t, u32 log2_pages)
+{
+  return vnet_classify_entry_alloc_i (t, log2_pages, 0 /* may_fail */ );
+}
+
 static void
 vnet_classify_entry_free (vnet_classify_table_t * t,
 			  vnet_classify_entry_t * v, u32 log2_pages)
@@ -387,6 +419,292 @@ split_and_rehash_linear (vnet_classify_table_t * t,
   return new_values;
 }
 
+/*
+ * Online growth.
+ *
+ * A table with too few buckets for its sessions ends up with big pages
+ * and linear-search buckets. Once the sessions average more than
+ * VNET_CLASSIFY_GROW_LOAD per bucket the buckets are doubled. The new
+ * buckets and their pages are built aside from the live ones and
+ * swapped in with one store; the readers are not stopped. The old
+ * buckets and pages are freed once each worker has been round its loop.
+ * Growth that runs out of the table's memory leaves the table as it was.
+ */
+static u64
+vnet_classify_entry_hash (vnet_classify_table_t * t,
+			  vnet_classify_entry_t * v)
+{
+  /* Hack so we can use the packet hash routine */
+  u8 *key_minus_skip;
+
+  key_minus_skip = (u8 *) v->key;
+  key_minus_skip -= t->skip_n_vectors * sizeof (u32x4);
+
+  return vnet_classify_hash_packet (t, key_minus_skip);
+}
+
+/*
+ * Copy the entries into new pages for a bucket of a table with
+ * 2^log2_nbuckets buckets. Returns the pages, or 0 if two entries
+ * collide in the hashed pages or there's no memory.
+ */
+static vnet_classify_entry_t *
+vnet_classify_grow_place (vnet_classify_table_t * t,
+			  vnet_classify_entry_t ** entries,
+			  u32 log2_nbuckets, u32 log2_pages,
+			  int linear, int *no_memory)
+{
+  vnet_classify_entry_t *pages, *new_v;
+  u32 i, j, slot;
+
+  pages = vnet_classify_entry_alloc_i (t, log2_pages, 1 /* may_fail */ );
+  if (pages == 0)
+    {
+      *no_memory = 1;
+      return 0;
+    }
+
+  for (i = 0; i < vec_len (entries); i++)
+    {
+      if (linear)
+	slot = i;
+      else
+	slot = ((vnet_classify_entry_hash (t, entries[i]) >> log2_nbuckets) &
+		((1 << log2_pages) - 1));
+
+      for (j = 0; j < (linear ? 1 : t->entries_per_page); j++)
+	{
+	  new_v = vnet_classify_entry_at_index (t, pages, slot + j);
+
+	  if (vnet_classify_entry_is_free (new_v))
+	    {
+	      clib_memcpy_fast (new_v, entries[i],
+				sizeof (vnet_classify_entry_t) +
+				(t->match_n_vectors * sizeof (u32x4)));
+	      new_v->flags &= ~(VNET_CLASSIFY_ENTRY_FREE);
+	      goto next;
+	    }
+	}
+      vnet_classify_entry_free (t, pages, log2_pages);
+      return 0;
+    next:
+      ;
+    }
+  return pages;
+}
+
+/*
+ * Build a bucket of the grown table from its entries; hashed over the
+ * fewest pages that hold them without collision, failing that linear.
+ */
+static int
+vnet_classify_grow_bucket (vnet_classify_table_t * t,
+			   vnet_classify_entry_t ** entries,
+			   u32 log2_nbuckets, vnet_classify_bucket_t * b)
+{
+  vnet_classify_entry_t *pages = 0;
+  u32 min_log2_pages, log2_pages;
+  int no_memory = 0;
+
+  b->as_u64 = 0;
+  if (vec_len (entries) == 0)
+    return 0;
+
+  min_log2_pages = max_log2 ((vec_len (entries) + t->entries_per_page - 1) /
+			     t->entries_per_page);
+
+  for (log2_pages = min_log2_pages;
+       log2_pages <= min_log2_pages + 2 && !pages && !no_memory;
+       log2_pages++)
+    pages = vnet_classify_grow_place (t, entries, log2_nbuckets,
+				      log2_pages, 0 /* linear */ ,
+				      &no_memory);
+  if (pages)
+    {
+      b->log2_pages = log2_pages - 1;
+      b->offset = vnet_classify_get_offset (t, pages);
+      return 0;
+    }
+  if (no_memory)
+    return -1;
+
+  /* pinned collisions, use linear search */
+  pages = vnet_classify_grow_place (t, entries, log2_nbuckets,
+				    min_log2_pages, 1 /* linear */ ,
+				    &no_memory);
+  if (pages == 0)
+    return -1;
+
+  b->log2_pages = min_log2_pages;
+  b->offset = vnet_classify_get_offset (t, pages);
+  b->linear_search = 1;
+  return 0;
+}
+
+/*
+ * The entries compared by the lookups of a bucket's sessions, and by a
+ * lookup that misses in it
+ */
+static void
+vnet_classify_bucket_probes (vnet_classify_table_t * t,
+			     vnet_classify_bucket_t * b, u64 * n_hit,
+			     u64 * n_miss)
+{
+  vnet_classify_entry_t *v, *save_v;
+  u32 j, n_slots, value_index;
+
+  *n_hit = *n_miss = 0;
+
+  if (b->offset == 0)
+    return;
+
+  n_slots = (1 << b->log2_pages) * t->entries_per_page;
+  *n_miss = (b->linear_search ? n_slots : t->entries_per_page);
+
+  save_v = vnet_classify_get_entry (t, b->offset);
+  for (j = 0; j < n_slots; j++)
+    {
+      v = vnet_classify_entry_at_index (t, save_v, j);
+
+      if (vnet_classify_entry_is_free (v))
+	continue;
+
+      if (b->linear_search)
+	value_index = 0;
+      else
+	value_index = ((vnet_classify_entry_hash (t, v) >> t->log2_nbuckets)
+		       & ((1 << b->log2_pages) - 1));
+
+      *n_hit += j - value_index + 1;
+    }
+}
+
+static void
+vnet_classify_free_bucket_pages (vnet_classify_table_t * t,
+				 vnet_classify_bucket_t * buckets)
+{
+  vnet_classify_bucket_t *b;
+
+  vec_foreach (b, buckets)
+  {
+    if (b->offset)
+      vnet_classify_entry_free (t, vnet_classify_get_entry (t, b->offset),
+				b->log2_pages);
+  }
+}
+
+static int
+vnet_classify_table_grow (vnet_classify_table_t * t)
+{
+  vnet_classify_bucket_t *old_buckets, *new_buckets = 0, *b;
+  vnet_classify_entry_t **halves[2] = { 0 }, *v, *save_v;
+  u32 new_log2_nbuckets, linear_buckets;
+  u64 hash, n_hit, n_miss;
+  int i, j, rv = 0;
+
+  ASSERT (vlib_get_thread_index () == 0);
+
+  clib_spinlock_lock (&t->writer_lock);
+
+  old_buckets = t->buckets;
+  new_log2_nbuckets = t->log2_nbuckets + 1;
+  vec_validate_aligned (new_buckets, (1 << new_log2_nbuckets) - 1,
+			CLIB_CACHE_LINE_BYTES);
+
+  /* bucket i splits into i and i + nbuckets, on the next bit of the hash */
+  for (i = 0; i < t->nbuckets; i++)
+    {
+      b = &old_buckets[i];
+      if (b->offset == 0)
+	continue;
+
+      vec_reset_length (halves[0]);
+      vec_reset_length (halves[1]);
+
+      save_v = vnet_classify_get_entry (t, b->offset);
+      for (j = 0; j < (1 << b->log2_pages) * t->entries_per_page; j++)
+	{
+	  v = vnet_classify_entry_at_index (t, save_v, j);
+
+	  if (vnet_classify_entry_is_free (v))
+	    continue;
+
+	  hash = vnet_classify_entry_hash (t, v);
+	  vec_add1 (halves[(hash >> t->log2_nbuckets) & 1], v);
+	}
+
+      for (j = 0; j < 2; j++)
+	if (vnet_classify_grow_bucket (t, halves[j], new_log2_nbuckets,
+				       &new_buckets[i + (j << t->log2_nbuckets)]))
+	  {
+	    vnet_classify_free_bucket_pages (t, new_buckets);
+	    vec_free (new_buckets);
+	    t->n_grow_failures++;
+	    rv = -1;
+	    clib_spinlock_unlock (&t->writer_lock);
+	    goto done;
+	  }
+    }
+
+  clib_atomic_store_rel_n (&t->buckets, new_buckets);
+  t->nbuckets = 1 << new_log2_nbuckets;
+  t->log2_nbuckets = new_log2_nbuckets;
+
+  linear_buckets = 0;
+  t->n_hit_probes = t->n_miss_probes = 0;
+  vec_foreach (b, new_buckets)
+  {
+    linear_buckets += b->linear_search;
+    vnet_classify_bucket_probes (t, b, &n_hit, &n_miss);
+    t->n_hit_probes += n_hit;
+    t->n_miss_probes += n_miss;
+  }
+  t->linear_buckets = linear_buckets;
+  t->n_grows++;
+
+  clib_spinlock_unlock (&t->writer_lock);
+
+  /* no worker can still be looking at the old buckets after this */
+  vlib_worker_wait_one_loop ();
+
+  clib_spinlock_lock (&t->writer_lock);
+  vnet_classify_free_bucket_pages (t, old_buckets);
+  clib_spinlock_unlock (&t->writer_lock);
+  vec_free (old_buckets);
+
+done:
+  vec_free (halves[0]);
+  vec_free (halves[1]);
+  return rv;
+}
+
+static void
+vnet_classify_table_maybe_grow (vnet_classify_table_t * t)
+{
+  if (PREDICT_TRUE (t->active_elements <= t->grow_threshold))
+    return;
+
+  /* the workers may add, only the main thread grows */
+  if (vlib_get_thread_index () != 0 ||
+      t->log2_nbuckets >= VNET_CLASSIFY_GROW_MAX_LOG2_NBUCKETS)
+    return;
+
+  if (vnet_classify_table_grow (t))
+    /* out of memory, try again when the table's twice as full */
+    t->grow_threshold = 2 * t->active_elements;
+  else
+    t->grow_threshold = VNET_CLASSIFY_GROW_LOAD * t->nbuckets;
+}
+
+void
+vnet_classify_table_probe_stats (vnet_classify_table_t * t,
+				 f64 * per_hit, f64 * per_miss)
+{
+  *per_hit = (t->active_elements ?
+	      (f64) t->n_hit_probes / t->active_elements : 0);
+  *per_miss = (f64) t->n_miss_probes / t->nbuckets;
+}
+
 static void
 vnet_classify_entry_claim_resource (vnet_classify_entry_t * e)
 {
@@ -436,6 +754,7 @@ vnet_classify_add_del (vnet_classify_table_t * t,
   u8 *key_minus_skip;
   int resplit_once = 0;
   int mark_bucket_linear;
+  u64 n_hit, n_miss;
 
   ASSERT ((add_v->flags & VNET_CLASSIFY_ENTRY_FREE) == 0);
 
@@ -444,12 +763,17 @@ vnet_classify_add_del (vnet_classify_table_t * t,
 
   hash = vnet_classify_hash_packet (t, key_minus_skip);
 
+  clib_spinlock_lock (&t->writer_lock);
+
   bucket_index = hash & (t->nbuckets - 1);
   b = &t->buckets[bucket_index];
 
   hash >>= t->log2_nbuckets;
 
-  clib_spinlock_lock (&t->writer_lock);
+  /* the bucket's share of the probe stats, re-added once it's updated */
+  vnet_classify_bucket_probes (t, b, &n_hit, &n_miss);
+  t->n_hit_probes -= n_hit;
+  t->n_miss_probes -= n_miss;
 
   /* First elt in the bucket? */
   if (b->offset == 0)
@@ -641,7 +965,13 @@ expand_ok:
   vnet_classify_entry_free (t, v, old_log2_pages);
 
 unlock:
+  vnet_classify_bucket_probes (t, b, &n_hit, &n_miss);
+  t->n_hit_probes += n_hit;
+  t->n_miss_probes += n_miss;
+
   clib_spinlock_unlock (&t->writer_lock);
+  if (is_add && rv == 0)
+    vnet_classify_table_maybe_grow (t);
   return rv;
 }
 
@@ -655,14 +985,14 @@ typedef CLIB_PACKED(struct {
 u64
 vnet_classify_hash_packet (vnet_classify_table_t * t, u8 * h)
 {
-  return vnet_classify_hash_packet_inline (t, h);
+  return CLIB_MARCH_FN_SELECT (vnet_classify_hash_packet) (t, h);
 }
 
 vnet_classify_entry_t *
 vnet_classify_find_entry (vnet_classify_table_t * t,
 			  u8 * h, u64 hash, f64 now)
 {
-  return vnet_classify_find_entry_inline (t, h, hash, now);
+  return CLIB_MARCH_FN_SELECT (vnet_classify_find_entry) (t, h, hash, now);
 }
 
 static u8 *
@@ -2044,6 +2374,7 @@ format_vnet_classify_table (u8 * s, va_list * args)
   int verbose = va_arg (*args, int);
   u32 index = va_arg (*args, u32);
   vnet_classify_table_t *t;
+  f64 per_hit, per_miss;
 
   if (index == ~0)
     {
@@ -2063,7 +2394,11 @@ format_vnet_classify_table (u8 * s, va_list * args)
 	      t->current_data_flag, t->current_data_offset);
   s = format (s, "\n  mask %U", format_hex_bytes, t->mask,
 	      t->match_n_vectors * sizeof (u32x4));
-  s = format (s, "\n  linear-search buckets %d\n", t->linear_buckets);
+  s = format (s, "\n  linear-search buckets %d", t->linear_buckets);
+  vnet_classify_table_probe_stats (t, &per_hit, &per_miss);
+  s = format (s, "\n  grown %d times (%d failed), avg probes per hit %.2f"
+	      " per miss %.2f\n", t->n_grows, t->n_grow_failures,
+	      per_hit, per_miss);
 
   if (verbose == 0)
     return s;
@@ -2129,6 +2464,41 @@ VLIB_CLI_COMMAND (show_classify_table_command, static) = {
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+set_classify_chain_lookup_command_fn (vlib_main_t * vm,
+				      unformat_input_t * input,
+				      vlib_cli_command_t * cmd)
+{
+  vnet_classify_main_t *cm = &vnet_classify_main;
+
+  if (unformat (input, "enable"))
+    cm->chain_lookup = 1;
+  else if (unformat (input, "disable"))
+    cm->chain_lookup = 0;
+  else
+    return clib_error_return (0, "expected enable or disable");
+
+  return 0;
+}
+
+/*?
+ * Search the tables of a chain in one pass. The hashes of a packet in
+ * all the tables of the chain are computed, and their buckets and
+ * entries fetched, before any is compared; rather than each table's
+ * waiting on a miss in the one before. This is a win when packets
+ * often walk the chain, and a loss when most hit in the first table.
+ * Used by the ip4/ip6 classify and input/output ACL nodes.
+ *
+ * @cliexcmd{set classify chain-lookup enable}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_classify_chain_lookup_command, static) = {
+  .path = "set classify chain-lookup",
+  .short_help = "set classify chain-lookup [enable|disable]",
+  .function = set_classify_chain_lookup_command_fn,
+};
+/* *INDENT-ON* */
+
 uword
 unformat_l4_match (unformat_input_t * input, va_list * args)
 {
@@ -3160,6 +3530,8 @@ VLIB_CLI_COMMAND (test_classify_command, static) = {
 /* *INDENT-ON* */
 #endif /* TEST_CODE */
 
+#endif /* CLIB_MARCH_VARIANT */
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
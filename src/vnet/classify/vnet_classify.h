@@ -135,6 +135,13 @@ typedef struct
   };
 } vnet_classify_bucket_t;
 
+/*
+ * The buckets of a table are doubled, online, when its sessions average
+ * more than this per bucket; up to a limit
+ */
+#define VNET_CLASSIFY_GROW_LOAD 4
+#define VNET_CLASSIFY_GROW_MAX_LOG2_NBUCKETS 24
+
 typedef struct
 {
   CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
@@ -174,6 +181,20 @@ typedef struct
   /* Private allocation arena, protected by the writer lock */
   void *mheap;
 
+  /* Sessions above which the buckets are doubled */
+  u32 grow_threshold;
+
+  /* Times the buckets have been doubled, and times that failed */
+  u32 n_grows;
+  u32 n_grow_failures;
+
+  /*
+   * Entries compared, summed over the sessions' lookups and over the
+   * buckets' misses; kept by the writer as the buckets change
+   */
+  u64 n_hit_probes;
+  u64 n_miss_probes;
+
   /* Writer (only) lock for this table */
   clib_spinlock_t writer_lock;
 
@@ -203,6 +224,9 @@ struct _vnet_classify_main
   /* Per-interface filter set map. [0] is used for pcap */
   u32 *filter_set_by_sw_if_index;
 
+  /* Search the tables of a chain in one pass */
+  u8 chain_lookup;
+
   /* convenience variables */
   vlib_main_t *vlib_main;
   vnet_main_t *vnet_main;
@@ -212,8 +236,39 @@ extern vnet_classify_main_t vnet_classify_main;
 
 u8 *format_classify_table (u8 * s, va_list * args);
 
+/*
+ * The average number of entries a lookup compares; over the sessions
+ * for a lookup that hits, over the buckets for one that misses.
+ */
+void vnet_classify_table_probe_stats (vnet_classify_table_t * t,
+				      f64 * per_hit, f64 * per_miss);
+
 u64 vnet_classify_hash_packet (vnet_classify_table_t * t, u8 * h);
 
+/*
+ * The wide hash and match take the first four vectors of the key in one
+ * 512 bit, or two 256 bit, masked operations; a fifth vector is taken
+ * alone. The lanes past the table's vectors are not loaded, neither from
+ * the packet, the mask nor the key.
+ */
+#if defined(CLIB_HAVE_VEC512)
+static_always_inline u16
+vnet_classify_lanes_x16 (u32 n_vectors)
+{
+  return (n_vectors >= 4 ? 0xffff : (1 << (4 * n_vectors)) - 1);
+}
+#elif defined(CLIB_HAVE_VEC256)
+static_always_inline void
+vnet_classify_lanes_x8 (u32 n_vectors, u32x8 lanes[2])
+{
+  u32x8 idx = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  u32x8 n = u32x8_splat (4 * clib_min (n_vectors, 4));
+
+  lanes[0] = (u32x8) (idx < n);
+  lanes[1] = (u32x8) (idx + 8 < n);
+}
+#endif
+
 static inline u64
 vnet_classify_hash_packet_inline (vnet_classify_table_t * t, u8 * h)
 {
@@ -226,8 +281,34 @@ vnet_classify_hash_packet_inline (vnet_classify_table_t * t, u8 * h)
   } xor_sum __attribute__ ((aligned (sizeof (u32x4))));
 
   ASSERT (t);
+  ASSERT (t->match_n_vectors >= 1 && t->match_n_vectors <= 5);
   mask = t->mask;
-#ifdef CLIB_HAVE_VEC128
+#if defined(CLIB_HAVE_VEC512)
+  u32x4u *data = (u32x4u *) h + t->skip_n_vectors;
+  u16 lanes = vnet_classify_lanes_x16 (t->match_n_vectors);
+  u32x16 x16;
+  u32x8 x8;
+
+  x16 = (u32x16_mask_load_zero (data, lanes) &
+	 u32x16_mask_load_zero (mask, lanes));
+  x8 = u32x16_extract_lo (x16) ^ u32x16_extract_hi (x16);
+  xor_sum.as_u32x4 = u32x8_extract_lo (x8) ^ u32x8_extract_hi (x8);
+  if (PREDICT_FALSE (t->match_n_vectors == 5))
+    xor_sum.as_u32x4 ^= data[4] & mask[4];
+#elif defined(CLIB_HAVE_VEC256)
+  u32x4u *data = (u32x4u *) h + t->skip_n_vectors;
+  u32x8 lanes[2], x8;
+
+  vnet_classify_lanes_x8 (t->match_n_vectors, lanes);
+  x8 = (u32x8_mask_load (data, lanes[0]) &
+	u32x8_mask_load (mask, lanes[0]));
+  if (t->match_n_vectors > 2)
+    x8 ^= (u32x8_mask_load (data + 2, lanes[1]) &
+	   u32x8_mask_load (mask + 2, lanes[1]));
+  xor_sum.as_u32x4 = u32x8_extract_lo (x8) ^ u32x8_extract_hi (x8);
+  if (PREDICT_FALSE (t->match_n_vectors == 5))
+    xor_sum.as_u32x4 ^= data[4] & mask[4];
+#elif defined(CLIB_HAVE_VEC128)
   u32x4u *data = (u32x4u *) h;
   xor_sum.as_u32x4 = data[0 + t->skip_n_vectors] & mask[0];
   switch (t->match_n_vectors)
@@ -278,21 +359,38 @@ vnet_classify_hash_packet_inline (vnet_classify_table_t * t, u8 * h)
     default:
       abort ();
     }
-#endif /* CLIB_HAVE_VEC128 */
+#endif
 
   return clib_xxhash (xor_sum.as_u64[0] ^ xor_sum.as_u64[1]);
 }
 
-static inline void
-vnet_classify_prefetch_bucket (vnet_classify_table_t * t, u64 hash)
+/*
+ * The bucket of a hash; the hash is left shifted past the bucket bits,
+ * ready to pick the page. The number of buckets is taken from the one
+ * read of the bucket vector, so a lookup that races with the growth of
+ * the table sees either the old buckets or the new, never a mix.
+ */
+static inline vnet_classify_bucket_t *
+vnet_classify_get_bucket (vnet_classify_table_t * t, u64 * hash)
 {
-  u32 bucket_index;
+  vnet_classify_bucket_t *buckets;
+  u32 log2_nbuckets;
+  u64 h = *hash;
+
+  buckets = clib_atomic_load_acq_n (&t->buckets);
+  log2_nbuckets = min_log2 (vec_len (buckets));
 
-  ASSERT (is_pow2 (t->nbuckets));
+  ASSERT (is_pow2 (vec_len (buckets)));
 
-  bucket_index = hash & (t->nbuckets - 1);
+  *hash = h >> log2_nbuckets;
+  return (&buckets[h & pow2_mask (log2_nbuckets)]);
+}
 
-  CLIB_PREFETCH (&t->buckets[bucket_index], CLIB_CACHE_LINE_BYTES, LOAD);
+static inline void
+vnet_classify_prefetch_bucket (vnet_classify_table_t * t, u64 hash)
+{
+  CLIB_PREFETCH (vnet_classify_get_bucket (t, &hash),
+		 CLIB_CACHE_LINE_BYTES, LOAD);
 }
 
 static inline vnet_classify_entry_t *
@@ -334,20 +432,15 @@ vnet_classify_entry_at_index (vnet_classify_table_t * t,
 static inline void
 vnet_classify_prefetch_entry (vnet_classify_table_t * t, u64 hash)
 {
-  u32 bucket_index;
   u32 value_index;
   vnet_classify_bucket_t *b;
   vnet_classify_entry_t *e;
 
-  bucket_index = hash & (t->nbuckets - 1);
-
-  b = &t->buckets[bucket_index];
+  b = vnet_classify_get_bucket (t, &hash);
 
   if (b->offset == 0)
     return;
 
-  hash >>= t->log2_nbuckets;
-
   e = vnet_classify_get_entry (t, b->offset);
   value_index = hash & ((1 << b->log2_pages) - 1);
 
@@ -372,19 +465,15 @@ vnet_classify_find_entry_inline (vnet_classify_table_t * t,
   } result __attribute__ ((aligned (sizeof (u32x4))));
   vnet_classify_bucket_t *b;
   u32 value_index;
-  u32 bucket_index;
   u32 limit;
   int i;
 
-  bucket_index = hash & (t->nbuckets - 1);
-  b = &t->buckets[bucket_index];
+  b = vnet_classify_get_bucket (t, &hash);
   mask = t->mask;
 
   if (b->offset == 0)
     return 0;
 
-  hash >>= t->log2_nbuckets;
-
   v = vnet_classify_get_entry (t, b->offset);
   value_index = hash & ((1 << b->log2_pages) - 1);
   limit = t->entries_per_page;
@@ -396,7 +485,73 @@ vnet_classify_find_entry_inline (vnet_classify_table_t * t,
 
   v = vnet_classify_entry_at_index (t, v, value_index);
 
-#ifdef CLIB_HAVE_VEC128
+#if defined(CLIB_HAVE_VEC512)
+  u32x4u *data = (u32x4u *) h + t->skip_n_vectors;
+  u16 lanes = vnet_classify_lanes_x16 (t->match_n_vectors);
+  u32x16 d16, r16;
+  u32x4 d4 = { };
+
+  /* the masked packet, once for all the entries of the bucket */
+  d16 = (u32x16_mask_load_zero (data, lanes) &
+	 u32x16_mask_load_zero (mask, lanes));
+  if (PREDICT_FALSE (t->match_n_vectors == 5))
+    d4 = data[4] & mask[4];
+
+  for (i = 0; i < limit; i++)
+    {
+      key = v->key;
+      r16 = u32x16_mask_load_zero (key, lanes) ^ d16;
+      result.as_u32x4 = d4;
+      if (PREDICT_FALSE (t->match_n_vectors == 5))
+	result.as_u32x4 ^= key[4];
+
+      if (u32x16_is_all_zero (r16) && u32x4_is_all_zero (result.as_u32x4))
+	{
+	  if (PREDICT_TRUE (now))
+	    {
+	      v->hits++;
+	      v->last_heard = now;
+	    }
+	  return (v);
+	}
+      v = vnet_classify_entry_at_index (t, v, 1);
+    }
+#elif defined(CLIB_HAVE_VEC256)
+  u32x4u *data = (u32x4u *) h + t->skip_n_vectors;
+  u32x8 lanes[2], d8[2], r8;
+  u32x4 d4 = { };
+
+  /* the masked packet, once for all the entries of the bucket */
+  vnet_classify_lanes_x8 (t->match_n_vectors, lanes);
+  d8[0] = (u32x8_mask_load (data, lanes[0]) &
+	   u32x8_mask_load (mask, lanes[0]));
+  d8[1] = (u32x8_mask_load (data + 2, lanes[1]) &
+	   u32x8_mask_load (mask + 2, lanes[1]));
+  if (PREDICT_FALSE (t->match_n_vectors == 5))
+    d4 = data[4] & mask[4];
+
+  for (i = 0; i < limit; i++)
+    {
+      key = v->key;
+      r8 = u32x8_mask_load (key, lanes[0]) ^ d8[0];
+      if (t->match_n_vectors > 2)
+	r8 |= u32x8_mask_load (key + 2, lanes[1]) ^ d8[1];
+      result.as_u32x4 = d4;
+      if (PREDICT_FALSE (t->match_n_vectors == 5))
+	result.as_u32x4 ^= key[4];
+
+      if (u32x8_is_all_zero (r8) && u32x4_is_all_zero (result.as_u32x4))
+	{
+	  if (PREDICT_TRUE (now))
+	    {
+	      v->hits++;
+	      v->last_heard = now;
+	    }
+	  return (v);
+	}
+      v = vnet_classify_entry_at_index (t, v, 1);
+    }
+#elif defined(CLIB_HAVE_VEC128)
   u32x4u *data = (u32x4u *) h;
   for (i = 0; i < limit; i++)
     {
@@ -488,10 +643,105 @@ vnet_classify_find_entry_inline (vnet_classify_table_t * t,
 
       v = vnet_classify_entry_at_index (t, v, 1);
     }
-#endif /* CLIB_HAVE_VEC128 */
+#endif
   return 0;
 }
 
+/*
+ * Multi-table lookup.
+ *
+ * Walking a chain of tables packet by packet, the hash for, and the
+ * bucket and entry fetch from, each table waits on the miss in the one
+ * before. In one pass the masked hashes of a packet for all the tables
+ * of a chain are computed together and all their buckets prefetched,
+ * then all their entries, before any is compared. The first table to
+ * match, in chain order, wins; as the walk.
+ *
+ * A chain longer than VNET_CLASSIFY_CHAIN_MAX is searched in one pass
+ * up to that length and walked from there.
+ */
+#define VNET_CLASSIFY_CHAIN_MAX 8
+
+typedef struct
+{
+  /* The tables of the chain, in order */
+  vnet_classify_table_t *tables[VNET_CLASSIFY_CHAIN_MAX];
+  u32 n_tables;
+
+  /* The table the chain was built from */
+  u32 table_index;
+} vnet_classify_chain_t;
+
+static inline void
+vnet_classify_chain_init (vnet_classify_main_t * cm,
+			  vnet_classify_chain_t * c, u32 table_index)
+{
+  c->table_index = table_index;
+  c->n_tables = 0;
+
+  while (table_index != ~0 && c->n_tables < VNET_CLASSIFY_CHAIN_MAX)
+    {
+      c->tables[c->n_tables] = pool_elt_at_index (cm->tables, table_index);
+      table_index = c->tables[c->n_tables]->next_table_index;
+      c->n_tables++;
+    }
+}
+
+/*
+ * Compute the hashes of the packet in all the chain's tables, then
+ * prefetch the buckets. The tables may not all match from the same
+ * offset in the packet, so each has its own header pointer.
+ */
+static inline void
+vnet_classify_chain_hash (vnet_classify_chain_t * c, u8 ** h, u64 * hashes)
+{
+  u32 i;
+
+  for (i = 0; i < c->n_tables; i++)
+    hashes[i] = vnet_classify_hash_packet_inline (c->tables[i], h[i]);
+
+  for (i = 0; i < c->n_tables; i++)
+    vnet_classify_prefetch_bucket (c->tables[i], hashes[i]);
+}
+
+static inline void
+vnet_classify_chain_prefetch_entries (vnet_classify_chain_t * c,
+				      u64 * hashes)
+{
+  u32 i;
+
+  for (i = 0; i < c->n_tables; i++)
+    vnet_classify_prefetch_entry (c->tables[i], hashes[i]);
+}
+
+/*
+ * Returns the matching entry of the first table in the chain that has
+ * one, and that table's position in the chain in *table_pos. Otherwise
+ * 0, and the position of the last table searched.
+ */
+static inline vnet_classify_entry_t *
+vnet_classify_chain_find_entry (vnet_classify_chain_t * c,
+				u8 ** h, u64 * hashes, f64 now,
+				u32 * table_pos)
+{
+  vnet_classify_entry_t *e;
+  u32 i;
+
+  for (i = 0; i < c->n_tables; i++)
+    {
+      e = vnet_classify_find_entry_inline (c->tables[i], h[i], hashes[i],
+					   now);
+      if (e)
+	{
+	  *table_pos = i;
+	  return (e);
+	}
+    }
+
+  *table_pos = c->n_tables - 1;
+  return (0);
+}
+
 vnet_classify_table_t *vnet_classify_new_table (vnet_classify_main_t * cm,
 						u8 * mask, u32 nbuckets,
 						u32 memory_size,
@@ -74,8 +74,9 @@ format_vnet_crypto_handlers (u8 * s, va_list * args)
       od = cm->opt_data + id;
       if (first == 0)
         s = format (s, "\n%U", format_white_space, indent);
-      s = format (s, "%-20U%-20U", format_vnet_crypto_op_type, od->type,
-		  format_vnet_crypto_engine, od->active_engine_index,s);
+      s = format (s, "%-20U%-20U%-20U", format_vnet_crypto_op_type, od->type,
+		  format_vnet_crypto_engine, od->active_engine_index,
+		  format_vnet_crypto_engine, od->active_engine_index_chained);
 
       vec_foreach (e, cm->engines)
 	{
@@ -98,8 +99,8 @@ show_crypto_handlers_command_fn (vlib_main_t * vm,
   if (unformat_user (input, unformat_line_input, line_input))
     unformat_free (line_input);
 
-  vlib_cli_output (vm, "%-20s%-20s%-20s%s", "Algo", "Type", "Active",
-		   "Candidates");
+  vlib_cli_output (vm, "%-20s%-20s%-20s%-20s%s", "Algo", "Type", "Active",
+		   "Active chained", "Candidates");
 
   for (i = 0; i < VNET_CRYPTO_N_ALGS; i++)
     vlib_cli_output (vm, "%-20U%U", format_vnet_crypto_alg, i,
@@ -200,6 +201,85 @@ VLIB_CLI_COMMAND (set_crypto_handler_command, static) =
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+show_crypto_async_status_command_fn (vlib_main_t * vm,
+				     unformat_input_t * input,
+				     vlib_cli_command_t * cmd)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vlib_simple_counter_main_t *fc = &vnet_crypto_async_frame_counters;
+  vnet_crypto_thread_t *ct;
+  int i;
+
+  vlib_cli_output (vm, "async mode: %s, engine: %U",
+		   vnet_crypto_async_is_enabled ()? "on" : "off",
+		   format_vnet_crypto_engine, cm->async_engine_index);
+
+  vlib_cli_output (vm, "%-10s%-12s%-12s%-12s%s", "Thread", "In-flight",
+		   "Submitted", "Completed", "Failed");
+  for (i = 0; i < vec_len (vlib_mains); i++)
+    {
+      ct = vec_elt_at_index (cm->threads, i);
+      vlib_cli_output (vm, "%-10u%-12u%-12lu%-12lu%lu", i,
+		       pool_elts (ct->frame_pool),
+		       fc->counters[i][VNET_CRYPTO_ASYNC_FRAME_COUNTER_SUBMITTED],
+		       fc->counters[i][VNET_CRYPTO_ASYNC_FRAME_COUNTER_COMPLETED],
+		       fc->counters[i][VNET_CRYPTO_ASYNC_FRAME_COUNTER_FAILED]);
+    }
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_crypto_async_status_command, static) =
+{
+  .path = "show crypto async status",
+  .short_help = "show crypto async status",
+  .function = show_crypto_async_status_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+set_crypto_async_handler_command_fn (vlib_main_t * vm,
+				     unformat_input_t * input,
+				     vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  clib_error_t *error = 0;
+  char *engine = 0;
+  int rc;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  if (!unformat (line_input, "%s", &engine))
+    {
+      error = clib_error_return (0, "missing engine!");
+      goto done;
+    }
+  vec_add1 (engine, 0);
+
+  rc = vnet_crypto_set_async_handler (engine);
+  if (rc == -1)
+    error = clib_error_return (0, "no async engine %s", engine);
+  else if (rc)
+    error = clib_error_return (0, "async mode in use, engine unchanged");
+
+done:
+  vec_free (engine);
+  unformat_free (line_input);
+  return error;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_crypto_async_handler_command, static) =
+{
+  .path = "set crypto async handler",
+  .short_help = "set crypto async handler <engine>",
+  .function = set_crypto_async_handler_command_fn,
+};
+/* *INDENT-ON* */
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
@@ -19,6 +19,11 @@
 
 vnet_crypto_main_t crypto_main;
 
+vlib_simple_counter_main_t vnet_crypto_async_frame_counters = {
+  .name = "crypto-async-frames",
+  .stat_segment_name = "/net/crypto/async/frames",
+};
+
 static_always_inline u32
 vnet_crypto_process_ops_call_handler (vlib_main_t * vm,
 				      vnet_crypto_main_t * cm,
@@ -41,6 +46,30 @@ vnet_crypto_process_ops_call_handler (vlib_main_t * vm,
   return (cm->ops_handlers[opt]) (vm, ops, n_ops);
 }
 
+static_always_inline u32
+vnet_crypto_process_chained_ops_call_handler (vlib_main_t * vm,
+					      vnet_crypto_main_t * cm,
+					      vnet_crypto_op_id_t opt,
+					      vnet_crypto_op_t * ops[],
+					      vnet_crypto_op_chunk_t * chunks,
+					      u32 n_ops)
+{
+  if (n_ops == 0)
+    return 0;
+
+  if (cm->chained_ops_handlers[opt] == 0)
+    {
+      while (n_ops--)
+	{
+	  ops[0]->status = VNET_CRYPTO_OP_STATUS_FAIL_NO_HANDLER;
+	  ops++;
+	}
+      return 0;
+    }
+
+  return (cm->chained_ops_handlers[opt]) (vm, ops, chunks, n_ops);
+}
+
 
 u32
 vnet_crypto_process_ops (vlib_main_t * vm, vnet_crypto_op_t ops[], u32 n_ops)
@@ -74,6 +103,50 @@ vnet_crypto_process_ops (vlib_main_t * vm, vnet_crypto_op_t ops[], u32 n_ops)
   return rv;
 }
 
+/**
+ * @brief Process ops whose data is scattered over several chunks, e.g.
+ * the buffers of a vlib_buffer_t chain. All ops must have
+ * VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS set, their chunk_index refers to
+ * the chunks vector.
+ */
+u32
+vnet_crypto_process_chained_ops (vlib_main_t * vm, vnet_crypto_op_t ops[],
+				 vnet_crypto_op_chunk_t * chunks, u32 n_ops)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  const int op_q_size = VLIB_FRAME_SIZE;
+  vnet_crypto_op_t *op_queue[op_q_size];
+  vnet_crypto_op_id_t opt, current_op_type = ~0;
+  u32 n_op_queue = 0;
+  u32 rv = 0, i;
+
+  ASSERT (n_ops >= 1);
+
+  for (i = 0; i < n_ops; i++)
+    {
+      opt = ops[i].op;
+      ASSERT (ops[i].flags & VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS);
+
+      if (current_op_type != opt || n_op_queue >= op_q_size)
+	{
+	  rv += vnet_crypto_process_chained_ops_call_handler (vm, cm,
+							      current_op_type,
+							      op_queue,
+							      chunks,
+							      n_op_queue);
+	  n_op_queue = 0;
+	  current_op_type = opt;
+	}
+
+      op_queue[n_op_queue++] = &ops[i];
+    }
+
+  rv += vnet_crypto_process_chained_ops_call_handler (vm, cm, current_op_type,
+						      op_queue, chunks,
+						      n_op_queue);
+  return rv;
+}
+
 u32
 vnet_crypto_register_engine (vlib_main_t * vm, char *name, int prio,
 			     char *desc)
@@ -124,6 +197,11 @@ vnet_crypto_set_handler (char *alg_name, char *engine)
 	  od->active_engine_index = p[0];
 	  cm->ops_handlers[id] = ce->ops_handlers[id];
 	}
+      if (ce->chained_ops_handlers[id])
+	{
+	  od->active_engine_index_chained = p[0];
+	  cm->chained_ops_handlers[id] = ce->chained_ops_handlers[id];
+	}
     }
 
   return 0;
@@ -165,6 +243,35 @@ vnet_crypto_register_ops_handler (vlib_main_t * vm, u32 engine_index,
   return;
 }
 
+void
+vnet_crypto_register_chained_ops_handler (vlib_main_t * vm, u32 engine_index,
+					  vnet_crypto_op_id_t opt,
+					  vnet_crypto_chained_ops_handler_t *
+					  fn)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *ae, *e = vec_elt_at_index (cm->engines, engine_index);
+  vnet_crypto_op_data_t *otd = cm->opt_data + opt;
+  vec_validate_aligned (cm->chained_ops_handlers, VNET_CRYPTO_N_OP_IDS - 1,
+			CLIB_CACHE_LINE_BYTES);
+  e->chained_ops_handlers[opt] = fn;
+
+  /* chained ops are selected independently, an engine may support only
+     the simple form of an op */
+  if (otd->active_engine_index_chained == ~0)
+    {
+      otd->active_engine_index_chained = engine_index;
+      cm->chained_ops_handlers[opt] = fn;
+      return;
+    }
+  ae = vec_elt_at_index (cm->engines, otd->active_engine_index_chained);
+  if (ae->priority < e->priority)
+    {
+      otd->active_engine_index_chained = engine_index;
+      cm->chained_ops_handlers[opt] = fn;
+    }
+}
+
 void
 vnet_crypto_register_key_handler (vlib_main_t * vm, u32 engine_index,
 				  vnet_crypto_key_handler_t * key_handler)
@@ -175,6 +282,113 @@ vnet_crypto_register_key_handler (vlib_main_t * vm, u32 engine_index,
   return;
 }
 
+void
+vnet_crypto_register_async_handler (vlib_main_t * vm, u32 engine_index,
+				    vnet_crypto_frame_enqueue_t * enqh,
+				    vnet_crypto_frame_dequeue_t * deqh)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *ae, *e = vec_elt_at_index (cm->engines, engine_index);
+
+  e->enqueue_handler = enqh;
+  e->dequeue_handler = deqh;
+
+  if (cm->async_engine_index != ~0)
+    {
+      ae = vec_elt_at_index (cm->engines, cm->async_engine_index);
+      if (ae->priority >= e->priority)
+	return;
+    }
+
+  cm->async_engine_index = engine_index;
+  cm->enqueue_handler = enqh;
+  cm->dequeue_handler = deqh;
+}
+
+int
+vnet_crypto_set_async_handler (char *engine)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_engine_t *ce;
+  uword *p;
+
+  p = hash_get_mem (cm->engine_index_by_name, engine);
+  if (!p)
+    return -1;
+
+  ce = vec_elt_at_index (cm->engines, p[0]);
+  if (ce->enqueue_handler == 0 || ce->dequeue_handler == 0)
+    return -1;
+
+  /* frames in flight belong to the old engine */
+  if (cm->async_engine_index != p[0] && cm->async_refcnt)
+    return -2;
+
+  cm->async_engine_index = p[0];
+  cm->enqueue_handler = ce->enqueue_handler;
+  cm->dequeue_handler = ce->dequeue_handler;
+  return 0;
+}
+
+static void
+vnet_crypto_set_dispatch_state (vlib_node_state_t state)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  u32 i;
+
+  /* any thread may submit frames, main too for locally originated
+     packets, and with the sw scheduler any thread may process them */
+  for (i = 0; i < tm->n_vlib_mains; i++)
+    vlib_node_set_state (vlib_mains[i], crypto_dispatch_node.index, state);
+}
+
+/**
+ * @brief Reference counted request for async crypto. While at least one
+ * user has async mode on, the crypto-dispatch node polls for completed
+ * frames on every thread that may submit them. Called with the worker
+ * barrier held.
+ */
+void
+vnet_crypto_request_async_mode (int is_enable)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_thread_t *ct;
+
+  if (is_enable)
+    {
+      if (cm->async_refcnt++)
+	return;
+
+      /* frames are shared with engine threads, so never reallocate */
+      /* *INDENT-OFF* */
+      vec_foreach (ct, cm->threads)
+	if (ct->frame_pool == 0)
+	  pool_alloc_aligned (ct->frame_pool, VNET_CRYPTO_FRAME_POOL_SIZE,
+			      CLIB_CACHE_LINE_BYTES);
+      /* *INDENT-ON* */
+      vnet_crypto_set_dispatch_state (VLIB_NODE_STATE_POLLING);
+      return;
+    }
+
+  ASSERT (cm->async_refcnt > 0);
+  if (cm->async_refcnt)
+    cm->async_refcnt--;
+
+  /* crypto-dispatch turns itself off once in-flight frames are drained */
+}
+
+/**
+ * @brief Register a node where packets resume after async crypto
+ * @return next index on the crypto-dispatch node, for use as the
+ *         element next_node_index
+ */
+u32
+vnet_crypto_register_post_node (vlib_main_t * vm, char *post_node_name)
+{
+  return vlib_node_add_named_next (vm, crypto_dispatch_node.index,
+				   post_node_name);
+}
+
 static int
 vnet_crypto_key_len_check (vnet_crypto_alg_t alg, u16 length)
 {
@@ -257,6 +471,8 @@ vnet_crypto_init_cipher_data (vnet_crypto_alg_t alg, vnet_crypto_op_id_t eid,
   cm->opt_data[eid].alg = cm->opt_data[did].alg = alg;
   cm->opt_data[eid].active_engine_index = ~0;
   cm->opt_data[did].active_engine_index = ~0;
+  cm->opt_data[eid].active_engine_index_chained = ~0;
+  cm->opt_data[did].active_engine_index_chained = ~0;
   if (is_aead)
     {
       eopt = VNET_CRYPTO_OP_TYPE_AEAD_ENCRYPT;
@@ -283,6 +499,7 @@ vnet_crypto_init_hmac_data (vnet_crypto_alg_t alg,
   cm->algs[alg].op_by_type[VNET_CRYPTO_OP_TYPE_HMAC] = id;
   cm->opt_data[id].alg = alg;
   cm->opt_data[id].active_engine_index = ~0;
+  cm->opt_data[id].active_engine_index_chained = ~0;
   cm->opt_data[id].type = VNET_CRYPTO_OP_TYPE_HMAC;
   hash_set_mem (cm->alg_index_by_name, name, alg);
 }
@@ -297,6 +514,17 @@ vnet_crypto_init (vlib_main_t * vm)
   cm->alg_index_by_name = hash_create_string (0, sizeof (uword));
   vec_validate_aligned (cm->threads, tm->n_vlib_mains, CLIB_CACHE_LINE_BYTES);
   vec_validate (cm->algs, VNET_CRYPTO_N_ALGS);
+  vec_validate_aligned (cm->chained_ops_handlers, VNET_CRYPTO_N_OP_IDS - 1,
+			CLIB_CACHE_LINE_BYTES);
+  cm->async_engine_index = ~0;
+  vlib_validate_simple_counter (&vnet_crypto_async_frame_counters,
+				VNET_CRYPTO_ASYNC_FRAME_N_COUNTERS - 1);
+  vlib_zero_simple_counter (&vnet_crypto_async_frame_counters,
+			    VNET_CRYPTO_ASYNC_FRAME_COUNTER_SUBMITTED);
+  vlib_zero_simple_counter (&vnet_crypto_async_frame_counters,
+			    VNET_CRYPTO_ASYNC_FRAME_COUNTER_COMPLETED);
+  vlib_zero_simple_counter (&vnet_crypto_async_frame_counters,
+			    VNET_CRYPTO_ASYNC_FRAME_COUNTER_FAILED);
 #define _(n, s, l) \
   vnet_crypto_init_cipher_data (VNET_CRYPTO_ALG_##n, \
 				VNET_CRYPTO_OP_##n##_ENC, \
@@ -122,6 +122,16 @@ typedef struct
   vnet_crypto_op_id_t op_by_type[VNET_CRYPTO_OP_N_TYPES];
 } vnet_crypto_alg_data_t;
 
+/**
+ * @brief One contiguous piece of the data of a chained op
+ */
+typedef struct
+{
+  u8 *src;
+  u8 *dst;
+  u32 len;
+} vnet_crypto_op_chunk_t;
+
 typedef struct
 {
   CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
@@ -130,17 +140,25 @@ typedef struct
   u8 flags;
 #define VNET_CRYPTO_OP_FLAG_INIT_IV (1 << 0)
 #define VNET_CRYPTO_OP_FLAG_HMAC_CHECK (1 << 1)
+#define VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS (1 << 2)
   u32 key_index;
+  /* total data length, also for chained ops */
   u32 len;
   u16 aad_len;
   u8 digest_len, tag_len;
   u8 *iv;
+  /* src and dst are not used by chained ops */
   u8 *src;
   u8 *dst;
   u8 *aad;
   u8 *tag;
   u8 *digest;
   uword user_data;
+  /* valid if VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS is set: the op data is
+     n_chunks chunks starting at chunk_index in the chunk vector passed
+     along with the ops */
+  u32 chunk_index;
+  u16 n_chunks;
 } vnet_crypto_op_t;
 
 typedef struct
@@ -148,12 +166,74 @@ typedef struct
   vnet_crypto_op_type_t type;
   vnet_crypto_alg_t alg;
   u32 active_engine_index;
+  u32 active_engine_index_chained;
 } vnet_crypto_op_data_t;
 
+/* async frame: number of packets (elements) per frame */
+#define VNET_CRYPTO_FRAME_SIZE 64
+/* async frame: ops stages, ops of stage n are completed before stage n+1 */
+#define VNET_CRYPTO_FRAME_N_STAGES 2
+/* async frame: max number of in-flight frames per thread */
+#define VNET_CRYPTO_FRAME_POOL_SIZE 256
+
+#define foreach_crypto_async_frame_state \
+  _(NOT_PROCESSED, "not-processed") \
+  _(PENDING, "pending") \
+  _(WORK_IN_PROGRESS, "work-in-progress") \
+  _(SUCCESS, "success") \
+  _(ELT_ERROR, "element-error")
+
+typedef enum
+{
+#define _(n, s) VNET_CRYPTO_FRAME_STATE_##n,
+  foreach_crypto_async_frame_state
+#undef _
+    VNET_CRYPTO_FRAME_N_STATES,
+} vnet_crypto_async_frame_state_t;
+
+/* per-thread async frame counters, in the stats segment */
+#define foreach_crypto_async_frame_counter \
+  _(SUBMITTED, "submitted") \
+  _(COMPLETED, "completed") \
+  _(FAILED, "failed")
+
+typedef enum
+{
+#define _(n, s) VNET_CRYPTO_ASYNC_FRAME_COUNTER_##n,
+  foreach_crypto_async_frame_counter
+#undef _
+    VNET_CRYPTO_ASYNC_FRAME_N_COUNTERS,
+} vnet_crypto_async_frame_counter_t;
+
+extern vlib_simple_counter_main_t vnet_crypto_async_frame_counters;
+
+/**
+ * @brief A batch of crypto work submitted to an async engine.
+ *
+ * Each element is a packet: the buffer index, the next index on the
+ * crypto-dispatch node the packet resumes at once the frame completes,
+ * and the element status. The ops carry the element index in user_data.
+ * Frames are owned by the enqueuing thread and are handed back to it,
+ * in submission order, by the engine dequeue handler.
+ */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile vnet_crypto_async_frame_state_t state;
+  u16 n_elts;
+  u16 n_ops[VNET_CRYPTO_FRAME_N_STAGES];
+  u32 enqueue_thread_index;
+  u32 buffer_indices[VNET_CRYPTO_FRAME_SIZE];
+  u16 next_node_index[VNET_CRYPTO_FRAME_SIZE];
+  u8 elt_status[VNET_CRYPTO_FRAME_SIZE];
+  vnet_crypto_op_t ops[VNET_CRYPTO_FRAME_N_STAGES][VNET_CRYPTO_FRAME_SIZE];
+} vnet_crypto_async_frame_t;
+
 typedef struct
 {
   CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
   clib_bitmap_t *act_queues;
+  vnet_crypto_async_frame_t *frame_pool;
 } vnet_crypto_thread_t;
 
 typedef u32 vnet_crypto_key_index_t;
@@ -161,6 +241,11 @@ typedef u32 vnet_crypto_key_index_t;
 typedef u32 (vnet_crypto_ops_handler_t) (vlib_main_t * vm,
 					 vnet_crypto_op_t * ops[], u32 n_ops);
 
+typedef u32 (vnet_crypto_chained_ops_handler_t) (vlib_main_t * vm,
+						 vnet_crypto_op_t * ops[],
+						 vnet_crypto_op_chunk_t *
+						 chunks, u32 n_ops);
+
 typedef void (vnet_crypto_key_handler_t) (vlib_main_t * vm,
 					  vnet_crypto_key_op_t kop,
 					  vnet_crypto_key_index_t idx);
@@ -171,9 +256,24 @@ u32 vnet_crypto_register_engine (vlib_main_t * vm, char *name, int prio,
 void vnet_crypto_register_ops_handler (vlib_main_t * vm, u32 engine_index,
 				       vnet_crypto_op_id_t opt,
 				       vnet_crypto_ops_handler_t * oph);
+void vnet_crypto_register_chained_ops_handler (vlib_main_t * vm,
+					       u32 engine_index,
+					       vnet_crypto_op_id_t opt,
+					       vnet_crypto_chained_ops_handler_t
+					       * oph);
 void vnet_crypto_register_key_handler (vlib_main_t * vm, u32 engine_index,
 				       vnet_crypto_key_handler_t * keyh);
 
+/** async crypto engine handlers */
+typedef int (vnet_crypto_frame_enqueue_t) (vlib_main_t * vm,
+					   vnet_crypto_async_frame_t * frame);
+typedef vnet_crypto_async_frame_t *(vnet_crypto_frame_dequeue_t) (vlib_main_t
+								  * vm);
+
+void vnet_crypto_register_async_handler (vlib_main_t * vm, u32 engine_index,
+					 vnet_crypto_frame_enqueue_t * enqh,
+					 vnet_crypto_frame_dequeue_t * deqh);
+
 typedef struct
 {
   char *name;
@@ -181,6 +281,10 @@ typedef struct
   int priority;
   vnet_crypto_key_handler_t *key_op_handler;
   vnet_crypto_ops_handler_t *ops_handlers[VNET_CRYPTO_N_OP_IDS];
+  vnet_crypto_chained_ops_handler_t
+    * chained_ops_handlers[VNET_CRYPTO_N_OP_IDS];
+  vnet_crypto_frame_enqueue_t *enqueue_handler;
+  vnet_crypto_frame_dequeue_t *dequeue_handler;
 } vnet_crypto_engine_t;
 
 typedef struct
@@ -188,24 +292,39 @@ typedef struct
   vnet_crypto_alg_data_t *algs;
   vnet_crypto_thread_t *threads;
   vnet_crypto_ops_handler_t **ops_handlers;
+  vnet_crypto_chained_ops_handler_t **chained_ops_handlers;
   vnet_crypto_op_data_t opt_data[VNET_CRYPTO_N_OP_IDS];
   vnet_crypto_engine_t *engines;
   vnet_crypto_key_t *keys;
   uword *engine_index_by_name;
   uword *alg_index_by_name;
+
+  /* async mode */
+  u32 async_engine_index;
+  vnet_crypto_frame_enqueue_t *enqueue_handler;
+  vnet_crypto_frame_dequeue_t *dequeue_handler;
+  u32 async_refcnt;
 } vnet_crypto_main_t;
 
 extern vnet_crypto_main_t crypto_main;
+extern vlib_node_registration_t crypto_dispatch_node;
 
 u32 vnet_crypto_submit_ops (vlib_main_t * vm, vnet_crypto_op_t ** jobs,
 			    u32 n_jobs);
 
 u32 vnet_crypto_process_ops (vlib_main_t * vm, vnet_crypto_op_t ops[],
 			     u32 n_ops);
+u32 vnet_crypto_process_chained_ops (vlib_main_t * vm, vnet_crypto_op_t ops[],
+				     vnet_crypto_op_chunk_t * chunks,
+				     u32 n_ops);
 
 int vnet_crypto_set_handler (char *ops_handler_name, char *engine);
 int vnet_crypto_is_set_handler (vnet_crypto_alg_t alg);
 
+int vnet_crypto_set_async_handler (char *engine);
+void vnet_crypto_request_async_mode (int is_enable);
+u32 vnet_crypto_register_post_node (vlib_main_t * vm, char *post_node_name);
+
 u32 vnet_crypto_key_add (vlib_main_t * vm, vnet_crypto_alg_t alg,
 			 u8 * data, u16 length);
 void vnet_crypto_key_del (vlib_main_t * vm, vnet_crypto_key_index_t index);
@@ -215,6 +334,7 @@ format_function_t format_vnet_crypto_engine;
 format_function_t format_vnet_crypto_op;
 format_function_t format_vnet_crypto_op_type;
 format_function_t format_vnet_crypto_op_status;
+format_function_t format_vnet_crypto_async_frame_state;
 unformat_function_t unformat_vnet_crypto_alg;
 
 static_always_inline void
@@ -243,6 +363,145 @@ vnet_crypto_get_key (vnet_crypto_key_index_t index)
   return vec_elt_at_index (cm->keys, index);
 }
 
+static_always_inline int
+vnet_crypto_async_is_enabled (void)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  return cm->async_refcnt > 0 && cm->enqueue_handler != 0;
+}
+
+/**
+ * @brief Get an empty async frame from the per-thread frame pool
+ * @return 0 if the thread already has VNET_CRYPTO_FRAME_POOL_SIZE frames
+ *         in flight
+ */
+static_always_inline vnet_crypto_async_frame_t *
+vnet_crypto_async_get_frame (vlib_main_t * vm)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_thread_t *ct = cm->threads + vm->thread_index;
+  vnet_crypto_async_frame_t *f;
+
+  if (PREDICT_FALSE (pool_elts (ct->frame_pool) >=
+		     VNET_CRYPTO_FRAME_POOL_SIZE))
+    return 0;
+
+  pool_get_aligned (ct->frame_pool, f, CLIB_CACHE_LINE_BYTES);
+  f->state = VNET_CRYPTO_FRAME_STATE_NOT_PROCESSED;
+  f->n_elts = 0;
+  f->n_ops[0] = f->n_ops[1] = 0;
+  f->enqueue_thread_index = vm->thread_index;
+  return f;
+}
+
+static_always_inline void
+vnet_crypto_async_free_frame (vlib_main_t * vm,
+			      vnet_crypto_async_frame_t * f)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_thread_t *ct = cm->threads + vm->thread_index;
+  ASSERT (f->enqueue_thread_index == vm->thread_index);
+  pool_put (ct->frame_pool, f);
+}
+
+static_always_inline int
+vnet_crypto_async_frame_is_full (const vnet_crypto_async_frame_t * f)
+{
+  return f->n_elts == VNET_CRYPTO_FRAME_SIZE;
+}
+
+/**
+ * @brief Add a packet to an async frame
+ * @return element index, to be stored in the user_data of the element ops
+ */
+static_always_inline u16
+vnet_crypto_async_add_elt (vnet_crypto_async_frame_t * f, u32 buffer_index,
+			   u16 next_node_index)
+{
+  u16 i = f->n_elts++;
+  ASSERT (i < VNET_CRYPTO_FRAME_SIZE);
+  f->buffer_indices[i] = buffer_index;
+  f->next_node_index[i] = next_node_index;
+  f->elt_status[i] = VNET_CRYPTO_OP_STATUS_PENDING;
+  return i;
+}
+
+static_always_inline vnet_crypto_op_t *
+vnet_crypto_async_add_op (vnet_crypto_async_frame_t * f, u8 stage,
+			  vnet_crypto_op_id_t id, u16 elt_index)
+{
+  vnet_crypto_op_t *op;
+  ASSERT (stage < VNET_CRYPTO_FRAME_N_STAGES);
+  ASSERT (f->n_ops[stage] < VNET_CRYPTO_FRAME_SIZE);
+  op = &f->ops[stage][f->n_ops[stage]++];
+  vnet_crypto_op_init (op, id);
+  op->user_data = elt_index;
+  return op;
+}
+
+/**
+ * @brief Hand a frame over to the active async engine
+ * @return 0 on success; on failure the frame is still owned by the caller
+ */
+static_always_inline int
+vnet_crypto_async_submit_open_frame (vlib_main_t * vm,
+				     vnet_crypto_async_frame_t * f)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  int rv;
+
+  f->state = VNET_CRYPTO_FRAME_STATE_PENDING;
+  rv = cm->enqueue_handler (vm, f);
+  if (PREDICT_FALSE (rv))
+    {
+      f->state = VNET_CRYPTO_FRAME_STATE_NOT_PROCESSED;
+      return rv;
+    }
+
+  vlib_increment_simple_counter (&vnet_crypto_async_frame_counters,
+				 vm->thread_index,
+				 VNET_CRYPTO_ASYNC_FRAME_COUNTER_SUBMITTED, 1);
+  return 0;
+}
+
+/**
+ * @brief Run the ops of a frame synchronously on the calling thread and
+ * complete it. Used by software async engines on their crypto workers.
+ */
+static_always_inline void
+vnet_crypto_async_process_frame (vlib_main_t * vm,
+				 vnet_crypto_async_frame_t * f)
+{
+  vnet_crypto_async_frame_state_t state = VNET_CRYPTO_FRAME_STATE_SUCCESS;
+  vnet_crypto_op_t *op;
+  u32 n_ops, n_fail;
+  int stage, i;
+
+  for (stage = 0; stage < VNET_CRYPTO_FRAME_N_STAGES; stage++)
+    {
+      n_ops = f->n_ops[stage];
+      if (n_ops == 0)
+	continue;
+
+      op = f->ops[stage];
+      n_fail = n_ops - vnet_crypto_process_ops (vm, op, n_ops);
+
+      for (i = 0; n_fail && i < n_ops; i++, op++)
+	if (op->status != VNET_CRYPTO_OP_STATUS_COMPLETED)
+	  {
+	    f->elt_status[op->user_data] = op->status;
+	    state = VNET_CRYPTO_FRAME_STATE_ELT_ERROR;
+	    n_fail--;
+	  }
+    }
+
+  for (i = 0; i < f->n_elts; i++)
+    if (f->elt_status[i] == VNET_CRYPTO_OP_STATUS_PENDING)
+      f->elt_status[i] = VNET_CRYPTO_OP_STATUS_COMPLETED;
+
+  clib_atomic_store_rel_n (&f->state, state);
+}
+
 #endif /* included_vnet_crypto_crypto_h */
 
 /*
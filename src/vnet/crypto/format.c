@@ -90,6 +90,23 @@ format_vnet_crypto_op_status (u8 * s, va_list * args)
   return format (s, "%s", strings[st]);
 }
 
+u8 *
+format_vnet_crypto_async_frame_state (u8 * s, va_list * args)
+{
+  vnet_crypto_async_frame_state_t st =
+    va_arg (*args, vnet_crypto_async_frame_state_t);
+  char *strings[] = {
+#define _(n, s) [VNET_CRYPTO_FRAME_STATE_##n] = s,
+    foreach_crypto_async_frame_state
+#undef _
+  };
+
+  if (st >= VNET_CRYPTO_FRAME_N_STATES)
+    return format (s, "unknown");
+
+  return format (s, "%s", strings[st]);
+}
+
 u8 *
 format_vnet_crypto_engine (u8 * s, va_list * args)
 {
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2019 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdbool.h>
+#include <vlib/vlib.h>
+#include <vnet/crypto/crypto.h>
+
+typedef enum
+{
+#define _(sym,str) VNET_CRYPTO_ASYNC_ERROR_##sym,
+  foreach_crypto_op_status
+#undef _
+    VNET_CRYPTO_ASYNC_N_ERROR,
+} vnet_crypto_async_error_t;
+
+static char *vnet_crypto_async_error_strings[] = {
+#define _(sym,string) string,
+  foreach_crypto_op_status
+#undef _
+};
+
+#define foreach_crypto_dispatch_next \
+  _(ERR_DROP, "error-drop")
+
+typedef enum
+{
+#define _(n, s) CRYPTO_DISPATCH_NEXT_##n,
+  foreach_crypto_dispatch_next
+#undef _
+    CRYPTO_DISPATCH_N_NEXT,
+} crypto_dispatch_next_t;
+
+typedef struct
+{
+  vnet_crypto_op_status_t op_status;
+  u32 enqueue_thread_index;
+} crypto_dispatch_trace_t;
+
+static u8 *
+format_crypto_dispatch_trace (u8 * s, va_list * args)
+{
+  CLIB_UNUSED (vlib_main_t * vm) = va_arg (*args, vlib_main_t *);
+  CLIB_UNUSED (vlib_node_t * node) = va_arg (*args, vlib_node_t *);
+  crypto_dispatch_trace_t *t = va_arg (*args, crypto_dispatch_trace_t *);
+
+  s = format (s, "%U enqueue-thread %u", format_vnet_crypto_op_status,
+	      t->op_status, t->enqueue_thread_index);
+  return s;
+}
+
+static_always_inline void
+crypto_dispatch_flush (vlib_main_t * vm, vlib_node_runtime_t * node,
+		       u32 * bis, u16 * nexts, u32 n_buffers)
+{
+  if (n_buffers)
+    vlib_buffer_enqueue_to_next (vm, node, bis, nexts, n_buffers);
+}
+
+/**
+ * @brief Resume packets of completed async frames into the graph.
+ *
+ * Polls the active async engine for frames this thread submitted. Packets
+ * of failed elements are dropped with an error per op status, the others
+ * continue at the post node recorded when they were added to the frame.
+ */
+VLIB_NODE_FN (crypto_dispatch_node) (vlib_main_t * vm,
+				     vlib_node_runtime_t * node,
+				     vlib_frame_t * frame)
+{
+  vnet_crypto_main_t *cm = &crypto_main;
+  vnet_crypto_thread_t *ct;
+  u32 bis[VLIB_FRAME_SIZE];
+  u16 nexts[VLIB_FRAME_SIZE];
+  vnet_crypto_async_frame_t *cf;
+  u32 n_buffers = 0, n_dispatched = 0;
+  u32 i;
+
+  if (PREDICT_FALSE (cm->dequeue_handler == 0))
+    return 0;
+
+  while ((cf = cm->dequeue_handler (vm)))
+    {
+      if (n_buffers + cf->n_elts > VLIB_FRAME_SIZE)
+	{
+	  crypto_dispatch_flush (vm, node, bis, nexts, n_buffers);
+	  n_buffers = 0;
+	}
+
+      for (i = 0; i < cf->n_elts; i++)
+	{
+	  u32 bi = cf->buffer_indices[i];
+
+	  bis[n_buffers] = bi;
+	  nexts[n_buffers] = cf->next_node_index[i];
+
+	  if (PREDICT_FALSE (cf->elt_status[i] !=
+			     VNET_CRYPTO_OP_STATUS_COMPLETED))
+	    {
+	      vlib_buffer_t *b = vlib_get_buffer (vm, bi);
+	      b->error = node->errors[cf->elt_status[i]];
+	      nexts[n_buffers] = CRYPTO_DISPATCH_NEXT_ERR_DROP;
+	    }
+
+	  if (PREDICT_FALSE (node->flags & VLIB_NODE_FLAG_TRACE))
+	    {
+	      vlib_buffer_t *b = vlib_get_buffer (vm, bi);
+	      if (b->flags & VLIB_BUFFER_IS_TRACED)
+		{
+		  crypto_dispatch_trace_t *tr;
+		  tr = vlib_add_trace (vm, node, b, sizeof (*tr));
+		  tr->op_status = cf->elt_status[i];
+		  tr->enqueue_thread_index = cf->enqueue_thread_index;
+		}
+	    }
+	  n_buffers++;
+	}
+
+      vlib_increment_simple_counter (&vnet_crypto_async_frame_counters,
+				     vm->thread_index,
+				     cf->state == VNET_CRYPTO_FRAME_STATE_SUCCESS ?
+				     VNET_CRYPTO_ASYNC_FRAME_COUNTER_COMPLETED :
+				     VNET_CRYPTO_ASYNC_FRAME_COUNTER_FAILED, 1);
+
+      n_dispatched += cf->n_elts;
+      vnet_crypto_async_free_frame (vm, cf);
+    }
+
+  crypto_dispatch_flush (vm, node, bis, nexts, n_buffers);
+
+  if (PREDICT_TRUE (cm->async_refcnt))
+    return n_dispatched;
+
+  /* async mode was turned off; keep polling while any thread has frames in
+     flight, an engine may process them on this thread */
+  /* *INDENT-OFF* */
+  vec_foreach (ct, cm->threads)
+    if (pool_elts (ct->frame_pool))
+      return n_dispatched;
+  /* *INDENT-ON* */
+
+  vlib_node_set_state (vm, node->node_index, VLIB_NODE_STATE_DISABLED);
+
+  return n_dispatched;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (crypto_dispatch_node) = {
+  .name = "crypto-dispatch",
+  .type = VLIB_NODE_TYPE_INPUT,
+  .state = VLIB_NODE_STATE_DISABLED,
+  .format_trace = format_crypto_dispatch_trace,
+
+  .n_errors = ARRAY_LEN(vnet_crypto_async_error_strings),
+  .error_strings = vnet_crypto_async_error_strings,
+
+  .n_next_nodes = CRYPTO_DISPATCH_N_NEXT,
+  .next_nodes = {
+#define _(n, s) \
+  [CRYPTO_DISPATCH_NEXT_##n] = s,
+      foreach_crypto_dispatch_next
+#undef _
+  },
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -50,6 +50,18 @@ vlib_log_class_t load_balance_logger;
  */
 load_balance_t *load_balance_pool;
 
+/**
+ * Pool of the bucket ownership of resilient load-balances, and the
+ * index in it, by load-balance index. Not static for the DP.
+ */
+load_balance_resilient_t *load_balance_resilient_pool;
+index_t *load_balance_resilient_by_lb;
+
+/**
+ * The interval, in seconds, between scans for idle buckets
+ */
+static f64 load_balance_resilient_scan_interval = 10.0;
+
 /**
  * The one instance of load-balance main
  */
@@ -160,6 +172,24 @@ load_balance_format (index_t lbi,
                    format_white_space, indent+4,
                    format_load_balance_map, lb->lb_map, indent+4);
     }
+    if (lb->lb_flags & LOAD_BALANCE_FLAG_RESILIENT)
+    {
+        const load_balance_resilient_path_t *lbrp;
+        const load_balance_resilient_t *lbr;
+
+        lbr = load_balance_resilient_get(lbi);
+
+        s = format(s, "\n%Uresilient: moved:[removed:%d idle:%d]",
+                   format_white_space, indent+4,
+                   lbr->lbr_n_moved_removed, lbr->lbr_n_moved_idle);
+        vec_foreach(lbrp, lbr->lbr_paths)
+        {
+            s = format(s, "\n%Ubuckets:%d share:%d %U",
+                       format_white_space, indent+6,
+                       lbrp->lbrp_n_buckets, lbrp->lbrp_target,
+                       format_dpo_id, &lbrp->lbrp_dpo, indent+8);
+        }
+    }
     for (i = 0; i < lb->lb_n_buckets; i++)
     {
         s = format(s, "\n%U[%d] %U",
@@ -573,6 +603,213 @@ load_balance_fill_buckets_sticky (load_balance_t *lb,
     vec_free(fwding_paths);
 }
 
+load_balance_resilient_t *
+load_balance_resilient_get (index_t lbi)
+{
+    if (lbi >= vec_len(load_balance_resilient_by_lb) ||
+        INDEX_INVALID == load_balance_resilient_by_lb[lbi])
+        return (NULL);
+
+    return (pool_elt_at_index(load_balance_resilient_pool,
+                              load_balance_resilient_by_lb[lbi]));
+}
+
+static load_balance_resilient_t *
+load_balance_resilient_get_or_create (load_balance_t *lb)
+{
+    load_balance_resilient_t *lbr;
+    index_t lbi;
+
+    lbi = load_balance_get_index(lb);
+    lbr = load_balance_resilient_get(lbi);
+
+    if (NULL != lbr)
+        return (lbr);
+
+    pool_get_zero(load_balance_resilient_pool, lbr);
+    lbr->lbr_lb = lbi;
+    vec_validate(lbr->lbr_active, LB_RESILIENT_N_BUCKETS - 1);
+
+    vec_validate_init_empty(load_balance_resilient_by_lb, lbi, INDEX_INVALID);
+    load_balance_resilient_by_lb[lbi] = lbr - load_balance_resilient_pool;
+
+    return (lbr);
+}
+
+static void
+load_balance_resilient_free (load_balance_t *lb)
+{
+    load_balance_resilient_path_t *lbrp;
+    load_balance_resilient_t *lbr;
+    index_t lbi;
+
+    lbi = load_balance_get_index(lb);
+    lbr = load_balance_resilient_get(lbi);
+
+    if (NULL == lbr)
+        return;
+
+    vec_foreach(lbrp, lbr->lbr_paths)
+    {
+        dpo_reset(&lbrp->lbrp_dpo);
+    }
+    vec_free(lbr->lbr_paths);
+    vec_free(lbr->lbr_owners);
+    vec_free(lbr->lbr_active);
+
+    load_balance_resilient_by_lb[lbi] = INDEX_INVALID;
+    pool_put(load_balance_resilient_pool, lbr);
+}
+
+/**
+ * The path with the largest shortfall of buckets against its share,
+ * or ~0 if none is short.
+ */
+static u32
+load_balance_resilient_neediest (const load_balance_resilient_t *lbr)
+{
+    u32 ii, best;
+    int deficit;
+
+    best = ~0;
+    deficit = 0;
+
+    for (ii = 0; ii < vec_len(lbr->lbr_paths); ii++)
+    {
+        const load_balance_resilient_path_t *lbrp = &lbr->lbr_paths[ii];
+
+        if ((int) lbrp->lbrp_target - (int) lbrp->lbrp_n_buckets > deficit)
+        {
+            deficit = (int) lbrp->lbrp_target - (int) lbrp->lbrp_n_buckets;
+            best = ii;
+        }
+    }
+
+    return (best);
+}
+
+#define LB_RESILIENT_NO_OWNER ((u16) ~0)
+
+/*
+ * Fill the buckets of a resilient load-balance. A bucket whose path
+ * remains, i.e. whose DPO is still present, keeps that path. Only the
+ * buckets of the paths that are gone get a new owner, given first to
+ * the paths furthest below their share. The next-hops are not
+ * normalised; the buckets are shared by their weights.
+ */
+static void
+load_balance_fill_buckets_resilient (load_balance_t *lb,
+                                     load_balance_path_t *nhs,
+                                     dpo_id_t *buckets,
+                                     u32 n_buckets)
+{
+    load_balance_resilient_path_t *old_paths, *lbrp;
+    load_balance_resilient_t *lbr;
+    u32 ii, jj, n_assigned, sum;
+    load_balance_path_t *nh;
+    u16 owner;
+
+    lbr = load_balance_resilient_get(load_balance_get_index(lb));
+    ASSERT(NULL != lbr);
+
+    old_paths = lbr->lbr_paths;
+    lbr->lbr_paths = NULL;
+
+    /*
+     * each path's share of the buckets. Any left from rounding down go one
+     * each to the paths in turn.
+     */
+    sum = 0;
+    vec_foreach (nh, nhs)
+    {
+        sum += clib_max(1, nh->path_weight);
+    }
+    n_assigned = 0;
+    vec_foreach (nh, nhs)
+    {
+        vec_add2(lbr->lbr_paths, lbrp, 1);
+
+        dpo_copy(&lbrp->lbrp_dpo, &nh->path_dpo);
+        lbrp->lbrp_target = ((u64) clib_max(1, nh->path_weight) *
+                             n_buckets) / sum;
+        lbrp->lbrp_n_buckets = 0;
+        n_assigned += lbrp->lbrp_target;
+    }
+    for (ii = 0; n_assigned < n_buckets; n_assigned++)
+    {
+        lbr->lbr_paths[ii].lbrp_target++;
+        ii = (ii + 1) % vec_len(lbr->lbr_paths);
+    }
+
+    if (vec_len(lbr->lbr_owners) != n_buckets)
+    {
+        /*
+         * no ownership to preserve. deal the buckets out to the neediest,
+         * which interleaves the paths.
+         */
+        vec_validate(lbr->lbr_owners, n_buckets - 1);
+        _vec_len(lbr->lbr_owners) = n_buckets;
+
+        for (ii = 0; ii < n_buckets; ii++)
+        {
+            owner = load_balance_resilient_neediest(lbr);
+            lbr->lbr_owners[ii] = owner;
+            lbr->lbr_paths[owner].lbrp_n_buckets++;
+        }
+    }
+    else
+    {
+        /*
+         * the buckets whose path remains stay with it
+         */
+        for (ii = 0; ii < n_buckets; ii++)
+        {
+            owner = LB_RESILIENT_NO_OWNER;
+
+            if (lbr->lbr_owners[ii] < vec_len(old_paths))
+            {
+                vec_foreach_index(jj, lbr->lbr_paths)
+                {
+                    if (dpo_cmp(&lbr->lbr_paths[jj].lbrp_dpo,
+                                &old_paths[lbr->lbr_owners[ii]].lbrp_dpo) == 0)
+                    {
+                        owner = jj;
+                        lbr->lbr_paths[jj].lbrp_n_buckets++;
+                        break;
+                    }
+                }
+            }
+            lbr->lbr_owners[ii] = owner;
+        }
+        /*
+         * and those that are orphaned go to the neediest
+         */
+        for (ii = 0; ii < n_buckets; ii++)
+        {
+            if (LB_RESILIENT_NO_OWNER != lbr->lbr_owners[ii])
+                continue;
+
+            owner = load_balance_resilient_neediest(lbr);
+            ASSERT(LB_RESILIENT_NO_OWNER != owner);
+            lbr->lbr_owners[ii] = owner;
+            lbr->lbr_paths[owner].lbrp_n_buckets++;
+            lbr->lbr_n_moved_removed++;
+        }
+    }
+
+    for (ii = 0; ii < n_buckets; ii++)
+    {
+        load_balance_set_bucket_i(lb, ii, buckets,
+                                  &lbr->lbr_paths[lbr->lbr_owners[ii]].lbrp_dpo);
+    }
+
+    vec_foreach(lbrp, old_paths)
+    {
+        dpo_reset(&lbrp->lbrp_dpo);
+    }
+    vec_free(old_paths);
+}
+
 static void
 load_balance_fill_buckets (load_balance_t *lb,
                            load_balance_path_t *nhs,
@@ -580,7 +817,11 @@ load_balance_fill_buckets (load_balance_t *lb,
                            u32 n_buckets,
                            load_balance_flags_t flags)
 {
-    if (flags & LOAD_BALANCE_FLAG_STICKY)
+    if (flags & LOAD_BALANCE_FLAG_RESILIENT)
+    {
+        load_balance_fill_buckets_resilient(lb, nhs, buckets, n_buckets);
+    }
+    else if (flags & LOAD_BALANCE_FLAG_STICKY)
     {
         load_balance_fill_buckets_sticky(lb, nhs, buckets, n_buckets);
     }
@@ -613,23 +854,49 @@ load_balance_multipath_update (const dpo_id_t *dpo,
 
     ASSERT(DPO_LOAD_BALANCE == dpo->dpoi_type);
     lb = load_balance_get(dpo->dpoi_index);
-    lb->lb_flags = flags;
     fixed_nhs = load_balance_multipath_next_hop_fixup(raw_nhs, lb->lb_proto);
-    n_buckets =
-        ip_multipath_normalize_next_hops((NULL == fixed_nhs ?
-                                          raw_nhs :
-                                          fixed_nhs),
-                                         &nhs,
-                                         &sum_of_weights,
-                                         multipath_next_hop_error_tolerance);
+
+    if (flags & LOAD_BALANCE_FLAG_RESILIENT)
+    {
+        load_balance_resilient_t *lbr;
+
+        /*
+         * a fixed, large, number of buckets shared by the raw weights.
+         * The bucket ownership must exist before the DP sees the flag.
+         */
+        if (NULL == fixed_nhs)
+            vec_add(nhs, raw_nhs, vec_len(raw_nhs));
+        else
+            vec_add(nhs, fixed_nhs, vec_len(fixed_nhs));
+        sum_of_weights = 0;
+        n_buckets = clib_max(LB_RESILIENT_N_BUCKETS,
+                             max_pow2(vec_len(nhs)));
+
+        lbr = load_balance_resilient_get_or_create(lb);
+        vec_validate(lbr->lbr_active, n_buckets - 1);
+    }
+    else
+    {
+        n_buckets =
+            ip_multipath_normalize_next_hops((NULL == fixed_nhs ?
+                                              raw_nhs :
+                                              fixed_nhs),
+                                             &nhs,
+                                             &sum_of_weights,
+                                             multipath_next_hop_error_tolerance);
+    }
+    lb->lb_flags = flags;
 
     ASSERT (n_buckets >= vec_len (raw_nhs));
 
     /*
      * Save the old load-balance map used, and get a new one if required.
+     * A resilient load-balance does not use one; its buckets of a
+     * path that goes are already given to the others.
      */
     old_lbmi = lb->lb_map;
-    if (flags & LOAD_BALANCE_FLAG_USES_MAP)
+    if ((flags & LOAD_BALANCE_FLAG_USES_MAP) &&
+        !(flags & LOAD_BALANCE_FLAG_RESILIENT))
     {
         lbmi = load_balance_map_add_or_lock(n_buckets, sum_of_weights, nhs);
     }
@@ -831,6 +1098,11 @@ load_balance_multipath_update (const dpo_id_t *dpo,
     vec_free(fixed_nhs);
 
     load_balance_map_unlock(old_lbmi);
+
+    if (!(flags & LOAD_BALANCE_FLAG_RESILIENT))
+    {
+        load_balance_resilient_free(lb);
+    }
 }
 
 static void
@@ -864,6 +1136,7 @@ load_balance_destroy (load_balance_t *lb)
 
     fib_urpf_list_unlock(lb->lb_urpf);
     load_balance_map_unlock(lb->lb_map);
+    load_balance_resilient_free(lb);
 
     pool_put(load_balance_pool, lb);
 }
@@ -1021,6 +1294,117 @@ VLIB_CLI_COMMAND (load_balance_show_command, static) = {
     .function = load_balance_show,
 };
 
+u32
+load_balance_resilient_scan (void)
+{
+    load_balance_resilient_t *lbr;
+    u32 n_moved;
+
+    n_moved = 0;
+
+    pool_foreach(lbr, load_balance_resilient_pool,
+    ({
+        load_balance_resilient_path_t *from;
+        dpo_id_t *buckets;
+        load_balance_t *lb;
+        u32 ii, to;
+
+        lb = load_balance_get(lbr->lbr_lb);
+        buckets = load_balance_get_buckets(lb);
+
+        /*
+         * give the buckets not used since the last scan, of the paths with
+         * more than their share, to those with less. A bucket that is in
+         * use keeps its path, so no flow moves.
+         */
+        for (ii = 0; ii < lb->lb_n_buckets; ii++)
+        {
+            if (lbr->lbr_active[ii])
+                continue;
+
+            from = &lbr->lbr_paths[lbr->lbr_owners[ii]];
+
+            if (from->lbrp_n_buckets <= from->lbrp_target)
+                continue;
+
+            to = load_balance_resilient_neediest(lbr);
+
+            if (~0 == to)
+                break;
+
+            from->lbrp_n_buckets--;
+            lbr->lbr_paths[to].lbrp_n_buckets++;
+            lbr->lbr_owners[ii] = to;
+            load_balance_set_bucket_i(lb, ii, buckets,
+                                      &lbr->lbr_paths[to].lbrp_dpo);
+            lbr->lbr_n_moved_idle++;
+            n_moved++;
+        }
+
+        clib_memset(lbr->lbr_active, 0, vec_len(lbr->lbr_active));
+    }));
+
+    return (n_moved);
+}
+
+static uword
+load_balance_resilient_process (vlib_main_t * vm,
+                                vlib_node_runtime_t * rt,
+                                vlib_frame_t * f)
+{
+    while (1)
+    {
+        vlib_process_wait_for_event_or_clock(vm,
+                                             load_balance_resilient_scan_interval);
+        vlib_process_get_events(vm, NULL);
+
+        load_balance_resilient_scan();
+    }
+
+    return (0);
+}
+
+VLIB_REGISTER_NODE (load_balance_resilient_process_node, static) = {
+    .function = load_balance_resilient_process,
+    .type = VLIB_NODE_TYPE_PROCESS,
+    .name = "load-balance-resilient-process",
+};
+
+static clib_error_t *
+load_balance_resilient_cli (vlib_main_t * vm,
+                            unformat_input_t * input,
+                            vlib_cli_command_t * cmd)
+{
+    f64 interval;
+
+    if (unformat (input, "scan-interval %f", &interval))
+    {
+        if (interval <= 0)
+            return (clib_error_return (0, "invalid interval: %f", interval));
+
+        load_balance_resilient_scan_interval = interval;
+        vlib_process_signal_event(vm,
+                                  load_balance_resilient_process_node.index,
+                                  0, 0);
+    }
+    else if (unformat (input, "scan"))
+    {
+        vlib_cli_output (vm, "moved %d buckets",
+                         load_balance_resilient_scan());
+    }
+    else
+        return (clib_error_return (0, "unknown input '%U'",
+                                   format_unformat_error, input));
+
+    return (NULL);
+}
+
+VLIB_CLI_COMMAND (load_balance_resilient_command, static) = {
+    .path = "set load-balance resilient",
+    .short_help = "set load-balance resilient [scan-interval <seconds>] [scan]",
+    .function = load_balance_resilient_cli,
+};
+
 
 always_inline u32
 ip_flow_hash (void *data)
@@ -82,20 +82,23 @@ typedef struct load_balance_path_t_ {
 typedef enum load_balance_attr_t_ {
     LOAD_BALANCE_ATTR_USES_MAP = 0,
     LOAD_BALANCE_ATTR_STICKY = 1,
+    LOAD_BALANCE_ATTR_RESILIENT = 2,
 } load_balance_attr_t;
 
 #define LOAD_BALANCE_ATTR_NAMES  {                  \
     [LOAD_BALANCE_ATTR_USES_MAP] = "uses-map",      \
     [LOAD_BALANCE_ATTR_STICKY] = "sticky",          \
+    [LOAD_BALANCE_ATTR_RESILIENT] = "resilient",    \
 }
 
 #define FOR_EACH_LOAD_BALANCE_ATTR(_attr)                       \
-    for (_attr = 0; _attr <= LOAD_BALANCE_ATTR_STICKY; _attr++)
+    for (_attr = 0; _attr <= LOAD_BALANCE_ATTR_RESILIENT; _attr++)
 
 typedef enum load_balance_flags_t_ {
     LOAD_BALANCE_FLAG_NONE = 0,
     LOAD_BALANCE_FLAG_USES_MAP = (1 << 0),
     LOAD_BALANCE_FLAG_STICKY = (1 << 1),
+    LOAD_BALANCE_FLAG_RESILIENT = (1 << 2),
 } __attribute__((packed)) load_balance_flags_t;
 
 /**
@@ -177,6 +180,72 @@ typedef struct load_balance_t_ {
 STATIC_ASSERT(sizeof(load_balance_t) <= CLIB_CACHE_LINE_BYTES,
 	      "A load_balance object size exceeds one cacheline");
 
+/**
+ * The number of buckets in a resilient load-balance.
+ * A resilient load-balance does not rebuild its buckets when its paths
+ * change. Only the buckets of a removed path are given to another path;
+ * so a flow moves only if its path goes. A path that is added, or whose
+ * weight increases, is given buckets from the others lazily, as they
+ * become idle. There are many buckets so that the share of each path
+ * can be close to its weight without a rebuild.
+ */
+#define LB_RESILIENT_N_BUCKETS 256
+
+/**
+ * @brief A path's share of a resilient load-balance's buckets
+ */
+typedef struct load_balance_resilient_path_t_ {
+    /**
+     * The path's DPO that is the owned buckets' next. This is also the
+     * path's identity across updates; the FIB path indices are not
+     * stable, the path-list is copied on each path add/remove.
+     */
+    dpo_id_t lbrp_dpo;
+
+    /**
+     * The number of buckets the path's weight entitles it to
+     */
+    u16 lbrp_target;
+
+    /**
+     * The number of buckets the path owns
+     */
+    u16 lbrp_n_buckets;
+} load_balance_resilient_path_t;
+
+/**
+ * @brief The bucket ownership of a resilient load-balance
+ */
+typedef struct load_balance_resilient_t_ {
+    /**
+     * Per-bucket activity. Set by the data-plane when a packet uses the
+     * bucket, cleared at each scan for idle buckets.
+     */
+    u8 *lbr_active;
+
+    /**
+     * Per-bucket owner; the index of the path in lbr_paths
+     */
+    u16 *lbr_owners;
+
+    /**
+     * The current paths
+     */
+    load_balance_resilient_path_t *lbr_paths;
+
+    /**
+     * The load-balance
+     */
+    index_t lbr_lb;
+
+    /**
+     * The number of buckets moved because their path was removed, and
+     * because they were idle and their path had more than its share.
+     */
+    u32 lbr_n_moved_removed;
+    u32 lbr_n_moved_idle;
+} load_balance_resilient_t;
+
 /**
  * Flags controlling load-balance formatting/display
  */
@@ -212,6 +281,14 @@ extern u16 load_balance_n_buckets(index_t lbi);
 
 extern f64 load_balance_get_multipath_tolerance(void);
 
+/**
+ * @brief Give the idle buckets of the paths of resilient load-balances
+ * that have more than their share of buckets to those that have less.
+ * This is run periodically. Returns the number of buckets moved.
+ */
+extern u32 load_balance_resilient_scan(void);
+extern load_balance_resilient_t *load_balance_resilient_get(index_t lbi);
+
 /**
  * The encapsulation breakages are for fast DP access
  */
@@ -225,6 +302,31 @@ load_balance_get (index_t lbi)
 #define LB_HAS_INLINE_BUCKETS(_lb)		\
     ((_lb)->lb_n_buckets <= LB_NUM_INLINE_BUCKETS)
 
+/**
+ * The resilient bucket ownership, by load-balance index
+ */
+extern load_balance_resilient_t *load_balance_resilient_pool;
+extern index_t *load_balance_resilient_by_lb;
+
+/**
+ * @brief Note that a packet has used a bucket of a resilient load-balance.
+ * Only the first use since the last scan writes.
+ */
+static inline void
+load_balance_resilient_mark_active (const load_balance_t *lb,
+                                    u32 bucket)
+{
+    load_balance_resilient_t *lbr;
+
+    lbr = pool_elt_at_index(load_balance_resilient_pool,
+                            load_balance_resilient_by_lb[lb - load_balance_pool]);
+
+    if (PREDICT_FALSE(0 == lbr->lbr_active[bucket]))
+    {
+        lbr->lbr_active[bucket] = 1;
+    }
+}
+
 static inline const dpo_id_t *
 load_balance_get_bucket_i (const load_balance_t *lb,
 			   u32 bucket)
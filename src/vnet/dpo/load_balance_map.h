@@ -100,6 +100,10 @@ load_balance_get_fwd_bucket (const load_balance_t *lb,
     {
         bucket = load_balance_map_translate(lb->lb_map, bucket);
     }
+    else if (PREDICT_FALSE(lb->lb_flags & LOAD_BALANCE_FLAG_RESILIENT))
+    {
+        load_balance_resilient_mark_active(lb, bucket);
+    }
 
     if (PREDICT_TRUE(LB_HAS_INLINE_BUCKETS(lb)))
     {
@@ -19,6 +19,7 @@
 #include <vnet/dpo/receive_dpo.h>
 #include <vnet/adj/adj.h>
 #include <vnet/mpls/mpls_types.h>
+#include <vlib/threads.h>
 
 /**
  * the logger
@@ -64,6 +65,10 @@ replicate_main_t replicate_main = {
         .name = "mroutes",
         .stat_segment_name = "/net/mroute",
     },
+    .repm_replicas = {
+        .name = "mroute-replicas",
+        .stat_segment_name = "/net/mroute/replicas",
+    },
 };
 
 static inline index_t
@@ -97,10 +102,88 @@ replicate_alloc_i (void)
                                    replicate_get_index(rep));
     vlib_zero_combined_counter(&(replicate_main.repm_counters),
                                replicate_get_index(rep));
+    vlib_validate_combined_counter(&(replicate_main.repm_replicas),
+                                   replicate_get_index(rep));
+    vlib_zero_combined_counter(&(replicate_main.repm_replicas),
+                               replicate_get_index(rep));
 
     return (rep);
 }
 
+static void
+replicate_fanout_free (replicate_fanout_t *rf)
+{
+    vec_free(rf->rf_nexts);
+    vec_free(rf->rf_dpois);
+    vec_free(rf->rf_buckets);
+    clib_mem_free(rf);
+}
+
+typedef struct replicate_fanout_elt_t_
+{
+    u16 rfe_next;
+    u16 rfe_bucket;
+    u32 rfe_dpoi;
+} replicate_fanout_elt_t;
+
+static int
+replicate_fanout_elt_cmp (void *a1, void *a2)
+{
+    replicate_fanout_elt_t *e1 = a1, *e2 = a2;
+
+    if (e1->rfe_next != e2->rfe_next)
+        return ((int) e1->rfe_next - (int) e2->rfe_next);
+    if (e1->rfe_dpoi != e2->rfe_dpoi)
+        return (e1->rfe_dpoi < e2->rfe_dpoi ? -1 : 1);
+    return ((int) e1->rfe_bucket - (int) e2->rfe_bucket);
+}
+
+/**
+ * Rebuild the switch path's copy of the buckets, after they change.
+ * The old copy is freed once no worker can still be using it.
+ */
+static void
+replicate_fanout_update (replicate_t *rep)
+{
+    replicate_fanout_elt_t *elts, *elt;
+    replicate_fanout_t *old, *new;
+    const dpo_id_t *buckets;
+    u16 bucket;
+
+    elts = NULL;
+    buckets = replicate_get_buckets(rep);
+
+    for (bucket = 0; bucket < rep->rep_n_buckets; bucket++)
+    {
+        vec_add2(elts, elt, 1);
+        elt->rfe_next = buckets[bucket].dpoi_next_node;
+        elt->rfe_dpoi = buckets[bucket].dpoi_index;
+        elt->rfe_bucket = bucket;
+    }
+    vec_sort_with_function(elts, replicate_fanout_elt_cmp);
+
+    new = clib_mem_alloc(sizeof(*new));
+    clib_memset(new, 0, sizeof(*new));
+
+    vec_foreach(elt, elts)
+    {
+        vec_add1(new->rf_nexts, elt->rfe_next);
+        vec_add1(new->rf_dpois, elt->rfe_dpoi);
+        vec_add1(new->rf_buckets, elt->rfe_bucket);
+    }
+    vec_free(elts);
+
+    old = rep->rep_fanout;
+    CLIB_MEMORY_BARRIER();
+    rep->rep_fanout = new;
+
+    if (NULL != old)
+    {
+        vlib_worker_wait_one_loop();
+        replicate_fanout_free(old);
+    }
+}
+
 static u8*
 format_replicate_flags (u8 *s, va_list *args)
 {
@@ -124,7 +207,7 @@ replicate_format (index_t repi,
                   u32 indent,
                   u8 *s)
 {
-    vlib_counter_t to;
+    vlib_counter_t to, replicas;
     replicate_t *rep;
     dpo_id_t *buckets;
     u32 i;
@@ -132,12 +215,15 @@ replicate_format (index_t repi,
     repi &= ~MPLS_IS_REPLICATE;
     rep = replicate_get(repi);
     vlib_get_combined_counter(&(replicate_main.repm_counters), repi, &to);
+    vlib_get_combined_counter(&(replicate_main.repm_replicas), repi,
+                              &replicas);
     buckets = replicate_get_buckets(rep);
 
     s = format(s, "%U: ", format_dpo_type, DPO_REPLICATE);
     s = format(s, "[index:%d buckets:%d ", repi, rep->rep_n_buckets);
     s = format(s, "flags:[%U] ", format_replicate_flags, rep->rep_flags);
-    s = format(s, "to:[%Ld:%Ld]]", to.packets, to.bytes);
+    s = format(s, "to:[%Ld:%Ld] ", to.packets, to.bytes);
+    s = format(s, "replicas:[%Ld:%Ld]]", replicas.packets, replicas.bytes);
 
     for (i = 0; i < rep->rep_n_buckets; i++)
     {
@@ -182,6 +268,7 @@ replicate_create_i (u32 num_buckets,
                              rep->rep_n_buckets - 1,
                              CLIB_CACHE_LINE_BYTES);
     }
+    replicate_fanout_update(rep);
 
     REP_DBG(rep, "create");
 
@@ -227,6 +314,7 @@ replicate_set_bucket (index_t repi,
     ASSERT(bucket < rep->rep_n_buckets);
 
     replicate_set_bucket_i(rep, bucket, buckets, next);
+    replicate_fanout_update(rep);
 }
 
 int
@@ -502,6 +590,8 @@ replicate_multipath_update (const dpo_id_t *dpo,
         }
     }
 
+    replicate_fanout_update(rep);
+
     vec_foreach (nh, nhs)
     {
         dpo_reset(&nh->path_dpo);
@@ -575,6 +665,7 @@ replicate_dup (replicate_flags_t flags,
                 }
             }
         }
+        replicate_fanout_update(copy);
     }
 
     return (replicate_get_index(copy));
@@ -598,6 +689,7 @@ replicate_destroy (replicate_t *rep)
     {
         vec_free(rep->rep_buckets);
     }
+    replicate_fanout_free(rep->rep_fanout);
 
     pool_put(replicate_pool, rep);
 }
@@ -717,99 +809,112 @@ typedef struct replicate_trace_t_
     dpo_id_t dpo;
 } replicate_trace_t;
 
+/*
+ * The copies of the packets of a frame are cloned straight into a batch,
+ * with their next nodes from the replicate's fan-out, and the batch is
+ * enqueued in bulk. The copies of a packet are ordered by next node, so
+ * they go in runs to the same next frame.
+ */
 static uword
 replicate_inline (vlib_main_t * vm,
                   vlib_node_runtime_t * node,
                   vlib_frame_t * frame)
 {
     vlib_combined_counter_main_t * cm = &replicate_main.repm_counters;
+    vlib_combined_counter_main_t * rcm = &replicate_main.repm_replicas;
     replicate_main_t * rm = &replicate_main;
-    u32 n_left_from, * from, * to_next, next_index;
+    u32 n_left_from, * from, * clones, n_clones;
     u32 thread_index = vlib_get_thread_index();
+    u16 * nexts;
 
     from = vlib_frame_vector_args (frame);
     n_left_from = frame->n_vectors;
-    next_index = node->cached_next_index;
-  
+    clones = rm->clones[thread_index];
+    nexts = rm->clone_nexts[thread_index];
+    n_clones = 0;
+
     while (n_left_from > 0)
     {
-        u32 n_left_to_next;
-
-        vlib_get_next_frame (vm, node, next_index,
-                             to_next, n_left_to_next);
-
-        while (n_left_from > 0 && n_left_to_next > 0)
-	{
-            u32 next0, ci0, bi0, bucket, repi0;
-            const replicate_t *rep0;
-            vlib_buffer_t * b0, *c0;
-            const dpo_id_t *dpo0;
-	    u8 num_cloned;
+        const replicate_fanout_t *rf0;
+        u32 bi0, repi0, len0, ii;
+        const replicate_t *rep0;
+        u16 n_buckets0, n_cloned0;
+        vlib_buffer_t * b0, *c0;
 
-            bi0 = from[0];
-            from += 1;
-            n_left_from -= 1;
+        if (n_left_from > 1)
+        {
+            vlib_buffer_t *p1;
 
-            b0 = vlib_get_buffer (vm, bi0);
-            repi0 = vnet_buffer (b0)->ip.adj_index[VLIB_TX];
-            rep0 = replicate_get(repi0);
+            p1 = vlib_get_buffer (vm, from[1]);
+            vlib_prefetch_buffer_header (p1, LOAD);
+        }
 
-            vlib_increment_combined_counter(
-                cm, thread_index, repi0, 1,
-                vlib_buffer_length_in_chain(vm, b0));
+        bi0 = from[0];
+        from += 1;
+        n_left_from -= 1;
 
-	    vec_validate (rm->clones[thread_index], rep0->rep_n_buckets - 1);
+        b0 = vlib_get_buffer (vm, bi0);
+        repi0 = vnet_buffer (b0)->ip.adj_index[VLIB_TX];
+        rep0 = replicate_get(repi0);
+        rf0 = rep0->rep_fanout;
+        n_buckets0 = vec_len(rf0->rf_nexts);
+        len0 = vlib_buffer_length_in_chain(vm, b0);
 
-	    num_cloned = vlib_buffer_clone (vm, bi0, rm->clones[thread_index],
-                                            rep0->rep_n_buckets,
-					    VLIB_BUFFER_CLONE_HEAD_SIZE);
+        vlib_increment_combined_counter(cm, thread_index, repi0, 1, len0);
 
-	    if (num_cloned != rep0->rep_n_buckets)
-	      {
-		vlib_node_increment_counter
-		  (vm, node->node_index,
-		   REPLICATE_DPO_ERROR_BUFFER_ALLOCATION_FAILURE, 1);
-	      }
+        vec_validate (clones, n_clones + n_buckets0);
+        vec_validate (nexts, n_clones + n_buckets0);
 
-            for (bucket = 0; bucket < num_cloned; bucket++)
-            {
-                ci0 = rm->clones[thread_index][bucket];
-                c0 = vlib_get_buffer(vm, ci0);
+        n_cloned0 = vlib_buffer_clone (vm, bi0, clones + n_clones,
+                                       n_buckets0,
+                                       VLIB_BUFFER_CLONE_HEAD_SIZE);
 
-                to_next[0] = ci0;
-                to_next += 1;
-                n_left_to_next -= 1;
+        if (n_cloned0 != n_buckets0)
+        {
+            vlib_node_increment_counter
+                (vm, node->node_index,
+                 REPLICATE_DPO_ERROR_BUFFER_ALLOCATION_FAILURE, 1);
+        }
 
-                dpo0 = replicate_get_bucket_i(rep0, bucket);
-                next0 = dpo0->dpoi_next_node;
-                vnet_buffer (c0)->ip.adj_index[VLIB_TX] = dpo0->dpoi_index;
+        vlib_increment_combined_counter(rcm, thread_index, repi0,
+                                        n_cloned0, n_cloned0 * len0);
 
-                if (PREDICT_FALSE(b0->flags & VLIB_BUFFER_IS_TRACED))
-                {
-                    replicate_trace_t *t;
+        clib_memcpy_fast (nexts + n_clones, rf0->rf_nexts,
+                          n_cloned0 * sizeof (nexts[0]));
 
-                    if (c0 != b0)
-		      VLIB_BUFFER_TRACE_TRAJECTORY_INIT (c0);
-                    t = vlib_add_trace (vm, node, c0, sizeof (*t));
-                    t->rep_index = repi0;
-                    t->dpo = *dpo0;
-                }
+        for (ii = 0; ii < n_cloned0; ii++)
+        {
+            c0 = vlib_get_buffer(vm, clones[n_clones + ii]);
+            vnet_buffer (c0)->ip.adj_index[VLIB_TX] = rf0->rf_dpois[ii];
 
-                vlib_validate_buffer_enqueue_x1 (vm, node, next_index,
-                                                 to_next, n_left_to_next,
-                                                 ci0, next0);
-		if (PREDICT_FALSE (n_left_to_next == 0))
-		  {
-		    vlib_put_next_frame (vm, node, next_index, n_left_to_next);
-		    vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
-		  }
+            if (PREDICT_FALSE(b0->flags & VLIB_BUFFER_IS_TRACED))
+            {
+                replicate_trace_t *t;
+
+                if (c0 != b0)
+                    VLIB_BUFFER_TRACE_TRAJECTORY_INIT (c0);
+                t = vlib_add_trace (vm, node, c0, sizeof (*t));
+                t->rep_index = repi0;
+                t->dpo = *replicate_get_bucket_i(rep0,
+                                                 rf0->rf_buckets[ii]);
             }
-	    vec_reset_length (rm->clones[thread_index]);
         }
+        n_clones += n_cloned0;
 
-        vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+        if (n_clones >= VLIB_FRAME_SIZE)
+        {
+            vlib_buffer_enqueue_to_next (vm, node, clones, nexts, n_clones);
+            n_clones = 0;
+        }
     }
 
+    if (n_clones)
+        vlib_buffer_enqueue_to_next (vm, node, clones, nexts, n_clones);
+
+    /* the batch may have grown */
+    rm->clones[thread_index] = clones;
+    rm->clone_nexts[thread_index] = nexts;
+
     return frame->n_vectors;
 }
 
@@ -910,6 +1015,7 @@ replicate_dpo_init (vlib_main_t * vm)
   replicate_main_t * rm = &replicate_main;
 
   vec_validate (rm->clones, vlib_num_workers());
+  vec_validate (rm->clone_nexts, vlib_num_workers());
 
   return 0;
 }
@@ -34,8 +34,15 @@ typedef struct replicate_main_t_
 {
     vlib_combined_counter_main_t repm_counters;
 
-    /* per-cpu vector of cloned packets */
+    /**
+     * The copies sent, and their bytes; the cost of the fan-out
+     */
+    vlib_combined_counter_main_t repm_replicas;
+
+    /* per-cpu vector of cloned packets, and their next nodes, that
+     * are to be enqueued */
     u32 **clones;
+    u16 **clone_nexts;
 } replicate_main_t;
 
 extern replicate_main_t replicate_main;
@@ -55,6 +62,30 @@ typedef enum replicate_flags_t_
     REPLICATE_FLAGS_HAS_LOCAL,
 } __clib_packed replicate_flags_t;
 
+/**
+ * The buckets of a replicate as the switch path uses them; the next node
+ * and DPO index of each, ordered by next node then by DPO, so that the
+ * copies of a packet leave in runs to the same node and interface.
+ * Rebuilt when the buckets change.
+ */
+typedef struct replicate_fanout_t_
+{
+    /**
+     * The next node of each copy
+     */
+    u16 *rf_nexts;
+
+    /**
+     * The DPO index of each copy
+     */
+    u32 *rf_dpois;
+
+    /**
+     * The bucket each copy is from
+     */
+    u16 *rf_buckets;
+} replicate_fanout_t;
+
 /**
  * The FIB DPO provieds;
  *  - load-balancing over the next DPOs in the chain/graph
@@ -97,6 +128,11 @@ typedef struct replicate_t_ {
      */
     dpo_id_t *rep_buckets;
 
+    /**
+     * The buckets, ready for the switch path
+     */
+    replicate_fanout_t *rep_fanout;
+
     /**
      * The rest of the cache line is used for buckets. In the common case
      * where there there are less than 4 buckets, then the buckets are
@@ -224,10 +224,23 @@ load_balance_flags_t
 fib_entry_calc_lb_flags (fib_entry_src_collect_forwarding_ctx_t *ctx)
 {
     /**
-     * We'll use a LB map if the path-list has multiple recursive paths.
-     * recursive paths implies BGP, and hence scale.
+     * A resilient entry's buckets are never rebuilt, so there is no need
+     * for the map.
      */
-    if (ctx->n_recursive_constrained > 1 &&
+    if (ctx->esrc->fes_entry_flags & FIB_ENTRY_FLAG_RESILIENT)
+    {
+        return (LOAD_BALANCE_FLAG_RESILIENT);
+    }
+    /**
+     * We'll use a LB map if the path-list is shared by many entries and
+     * has multiple paths to choose from. Then the failure of one path
+     * is repaired by updating the map shared by all those entries, rather
+     * than by walking each of them. Multiple recursive paths implies BGP,
+     * and hence scale, but an IGP's many prefixes via the same attached
+     * next-hops benefit in the same way.
+     */
+    if ((ctx->n_recursive_constrained > 1 ||
+         fib_path_list_get_n_paths(ctx->esrc->fes_pl) > 1) &&
         fib_path_list_is_popular(ctx->esrc->fes_pl))
     {
         return (LOAD_BALANCE_FLAG_USES_MAP);
@@ -138,6 +138,13 @@ fib_node_child_remove (fib_node_type_t parent_type,
     fib_node_unlock(parent);
 }
 
+fib_node_t *
+fib_node_get (fib_node_index_t index,
+              fib_node_type_t type)
+{
+    return (fn_vfts[type].fnv_get(index));
+}
+
 u32
 fib_node_get_n_children (fib_node_type_t parent_type,
                          fib_node_index_t parent_index)
@@ -977,8 +977,10 @@ fib_path_back_walk_notify (fib_node_t *node,
 			   fib_node_back_walk_ctx_t *ctx)
 {
     fib_path_t *path;
+    int was_resolved;
 
     path = fib_path_from_fib_node(node);
+    was_resolved = fib_path_is_resolved(fib_path_get_index(path));
 
     FIB_PATH_DBG(path, "bw:%U",
                  format_fib_node_bw_reason, ctx->fnbw_reason);
@@ -1202,6 +1204,18 @@ FIXME comment
 	break;
     }
 
+    /*
+     * PIC edge trigger. Recursive paths are handled as the recursive
+     * adjacency is updated, for the others a change in the resolved
+     * state updates the load-balance maps now, before the (likely async)
+     * walk of the children reaches the entries.
+     */
+    if (FIB_PATH_TYPE_RECURSIVE != path->fp_type &&
+        was_resolved != fib_path_is_resolved(fib_path_get_index(path)))
+    {
+        load_balance_map_path_state_change(fib_path_get_index(path));
+    }
+
     /*
      * propagate the backwalk further to the path-list
      */
@@ -22,6 +22,7 @@
 #include <vnet/fib/ip4_fib.h>
 #include <vnet/fib/ip6_fib.h>
 #include <vnet/fib/mpls_fib.h>
+#include <vnet/fib/fib_walk.h>
 
 fib_table_t *
 fib_table_get (fib_node_index_t index,
@@ -563,6 +564,15 @@ fib_table_entry_path_add (u32 fib_index,
     return (fib_entry_index);
 }
 
+static inline void
+fib_table_batch_count (fib_table_t *fib_table)
+{
+    if (fib_table->ft_batch_depth)
+    {
+        fib_table->ft_batch_n_routes++;
+    }
+}
+
 fib_node_index_t
 fib_table_entry_path_add2 (u32 fib_index,
 			   const fib_prefix_t *prefix,
@@ -576,6 +586,7 @@ fib_table_entry_path_add2 (u32 fib_index,
 
     fib_table = fib_table_get(fib_index, prefix->fp_proto);
     fib_entry_index = fib_table_lookup_exact_match_i(fib_table, prefix);
+    fib_table_batch_count(fib_table);
 
     for (ii = 0; ii < vec_len(rpaths); ii++)
     {
@@ -625,6 +636,7 @@ fib_table_entry_path_remove2 (u32 fib_index,
 
     fib_table = fib_table_get(fib_index, prefix->fp_proto);
     fib_entry_index = fib_table_lookup_exact_match_i(fib_table, prefix);
+    fib_table_batch_count(fib_table);
 
     if (FIB_NODE_INDEX_INVALID == fib_entry_index)
     {
@@ -743,6 +755,7 @@ fib_table_entry_update (u32 fib_index,
 
     fib_table = fib_table_get(fib_index, prefix->fp_proto);
     fib_entry_index = fib_table_lookup_exact_match_i(fib_table, prefix);
+    fib_table_batch_count(fib_table);
 
     for (ii = 0; ii < vec_len(paths); ii++)
     {
@@ -867,6 +880,7 @@ fib_table_entry_delete (u32 fib_index,
 {
     fib_node_index_t fib_entry_index;
 
+    fib_table_batch_count(fib_table_get(fib_index, prefix->fp_proto));
     fib_entry_index = fib_table_lookup_exact_match(fib_index, prefix);
 
     if (FIB_NODE_INDEX_INVALID == fib_entry_index)
@@ -1359,6 +1373,96 @@ fib_table_flush (u32 fib_index,
     vec_free(ctx.ftf_entries);
 }
 
+void
+fib_table_batch_begin (u32 fib_index,
+                       fib_protocol_t proto)
+{
+    fib_table_t *fib_table;
+
+    fib_table = fib_table_get(fib_index, proto);
+
+    if (0 == fib_table->ft_batch_depth++)
+    {
+        fib_table->ft_batch_n_routes = 0;
+        fib_table->ft_batch_start = vlib_time_now(vlib_get_main());
+        fib_walk_defer_begin();
+    }
+
+    if (FIB_PROTOCOL_IP4 == proto)
+    {
+        ip4_fib_table_batch_begin(ip4_fib_get(fib_index));
+    }
+}
+
+int
+fib_table_batch_end (u32 fib_index,
+                     fib_protocol_t proto,
+                     fib_table_batch_stats_t *stats)
+{
+    fib_table_batch_stats_t fbs = {
+        .fbs_n_routes = 0,
+    };
+    fib_table_t *fib_table;
+    f64 now;
+
+    fib_table = fib_table_get(fib_index, proto);
+    ASSERT(fib_table->ft_batch_depth);
+    now = vlib_time_now(vlib_get_main());
+
+    if (--fib_table->ft_batch_depth)
+    {
+        if (FIB_PROTOCOL_IP4 == proto)
+        {
+            ip4_fib_table_batch_end(ip4_fib_get(fib_index));
+        }
+        return (0);
+    }
+
+    /*
+     * the walks go first; the forwarding updates they cause are then
+     * collected into the same commit of the mtrie
+     */
+    fbs.fbs_n_walks = fib_walk_defer_end(fib_index, proto);
+
+    fbs.fbs_n_routes = fib_table->ft_batch_n_routes;
+    fbs.fbs_update_time = now - fib_table->ft_batch_start;
+
+    if (FIB_PROTOCOL_IP4 == proto)
+    {
+        fbs.fbs_n_fwd_updates =
+            ip4_fib_table_batch_end(ip4_fib_get(fib_index));
+    }
+    fbs.fbs_commit_time = vlib_time_now(vlib_get_main()) - now;
+
+    if (NULL != stats)
+    {
+        *stats = fbs;
+    }
+
+    return (1);
+}
+
+u8 *
+format_fib_table_batch_stats (u8 *s, va_list *args)
+{
+    fib_table_batch_stats_t *fbs = va_arg(*args, fib_table_batch_stats_t *);
+    f64 total;
+
+    total = fbs->fbs_update_time + fbs->fbs_commit_time;
+
+    s = format(s, "%d routes in %.6f sec (update %.6f, commit %.6f)",
+               fbs->fbs_n_routes, total,
+               fbs->fbs_update_time, fbs->fbs_commit_time);
+    if (total > 0)
+    {
+        s = format(s, ", %.2e routes/sec", fbs->fbs_n_routes / total);
+    }
+    s = format(s, "\n  walks:%d forwarding-updates:%d",
+               fbs->fbs_n_walks, fbs->fbs_n_fwd_updates);
+
+    return (s);
+}
+
 u8 *
 format_fib_table_memory (u8 *s, va_list *args)
 {
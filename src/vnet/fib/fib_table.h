@@ -112,8 +112,44 @@ typedef struct fib_table_t_
      * Table description
      */
     u8* ft_desc;
+
+    /**
+     * Batch nesting depth, the number of routes programmed in the
+     * current batch and the time it began
+     */
+    u32 ft_batch_depth;
+    u32 ft_batch_n_routes;
+    f64 ft_batch_start;
 } fib_table_t;
 
+/**
+ * @brief The outcome of a batch of route updates to a table
+ */
+typedef struct fib_table_batch_stats_t_
+{
+    /**
+     * Number of route adds, updates and removes in the batch
+     */
+    u32 fbs_n_routes;
+
+    /**
+     * Number of back-walks run at the commit, once per parent however
+     * many of the batch's updates requested it
+     */
+    u32 fbs_n_walks;
+
+    /**
+     * Number of forwarding (mtrie) updates applied at the commit
+     */
+    u32 fbs_n_fwd_updates;
+
+    /**
+     * Time spent programming the routes and committing the batch
+     */
+    f64 fbs_update_time;
+    f64 fbs_commit_time;
+} fib_table_batch_stats_t;
+
 /**
  * @brief
  *  Format the description/name of the table
@@ -904,6 +940,50 @@ extern void fib_table_sub_tree_walk(u32 fib_index,
                                     fib_table_walk_fn_t fn,
                                     void *ctx);
 
+/**
+ * @brief
+ *  Begin a batch of route updates to the table.
+ *  Whilst in a batch the back-walks from the table's entries are deferred
+ *  and merged (other tables' walks are not affected), and for IPv4 the
+ *  updates to the forwarding mtrie are collected, so that each is done
+ *  once when the batch ends.
+ *  Batches may nest, only the outer-most end commits.
+ *
+ * @param fib_index
+ *  The index of the FIB
+ *
+ * @param proto
+ *  The protocol of the FIB (and thus the entries therein)
+ */
+extern void fib_table_batch_begin(u32 fib_index,
+                                  fib_protocol_t proto);
+
+/**
+ * @brief
+ *  End a batch of route updates to the table, committing the deferred
+ *  walks and forwarding updates.
+ *
+ * @param fib_index
+ *  The index of the FIB
+ *
+ * @param proto
+ *  The protocol of the FIB (and thus the entries therein)
+ *
+ * @param stats
+ *  If not NULL, filled with the outcome of the batch when it commits
+ *
+ * @return
+ *  non-zero if the batch was committed
+ */
+extern int fib_table_batch_end(u32 fib_index,
+                               fib_protocol_t proto,
+                               fib_table_batch_stats_t *stats);
+
+/**
+ * @brief format (display) a batch's statistics
+ */
+extern u8 *format_fib_table_batch_stats(u8 *s, va_list *args);
+
 /**
  * @brief format (display) the memory used by the FIB tables
  */
@@ -15,6 +15,9 @@
 
 #include <vnet/fib/fib_walk.h>
 #include <vnet/fib/fib_node_list.h>
+#include <vnet/fib/fib_entry.h>
+#include <vnet/fib/fib_table.h>
+#include <vlibmemory/api.h>
 
 vlib_log_class_t fib_walk_logger;
 
@@ -97,6 +100,39 @@ typedef struct fib_walk_t_
  */
 static fib_walk_t *fib_walk_pool;
 
+/**
+ * @brief A sync walk deferred until the end of a batch
+ */
+typedef struct fib_walk_deferred_t_
+{
+    /**
+     * The parent whose children are walked
+     */
+    fib_node_ptr_t fwd_parent;
+
+    /**
+     * The reasons of all the requests merged into this walk
+     */
+    fib_node_bw_reason_flag_t fwd_reason;
+
+    /**
+     * The table, in a batch, of the parent entry
+     */
+    u32 fwd_fib_index;
+    fib_protocol_t fwd_proto;
+} fib_walk_deferred_t;
+
+/**
+ * @brief The number of tables in a batch; walks are deferred when non-zero
+ */
+static u32 fib_walk_n_batches;
+
+/**
+ * @brief The deferred walks and the DB of them keyed by parent
+ */
+static fib_walk_deferred_t *fib_walk_deferred;
+static uword *fib_walk_deferred_db;
+
 /**
  * Statistics maintained per-walk queue
  */
@@ -434,6 +470,19 @@ static f64 fib_walk_sleep_duration[] = {
  */
 static f64 quota = 1e-4;
 
+/**
+ * @brief The time quota for a walk when there are API messages waiting.
+ * The API is processed on the main thread, between the quanta of the
+ * walk process, so this bounds the latency the walks add to an API
+ * request during mass route churn.
+ */
+static f64 api_quota = 1e-5;
+
+/**
+ * The number of quanta cut short to service the API
+ */
+static u64 fib_walk_n_api_yields;
+
 /**
  * Histogram on the amount of work done (in msecs) in each walk
  */
@@ -454,12 +503,38 @@ static u64 fib_walk_work_nodes_visited[N_ELTS_BUCKETS];
 static u64 fib_walk_sleep_lengths[2];
 
 /**
- * @brief Service the queues
- * This is not declared static so that it can be unit tested - i know i know...
+ * @brief Are there API messages waiting for the main thread
  */
-f64
-fib_walk_process_queues (vlib_main_t * vm,
-			 const f64 quota)
+typedef int (*fib_walk_api_pending_t)(void);
+
+/**
+ * @brief Has the walk used its quota.
+ * When yielding to the API, a quantum ends early if messages are waiting.
+ */
+static inline int
+fib_walk_quota_exceeded (f64 consumed_time,
+                         f64 quota,
+                         f64 yield_quota,
+                         fib_walk_api_pending_t api_pending)
+{
+    if (consumed_time >= quota)
+        return (1);
+
+    if (NULL != api_pending &&
+        consumed_time >= yield_quota &&
+        api_pending())
+    {
+        fib_walk_n_api_yields++;
+        return (1);
+    }
+    return (0);
+}
+
+static f64
+fib_walk_process_queues_i (vlib_main_t * vm,
+                           const f64 quota,
+                           const f64 yield_quota,
+                           fib_walk_api_pending_t api_pending)
 {
     f64 start_time, consumed_time;
     fib_walk_sleep_type_t sleep;
@@ -491,7 +566,8 @@ fib_walk_process_queues (vlib_main_t * vm,
 		rc = fib_walk_advance(fwi);
 		n_elts++;
 		consumed_time = (vlib_time_now(vm) - start_time);
-	    } while ((consumed_time < quota) &&
+	    } while (!fib_walk_quota_exceeded(consumed_time, quota,
+                                              yield_quota, api_pending) &&
 		     (FIB_WALK_ADVANCE_MORE == rc));
 
 	    /*
@@ -543,6 +619,31 @@ that_will_do_for_now:
     return (fib_walk_sleep_duration[sleep]);
 }
 
+/**
+ * @brief Service the queues
+ * This is not declared static so that it can be unit tested - i know i know...
+ */
+f64
+fib_walk_process_queues (vlib_main_t * vm,
+			 const f64 quota)
+{
+    return (fib_walk_process_queues_i(vm, quota, quota, NULL));
+}
+
+/**
+ * @brief Service the queues, yielding after yield_quota when api_pending
+ * says there are API messages waiting.
+ * Also not static so that it can be unit tested.
+ */
+f64
+fib_walk_process_queues_yield (vlib_main_t * vm,
+                               const f64 quota,
+                               const f64 yield_quota,
+                               int (*api_pending)(void))
+{
+    return (fib_walk_process_queues_i(vm, quota, yield_quota, api_pending));
+}
+
 /**
  * Events sent to the FIB walk process
  */
@@ -600,7 +701,8 @@ fib_walk_process (vlib_main_t * vm,
 
         if (enabled)
         {
-            sleep_time = fib_walk_process_queues(vm, quota);
+            sleep_time = fib_walk_process_queues_i(vm, quota, api_quota,
+                                                   vl_mem_api_queue_nonempty);
         }
     }
 
@@ -734,6 +836,138 @@ fib_walk_async (fib_node_type_t parent_type,
                  format_fib_node_bw_reason, ctx->fnbw_reason);
 }
 
+/**
+ * @brief Record a top-level sync walk from an entry of a table in a batch.
+ * Returns non-zero if the walk was deferred.
+ */
+static int
+fib_walk_defer (fib_node_type_t parent_type,
+                fib_node_index_t parent_index,
+                const fib_node_back_walk_ctx_t *ctx)
+{
+    fib_walk_deferred_t *fwd;
+    fib_protocol_t proto;
+    fib_node_t *parent;
+    u32 fib_index;
+    uword *p;
+    u64 key;
+
+    if (0 == fib_walk_n_batches ||
+        FIB_NODE_TYPE_ENTRY != parent_type ||
+        (ctx->fnbw_flags & FIB_NODE_BW_FLAG_FORCE_SYNC))
+    {
+        return (0);
+    }
+
+    /*
+     * only walks from the entries of the tables in a batch are deferred,
+     * those of other tables are not held up by the batch
+     */
+    fib_index = fib_entry_get_fib_index(parent_index);
+    proto = fib_entry_get_prefix(parent_index)->fp_proto;
+
+    if (0 == fib_table_get(fib_index, proto)->ft_batch_depth)
+    {
+        return (0);
+    }
+
+    key = ((u64)parent_type << 32) | parent_index;
+    p = hash_get(fib_walk_deferred_db, key);
+
+    if (NULL != p)
+    {
+        fwd = vec_elt_at_index(fib_walk_deferred, p[0]);
+        fwd->fwd_reason |= ctx->fnbw_reason;
+        return (1);
+    }
+
+    parent = fib_node_get(parent_index, parent_type);
+
+    if (0 == parent->fn_locks)
+    {
+        /*
+         * the parent is on its way out; it cannot be held until the
+         * end of the batch, so walk now.
+         */
+        return (0);
+    }
+
+    /*
+     * hold the parent so it survives until the deferred walk
+     */
+    fib_node_lock(parent);
+
+    hash_set(fib_walk_deferred_db, key, vec_len(fib_walk_deferred));
+    vec_add2(fib_walk_deferred, fwd, 1);
+    fwd->fwd_parent.fnp_type = parent_type;
+    fwd->fwd_parent.fnp_index = parent_index;
+    fwd->fwd_reason = ctx->fnbw_reason;
+    fwd->fwd_fib_index = fib_index;
+    fwd->fwd_proto = proto;
+
+    return (1);
+}
+
+void
+fib_walk_defer_begin (void)
+{
+    fib_walk_n_batches++;
+}
+
+u32
+fib_walk_defer_end (u32 fib_index,
+                    fib_protocol_t proto)
+{
+    fib_walk_deferred_t *fwds = NULL, *fwd, *keep = NULL;
+    u32 n_walks;
+
+    ASSERT(fib_walk_n_batches);
+    fib_walk_n_batches--;
+
+    /*
+     * take the table's deferred walks, and keep those of the tables
+     * still in a batch. The table's batch is closed, so the walks run
+     * now can spawn their own, which run immediately.
+     */
+    hash_free(fib_walk_deferred_db);
+
+    vec_foreach(fwd, fib_walk_deferred)
+    {
+        if (fwd->fwd_fib_index == fib_index &&
+            fwd->fwd_proto == proto)
+        {
+            vec_add1(fwds, *fwd);
+        }
+        else
+        {
+            hash_set(fib_walk_deferred_db,
+                     ((u64)fwd->fwd_parent.fnp_type << 32) |
+                     fwd->fwd_parent.fnp_index,
+                     vec_len(keep));
+            vec_add1(keep, *fwd);
+        }
+    }
+    vec_free(fib_walk_deferred);
+    fib_walk_deferred = keep;
+    n_walks = vec_len(fwds);
+
+    vec_foreach(fwd, fwds)
+    {
+        fib_node_back_walk_ctx_t ctx = {
+            .fnbw_reason = fwd->fwd_reason,
+        };
+
+        fib_walk_sync(fwd->fwd_parent.fnp_type,
+                      fwd->fwd_parent.fnp_index,
+                      &ctx);
+        fib_node_unlock(fib_node_get(fwd->fwd_parent.fnp_index,
+                                     fwd->fwd_parent.fnp_type));
+    }
+    vec_free(fwds);
+
+    return (n_walks);
+}
+
 /**
  * @brief Back walk all the children of a FIB node.
  *
@@ -767,6 +1001,12 @@ fib_walk_sync (fib_node_type_t parent_type,
         return;
     }
 
+    if (1 == ctx->fnbw_depth &&
+        fib_walk_defer(parent_type, parent_index, ctx))
+    {
+        return;
+    }
+
     fwalk = fib_walk_alloc(parent_type,
 			   parent_index,
 			   FIB_WALK_FLAG_SYNC,
@@ -998,6 +1238,10 @@ fib_walk_show (vlib_main_t * vm,
 
 #define USEC 1000000
     vlib_cli_output(vm, "FIB Walk Quota = %.2fusec:", quota * USEC);
+    vlib_cli_output(vm, "FIB Walk Quota with API pending = %.2fusec:",
+                    api_quota * USEC);
+    vlib_cli_output(vm, " Quanta cut short for the API: %lld",
+                    fib_walk_n_api_yields);
     vlib_cli_output(vm, "FIB Walk queues:");
 
     FOR_EACH_FIB_WALK_PRIORITY(prio)
@@ -1134,7 +1378,11 @@ fib_walk_set_quota (vlib_main_t * vm,
     clib_error_t * error = NULL;
     f64 new_quota;
 
-    if (unformat (input, "%f", &new_quota))
+    if (unformat (input, "api %f", &new_quota))
+    {
+	api_quota = new_quota;
+    }
+    else if (unformat (input, "%f", &new_quota))
     {
 	quota = new_quota;
     }
@@ -1148,7 +1396,7 @@ fib_walk_set_quota (vlib_main_t * vm,
 
 VLIB_CLI_COMMAND (fib_walk_set_quota_command, static) = {
     .path = "set fib walk quota",
-    .short_help = "set fib walk quota",
+    .short_help = "set fib walk quota [api] <secs>",
     .function = fib_walk_set_quota,
 };
 
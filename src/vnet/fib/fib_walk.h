@@ -52,6 +52,19 @@ extern void fib_walk_sync(fib_node_type_t parent_type,
                           fib_node_index_t parent_index,
                           fib_node_back_walk_ctx_t *ctx);
 
+/**
+ * @brief Defer top-level synchronous walks from the entries of a table.
+ * Whilst a table is in a batch (see fib_table_batch_begin), each of its
+ * entries' sync walk requests are recorded (their reasons merged) and the
+ * entry locked; when the table's batch ends each entry is walked once.
+ * This is used to program a batch of routes without re-walking the same
+ * children for every route in the batch.
+ * Begin is called when a table's batch opens, end when it closes.
+ */
+extern void fib_walk_defer_begin(void);
+extern u32 fib_walk_defer_end(u32 fib_index,
+                              fib_protocol_t proto);
+
 extern u8* format_fib_walk_priority(u8 *s, va_list *ap);
 
 extern void fib_walk_process_enable(void);
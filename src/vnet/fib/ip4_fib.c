@@ -133,6 +133,9 @@ ip4_create_fib_with_table_id (u32 table_id,
     fib_table_lock(fib_table->ft_index, FIB_PROTOCOL_IP4, src);
 
     ip4_mtrie_init(&v4_fib->mtrie);
+    v4_fib->batch_depth = 0;
+    v4_fib->batch_updates = NULL;
+    v4_fib->batch_update_by_prefix = NULL;
 
     /*
      * add the special entries into the new FIB
@@ -192,6 +195,9 @@ ip4_fib_table_destroy (u32 fib_index)
 	hash_unset (ip4_main.fib_index_by_table_id, fib_table->ft_table_id);
     }
 
+    ASSERT(0 == v4_fib->batch_depth);
+    vec_free(v4_fib->batch_updates);
+    hash_free(v4_fib->batch_update_by_prefix);
     ip4_mtrie_free(&v4_fib->mtrie);
 
     pool_put(ip4_main.v4_fibs, v4_fib);
@@ -375,12 +381,101 @@ ip4_fib_table_entry_remove (ip4_fib_t *fib,
     fib->fib_entry_by_dst_address[len] = hash;
 }
 
+static int
+ip4_fib_batch_update_cmp (void *a1, void *a2)
+{
+    ip4_fib_batch_update_t *u1 = a1, *u2 = a2;
+
+    return ((int) u1->ifbu_len - (int) u2->ifbu_len);
+}
+
+/**
+ * @brief Apply the deferred updates to the mtrie.
+ * Shortest prefixes go first, so a covering prefix fills the plys
+ * once and the more specifics then overwrite only their own slots,
+ * rather than each covering update rewriting the more specifics.
+ */
+static u32
+ip4_fib_table_batch_flush (ip4_fib_t *fib)
+{
+    ip4_fib_batch_update_t *ifbu;
+    u32 n_updates;
+
+    n_updates = vec_len(fib->batch_updates);
+
+    if (0 == n_updates)
+    {
+        return (0);
+    }
+
+    vec_sort_with_function(fib->batch_updates, ip4_fib_batch_update_cmp);
+
+    vec_foreach(ifbu, fib->batch_updates)
+    {
+        ip4_fib_mtrie_route_add(&fib->mtrie,
+                                &ifbu->ifbu_addr,
+                                ifbu->ifbu_len,
+                                ifbu->ifbu_dpo.dpoi_index);
+        dpo_reset(&ifbu->ifbu_dpo);
+    }
+
+    vec_reset_length(fib->batch_updates);
+    hash_free(fib->batch_update_by_prefix);
+
+    return (n_updates);
+}
+
+void
+ip4_fib_table_batch_begin (ip4_fib_t *fib)
+{
+    fib->batch_depth++;
+}
+
+u32
+ip4_fib_table_batch_end (ip4_fib_t *fib)
+{
+    ASSERT(fib->batch_depth);
+
+    if (--fib->batch_depth)
+    {
+        return (0);
+    }
+
+    return (ip4_fib_table_batch_flush(fib));
+}
+
 void
 ip4_fib_table_fwding_dpo_update (ip4_fib_t *fib,
 				 const ip4_address_t *addr,
 				 u32 len,
 				 const dpo_id_t *dpo)
 {
+    if (fib->batch_depth)
+    {
+        ip4_fib_batch_update_t *ifbu;
+        uword *p;
+        u64 key;
+
+        key = ((u64)addr->as_u32 << 32) | len;
+        p = hash_get(fib->batch_update_by_prefix, key);
+
+        if (NULL != p)
+        {
+            ifbu = vec_elt_at_index(fib->batch_updates, p[0]);
+        }
+        else
+        {
+            hash_set(fib->batch_update_by_prefix, key,
+                     vec_len(fib->batch_updates));
+            vec_add2(fib->batch_updates, ifbu, 1);
+            ifbu->ifbu_addr = *addr;
+            ifbu->ifbu_len = len;
+            ifbu->ifbu_dpo = (dpo_id_t) DPO_INVALID;
+        }
+        dpo_copy(&ifbu->ifbu_dpo, dpo);
+        return;
+    }
+
     ip4_fib_mtrie_route_add(&fib->mtrie, addr, len, dpo->dpoi_index);
 }
 
@@ -394,6 +489,12 @@ ip4_fib_table_fwding_dpo_remove (ip4_fib_t *fib,
     const fib_prefix_t *cover_prefix;
     const dpo_id_t *cover_dpo;
 
+    /*
+     * a removal relies on the mtrie holding the prefix's and its cover's
+     * current forwarding, so any deferred updates go in first.
+     */
+    ip4_fib_table_batch_flush(fib);
+
     /*
      * We need to pass the MTRIE the LB index and address length of the
      * covering prefix, so it can fill the plys with the correct replacement
@@ -698,6 +799,8 @@ ip4_show_fib (vlib_main_t * vm,
         }
 	if (! verbose)
 	{
+	    vlib_cli_output (vm, "%U", format_ip4_fib_mtrie_summary,
+			     &fib->mtrie);
 	    vlib_cli_output (vm, "%=20s%=16s", "Prefix length", "Count");
 	    for (i = 0; i < ARRAY_LEN (fib->fib_entry_by_dst_address); i++)
 	    {
@@ -36,6 +36,19 @@
 #include <vnet/fib/fib_table.h>
 #include <vnet/ip/ip4_mtrie.h>
 
+/**
+ * @brief An mtrie update deferred whilst the table is in a batch
+ */
+typedef struct ip4_fib_batch_update_t_
+{
+  /** The prefix being updated */
+  ip4_address_t ifbu_addr;
+  u32 ifbu_len;
+
+  /** The forwarding it is updated to, locked until applied */
+  dpo_id_t ifbu_dpo;
+} ip4_fib_batch_update_t;
+
 typedef struct ip4_fib_t_
 {
   /** Required for pool_get_aligned */
@@ -55,6 +68,18 @@ typedef struct ip4_fib_t_
 
   /* Index into FIB vector. */
   u32 index;
+
+  /**
+   * Batch nesting depth. Whilst non-zero mtrie updates are deferred
+   */
+  u32 batch_depth;
+
+  /**
+   * The deferred mtrie updates, and the DB of them by prefix, so only
+   * the last update of each prefix in the batch is applied
+   */
+  ip4_fib_batch_update_t *batch_updates;
+  uword *batch_update_by_prefix;
 } ip4_fib_t;
 
 extern fib_node_index_t ip4_fib_table_lookup(const ip4_fib_t *fib,
@@ -87,6 +112,15 @@ extern void ip4_fib_table_fwding_dpo_remove(ip4_fib_t *fib,
 extern u32 ip4_fib_table_lookup_lb (ip4_fib_t *fib,
 				    const ip4_address_t * dst);
 
+/**
+ * @brief Begin/end a batch of updates to the table's mtrie.
+ * Within a batch the mtrie is only updated for removals; additions and
+ * modifications are collected and applied, shortest prefix first, when
+ * the outer-most batch ends. Returns the number of mtrie updates applied.
+ */
+extern void ip4_fib_table_batch_begin(ip4_fib_t *fib);
+extern u32 ip4_fib_table_batch_end(ip4_fib_t *fib);
+
 /**
  * @brief Walk all entries in a FIB table
  * N.B: This is NOT safe to deletes. If you need to delete walk the whole
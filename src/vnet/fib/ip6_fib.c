@@ -164,6 +164,7 @@ ip6_fib_table_destroy (u32 fib_index)
     {
 	hash_unset (ip6_main.fib_index_by_table_id, fib_table->ft_table_id);
     }
+    ip6_fib_bsl_table_destroy(fib_table->ft_index);
     pool_put_index(ip6_main.v6_fibs, fib_table->ft_index);
     pool_put(ip6_main.fibs, fib_table);
 }
@@ -364,6 +365,8 @@ ip6_fib_table_fwding_dpo_update (u32 fib_index,
         clib_bitmap_set (table->non_empty_dst_address_length_bitmap, 
 			 128 - len, 1);
     compute_prefix_lengths_in_search_order (table);
+
+    ip6_fib_bsl_table_invalidate(fib_index);
 }
 
 void
@@ -397,6 +400,8 @@ ip6_fib_table_fwding_dpo_remove (u32 fib_index,
                              128 - len, 0);
 	compute_prefix_lengths_in_search_order (table);
     }
+
+    ip6_fib_bsl_table_invalidate(fib_index);
 }
 
 /**
@@ -694,7 +699,8 @@ ip6_show_fib (vlib_main_t * vm,
                            fib_table->ft_locks[source]);
             }
         }
-        s = format (s, "]");
+        s = format (s, "] lookup:%U",
+                    format_ip6_fib_fwding_algo, fib->fwding_algo);
         vlib_cli_output (vm, "%v", s);
         vec_free(s);
 
@@ -22,6 +22,7 @@
 #include <vnet/fib/fib_table.h>
 #include <vnet/ip/lookup.h>
 #include <vnet/dpo/load_balance.h>
+#include <vnet/fib/ip6_fib_bsl.h>
 
 extern fib_node_index_t ip6_fib_table_lookup(u32 fib_index,
 					     const ip6_address_t *addr,
@@ -63,9 +64,12 @@ extern void ip6_fib_table_walk(u32 fib_index,
                                fib_table_walk_fn_t fn,
                                void *ctx);
 
+/**
+ * @brief Forwarding lookup by a hash probe per prefix length
+ */
 always_inline u32
-ip6_fib_table_fwding_lookup (u32 fib_index,
-                             const ip6_address_t * dst)
+ip6_fib_table_fwding_lookup_hash (u32 fib_index,
+                                  const ip6_address_t * dst)
 {
     ip6_fib_table_instance_t *table;
     clib_bihash_kv_24_8_t kv, value;
@@ -101,6 +105,59 @@ ip6_fib_table_fwding_lookup (u32 fib_index,
     return 0;
 }
 
+/**
+ * @brief The table's binary search structure, if it is to be used
+ */
+always_inline ip6_fib_bsl_t *
+ip6_fib_table_get_bsl (u32 fib_index)
+{
+    return (clib_atomic_load_acq_n(&ip6_main.v6_fibs[fib_index].bsl));
+}
+
+always_inline u32
+ip6_fib_table_fwding_lookup (u32 fib_index,
+                             const ip6_address_t * dst)
+{
+    ip6_fib_bsl_t *bsl;
+
+    bsl = ip6_fib_table_get_bsl(fib_index);
+
+    if (NULL != bsl)
+        return (ip6_fib_bsl_lookup(bsl, dst));
+
+    return (ip6_fib_table_fwding_lookup_hash(fib_index, dst));
+}
+
+/**
+ * @brief Forwarding lookup of four destinations.
+ * If they are all in the same table and it uses binary search, the four
+ * lookups are interleaved.
+ */
+always_inline void
+ip6_fib_table_fwding_lookup_x4 (const u32 *fib_index,
+                                const ip6_address_t **dst,
+                                u32 *lbi)
+{
+    ip6_fib_bsl_t *bsl;
+
+    bsl = ip6_fib_table_get_bsl(fib_index[0]);
+
+    if (NULL != bsl &&
+        fib_index[0] == fib_index[1] &&
+        fib_index[0] == fib_index[2] &&
+        fib_index[0] == fib_index[3])
+    {
+        ip6_fib_bsl_lookup_x4(bsl, dst, lbi);
+    }
+    else
+    {
+        lbi[0] = ip6_fib_table_fwding_lookup(fib_index[0], dst[0]);
+        lbi[1] = ip6_fib_table_fwding_lookup(fib_index[1], dst[1]);
+        lbi[2] = ip6_fib_table_fwding_lookup(fib_index[2], dst[2]);
+        lbi[3] = ip6_fib_table_fwding_lookup(fib_index[3], dst[3]);
+    }
+}
+
 /**
  * @brief Walk all entries in a sub-tree of the FIB table
  * N.B: This is NOT safe to deletes. If you need to delete walk the whole
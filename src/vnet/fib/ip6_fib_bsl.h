@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2020 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @brief IPv6 forwarding lookup by binary search on prefix lengths.
+ *
+ * The default IPv6 forwarding lookup probes the hash once for each
+ * prefix length present (in all tables), longest first. With a full
+ * table that is some tens of probes per packet.
+ *
+ * Binary search on prefix lengths (Waldvogel et al.) probes only
+ * log2(#lengths) times. The distinct lengths in the table are sorted
+ * and binary searched: a hit at a length means the match, if any, is
+ * at that length or longer, a miss that it is shorter. For that to hold
+ * each prefix leaves a 'marker' at each shorter length at which the
+ * search must go longer to reach it. A search that follows a marker may
+ * then fail to find anything longer, so each marker also carries the
+ * best matching prefix of its own key, and the result of a lookup is the
+ * forwarding of the last entry hit.
+ *
+ * The structure is built per-table from the forwarding hash, which
+ * remains the master copy. Building it is not incremental; a change to
+ * a table's forwarding drops the table back to the hash lookup and the
+ * structure is rebuilt once the updates have settled.
+ */
+
+#ifndef __IP6_FIB_BSL_H__
+#define __IP6_FIB_BSL_H__
+
+#include <vnet/ip/ip.h>
+#include <vppinfra/bihash_24_8.h>
+
+/**
+ * The forwarding lookup algorithms an IPv6 table can use
+ */
+typedef enum ip6_fib_fwding_algo_t_
+{
+    IP6_FIB_FWDING_ALGO_HASH,
+    IP6_FIB_FWDING_ALGO_BSL,
+} ip6_fib_fwding_algo_t;
+
+#define IP6_FIB_FWDING_ALGOS {                         \
+    [IP6_FIB_FWDING_ALGO_HASH] = "hash",               \
+    [IP6_FIB_FWDING_ALGO_BSL] = "binary-search",       \
+}
+
+typedef struct ip6_fib_bsl_t_
+{
+    /**
+     * The prefixes and markers, keyed on the masked address and length.
+     * The value is the load-balance of the best matching prefix.
+     */
+    clib_bihash_24_8_t ifb_hash;
+
+    /**
+     * The distinct, non-zero, prefix lengths in the table; ascending
+     */
+    u8 *ifb_lengths;
+
+    /**
+     * The load-balance of the default route, the result when no
+     * probe hits
+     */
+    u32 ifb_default;
+
+    /**
+     * The table's index
+     */
+    u32 ifb_fib_index;
+
+    /**
+     * Build statistics
+     */
+    u32 ifb_n_prefixes;
+    u32 ifb_n_markers;
+    f64 ifb_build_time;
+} ip6_fib_bsl_t;
+
+always_inline void
+ip6_fib_bsl_mk_key (clib_bihash_kv_24_8_t *kv,
+                    const ip6_address_t *dst,
+                    u32 len)
+{
+    const ip6_address_t *mask;
+
+    mask = &ip6_main.fib_masks[len];
+
+    kv->key[0] = dst->as_u64[0] & mask->as_u64[0];
+    kv->key[1] = dst->as_u64[1] & mask->as_u64[1];
+    kv->key[2] = len;
+}
+
+/**
+ * @brief Lookup the load-balance for the destination address
+ */
+always_inline u32
+ip6_fib_bsl_lookup (ip6_fib_bsl_t *bsl,
+                    const ip6_address_t *dst)
+{
+    clib_bihash_kv_24_8_t kv, value;
+    int lo, hi, mid;
+    u32 lbi;
+
+    lbi = bsl->ifb_default;
+    lo = 0;
+    hi = vec_len(bsl->ifb_lengths) - 1;
+
+    while (lo <= hi)
+    {
+        mid = (lo + hi) >> 1;
+
+        ip6_fib_bsl_mk_key(&kv, dst, bsl->ifb_lengths[mid]);
+
+        if (0 == clib_bihash_search_inline_2_24_8(&bsl->ifb_hash, &kv, &value))
+        {
+            lbi = value.value;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    return (lbi);
+}
+
+/**
+ * @brief Lookup four destinations in lock-step.
+ * Each round computes the hash of the four probes and prefetches their
+ * buckets before any is searched, so the cache misses of the four
+ * overlap.
+ */
+always_inline void
+ip6_fib_bsl_lookup_x4 (ip6_fib_bsl_t *bsl,
+                       const ip6_address_t **dst,
+                       u32 *lbi)
+{
+    clib_bihash_kv_24_8_t kv[4], value;
+    int lo[4], hi[4], mid[4];
+    u64 hash[4];
+    u8 active;
+    int ii;
+
+    for (ii = 0; ii < 4; ii++)
+    {
+        lbi[ii] = bsl->ifb_default;
+        lo[ii] = 0;
+        hi[ii] = vec_len(bsl->ifb_lengths) - 1;
+    }
+
+    while (1)
+    {
+        active = 0;
+
+        for (ii = 0; ii < 4; ii++)
+        {
+            if (lo[ii] > hi[ii])
+                continue;
+
+            active |= (1 << ii);
+            mid[ii] = (lo[ii] + hi[ii]) >> 1;
+            ip6_fib_bsl_mk_key(&kv[ii], dst[ii],
+                               bsl->ifb_lengths[mid[ii]]);
+            hash[ii] = clib_bihash_hash_24_8(&kv[ii]);
+            clib_bihash_prefetch_bucket_24_8(&bsl->ifb_hash, hash[ii]);
+        }
+
+        if (!active)
+            break;
+
+        for (ii = 0; ii < 4; ii++)
+        {
+            if (!(active & (1 << ii)))
+                continue;
+
+            if (0 == clib_bihash_search_inline_2_with_hash_24_8(&bsl->ifb_hash,
+                                                                hash[ii],
+                                                                &kv[ii],
+                                                                &value))
+            {
+                lbi[ii] = value.value;
+                lo[ii] = mid[ii] + 1;
+            }
+            else
+            {
+                hi[ii] = mid[ii] - 1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Set the forwarding lookup algorithm of a table.
+ * Moving to binary search schedules the build of the table's structure;
+ * lookups use the hash until it is ready.
+ */
+extern void ip6_fib_table_set_fwding_algo(u32 fib_index,
+                                          ip6_fib_fwding_algo_t algo);
+
+/**
+ * @brief The table's forwarding has changed.
+ * Drop it back to the hash lookup and schedule the rebuild.
+ */
+extern void ip6_fib_bsl_table_invalidate(u32 fib_index);
+
+/**
+ * @brief The table is being destroyed
+ */
+extern void ip6_fib_bsl_table_destroy(u32 fib_index);
+
+/**
+ * @brief Build now, without suspending, all the structures that are
+ * scheduled to be built
+ */
+extern void ip6_fib_bsl_sync(void);
+
+extern u8 *format_ip6_fib_fwding_algo(u8 *s, va_list *args);
+extern u8 *format_ip6_fib_bsl(u8 *s, va_list *args);
+
+#endif
@@ -169,6 +169,12 @@ typedef struct ip4_main_t
   /** The memory heap for the mtries */
   void *mtrie_mheap;
 
+  /**
+   * The number of plies a table's mtrie can have before its root is
+   * expanded from 8 to 16 bits. 0 to create all mtries expanded.
+   */
+  u32 mtrie_expand_n_plies;
+
   /** ARP throttling */
   throttle_t arp_throttle;
 
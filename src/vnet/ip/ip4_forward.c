@@ -3353,19 +3353,23 @@ static clib_error_t *
 ip4_config (vlib_main_t * vm, unformat_input_t * input)
 {
   ip4_main_t *im = &ip4_main;
+  u32 expand_n_plies = IP4_FIB_MTRIE_DEFAULT_EXPAND_N_PLIES;
   uword heapsize = 0;
 
   while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
       if (unformat (input, "heap-size %U", unformat_memory_size, &heapsize))
 	;
+      else if (unformat (input, "mtrie-expand-plies %d", &expand_n_plies))
+	;
       else
 	return clib_error_return (0,
-				  "invalid heap-size parameter `%U'",
+				  "invalid ip parameter `%U'",
 				  format_unformat_error, input);
     }
 
   im->mtrie_heap_size = heapsize;
+  im->mtrie_expand_n_plies = expand_n_plies;
 
   return 0;
 }
@@ -62,20 +62,46 @@ ip4_lookup_inline (vlib_main_t * vm,
   vlib_buffer_t *bufs[VLIB_FRAME_SIZE];
   vlib_buffer_t **b = bufs;
   u16 nexts[VLIB_FRAME_SIZE], *next;
+  const ip4_fib_mtrie_t *mtries[VLIB_FRAME_SIZE];
+  ip4_address_t dst_addrs[VLIB_FRAME_SIZE];
+  ip4_fib_mtrie_leaf_t leaves[VLIB_FRAME_SIZE], *leaf;
+  u32 i;
 
   from = vlib_frame_vector_args (frame);
   n_left = frame->n_vectors;
   next = nexts;
+  leaf = leaves;
   vlib_get_buffers (vm, from, bufs, n_left);
 
+  /*
+   * Collect the table and destination of each packet, then do the mtrie
+   * lookups for the whole frame stage by stage so that the cache misses
+   * on the plies of different packets overlap.
+   */
+  for (i = 0; i < n_left; i++)
+    {
+      ip4_header_t *ip0;
+
+      if (i + 4 < n_left)
+	{
+	  vlib_prefetch_buffer_header (bufs[i + 4], LOAD);
+	  CLIB_PREFETCH (bufs[i + 4]->data, sizeof (ip0[0]), LOAD);
+	}
+
+      ip0 = vlib_buffer_get_current (bufs[i]);
+      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, bufs[i]);
+
+      mtries[i] = &ip4_fib_get (vnet_buffer (bufs[i])->ip.fib_index)->mtrie;
+      dst_addrs[i] = ip0->dst_address;
+    }
+
+  ip4_fib_mtrie_lookup_n (mtries, dst_addrs, leaves, n_left);
+
 #if (CLIB_N_PREFETCHES >= 8)
   while (n_left >= 4)
     {
       ip4_header_t *ip0, *ip1, *ip2, *ip3;
       const load_balance_t *lb0, *lb1, *lb2, *lb3;
-      ip4_fib_mtrie_t *mtrie0, *mtrie1, *mtrie2, *mtrie3;
-      ip4_fib_mtrie_leaf_t leaf0, leaf1, leaf2, leaf3;
-      ip4_address_t *dst_addr0, *dst_addr1, *dst_addr2, *dst_addr3;
       u32 lb_index0, lb_index1, lb_index2, lb_index3;
       flow_hash_config_t flow_hash_config0, flow_hash_config1;
       flow_hash_config_t flow_hash_config2, flow_hash_config3;
@@ -101,40 +127,10 @@ ip4_lookup_inline (vlib_main_t * vm,
       ip2 = vlib_buffer_get_current (b[2]);
       ip3 = vlib_buffer_get_current (b[3]);
 
-      dst_addr0 = &ip0->dst_address;
-      dst_addr1 = &ip1->dst_address;
-      dst_addr2 = &ip2->dst_address;
-      dst_addr3 = &ip3->dst_address;
-
-      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, b[0]);
-      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, b[1]);
-      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, b[2]);
-      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, b[3]);
-
-      mtrie0 = &ip4_fib_get (vnet_buffer (b[0])->ip.fib_index)->mtrie;
-      mtrie1 = &ip4_fib_get (vnet_buffer (b[1])->ip.fib_index)->mtrie;
-      mtrie2 = &ip4_fib_get (vnet_buffer (b[2])->ip.fib_index)->mtrie;
-      mtrie3 = &ip4_fib_get (vnet_buffer (b[3])->ip.fib_index)->mtrie;
-
-      leaf0 = ip4_fib_mtrie_lookup_step_one (mtrie0, dst_addr0);
-      leaf1 = ip4_fib_mtrie_lookup_step_one (mtrie1, dst_addr1);
-      leaf2 = ip4_fib_mtrie_lookup_step_one (mtrie2, dst_addr2);
-      leaf3 = ip4_fib_mtrie_lookup_step_one (mtrie3, dst_addr3);
-
-      leaf0 = ip4_fib_mtrie_lookup_step (mtrie0, leaf0, dst_addr0, 2);
-      leaf1 = ip4_fib_mtrie_lookup_step (mtrie1, leaf1, dst_addr1, 2);
-      leaf2 = ip4_fib_mtrie_lookup_step (mtrie2, leaf2, dst_addr2, 2);
-      leaf3 = ip4_fib_mtrie_lookup_step (mtrie3, leaf3, dst_addr3, 2);
-
-      leaf0 = ip4_fib_mtrie_lookup_step (mtrie0, leaf0, dst_addr0, 3);
-      leaf1 = ip4_fib_mtrie_lookup_step (mtrie1, leaf1, dst_addr1, 3);
-      leaf2 = ip4_fib_mtrie_lookup_step (mtrie2, leaf2, dst_addr2, 3);
-      leaf3 = ip4_fib_mtrie_lookup_step (mtrie3, leaf3, dst_addr3, 3);
-
-      lb_index0 = ip4_fib_mtrie_leaf_get_adj_index (leaf0);
-      lb_index1 = ip4_fib_mtrie_leaf_get_adj_index (leaf1);
-      lb_index2 = ip4_fib_mtrie_leaf_get_adj_index (leaf2);
-      lb_index3 = ip4_fib_mtrie_leaf_get_adj_index (leaf3);
+      lb_index0 = ip4_fib_mtrie_leaf_get_adj_index (leaf[0]);
+      lb_index1 = ip4_fib_mtrie_leaf_get_adj_index (leaf[1]);
+      lb_index2 = ip4_fib_mtrie_leaf_get_adj_index (leaf[2]);
+      lb_index3 = ip4_fib_mtrie_leaf_get_adj_index (leaf[3]);
 
       ASSERT (lb_index0 && lb_index1 && lb_index2 && lb_index3);
       lb0 = load_balance_get (lb_index0);
@@ -237,6 +233,7 @@ ip4_lookup_inline (vlib_main_t * vm,
 
       b += 4;
       next += 4;
+      leaf += 4;
       n_left -= 4;
     }
 #elif (CLIB_N_PREFETCHES >= 4)
@@ -244,9 +241,6 @@ ip4_lookup_inline (vlib_main_t * vm,
     {
       ip4_header_t *ip0, *ip1;
       const load_balance_t *lb0, *lb1;
-      ip4_fib_mtrie_t *mtrie0, *mtrie1;
-      ip4_fib_mtrie_leaf_t leaf0, leaf1;
-      ip4_address_t *dst_addr0, *dst_addr1;
       u32 lb_index0, lb_index1;
       flow_hash_config_t flow_hash_config0, flow_hash_config1;
       u32 hash_c0, hash_c1;
@@ -264,26 +258,8 @@ ip4_lookup_inline (vlib_main_t * vm,
       ip0 = vlib_buffer_get_current (b[0]);
       ip1 = vlib_buffer_get_current (b[1]);
 
-      dst_addr0 = &ip0->dst_address;
-      dst_addr1 = &ip1->dst_address;
-
-      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, b[0]);
-      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, b[1]);
-
-      mtrie0 = &ip4_fib_get (vnet_buffer (b[0])->ip.fib_index)->mtrie;
-      mtrie1 = &ip4_fib_get (vnet_buffer (b[1])->ip.fib_index)->mtrie;
-
-      leaf0 = ip4_fib_mtrie_lookup_step_one (mtrie0, dst_addr0);
-      leaf1 = ip4_fib_mtrie_lookup_step_one (mtrie1, dst_addr1);
-
-      leaf0 = ip4_fib_mtrie_lookup_step (mtrie0, leaf0, dst_addr0, 2);
-      leaf1 = ip4_fib_mtrie_lookup_step (mtrie1, leaf1, dst_addr1, 2);
-
-      leaf0 = ip4_fib_mtrie_lookup_step (mtrie0, leaf0, dst_addr0, 3);
-      leaf1 = ip4_fib_mtrie_lookup_step (mtrie1, leaf1, dst_addr1, 3);
-
-      lb_index0 = ip4_fib_mtrie_leaf_get_adj_index (leaf0);
-      lb_index1 = ip4_fib_mtrie_leaf_get_adj_index (leaf1);
+      lb_index0 = ip4_fib_mtrie_leaf_get_adj_index (leaf[0]);
+      lb_index1 = ip4_fib_mtrie_leaf_get_adj_index (leaf[1]);
 
       ASSERT (lb_index0 && lb_index1);
       lb0 = load_balance_get (lb_index0);
@@ -340,6 +316,7 @@ ip4_lookup_inline (vlib_main_t * vm,
 
       b += 2;
       next += 2;
+      leaf += 2;
       n_left -= 2;
     }
 #endif
@@ -347,23 +324,14 @@ ip4_lookup_inline (vlib_main_t * vm,
     {
       ip4_header_t *ip0;
       const load_balance_t *lb0;
-      ip4_fib_mtrie_t *mtrie0;
-      ip4_fib_mtrie_leaf_t leaf0;
-      ip4_address_t *dst_addr0;
       u32 lbi0;
       flow_hash_config_t flow_hash_config0;
       const dpo_id_t *dpo0;
       u32 hash_c0;
 
       ip0 = vlib_buffer_get_current (b[0]);
-      dst_addr0 = &ip0->dst_address;
-      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, b[0]);
 
-      mtrie0 = &ip4_fib_get (vnet_buffer (b[0])->ip.fib_index)->mtrie;
-      leaf0 = ip4_fib_mtrie_lookup_step_one (mtrie0, dst_addr0);
-      leaf0 = ip4_fib_mtrie_lookup_step (mtrie0, leaf0, dst_addr0, 2);
-      leaf0 = ip4_fib_mtrie_lookup_step (mtrie0, leaf0, dst_addr0, 3);
-      lbi0 = ip4_fib_mtrie_leaf_get_adj_index (leaf0);
+      lbi0 = ip4_fib_mtrie_leaf_get_adj_index (leaf[0]);
 
       ASSERT (lbi0);
       lb0 = load_balance_get (lbi0);
@@ -398,6 +366,7 @@ ip4_lookup_inline (vlib_main_t * vm,
 
       b += 1;
       next += 1;
+      leaf += 1;
       n_left -= 1;
     }
 
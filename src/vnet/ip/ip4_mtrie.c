@@ -184,9 +184,18 @@ ply_create (ip4_fib_mtrie_t * m,
   clib_mem_set_heap (old_heap);
 
   ply_8_init (p, init_leaf, leaf_prefix_len, ply_base_len);
+  m->n_plies++;
   return ip4_fib_mtrie_leaf_set_next_ply_index (p - ip4_ply_pool);
 }
 
+static void
+ply_free (ip4_fib_mtrie_t * m, ip4_fib_mtrie_8_ply_t * p)
+{
+  ASSERT (m->n_plies > 0);
+  m->n_plies--;
+  pool_put (ip4_ply_pool, p);
+}
+
 always_inline ip4_fib_mtrie_8_ply_t *
 get_next_ply_for_leaf (ip4_fib_mtrie_t * m, ip4_fib_mtrie_leaf_t l)
 {
@@ -198,23 +207,145 @@ get_next_ply_for_leaf (ip4_fib_mtrie_t * m, ip4_fib_mtrie_leaf_t l)
 void
 ip4_mtrie_free (ip4_fib_mtrie_t * m)
 {
-  /* the root ply is embedded so there is nothing to do,
-   * the assumption being that the IP4 FIB table has emptied the trie
-   * before deletion.
+  /* the assumption being that the IP4 FIB table has emptied the trie
+   * before deletion, so only the root remains
    */
-#if CLIB_DEBUG > 0
-  int i;
-  for (i = 0; i < ARRAY_LEN (m->root_ply.leaves); i++)
+  if (ip4_fib_mtrie_is_compressed (m))
     {
-      ASSERT (!ip4_fib_mtrie_leaf_is_next_ply (m->root_ply.leaves[i]));
+      ip4_fib_mtrie_8_ply_t *root;
+
+      root = pool_elt_at_index (ip4_ply_pool, m->root_ply_8_index);
+#if CLIB_DEBUG > 0
+      int i;
+      for (i = 0; i < ARRAY_LEN (root->leaves); i++)
+	{
+	  ASSERT (!ip4_fib_mtrie_leaf_is_next_ply (root->leaves[i]));
+	}
+#endif
+      ply_free (m, root);
+      m->root_ply_8_index = ~0;
     }
+  else
+    {
+      void *old_heap;
+
+#if CLIB_DEBUG > 0
+      int i;
+      for (i = 0; i < ARRAY_LEN (m->root_ply->leaves); i++)
+	{
+	  ASSERT (!ip4_fib_mtrie_leaf_is_next_ply (m->root_ply->leaves[i]));
+	}
 #endif
+      old_heap = clib_mem_set_heap (ip4_main.mtrie_mheap);
+      clib_mem_free (m->root_ply);
+      clib_mem_set_heap (old_heap);
+      m->root_ply = NULL;
+    }
+  ASSERT (0 == m->n_plies);
+}
+
+static ip4_fib_mtrie_16_ply_t *
+ply_16_create (void)
+{
+  ip4_fib_mtrie_16_ply_t *p;
+  void *old_heap;
+
+  old_heap = clib_mem_set_heap (ip4_main.mtrie_mheap);
+  p = clib_mem_alloc_aligned (sizeof (*p), CLIB_CACHE_LINE_BYTES);
+  clib_mem_set_heap (old_heap);
+
+  return (p);
 }
 
 void
 ip4_mtrie_init (ip4_fib_mtrie_t * m)
 {
-  ply_16_init (&m->root_ply, IP4_FIB_MTRIE_LEAF_EMPTY, 0);
+  m->n_plies = 0;
+
+  if (0 == ip4_main.mtrie_expand_n_plies)
+    {
+      /* compression is disabled */
+      m->root_ply = ply_16_create ();
+      m->root_ply_8_index = ~0;
+      ply_16_init (m->root_ply, IP4_FIB_MTRIE_LEAF_EMPTY, 0);
+    }
+  else
+    {
+      m->root_ply = NULL;
+      m->root_ply_8_index =
+	ip4_fib_mtrie_leaf_get_next_ply_index (ply_create
+					       (m, IP4_FIB_MTRIE_LEAF_EMPTY,
+						0, 0));
+    }
+}
+
+void
+ip4_fib_mtrie_expand (ip4_fib_mtrie_t * m)
+{
+  ip4_fib_mtrie_8_ply_t *root, *ply;
+  ip4_fib_mtrie_16_ply_t *root_16;
+  ip4_fib_mtrie_leaf_t leaf;
+  ip4_address_t a;
+  u32 b0, b1;
+  u16 slot;
+
+  if (!ip4_fib_mtrie_is_compressed (m))
+    return;
+
+  root_16 = ply_16_create ();
+  root = pool_elt_at_index (ip4_ply_pool, m->root_ply_8_index);
+
+  /*
+   * Each slot of the 16 bit root gets what the lookup of its 2 bytes
+   * through the 8 bit root and the ply below it finds. The plies for
+   * bytes 2 and 3 are unchanged and are shared.
+   */
+  a.as_u32 = 0;
+  for (b0 = 0; b0 < ARRAY_LEN (root->leaves); b0++)
+    {
+      a.as_u8[0] = b0;
+      leaf = root->leaves[b0];
+
+      if (ip4_fib_mtrie_leaf_is_terminal (leaf))
+	{
+	  for (b1 = 0; b1 < 256; b1++)
+	    {
+	      a.as_u8[1] = b1;
+	      slot = a.as_u16[0];
+	      root_16->leaves[slot] = leaf;
+	      root_16->dst_address_bits_of_leaves[slot] =
+		root->dst_address_bits_of_leaves[b0];
+	    }
+	}
+      else
+	{
+	  ply = get_next_ply_for_leaf (m, leaf);
+
+	  for (b1 = 0; b1 < 256; b1++)
+	    {
+	      a.as_u8[1] = b1;
+	      slot = a.as_u16[0];
+	      root_16->leaves[slot] = ply->leaves[b1];
+	      root_16->dst_address_bits_of_leaves[slot] =
+		ply->dst_address_bits_of_leaves[b1];
+	    }
+	}
+    }
+
+  /*
+   * switch lookups to the new root, only then are the old plies unused
+   */
+  clib_atomic_store_rel_n (&m->root_ply, root_16);
+
+  for (b0 = 0; b0 < ARRAY_LEN (root->leaves); b0++)
+    {
+      leaf = root->leaves[b0];
+
+      if (!ip4_fib_mtrie_leaf_is_terminal (leaf))
+	ply_free (m, get_next_ply_for_leaf (m, leaf));
+    }
+  ply_free (m, root);
+  m->root_ply_8_index = ~0;
 }
 
 typedef struct
@@ -398,7 +529,7 @@ set_root_leaf (ip4_fib_mtrie_t * m,
   i32 n_dst_bits_next_plies;
   u16 dst_byte;
 
-  old_ply = &m->root_ply;
+  old_ply = m->root_ply;
 
   ASSERT (a->dst_address_length <= 32);
 
@@ -551,7 +682,7 @@ unset_leaf (ip4_fib_mtrie_t * m,
 	  ASSERT (old_ply->n_non_empty_leafs >= 0);
 	  if (old_ply->n_non_empty_leafs == 0 && dst_address_byte_index > 0)
 	    {
-	      pool_put (ip4_ply_pool, old_ply);
+	      ply_free (m, old_ply);
 	      /* Old ply was deleted. */
 	      return 1;
 	    }
@@ -585,7 +716,7 @@ unset_root_leaf (ip4_fib_mtrie_t * m,
 
   ASSERT (a->dst_address_length <= 32);
 
-  old_ply = &m->root_ply;
+  old_ply = m->root_ply;
   n_dst_bits_next_plies = a->dst_address_length - BITS (u16);
 
   dst_byte = a->dst_address.as_u16[0];
@@ -634,7 +765,15 @@ ip4_fib_mtrie_route_add (ip4_fib_mtrie_t * m,
   a.dst_address_length = dst_address_length;
   a.adj_index = adj_index;
 
-  set_root_leaf (m, &a);
+  if (ip4_fib_mtrie_is_compressed (m))
+    {
+      set_leaf (m, &a, m->root_ply_8_index, 0);
+
+      if (m->n_plies > ip4_main.mtrie_expand_n_plies)
+	ip4_fib_mtrie_expand (m);
+    }
+  else
+    set_root_leaf (m, &a);
 }
 
 void
@@ -656,41 +795,36 @@ ip4_fib_mtrie_route_del (ip4_fib_mtrie_t * m,
   a.cover_address_length = cover_address_length;
 
   /* the top level ply is never removed */
-  unset_root_leaf (m, &a);
+  if (ip4_fib_mtrie_is_compressed (m))
+    unset_leaf (m, &a, pool_elt_at_index (ip4_ply_pool,
+					  m->root_ply_8_index), 0);
+  else
+    unset_root_leaf (m, &a);
 }
 
 /* Returns number of bytes of memory used by mtrie. */
-static uword
-mtrie_ply_memory_usage (ip4_fib_mtrie_t * m, ip4_fib_mtrie_8_ply_t * p)
+uword
+ip4_fib_mtrie_memory_usage (ip4_fib_mtrie_t * m)
 {
-  uword bytes, i;
+  uword bytes;
 
-  bytes = sizeof (p[0]);
-  for (i = 0; i < ARRAY_LEN (p->leaves); i++)
-    {
-      ip4_fib_mtrie_leaf_t l = p->leaves[i];
-      if (ip4_fib_mtrie_leaf_is_next_ply (l))
-	bytes += mtrie_ply_memory_usage (m, get_next_ply_for_leaf (m, l));
-    }
+  bytes = sizeof (*m) + m->n_plies * sizeof (ip4_fib_mtrie_8_ply_t);
+  if (!ip4_fib_mtrie_is_compressed (m))
+    bytes += sizeof (*m->root_ply);
 
   return bytes;
 }
 
-/* Returns number of bytes of memory used by mtrie. */
-uword
-ip4_fib_mtrie_memory_usage (ip4_fib_mtrie_t * m)
+u8 *
+format_ip4_fib_mtrie_summary (u8 * s, va_list * va)
 {
-  uword bytes, i;
+  ip4_fib_mtrie_t *m = va_arg (*va, ip4_fib_mtrie_t *);
 
-  bytes = sizeof (*m);
-  for (i = 0; i < ARRAY_LEN (m->root_ply.leaves); i++)
-    {
-      ip4_fib_mtrie_leaf_t l = m->root_ply.leaves[i];
-      if (ip4_fib_mtrie_leaf_is_next_ply (l))
-	bytes += mtrie_ply_memory_usage (m, get_next_ply_for_leaf (m, l));
-    }
+  s = format (s, "mtrie: %s root, %d plies, memory usage %U",
+	      (ip4_fib_mtrie_is_compressed (m) ? "compressed" : "16 bit"),
+	      m->n_plies, format_memory_size, ip4_fib_mtrie_memory_usage (m));
 
-  return bytes;
+  return s;
 }
 
 static u8 *
@@ -761,16 +895,25 @@ format_ip4_fib_mtrie (u8 * s, va_list * va)
   u32 base_address = 0;
   int i;
 
-  s = format (s, "%d plies, memory usage %U\n",
-	      pool_elts (ip4_ply_pool),
-	      format_memory_size, ip4_fib_mtrie_memory_usage (m));
+  s = format (s, "%U, %d plies in all tables\n",
+	      format_ip4_fib_mtrie_summary, m, pool_elts (ip4_ply_pool));
+
+  if (ip4_fib_mtrie_is_compressed (m))
+    {
+      s = format (s, "root-ply");
+      if (verbose)
+	s = format (s, "\n%U", format_ip4_fib_mtrie_ply, m, base_address, 0,
+		    m->root_ply_8_index);
+      return s;
+    }
+
   s = format (s, "root-ply");
-  p = &m->root_ply;
+  p = m->root_ply;
 
   if (verbose)
     {
       s = format (s, "root-ply");
-      p = &m->root_ply;
+      p = m->root_ply;
 
       for (i = 0; i < ARRAY_LEN (p->leaves); i++)
 	{
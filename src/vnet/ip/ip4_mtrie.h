@@ -124,18 +124,45 @@ STATIC_ASSERT (0 == sizeof (ip4_fib_mtrie_8_ply_t) % CLIB_CACHE_LINE_BYTES,
 
 /**
  * @brief The mutiway-TRIE.
- * There is no data associated with the mtrie apart from the top PLY
+ *
+ * A 16 bit root ply is 320K of memory whether the table has any routes
+ * or not, which adds up with many small tables. So an mtrie starts
+ * compressed; its root is an 8 bit ply from the pool and lookups are
+ * 8-8-8-8. Once it has more than a configurable number of plies the
+ * root is expanded to 16 bits, and lookups are 16-8-8. An mtrie is
+ * never compressed again.
  */
 typedef struct
 {
   /**
-   * Embed the PLY with the mtrie struct. This means that the Data-plane
-   * 'get me the mtrie' returns the first ply, and not an indirect 'pointer'
-   * to it. therefore no cacheline misses in the data-path.
+   * The 16 bit root ply once the mtrie is expanded, NULL whilst it is
+   * compressed.
+   */
+  ip4_fib_mtrie_16_ply_t *root_ply;
+
+  /**
+   * Whilst compressed, the index of the 8 bit root ply in the pool
+   */
+  u32 root_ply_8_index;
+
+  /**
+   * The number of 8 bit plies the mtrie uses, including a compressed root
    */
-  ip4_fib_mtrie_16_ply_t root_ply;
+  u32 n_plies;
 } ip4_fib_mtrie_t;
 
+/**
+ * The default number of plies a compressed mtrie can have before its root
+ * is expanded. About a quarter of the memory of the 16 bit root.
+ */
+#define IP4_FIB_MTRIE_DEFAULT_EXPAND_N_PLIES 64
+
+always_inline int
+ip4_fib_mtrie_is_compressed (const ip4_fib_mtrie_t * m)
+{
+  return (NULL == m->root_ply);
+}
+
 /**
  * @brief Initialise an mtrie
  */
@@ -166,6 +193,16 @@ void ip4_fib_mtrie_route_del (ip4_fib_mtrie_t * m,
  */
 uword ip4_fib_mtrie_memory_usage (ip4_fib_mtrie_t * m);
 
+/**
+ * @brief Expand the root of a compressed mtrie to 16 bits
+ */
+void ip4_fib_mtrie_expand (ip4_fib_mtrie_t * m);
+
+/**
+ * @brief Format the mtrie's root mode, plies and memory
+ */
+format_function_t format_ip4_fib_mtrie_summary;
+
 /**
  * @brief Format/display the contents of the mtrie
  */
@@ -226,9 +263,215 @@ ip4_fib_mtrie_lookup_step_one (const ip4_fib_mtrie_t * m,
 {
   ip4_fib_mtrie_leaf_t next_leaf;
 
-  next_leaf = m->root_ply.leaves[dst_address->as_u16[0]];
+  if (PREDICT_TRUE (!ip4_fib_mtrie_is_compressed (m)))
+    return (m->root_ply->leaves[dst_address->as_u16[0]]);
+
+  /* a compressed root takes the 2 bytes one at a time */
+  next_leaf = ip4_ply_pool[m->root_ply_8_index].leaves[dst_address->as_u8[0]];
+
+  return (ip4_fib_mtrie_lookup_step (m, next_leaf, dst_address, 1));
+}
+
+/**
+ * The distance, in packets, at which the staged lookup prefetches the
+ * slot a packet will read in the current stage
+ */
+#define IP4_FIB_MTRIE_STAGE_PREFETCH_STRIDE 8
+
+/**
+ * The ply slots are gathered as u32s; ply index and slot are combined
+ * into one u32 index from the start of the pool
+ */
+#define IP4_FIB_MTRIE_PLY_N_U32 \
+  (sizeof (ip4_fib_mtrie_8_ply_t) / sizeof (ip4_fib_mtrie_leaf_t))
+
+STATIC_ASSERT ((sizeof (ip4_fib_mtrie_8_ply_t) %
+		sizeof (ip4_fib_mtrie_leaf_t)) == 0,
+	       "8 bit ply must be a whole number of leaves");
+
+always_inline void
+ip4_fib_mtrie_prefetch_step (ip4_fib_mtrie_leaf_t leaf,
+			     const ip4_address_t * dst_address,
+			     u32 dst_address_byte_index)
+{
+  if (!ip4_fib_mtrie_leaf_is_terminal (leaf))
+    CLIB_PREFETCH (&ip4_ply_pool[leaf >> 1].leaves
+		   [dst_address->as_u8[dst_address_byte_index]],
+		   sizeof (leaf), LOAD);
+}
+
+always_inline void
+ip4_fib_mtrie_prefetch_step_one (const ip4_fib_mtrie_t * m,
+				 const ip4_address_t * dst_address)
+{
+  if (PREDICT_TRUE (!ip4_fib_mtrie_is_compressed (m)))
+    CLIB_PREFETCH ((void *) &m->root_ply->leaves[dst_address->as_u16[0]],
+		   sizeof (ip4_fib_mtrie_leaf_t), LOAD);
+}
+
+/**
+ * @brief Staged lookup, the root ply for all packets.
+ */
+always_inline void
+ip4_fib_mtrie_lookup_stage_one (const ip4_fib_mtrie_t ** m,
+				const ip4_address_t * dst_addresses,
+				ip4_fib_mtrie_leaf_t * leaves, u32 n_left)
+{
+  const u32 stride = IP4_FIB_MTRIE_STAGE_PREFETCH_STRIDE;
+  u32 i = 0, j;
+
+#if defined (CLIB_HAVE_VEC512)
+  /* runs of packets in the same table gather their root slots at once */
+  while (i + 16 <= n_left)
+    {
+      u32x16 dst = u32x16_load_unaligned ((void *) (dst_addresses + i));
+
+      if (ip4_fib_mtrie_is_compressed (m[i]) ||
+	  !u64x8_is_all_equal (u64x8_load_unaligned ((void *) (m + i)),
+			       pointer_to_uword (m[i])) ||
+	  !u64x8_is_all_equal (u64x8_load_unaligned ((void *) (m + i + 8)),
+			       pointer_to_uword (m[i])))
+	break;
+
+      u32x16_store_unaligned (u32x16_mask_gather_u32 (dst, 0xffff,
+						      (void *) m[i]->
+						      root_ply->leaves,
+						      dst &
+						      u32x16_splat (0xffff)),
+			      leaves + i);
+      i += 16;
+    }
+#elif defined (CLIB_HAVE_VEC256)
+  while (i + 8 <= n_left)
+    {
+      u32x8 dst = u32x8_load_unaligned ((void *) (dst_addresses + i));
+
+      if (ip4_fib_mtrie_is_compressed (m[i]) ||
+	  !u64x4_is_all_equal (u64x4_load_unaligned ((void *) (m + i)),
+			       pointer_to_uword (m[i])) ||
+	  !u64x4_is_all_equal (u64x4_load_unaligned ((void *) (m + i + 4)),
+			       pointer_to_uword (m[i])))
+	break;
+
+      u32x8_store_unaligned (u32x8_mask_gather_u32 (dst, u32x8_splat (~0),
+						    (void *) m[i]->
+						    root_ply->leaves,
+						    dst &
+						    u32x8_splat (0xffff)),
+			     leaves + i);
+      i += 8;
+    }
+#endif
+
+  for (j = i; j < clib_min (n_left, i + stride); j++)
+    ip4_fib_mtrie_prefetch_step_one (m[j], &dst_addresses[j]);
+
+  for (; i < n_left; i++)
+    {
+      if (i + stride < n_left)
+	ip4_fib_mtrie_prefetch_step_one (m[i + stride],
+					 &dst_addresses[i + stride]);
+
+      leaves[i] = ip4_fib_mtrie_lookup_step_one (m[i], &dst_addresses[i]);
+    }
+}
+
+/**
+ * @brief Staged lookup, one 8 bit ply for all packets.
+ * Returns the number of packets whose leaf is still non-terminal.
+ */
+always_inline u32
+ip4_fib_mtrie_lookup_stage (const ip4_address_t * dst_addresses,
+			    ip4_fib_mtrie_leaf_t * leaves, u32 n_left,
+			    u32 dst_address_byte_index)
+{
+  const u32 stride = IP4_FIB_MTRIE_STAGE_PREFETCH_STRIDE;
+  u32 i = 0, j, n_non_terminal = 0;
+
+  /* the u32 gather index from the start of the pool must not wrap */
+  ASSERT (pool_len (ip4_ply_pool) < (1ULL << 31) / IP4_FIB_MTRIE_PLY_N_U32);
+
+#if defined (CLIB_HAVE_VEC512)
+  while (i + 16 <= n_left)
+    {
+      u32x16 dst = u32x16_load_unaligned ((void *) (dst_addresses + i));
+      u32x16 leaf = u32x16_load_unaligned (leaves + i);
+      u32x16 index;
+      u16 mask;
+
+      mask = ~u32x16_is_zero_mask (leaf & u32x16_splat (1));
+      index = ((leaf >> 1) * u32x16_splat (IP4_FIB_MTRIE_PLY_N_U32) +
+	       ((dst >> (8 * dst_address_byte_index)) & u32x16_splat (0xff)));
+      leaf = u32x16_mask_gather_u32 (leaf, mask, ip4_ply_pool, index);
+
+      u32x16_store_unaligned (leaf, leaves + i);
+      n_non_terminal +=
+	count_set_bits (~u32x16_is_zero_mask (leaf & u32x16_splat (1)) &
+			0xffff);
+      i += 16;
+    }
+#elif defined (CLIB_HAVE_VEC256)
+  while (i + 8 <= n_left)
+    {
+      u32x8 dst = u32x8_load_unaligned ((void *) (dst_addresses + i));
+      u32x8 leaf = u32x8_load_unaligned (leaves + i);
+      u32x8 index, mask;
+
+      mask = (leaf & u32x8_splat (1)) == u32x8_splat (0);
+      index = ((leaf >> 1) * u32x8_splat (IP4_FIB_MTRIE_PLY_N_U32) +
+	       ((dst >> (8 * dst_address_byte_index)) & u32x8_splat (0xff)));
+      leaf = u32x8_mask_gather_u32 (leaf, mask, ip4_ply_pool, index);
+
+      u32x8_store_unaligned (leaf, leaves + i);
+      n_non_terminal += count_set_bits (u8x32_msb_mask
+					((u8x32) ((leaf & u32x8_splat (1)) ==
+						  u32x8_splat (0)))) / 4;
+      i += 8;
+    }
+#endif
+
+  for (j = i; j < clib_min (n_left, i + stride); j++)
+    ip4_fib_mtrie_prefetch_step (leaves[j], &dst_addresses[j],
+				 dst_address_byte_index);
+
+  for (; i < n_left; i++)
+    {
+      if (i + stride < n_left)
+	ip4_fib_mtrie_prefetch_step (leaves[i + stride],
+				     &dst_addresses[i + stride],
+				     dst_address_byte_index);
+
+      leaves[i] = ip4_fib_mtrie_lookup_step (NULL, leaves[i],
+					     &dst_addresses[i],
+					     dst_address_byte_index);
+      n_non_terminal += !ip4_fib_mtrie_leaf_is_terminal (leaves[i]);
+    }
+
+  return (n_non_terminal);
+}
+
+/**
+ * @brief Lookup a batch of addresses, each in its own mtrie, one stage
+ * at a time.
+ *
+ * Per-packet lookups chain three dependent loads, the 16 bit root ply
+ * then the plies for bytes 2 and 3, so a lookup that misses the cache
+ * waits for each in turn. Here every packet does the root ply before any
+ * does the next, and within a stage the slot a packet will read is
+ * prefetched a few packets in advance, so the misses of different
+ * packets overlap. Where the CPU has vector gathers, the packets are
+ * instead stepped a vector at a time. A stage is skipped once no packet
+ * still has a non-terminal leaf.
+ */
+always_inline void
+ip4_fib_mtrie_lookup_n (const ip4_fib_mtrie_t ** m,
+			const ip4_address_t * dst_addresses,
+			ip4_fib_mtrie_leaf_t * leaves, u32 n_left)
+{
+  ip4_fib_mtrie_lookup_stage_one (m, dst_addresses, leaves, n_left);
 
-  return next_leaf;
+  if (ip4_fib_mtrie_lookup_stage (dst_addresses, leaves, n_left, 2))
+    ip4_fib_mtrie_lookup_stage (dst_addresses, leaves, n_left, 3);
 }
 
 #endif /* included_ip_ip4_fib_h */
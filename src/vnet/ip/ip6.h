@@ -76,6 +76,17 @@ typedef struct
 
   /* Index into FIB vector. */
   u32 index;
+
+  /* The forwarding lookup algorithm, an ip6_fib_fwding_algo_t */
+  u8 fwding_algo;
+
+  /* A build of the binary search structure is scheduled */
+  u8 bsl_pending;
+
+  /* The binary search on prefix lengths structure. NULL, so the lookup
+     uses the hash, when the table does not use it or it is being
+     rebuilt */
+  struct ip6_fib_bsl_t_ *bsl;
 } ip6_fib_t;
 
 typedef struct ip6_mfib_t
@@ -58,6 +58,8 @@ ip6_lookup_inline (vlib_main_t * vm,
   ip6_main_t *im = &ip6_main;
   vlib_combined_counter_main_t *cm = &load_balance_main.lbm_to_counters;
   u32 n_left_from, n_left_to_next, *from, *to_next;
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b;
+  u32 lbis[VLIB_FRAME_SIZE], *lbi;
   ip_lookup_next_t next;
   u32 thread_index = vm->thread_index;
 
@@ -65,6 +67,65 @@ ip6_lookup_inline (vlib_main_t * vm,
   n_left_from = frame->n_vectors;
   next = node->cached_next_index;
 
+  /*
+   * FIB lookups for the whole frame first, four at a time, so the
+   * lookup can interleave the probes of the four
+   */
+  vlib_get_buffers (vm, from, bufs, n_left_from);
+  b = bufs;
+  lbi = lbis;
+
+  while (n_left_from >= 4)
+    {
+      const ip6_address_t *dsts[4];
+      u32 fib_indices[4];
+      ip6_header_t *ip;
+      int ii;
+
+      if (n_left_from >= 8)
+	{
+	  vlib_prefetch_buffer_header (b[4], LOAD);
+	  vlib_prefetch_buffer_header (b[5], LOAD);
+	  vlib_prefetch_buffer_header (b[6], LOAD);
+	  vlib_prefetch_buffer_header (b[7], LOAD);
+	  CLIB_PREFETCH (b[4]->data, sizeof (ip[0]), LOAD);
+	  CLIB_PREFETCH (b[5]->data, sizeof (ip[0]), LOAD);
+	  CLIB_PREFETCH (b[6]->data, sizeof (ip[0]), LOAD);
+	  CLIB_PREFETCH (b[7]->data, sizeof (ip[0]), LOAD);
+	}
+
+      for (ii = 0; ii < 4; ii++)
+	{
+	  ip = vlib_buffer_get_current (b[ii]);
+	  dsts[ii] = &ip->dst_address;
+	  ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index,
+					  b[ii]);
+	  fib_indices[ii] = vnet_buffer (b[ii])->ip.fib_index;
+	}
+
+      ip6_fib_table_fwding_lookup_x4 (fib_indices, dsts, lbi);
+
+      b += 4;
+      lbi += 4;
+      n_left_from -= 4;
+    }
+  while (n_left_from > 0)
+    {
+      ip6_header_t *ip;
+
+      ip = vlib_buffer_get_current (b[0]);
+      ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, b[0]);
+      lbi[0] = ip6_fib_table_fwding_lookup (vnet_buffer (b[0])->ip.fib_index,
+					    &ip->dst_address);
+
+      b += 1;
+      lbi += 1;
+      n_left_from -= 1;
+    }
+
+  n_left_from = frame->n_vectors;
+  lbi = lbis;
+
   while (n_left_from > 0)
     {
       vlib_get_next_frame (vm, node, next, to_next, n_left_to_next);
@@ -75,7 +136,6 @@ ip6_lookup_inline (vlib_main_t * vm,
 	  u32 pi0, pi1, lbi0, lbi1, wrong_next;
 	  ip_lookup_next_t next0, next1;
 	  ip6_header_t *ip0, *ip1;
-	  ip6_address_t *dst_addr0, *dst_addr1;
 	  u32 flow_hash_config0, flow_hash_config1;
 	  const dpo_id_t *dpo0, *dpo1;
 	  const load_balance_t *lb0, *lb1;
@@ -102,16 +162,8 @@ ip6_lookup_inline (vlib_main_t * vm,
 	  ip0 = vlib_buffer_get_current (p0);
 	  ip1 = vlib_buffer_get_current (p1);
 
-	  dst_addr0 = &ip0->dst_address;
-	  dst_addr1 = &ip1->dst_address;
-
-	  ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, p0);
-	  ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, p1);
-
-	  lbi0 = ip6_fib_table_fwding_lookup (vnet_buffer (p0)->ip.fib_index,
-					      dst_addr0);
-	  lbi1 = ip6_fib_table_fwding_lookup (vnet_buffer (p1)->ip.fib_index,
-					      dst_addr1);
+	  lbi0 = lbi[0];
+	  lbi1 = lbi[1];
 
 	  lb0 = load_balance_get (lbi0);
 	  lb1 = load_balance_get (lbi1);
@@ -175,6 +227,7 @@ ip6_lookup_inline (vlib_main_t * vm,
 	    (cm, thread_index, lbi1, 1, vlib_buffer_length_in_chain (vm, p1));
 
 	  from += 2;
+	  lbi += 2;
 	  to_next += 2;
 	  n_left_to_next -= 2;
 	  n_left_from -= 2;
@@ -224,7 +277,6 @@ ip6_lookup_inline (vlib_main_t * vm,
 	  u32 pi0, lbi0;
 	  ip_lookup_next_t next0;
 	  load_balance_t *lb0;
-	  ip6_address_t *dst_addr0;
 	  u32 flow_hash_config0;
 	  const dpo_id_t *dpo0;
 
@@ -233,10 +285,7 @@ ip6_lookup_inline (vlib_main_t * vm,
 
 	  p0 = vlib_get_buffer (vm, pi0);
 	  ip0 = vlib_buffer_get_current (p0);
-	  dst_addr0 = &ip0->dst_address;
-	  ip_lookup_set_buffer_fib_index (im->fib_index_by_sw_if_index, p0);
-	  lbi0 = ip6_fib_table_fwding_lookup (vnet_buffer (p0)->ip.fib_index,
-					      dst_addr0);
+	  lbi0 = lbi[0];
 
 	  lb0 = load_balance_get (lbi0);
 	  flow_hash_config0 = lb0->lb_hash_config;
@@ -278,6 +327,7 @@ ip6_lookup_inline (vlib_main_t * vm,
 	    (cm, thread_index, lbi0, 1, vlib_buffer_length_in_chain (vm, p0));
 
 	  from += 1;
+	  lbi += 1;
 	  to_next += 1;
 	  n_left_to_next -= 1;
 	  n_left_from -= 1;
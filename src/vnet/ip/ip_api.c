@@ -77,6 +77,8 @@ _(IP_MTABLE_DUMP, ip_mtable_dump)                                       \
 _(IP_MROUTE_DUMP, ip_mroute_dump)                                       \
 _(IP_NEIGHBOR_DUMP, ip_neighbor_dump)                                   \
 _(IP_MROUTE_ADD_DEL, ip_mroute_add_del)                                 \
+_(IP_ROUTE_BATCH_BEGIN, ip_route_batch_begin)                           \
+_(IP_ROUTE_BATCH_END, ip_route_batch_end)                               \
 _(MFIB_SIGNAL_DUMP, mfib_signal_dump)                                   \
 _(IP_ADDRESS_DUMP, ip_address_dump)                                     \
 _(IP_UNNUMBERED_DUMP, ip_unnumbered_dump)                               \
@@ -596,6 +598,194 @@ vl_api_ip_neighbor_add_del_t_handler (vl_api_ip_neighbor_add_del_t * mp,
   /* *INDENT-ON* */
 }
 
+/**
+ * A batch of route updates opened by an API client. The batch defers
+ * the walks of its table, so it is released when the client ends it,
+ * disconnects, deletes the table or stops sending updates for the
+ * batch's timeout. The table is locked whilst in a batch.
+ */
+typedef struct ip_route_batch_t_
+{
+  u32 client_index;
+  u32 fib_index;
+  fib_protocol_t fproto;
+  /* the client's nesting depth of begins */
+  u32 depth;
+  f64 timeout;
+  f64 expires;
+} ip_route_batch_t;
+
+#define IP_ROUTE_BATCH_TIMEOUT 10.0
+
+static ip_route_batch_t *ip_route_batch_pool;
+
+static vlib_node_registration_t ip_route_batch_process_node;
+
+static ip_route_batch_t *
+ip_route_batch_find (u32 client_index, u32 fib_index, fib_protocol_t fproto)
+{
+  ip_route_batch_t *batch;
+
+  /* *INDENT-OFF* */
+  pool_foreach (batch, ip_route_batch_pool,
+  ({
+    if (batch->client_index == client_index &&
+        batch->fib_index == fib_index && batch->fproto == fproto)
+      return (batch);
+  }));
+  /* *INDENT-ON* */
+
+  return (NULL);
+}
+
+/**
+ * End the client's inner-most begin on the table
+ */
+static int
+ip_route_batch_end (ip_route_batch_t * batch, fib_table_batch_stats_t * fbs)
+{
+  int committed;
+
+  committed = fib_table_batch_end (batch->fib_index, batch->fproto, fbs);
+
+  if (0 == --batch->depth)
+    {
+      fib_table_unlock (batch->fib_index, batch->fproto, FIB_SOURCE_API);
+      pool_put (ip_route_batch_pool, batch);
+    }
+
+  return (committed);
+}
+
+static void
+ip_route_batch_release (ip_route_batch_t * batch)
+{
+  u32 depth = batch->depth;
+
+  while (depth--)
+    ip_route_batch_end (batch, NULL);
+}
+
+typedef int (*ip_route_batch_match_fn_t) (const ip_route_batch_t * batch,
+					  uword arg);
+
+/**
+ * Release all the batches the match function selects
+ */
+static u32
+ip_route_batch_release_matching (ip_route_batch_match_fn_t fn, uword arg)
+{
+  ip_route_batch_t *batch;
+  u32 *indices = NULL, *index;
+  u32 n_released;
+
+  /* *INDENT-OFF* */
+  pool_foreach (batch, ip_route_batch_pool,
+  ({
+    if (fn (batch, arg))
+      vec_add1 (indices, batch - ip_route_batch_pool);
+  }));
+  /* *INDENT-ON* */
+
+  vec_foreach (index, indices)
+    ip_route_batch_release (pool_elt_at_index (ip_route_batch_pool,
+					       index[0]));
+
+  n_released = vec_len (indices);
+  vec_free (indices);
+
+  return (n_released);
+}
+
+static int
+ip_route_batch_match_client (const ip_route_batch_t * batch, uword arg)
+{
+  return (batch->client_index == arg);
+}
+
+static int
+ip_route_batch_match_table (const ip_route_batch_t * batch, uword arg)
+{
+  return (batch->fib_index == (arg >> 8) && batch->fproto == (arg & 0xff));
+}
+
+static int
+ip_route_batch_match_expired (const ip_route_batch_t * batch, uword arg)
+{
+  f64 *now = (f64 *) arg;
+
+  return (batch->expires < *now);
+}
+
+static void
+ip_route_batch_release_table (u32 fib_index, fib_protocol_t fproto)
+{
+  ip_route_batch_release_matching (ip_route_batch_match_table,
+				   ((uword) fib_index << 8) | fproto);
+}
+
+/**
+ * The client sent an update to a table; keep its batch open
+ */
+static void
+ip_route_batch_refresh (u32 client_index, u32 fib_index,
+			fib_protocol_t fproto)
+{
+  ip_route_batch_t *batch;
+
+  if (0 == pool_elts (ip_route_batch_pool))
+    return;
+
+  batch = ip_route_batch_find (client_index, fib_index, fproto);
+
+  if (batch)
+    batch->expires = vlib_time_now (vlib_get_main ()) + batch->timeout;
+}
+
+static uword
+ip_route_batch_process (vlib_main_t * vm,
+			vlib_node_runtime_t * rt, vlib_frame_t * f)
+{
+  u32 n_expired;
+  f64 now;
+
+  while (1)
+    {
+      if (0 == pool_elts (ip_route_batch_pool))
+	vlib_process_wait_for_event (vm);
+      else
+	vlib_process_wait_for_event_or_clock (vm, 1.0);
+
+      vlib_process_get_events (vm, NULL);
+
+      now = vlib_time_now (vm);
+      n_expired =
+	ip_route_batch_release_matching (ip_route_batch_match_expired,
+					 pointer_to_uword (&now));
+      if (n_expired)
+	clib_warning ("%d route batches timed out", n_expired);
+    }
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (ip_route_batch_process_node,static) = {
+  .function = ip_route_batch_process,
+  .type = VLIB_NODE_TYPE_PROCESS,
+  .name = "ip-route-batch-process",
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+ip_route_batch_reaper (u32 client_index)
+{
+  ip_route_batch_release_matching (ip_route_batch_match_client,
+				   client_index);
+  return (NULL);
+}
+
+VL_MSG_API_REAPER_FUNCTION (ip_route_batch_reaper);
+
 void
 ip_table_delete (fib_protocol_t fproto, u32 table_id, u8 is_api)
 {
@@ -620,6 +810,8 @@ ip_table_delete (fib_protocol_t fproto, u32 table_id, u8 is_api)
 
       if (~0 != fib_index)
 	{
+	  /* the batches on the table hold it; end them first */
+	  ip_route_batch_release_table (fib_index, fproto);
 	  fib_table_unlock (fib_index, fproto,
 			    (is_api ? FIB_SOURCE_API : FIB_SOURCE_CLI));
 	}
@@ -652,6 +844,83 @@ vl_api_ip_table_add_del_t_handler (vl_api_ip_table_add_del_t * mp)
   REPLY_MACRO (VL_API_IP_TABLE_ADD_DEL_REPLY);
 }
 
+static void
+vl_api_ip_route_batch_begin_t_handler (vl_api_ip_route_batch_begin_t * mp)
+{
+  vl_api_ip_route_batch_begin_reply_t *rmp;
+  fib_protocol_t fproto = (mp->table.is_ip6 ?
+			   FIB_PROTOCOL_IP6 : FIB_PROTOCOL_IP4);
+  vlib_main_t *vm = vlib_get_main ();
+  ip_route_batch_t *batch;
+  u32 fib_index;
+  int rv;
+
+  rv = fib_api_table_id_decode (fproto, ntohl (mp->table.table_id),
+				&fib_index);
+  if (0 != rv)
+    goto out;
+
+  batch = ip_route_batch_find (mp->client_index, fib_index, fproto);
+
+  if (NULL == batch)
+    {
+      pool_get_zero (ip_route_batch_pool, batch);
+      batch->client_index = mp->client_index;
+      batch->fib_index = fib_index;
+      batch->fproto = fproto;
+      batch->timeout = IP_ROUTE_BATCH_TIMEOUT;
+      fib_table_lock (fib_index, fproto, FIB_SOURCE_API);
+    }
+  if (mp->timeout)
+    batch->timeout = ntohl (mp->timeout);
+  batch->depth++;
+  batch->expires = vlib_time_now (vm) + batch->timeout;
+
+  fib_table_batch_begin (fib_index, fproto);
+
+  vlib_process_signal_event (vm, ip_route_batch_process_node.index, 0, 0);
+
+out:
+  REPLY_MACRO (VL_API_IP_ROUTE_BATCH_BEGIN_REPLY);
+}
+
+static void
+vl_api_ip_route_batch_end_t_handler (vl_api_ip_route_batch_end_t * mp)
+{
+  vl_api_ip_route_batch_end_reply_t *rmp;
+  fib_protocol_t fproto = (mp->table.is_ip6 ?
+			   FIB_PROTOCOL_IP6 : FIB_PROTOCOL_IP4);
+  fib_table_batch_stats_t fbs = { 0 };
+  ip_route_batch_t *batch;
+  u8 committed = 0;
+  u32 fib_index;
+  int rv;
+
+  rv = fib_api_table_id_decode (fproto, ntohl (mp->table.table_id),
+				&fib_index);
+  if (0 == rv)
+    {
+      batch = ip_route_batch_find (mp->client_index, fib_index, fproto);
+
+      if (NULL == batch)
+	rv = VNET_API_ERROR_INVALID_VALUE;
+      else
+	committed = ip_route_batch_end (batch, &fbs);
+    }
+
+  /* *INDENT-OFF* */
+  REPLY_MACRO2 (VL_API_IP_ROUTE_BATCH_END_REPLY,
+  ({
+    rmp->committed = committed;
+    rmp->n_routes = htonl (fbs.fbs_n_routes);
+    rmp->n_walks = htonl (fbs.fbs_n_walks);
+    rmp->n_fwd_updates = htonl (fbs.fbs_n_fwd_updates);
+    rmp->update_usec = clib_host_to_net_u64 (fbs.fbs_update_time * 1e6);
+    rmp->commit_usec = clib_host_to_net_u64 (fbs.fbs_commit_time * 1e6);
+  }))
+  /* *INDENT-ON* */
+}
+
 static int
 ip_route_add_del_t_handler (vl_api_ip_route_add_del_t * mp, u32 * stats_index)
 {
@@ -670,6 +939,8 @@ ip_route_add_del_t_handler (vl_api_ip_route_add_del_t * mp, u32 * stats_index)
   if (0 != rv)
     goto out;
 
+  ip_route_batch_refresh (mp->client_index, fib_index, pfx.fp_proto);
+
   if (0 != mp->route.n_paths)
     vec_validate (rpaths, mp->route.n_paths - 1);
 
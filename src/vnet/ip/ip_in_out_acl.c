@@ -93,6 +93,136 @@ static char *ip_outacl_error_strings[] = {
 #undef _
 };
 
+/* the match data of a buffer in a table, the IP header on output */
+static_always_inline u8 *
+ip_in_out_acl_match_data (vnet_classify_table_t * t, vlib_buffer_t * b,
+			  int is_output)
+{
+  u8 *h;
+
+  if (t->current_data_flag == CLASSIFY_FLAG_USE_CURR_DATA)
+    h = (u8 *) vlib_buffer_get_current (b) + t->current_data_offset;
+  else
+    h = b->data;
+
+  /* advance the match pointer so the matching happens on IP header */
+  if (is_output)
+    h += vnet_buffer (b)->l2_classify.pad.l2_len;
+
+  return h;
+}
+
+/*
+ * Walk the chain on from the table *t, which missed. On return *t is the
+ * table that matched, or the last in the chain.
+ */
+static_always_inline vnet_classify_entry_t *
+ip_in_out_acl_walk_chain (vnet_classify_main_t * vcm,
+			  vnet_classify_table_t ** t, vlib_buffer_t * b,
+			  f64 now, int is_output)
+{
+  vnet_classify_entry_t *e;
+  u8 *h;
+
+  while ((*t)->next_table_index != ~0)
+    {
+      *t = pool_elt_at_index (vcm->tables, (*t)->next_table_index);
+      h = ip_in_out_acl_match_data (*t, b, is_output);
+      e = vnet_classify_find_entry (*t, h, vnet_classify_hash_packet (*t, h),
+				    now);
+      if (e)
+	return e;
+    }
+
+  return 0;
+}
+
+/* apply the session the buffer matched, return its next */
+static_always_inline u32
+ip_in_out_acl_hit (vlib_buffer_t * b0, vnet_classify_entry_t * e0,
+		   u32 next0, u32 n_next_nodes,
+		   vlib_node_runtime_t * error_node, int is_ip4,
+		   int is_output)
+{
+  u8 error0;
+
+  vnet_buffer (b0)->l2_classify.opaque_index = e0->opaque_index;
+  vlib_buffer_advance (b0, e0->advance);
+
+  next0 = (e0->next_index < n_next_nodes) ? e0->next_index : next0;
+
+  if (is_ip4)
+    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
+      (is_output ? IP4_ERROR_OUTACL_SESSION_DENY :
+       IP4_ERROR_INACL_SESSION_DENY) : IP4_ERROR_NONE;
+  else
+    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
+      (is_output ? IP6_ERROR_OUTACL_SESSION_DENY :
+       IP6_ERROR_INACL_SESSION_DENY) : IP6_ERROR_NONE;
+  b0->error = error_node->errors[error0];
+
+  if (!is_output)
+    {
+      if (e0->action == CLASSIFY_ACTION_SET_IP4_FIB_INDEX ||
+	  e0->action == CLASSIFY_ACTION_SET_IP6_FIB_INDEX)
+	vnet_buffer (b0)->sw_if_index[VLIB_TX] = e0->metadata;
+      else if (e0->action == CLASSIFY_ACTION_SET_METADATA)
+	vnet_buffer (b0)->ip.adj_index[VLIB_TX] = e0->metadata;
+    }
+
+  return next0;
+}
+
+/* the buffer missed in the last table of the chain t0, return its next */
+static_always_inline u32
+ip_in_out_acl_miss (vlib_buffer_t * b0, vnet_classify_table_t * t0,
+		    u32 next0, u32 n_next_nodes,
+		    vlib_node_runtime_t * error_node, int is_ip4,
+		    int is_output)
+{
+  u8 error0;
+
+  next0 = (t0->miss_next_index < n_next_nodes) ?
+    t0->miss_next_index : next0;
+
+  if (is_ip4)
+    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
+      (is_output ? IP4_ERROR_OUTACL_TABLE_MISS :
+       IP4_ERROR_INACL_TABLE_MISS) : IP4_ERROR_NONE;
+  else
+    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
+      (is_output ? IP6_ERROR_OUTACL_TABLE_MISS :
+       IP6_ERROR_INACL_TABLE_MISS) : IP6_ERROR_NONE;
+  b0->error = error_node->errors[error0];
+
+  return next0;
+}
+
+static_always_inline void
+ip_in_out_acl_trace_and_rewind (vlib_main_t * vm, vlib_node_runtime_t * node,
+				vnet_classify_main_t * vcm,
+				vlib_buffer_t * b0, vnet_classify_table_t * t0,
+				vnet_classify_entry_t * e0, u32 next0,
+				int is_output)
+{
+  if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
+		     && (b0->flags & VLIB_BUFFER_IS_TRACED)))
+    {
+      ip_in_out_acl_trace_t *t = vlib_add_trace (vm, node, b0, sizeof (*t));
+      t->sw_if_index =
+	vnet_buffer (b0)->sw_if_index[is_output ? VLIB_TX : VLIB_RX];
+      t->next_index = next0;
+      t->table_index = t0 ? t0 - vcm->tables : ~0;
+      t->offset = (e0 && t0) ? vnet_classify_get_offset (t0, e0) : ~0;
+    }
+
+  if ((next0 == ACL_NEXT_INDEX_DENY) && is_output)
+    {
+      /* on output, for the drop node to work properly, go back to ip header */
+      vlib_buffer_advance (b0, vnet_buffer (b0)->l2.l2_len);
+    }
+}
+
 static inline uword
 ip_in_out_acl_inline (vlib_main_t * vm,
 		      vlib_node_runtime_t * node, vlib_frame_t * frame,
@@ -280,7 +410,6 @@ ip_in_out_acl_inline (vlib_main_t * vm,
 	  vnet_classify_entry_t *e0;
 	  u64 hash0;
 	  u8 *h0;
-	  u8 error0;
 
 	  /* Stride 3 seems to work best */
 	  if (PREDICT_TRUE (n_left_from > 3))
@@ -323,147 +452,32 @@ ip_in_out_acl_inline (vlib_main_t * vm,
 	    {
 	      hash0 = vnet_buffer (b0)->l2_classify.hash;
 	      t0 = pool_elt_at_index (vcm->tables, table_index0);
-
-	      if (t0->current_data_flag == CLASSIFY_FLAG_USE_CURR_DATA)
-		h0 =
-		  (void *) vlib_buffer_get_current (b0) +
-		  t0->current_data_offset;
-	      else
-		h0 = b0->data;
-
-	      /* advance the match pointer so the matching happens on IP header */
-	      if (is_output)
-		h0 += vnet_buffer (b0)->l2_classify.pad.l2_len;
+	      h0 = ip_in_out_acl_match_data (t0, b0, is_output);
 
 	      e0 = vnet_classify_find_entry (t0, (u8 *) h0, hash0, now);
-	      if (e0)
+	      if (!e0)
 		{
-		  vnet_buffer (b0)->l2_classify.opaque_index
-		    = e0->opaque_index;
-		  vlib_buffer_advance (b0, e0->advance);
-
-		  next0 = (e0->next_index < n_next_nodes) ?
-		    e0->next_index : next0;
+		  e0 = ip_in_out_acl_walk_chain (vcm, &t0, b0, now, is_output);
+		  if (e0)
+		    chain_hits++;
+		}
 
+	      if (e0)
+		{
 		  hits++;
-
-		  if (is_ip4)
-		    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-		      (is_output ? IP4_ERROR_OUTACL_SESSION_DENY :
-		       IP4_ERROR_INACL_SESSION_DENY) : IP4_ERROR_NONE;
-		  else
-		    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-		      (is_output ? IP6_ERROR_OUTACL_SESSION_DENY :
-		       IP6_ERROR_INACL_SESSION_DENY) : IP6_ERROR_NONE;
-		  b0->error = error_node->errors[error0];
-
-		  if (!is_output)
-		    {
-		      if (e0->action == CLASSIFY_ACTION_SET_IP4_FIB_INDEX ||
-			  e0->action == CLASSIFY_ACTION_SET_IP6_FIB_INDEX)
-			vnet_buffer (b0)->sw_if_index[VLIB_TX] = e0->metadata;
-		      else if (e0->action == CLASSIFY_ACTION_SET_METADATA)
-			vnet_buffer (b0)->ip.adj_index[VLIB_TX] =
-			  e0->metadata;
-		    }
+		  next0 = ip_in_out_acl_hit (b0, e0, next0, n_next_nodes,
+					     error_node, is_ip4, is_output);
 		}
 	      else
 		{
-		  while (1)
-		    {
-		      if (PREDICT_TRUE (t0->next_table_index != ~0))
-			t0 = pool_elt_at_index (vcm->tables,
-						t0->next_table_index);
-		      else
-			{
-			  next0 = (t0->miss_next_index < n_next_nodes) ?
-			    t0->miss_next_index : next0;
-
-			  misses++;
-
-			  if (is_ip4)
-			    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-			      (is_output ? IP4_ERROR_OUTACL_TABLE_MISS :
-			       IP4_ERROR_INACL_TABLE_MISS) : IP4_ERROR_NONE;
-			  else
-			    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-			      (is_output ? IP6_ERROR_OUTACL_TABLE_MISS :
-			       IP6_ERROR_INACL_TABLE_MISS) : IP6_ERROR_NONE;
-			  b0->error = error_node->errors[error0];
-			  break;
-			}
-
-		      if (t0->current_data_flag ==
-			  CLASSIFY_FLAG_USE_CURR_DATA)
-			h0 =
-			  (void *) vlib_buffer_get_current (b0) +
-			  t0->current_data_offset;
-		      else
-			h0 = b0->data;
-
-		      /* advance the match pointer so the matching happens on IP header */
-		      if (is_output)
-			h0 += vnet_buffer (b0)->l2_classify.pad.l2_len;
-
-		      hash0 = vnet_classify_hash_packet (t0, (u8 *) h0);
-		      e0 = vnet_classify_find_entry
-			(t0, (u8 *) h0, hash0, now);
-		      if (e0)
-			{
-			  vnet_buffer (b0)->l2_classify.opaque_index
-			    = e0->opaque_index;
-			  vlib_buffer_advance (b0, e0->advance);
-			  next0 = (e0->next_index < n_next_nodes) ?
-			    e0->next_index : next0;
-			  hits++;
-			  chain_hits++;
-
-			  if (is_ip4)
-			    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-			      (is_output ? IP4_ERROR_OUTACL_SESSION_DENY :
-			       IP4_ERROR_INACL_SESSION_DENY) : IP4_ERROR_NONE;
-			  else
-			    error0 = (next0 == ACL_NEXT_INDEX_DENY) ?
-			      (is_output ? IP6_ERROR_OUTACL_SESSION_DENY :
-			       IP6_ERROR_INACL_SESSION_DENY) : IP6_ERROR_NONE;
-			  b0->error = error_node->errors[error0];
-
-			  if (!is_output)
-			    {
-			      if (e0->action ==
-				  CLASSIFY_ACTION_SET_IP4_FIB_INDEX
-				  || e0->action ==
-				  CLASSIFY_ACTION_SET_IP6_FIB_INDEX)
-				vnet_buffer (b0)->sw_if_index[VLIB_TX] =
-				  e0->metadata;
-			      else if (e0->action ==
-				       CLASSIFY_ACTION_SET_METADATA)
-				vnet_buffer (b0)->ip.adj_index[VLIB_TX] =
-				  e0->metadata;
-			    }
-			  break;
-			}
-		    }
+		  misses++;
+		  next0 = ip_in_out_acl_miss (b0, t0, next0, n_next_nodes,
+					      error_node, is_ip4, is_output);
 		}
 	    }
 
-	  if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
-			     && (b0->flags & VLIB_BUFFER_IS_TRACED)))
-	    {
-	      ip_in_out_acl_trace_t *t =
-		vlib_add_trace (vm, node, b0, sizeof (*t));
-	      t->sw_if_index =
-		vnet_buffer (b0)->sw_if_index[is_output ? VLIB_TX : VLIB_RX];
-	      t->next_index = next0;
-	      t->table_index = t0 ? t0 - vcm->tables : ~0;
-	      t->offset = (e0 && t0) ? vnet_classify_get_offset (t0, e0) : ~0;
-	    }
-
-	  if ((next0 == ACL_NEXT_INDEX_DENY) && is_output)
-	    {
-	      /* on output, for the drop node to work properly, go back to ip header */
-	      vlib_buffer_advance (b0, vnet_buffer (b0)->l2.l2_len);
-	    }
+	  ip_in_out_acl_trace_and_rewind (vm, node, vcm, b0, t0, e0, next0,
+					  is_output);
 
 	  /* verify speculative enqueue, maybe switch current next frame */
 	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index,
@@ -486,9 +500,186 @@ ip_in_out_acl_inline (vlib_main_t * vm,
   return frame->n_vectors;
 }
 
+static_always_inline void
+ip_in_out_acl_chain_headers (vnet_classify_chain_t * c, vlib_buffer_t * b,
+			     u8 ** h, int is_output)
+{
+  u32 i;
+
+  for (i = 0; i < c->n_tables; i++)
+    h[i] = ip_in_out_acl_match_data (c->tables[i], b, is_output);
+}
+
+/*
+ * The lookup in one pass over the table chain; see vnet_classify.h.
+ * The stages are per-frame: all the hashes, and so the bucket prefetches,
+ * are done before any entry is prefetched or compared.
+ */
+static_always_inline uword
+ip_in_out_acl_chain_inline (vlib_main_t * vm,
+			    vlib_node_runtime_t * node, vlib_frame_t * frame,
+			    int is_ip4, int is_output)
+{
+  u64 hashes[VLIB_FRAME_SIZE][VNET_CLASSIFY_CHAIN_MAX];
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE];
+  u16 nexts[VLIB_FRAME_SIZE];
+  in_out_acl_main_t *am = &in_out_acl_main;
+  vnet_classify_main_t *vcm = am->vnet_classify_main;
+  vnet_classify_chain_t chain, pchain;
+  u8 *h[VNET_CLASSIFY_CHAIN_MAX];
+  f64 now = vlib_time_now (vm);
+  u32 hits = 0;
+  u32 misses = 0;
+  u32 chain_hits = 0;
+  in_out_acl_table_id_t tid;
+  vlib_node_runtime_t *error_node;
+  u32 i, n_vectors, n_next_nodes, *from;
+
+  n_next_nodes = node->n_next_nodes;
+
+  if (is_ip4)
+    {
+      tid = IN_OUT_ACL_TABLE_IP4;
+      error_node = vlib_node_get_runtime (vm, ip4_input_node.index);
+    }
+  else
+    {
+      tid = IN_OUT_ACL_TABLE_IP6;
+      error_node = vlib_node_get_runtime (vm, ip6_input_node.index);
+    }
+
+  from = vlib_frame_vector_args (frame);
+  n_vectors = frame->n_vectors;
+  vlib_get_buffers (vm, from, bufs, n_vectors);
+
+  /* First pass: compute the hashes in all tables */
+  chain.table_index = ~0;
+  chain.n_tables = pchain.n_tables = 0;
+
+  for (i = 0; i < n_vectors; i++)
+    {
+      u32 sw_if_index0, table_index0;
+      vlib_buffer_t *b0;
+
+      if (i + 2 < n_vectors)
+	{
+	  vlib_prefetch_buffer_header (bufs[i + 2], STORE);
+	  CLIB_PREFETCH (bufs[i + 2]->data, CLIB_CACHE_LINE_BYTES, STORE);
+	}
+
+      b0 = bufs[i];
+      sw_if_index0 =
+	vnet_buffer (b0)->sw_if_index[is_output ? VLIB_TX : VLIB_RX];
+      table_index0 =
+	am->classify_table_index_by_sw_if_index[is_output][tid][sw_if_index0];
+
+      if (is_output)
+	/* Save the rewrite length, since we are using the l2_classify struct */
+	vnet_buffer (b0)->l2_classify.pad.l2_len =
+	  vnet_buffer (b0)->ip.save_rewrite_length;
+
+      vnet_buffer (b0)->l2_classify.table_index = table_index0;
+
+      if (PREDICT_FALSE (table_index0 == ~0))
+	continue;
+
+      if (table_index0 != chain.table_index)
+	vnet_classify_chain_init (vcm, &chain, table_index0);
+
+      ip_in_out_acl_chain_headers (&chain, b0, h, is_output);
+      vnet_classify_chain_hash (&chain, h, hashes[i]);
+    }
+
+  /* Second pass: prefetch the entries, then compare */
+  chain.table_index = pchain.table_index = ~0;
+
+  for (i = 0; i < n_vectors; i++)
+    {
+      u32 next0 = ACL_NEXT_INDEX_DENY;
+      vnet_classify_table_t *t0;
+      vnet_classify_entry_t *e0;
+      u32 table_index0, pos0;
+      vlib_buffer_t *b0;
+
+      /* Stride 3 seems to work best */
+      if (i + 3 < n_vectors)
+	{
+	  table_index0 = vnet_buffer (bufs[i + 3])->l2_classify.table_index;
+
+	  if (PREDICT_TRUE (table_index0 != ~0))
+	    {
+	      if (table_index0 != pchain.table_index)
+		vnet_classify_chain_init (vcm, &pchain, table_index0);
+	      vnet_classify_chain_prefetch_entries (&pchain, hashes[i + 3]);
+	    }
+	}
+
+      b0 = bufs[i];
+      table_index0 = vnet_buffer (b0)->l2_classify.table_index;
+      e0 = 0;
+      t0 = 0;
+      vnet_get_config_data (am->vnet_config_main[is_output][tid],
+			    &b0->current_config_index, &next0,
+			    /* # bytes of config data */ 0);
+
+      vnet_buffer (b0)->l2_classify.opaque_index = ~0;
+
+      if (PREDICT_TRUE (table_index0 != ~0))
+	{
+	  if (table_index0 != chain.table_index)
+	    vnet_classify_chain_init (vcm, &chain, table_index0);
+
+	  ip_in_out_acl_chain_headers (&chain, b0, h, is_output);
+	  e0 = vnet_classify_chain_find_entry (&chain, h, hashes[i], now,
+					       &pos0);
+	  t0 = chain.tables[pos0];
+
+	  /* the remainder of a chain longer than one pass is walked */
+	  if (!e0)
+	    e0 = ip_in_out_acl_walk_chain (vcm, &t0, b0, now, is_output);
+
+	  if (e0)
+	    {
+	      hits++;
+	      if (t0 != chain.tables[0])
+		chain_hits++;
+	      next0 = ip_in_out_acl_hit (b0, e0, next0, n_next_nodes,
+					 error_node, is_ip4, is_output);
+	    }
+	  else
+	    {
+	      misses++;
+	      next0 = ip_in_out_acl_miss (b0, t0, next0, n_next_nodes,
+					  error_node, is_ip4, is_output);
+	    }
+	}
+
+      ip_in_out_acl_trace_and_rewind (vm, node, vcm, b0, t0, e0, next0,
+				      is_output);
+
+      nexts[i] = next0;
+    }
+
+  vlib_buffer_enqueue_to_next (vm, node, from, nexts, n_vectors);
+
+  vlib_node_increment_counter (vm, node->node_index,
+			       is_output ? IP_OUTACL_ERROR_MISS :
+			       IP_INACL_ERROR_MISS, misses);
+  vlib_node_increment_counter (vm, node->node_index,
+			       is_output ? IP_OUTACL_ERROR_HIT :
+			       IP_INACL_ERROR_HIT, hits);
+  vlib_node_increment_counter (vm, node->node_index,
+			       is_output ? IP_OUTACL_ERROR_CHAIN_HIT :
+			       IP_INACL_ERROR_CHAIN_HIT, chain_hits);
+  return n_vectors;
+}
+
 VLIB_NODE_FN (ip4_inacl_node) (vlib_main_t * vm, vlib_node_runtime_t * node,
 			       vlib_frame_t * frame)
 {
+  if (vnet_classify_main.chain_lookup)
+    return ip_in_out_acl_chain_inline (vm, node, frame, 1 /* is_ip4 */ ,
+				       0 /* is_output */ );
   return ip_in_out_acl_inline (vm, node, frame, 1 /* is_ip4 */ ,
 			       0 /* is_output */ );
 }
@@ -496,6 +687,9 @@ VLIB_NODE_FN (ip4_inacl_node) (vlib_main_t * vm, vlib_node_runtime_t * node,
 VLIB_NODE_FN (ip4_outacl_node) (vlib_main_t * vm, vlib_node_runtime_t * node,
 				vlib_frame_t * frame)
 {
+  if (vnet_classify_main.chain_lookup)
+    return ip_in_out_acl_chain_inline (vm, node, frame, 1 /* is_ip4 */ ,
+				       1 /* is_output */ );
   return ip_in_out_acl_inline (vm, node, frame, 1 /* is_ip4 */ ,
 			       1 /* is_output */ );
 }
@@ -532,6 +726,9 @@ VLIB_REGISTER_NODE (ip4_outacl_node) = {
 VLIB_NODE_FN (ip6_inacl_node) (vlib_main_t * vm, vlib_node_runtime_t * node,
 			       vlib_frame_t * frame)
 {
+  if (vnet_classify_main.chain_lookup)
+    return ip_in_out_acl_chain_inline (vm, node, frame, 0 /* is_ip4 */ ,
+				       0 /* is_output */ );
   return ip_in_out_acl_inline (vm, node, frame, 0 /* is_ip4 */ ,
 			       0 /* is_output */ );
 }
@@ -539,6 +736,9 @@ VLIB_NODE_FN (ip6_inacl_node) (vlib_main_t * vm, vlib_node_runtime_t * node,
 VLIB_NODE_FN (ip6_outacl_node) (vlib_main_t * vm, vlib_node_runtime_t * node,
 				vlib_frame_t * frame)
 {
+  if (vnet_classify_main.chain_lookup)
+    return ip_in_out_acl_chain_inline (vm, node, frame, 0 /* is_ip4 */ ,
+				       1 /* is_output */ );
   return ip_in_out_acl_inline (vm, node, frame, 0 /* is_ip4 */ ,
 			       1 /* is_output */ );
 }
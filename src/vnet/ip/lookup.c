@@ -320,6 +320,7 @@ vnet_ip_route_cmd (vlib_main_t * vm,
   dpo_id_t dpo = DPO_INVALID, *dpos = NULL;
   fib_route_path_t *rpaths = NULL, rpath;
   fib_prefix_t *prefixs = NULL, pfx;
+  fib_entry_flag_t entry_flags;
   clib_error_t *error = NULL;
   f64 count;
   int i;
@@ -327,6 +328,7 @@ vnet_ip_route_cmd (vlib_main_t * vm,
   is_del = 0;
   table_id = 0;
   count = 1;
+  entry_flags = FIB_ENTRY_FLAG_NONE;
   clib_memset (&pfx, 0, sizeof (pfx));
 
   /* Get a line of input. */
@@ -341,6 +343,8 @@ vnet_ip_route_cmd (vlib_main_t * vm,
 	;
       else if (unformat (line_input, "count %f", &count))
 	;
+      else if (unformat (line_input, "resilient"))
+	entry_flags |= FIB_ENTRY_FLAG_RESILIENT;
 
       else if (unformat (line_input, "%U/%d",
 			 unformat_ip4_address, &pfx.fp_addr.ip4, &pfx.fp_len))
@@ -439,6 +443,9 @@ vnet_ip_route_cmd (vlib_main_t * vm,
 	  incr = 1 << ((FIB_PROTOCOL_IP4 == prefixs[0].fp_proto ? 32 : 128) -
 		       prefixs[i].fp_len);
 
+	  if (count > 1)
+	    fib_table_batch_begin (fib_index, prefixs[i].fp_proto);
+
 	  for (k = 0; k < n; k++)
 	    {
 	      fib_prefix_t rpfx = {
@@ -454,7 +461,7 @@ vnet_ip_route_cmd (vlib_main_t * vm,
 		fib_table_entry_path_add2 (fib_index,
 					   &rpfx,
 					   FIB_SOURCE_CLI,
-					   FIB_ENTRY_FLAG_NONE, rpaths);
+					   entry_flags, rpaths);
 
 	      if (FIB_PROTOCOL_IP4 == prefixs[0].fp_proto)
 		{
@@ -473,6 +480,15 @@ vnet_ip_route_cmd (vlib_main_t * vm,
 		}
 	    }
 
+	  if (count > 1)
+	    {
+	      fib_table_batch_stats_t fbs;
+
+	      if (fib_table_batch_end (fib_index, prefixs[i].fp_proto, &fbs))
+		vlib_cli_output (vm, "%U", format_fib_table_batch_stats,
+				 &fbs);
+	    }
+
 	  t[1] = vlib_time_now (vm);
 	  if (count > 1)
 	    vlib_cli_output (vm, "%.6e routes/sec", count / (t[1] - t[0]));
@@ -619,13 +635,16 @@ VLIB_CLI_COMMAND (vlib_cli_show_ip6_command, static) = {
  * second path, 1/4 following the first path:
  * @cliexcmd{ip route add 7.0.0.1/32 via 6.0.0.1 GigabitEthernet2/0/0 weight 1}
  * @cliexcmd{ip route add 7.0.0.1/32 via 6.0.0.2 GigabitEthernet2/0/0 weight 3}
+ * A resilient route moves only the flows of a path that is removed;
+ * the flows of the other paths are not rebalanced when paths change:
+ * @cliexcmd{ip route add 7.0.0.2/32 resilient via 6.0.0.1 GigabitEthernet2/0/0}
  * To add a route to a particular FIB table (VRF), use:
  * @cliexcmd{ip route add 172.16.24.0/24 table 7 via GigabitEthernet2/0/0}
  ?*/
 /* *INDENT-OFF* */
 VLIB_CLI_COMMAND (ip_route_command, static) = {
   .path = "ip route",
-  .short_help = "ip route [add|del] [count <n>] <dst-ip-addr>/<width> [table <table-id>] via [next-hop-address] [next-hop-interface] [next-hop-table <value>] [weight <value>] [preference <value>] [udp-encap-id <value>] [ip4-lookup-in-table <value>] [ip6-lookup-in-table <value>] [mpls-lookup-in-table <value>] [resolve-via-host] [resolve-via-connected] [rx-ip4 <interface>] [out-labels <value value value>]",
+  .short_help = "ip route [add|del] [count <n>] <dst-ip-addr>/<width> [table <table-id>] [resilient] via [next-hop-address] [next-hop-interface] [next-hop-table <value>] [weight <value>] [preference <value>] [udp-encap-id <value>] [ip4-lookup-in-table <value>] [ip6-lookup-in-table <value>] [mpls-lookup-in-table <value>] [resolve-via-host] [resolve-via-connected] [rx-ip4 <interface>] [out-labels <value value value>]",
   .function = vnet_ip_route_cmd,
   .is_mp_safe = 1,
 };
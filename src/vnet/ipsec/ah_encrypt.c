@@ -127,6 +127,7 @@ typedef struct
   i16 current_data;
   u8 skip;
   u32 sa_index;
+  u64 seq;
 } ah_encrypt_packet_data_t;
 
 always_inline uword
@@ -183,7 +184,8 @@ ah_encrypt_inline (vlib_main_t * vm,
       pd->sa_index = current_sa_index;
       next[0] = AH_ENCRYPT_NEXT_DROP;
 
-      if (PREDICT_FALSE (esp_seq_advance (sa0)))
+      if (PREDICT_FALSE (esp_seq_next (sa0, current_sa_index, ptd,
+					&pd->seq)))
 	{
 	  b[0]->error = node->errors[AH_ENCRYPT_ERROR_SEQ_CYCLED];
 	  pd->skip = 1;
@@ -250,7 +252,7 @@ ah_encrypt_inline (vlib_main_t * vm,
 	  oh6_0->ah.reserved = 0;
 	  oh6_0->ah.nexthdr = next_hdr_type;
 	  oh6_0->ah.spi = clib_net_to_host_u32 (sa0->spi);
-	  oh6_0->ah.seq_no = clib_net_to_host_u32 (sa0->seq);
+	  oh6_0->ah.seq_no = clib_net_to_host_u32 ((u32) pd->seq);
 	  oh6_0->ip6.payload_length =
 	    clib_host_to_net_u16 (vlib_buffer_length_in_chain (vm, b[0]) -
 				  sizeof (ip6_header_t));
@@ -281,7 +283,7 @@ ah_encrypt_inline (vlib_main_t * vm,
 	  oh0->ip4.length =
 	    clib_host_to_net_u16 (vlib_buffer_length_in_chain (vm, b[0]));
 	  oh0->ah.spi = clib_net_to_host_u32 (sa0->spi);
-	  oh0->ah.seq_no = clib_net_to_host_u32 (sa0->seq);
+	  oh0->ah.seq_no = clib_net_to_host_u32 ((u32) pd->seq);
 	  oh0->ah.nexthdr = next_hdr_type;
 	  oh0->ah.hdrlen =
 	    (sizeof (ah_header_t) + icv_size + padding_len) / 4 - 2;
@@ -322,7 +324,7 @@ ah_encrypt_inline (vlib_main_t * vm,
 	  op->user_data = b - bufs;
 	  if (ipsec_sa_is_set_USE_ESN (sa0))
 	    {
-	      u32 seq_hi = clib_host_to_net_u32 (sa0->seq_hi);
+	      u32 seq_hi = clib_host_to_net_u32 (pd->seq >> 32);
 
 	      op->len += sizeof (seq_hi);
 	      clib_memcpy (op->src + b[0]->current_length, &seq_hi,
@@ -383,8 +385,8 @@ ah_encrypt_inline (vlib_main_t * vm,
 	  ah_encrypt_trace_t *tr =
 	    vlib_add_trace (vm, node, b[0], sizeof (*tr));
 	  tr->spi = sa0->spi;
-	  tr->seq_lo = sa0->seq;
-	  tr->seq_hi = sa0->seq_hi;
+	  tr->seq_lo = pd->seq;
+	  tr->seq_hi = pd->seq >> 32;
 	  tr->integ_alg = sa0->integ_alg;
 	  tr->sa_index = pd->sa_index;
 	}
@@ -106,6 +106,50 @@ esp_seq_advance (ipsec_sa_t * sa)
 }
 
 
+/**
+ * @brief Take the next outbound sequence number of an SA.
+ * In multi-worker mode each worker takes its numbers from a block it
+ * reserved with a single atomic add, so that no state is shared between
+ * the workers encrypting with the same SA.
+ * @param seq returns the 64 bit sequence number, ESN high half included
+ * @return 1 if the sequence number cycled
+ */
+always_inline int
+esp_seq_next (ipsec_sa_t * sa, u32 sa_index, ipsec_per_thread_data_t * ptd,
+	      u64 * seq)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_sa_seq_block_t *blk;
+
+  if (PREDICT_TRUE (!im->sa_multi_worker))
+    {
+      if (esp_seq_advance (sa))
+	return 1;
+      *seq = sa->seq64;
+      return 0;
+    }
+
+  blk = vec_elt_at_index (ptd->seq_blocks, sa_index);
+
+  if (PREDICT_FALSE (blk->next == blk->end))
+    {
+      blk->next = clib_atomic_fetch_add (&sa->seq64, im->sa_seq_block_size);
+      blk->next += 1;
+      blk->end = blk->next + im->sa_seq_block_size;
+    }
+
+  *seq = blk->next++;
+
+  if (PREDICT_FALSE (ipsec_sa_is_set_USE_ANTI_REPLAY (sa)))
+    {
+      if (ipsec_sa_is_set_USE_ESN (sa))
+	return (*seq == 0);
+      return (*seq > ESP_SEQ_MAX);
+    }
+
+  return 0;
+}
+
 always_inline unsigned int
 hmac_calc (vlib_main_t * vm, ipsec_sa_t * sa, u8 * data, int data_len,
 	   u8 * signature)
@@ -136,7 +180,7 @@ hmac_calc (vlib_main_t * vm, ipsec_sa_t * sa, u8 * data, int data_len,
 
 always_inline void
 esp_aad_fill (vnet_crypto_op_t * op,
-	      const esp_header_t * esp, const ipsec_sa_t * sa)
+	      const esp_header_t * esp, const ipsec_sa_t * sa, u32 seq_hi)
 {
   esp_aead_t *aad;
 
@@ -146,7 +190,7 @@ esp_aad_fill (vnet_crypto_op_t * op,
   if (ipsec_sa_is_set_USE_ESN (sa))
     {
       /* SPI, seq-hi, seq-low */
-      aad->data[1] = clib_host_to_net_u32 (sa->seq_hi);
+      aad->data[1] = clib_host_to_net_u32 (seq_hi);
       aad->data[2] = esp->seq;
       op->aad_len = 12;
     }
@@ -157,6 +201,89 @@ esp_aad_fill (vnet_crypto_op_t * op,
       op->aad_len = 8;
     }
 }
+/**
+ * @brief Describe the data of a buffer chain as crypto op chunks, starting
+ * at @a start in the first buffer and stopping @a tail_sz bytes before the
+ * end of the last one.
+ *
+ * @return index of the first chunk in the per-thread chunk vector
+ */
+always_inline u32
+esp_add_chain_chunks (vlib_main_t * vm, ipsec_per_thread_data_t * ptd,
+		      vlib_buffer_t * b, u8 * start, i16 tail_sz,
+		      u16 * n_chunks)
+{
+  vnet_crypto_op_chunk_t *ch;
+  u32 chunk_index = vec_len (ptd->chunks);
+  u16 n = 1;
+
+  vec_add2 (ptd->chunks, ch, 1);
+  ch->src = ch->dst = start;
+  ch->len = (u8 *) vlib_buffer_get_tail (b) - start;
+
+  while (b->flags & VLIB_BUFFER_NEXT_PRESENT)
+    {
+      b = vlib_get_buffer (vm, b->next_buffer);
+      vec_add2 (ptd->chunks, ch, 1);
+      ch->src = ch->dst = vlib_buffer_get_current (b);
+      ch->len = b->current_length;
+      n++;
+    }
+
+  ch->len -= tail_sz;
+  *n_chunks = n;
+  return chunk_index;
+}
+
+always_inline void
+esp_process_chained_ops (vlib_main_t * vm, vlib_node_runtime_t * node,
+			 vnet_crypto_op_t * ops, vnet_crypto_op_chunk_t * chunks,
+			 vlib_buffer_t * b[], u16 * nexts, u32 drop_next,
+			 u32 err_bad_hmac, u32 err_engine)
+{
+  u32 n_fail, n_ops = vec_len (ops);
+  vnet_crypto_op_t *op = ops;
+
+  if (n_ops == 0)
+    return;
+
+  n_fail = n_ops - vnet_crypto_process_chained_ops (vm, op, chunks, n_ops);
+
+  while (n_fail)
+    {
+      ASSERT (op - ops < n_ops);
+
+      if (op->status != VNET_CRYPTO_OP_STATUS_COMPLETED)
+	{
+	  u32 bi = op->user_data;
+	  if (op->status == VNET_CRYPTO_OP_STATUS_FAIL_BAD_HMAC)
+	    b[bi]->error = node->errors[err_bad_hmac];
+	  else
+	    b[bi]->error = node->errors[err_engine];
+	  nexts[bi] = drop_next;
+	  n_fail--;
+	}
+      op++;
+    }
+}
+
+/**
+ * @brief Per-packet state kept while a packet is owned by an async crypto
+ * engine; lives in the unused tail of the buffer opaque2.
+ */
+typedef struct
+{
+  u32 next_index;
+} esp_post_data_t;
+
+STATIC_ASSERT (sizeof (vnet_buffer_opaque2_t) + sizeof (esp_post_data_t) <=
+	       STRUCT_SIZE_OF (vlib_buffer_t, opaque2),
+	       "ESP post data does not fit in buffer opaque2");
+
+#define esp_post_data(b) \
+  ((esp_post_data_t *) ((u8 *) ((b)->opaque2) + \
+			sizeof (vnet_buffer_opaque2_t)))
+
 #endif /* __ESP_H__ */
 
 /*
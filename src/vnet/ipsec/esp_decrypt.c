@@ -45,7 +45,7 @@ typedef enum
  _(CRYPTO_ENGINE_ERROR, "crypto engine error (packet dropped)") \
  _(REPLAY, "SA replayed packet")                                \
  _(RUNT, "undersized packet")                                   \
- _(CHAINED_BUFFER, "chained buffers (packet dropped)")          \
+ _(CHAINED_BUFFER, "unsupported buffer chain (packet dropped)") \
  _(OVERSIZED_HEADER, "buffer with oversized header (dropped)")  \
  _(NO_TAIL_SPACE, "no enough buffer tail space (dropped)")      \
  _(TUN_NO_PROTO, "no tunnel protocol")                          \
@@ -108,12 +108,81 @@ typedef struct
   i16 current_data;
   i16 current_length;
   u16 hdr_sz;
+  u8 is_chain;
+  u32 seq_hi;
 } esp_decrypt_packet_data_t;
 
 STATIC_ASSERT_SIZEOF (esp_decrypt_packet_data_t, 3 * sizeof (u64));
 
 #define ESP_ENCRYPT_PD_F_FD_TRANSPORT (1 << 2)
 
+/*
+ * Make sure the ICV and the ESP footer of a chained packet sit in its last
+ * buffer, moving the bytes the last buffer is short of over from the one
+ * before it. Returns the last buffer, 0 if the chain can't be fixed.
+ */
+static_always_inline vlib_buffer_t *
+esp_decrypt_prepare_chain (vlib_main_t * vm, vlib_buffer_t * b, u16 icv_sz,
+			   u16 buffer_data_size)
+{
+  vlib_buffer_t *before_last = b, *lb = b;
+  u16 need = icv_sz + sizeof (esp_footer_t), n_move;
+  u8 *p;
+
+  /* makes total_length_not_including_first_buffer valid */
+  vlib_buffer_length_in_chain (vm, b);
+
+  while (lb->flags & VLIB_BUFFER_NEXT_PRESENT)
+    {
+      before_last = lb;
+      lb = vlib_get_buffer (vm, lb->next_buffer);
+    }
+
+  if (PREDICT_TRUE (lb->current_length >= need))
+    return lb;
+
+  n_move = need - lb->current_length;
+  if (before_last->current_length < n_move ||
+      lb->current_data + need > buffer_data_size)
+    return 0;
+
+  p = vlib_buffer_get_current (lb);
+  memmove (p + n_move, p, lb->current_length);
+  clib_memcpy_fast (p, (u8 *) vlib_buffer_get_tail (before_last) - n_move,
+		    n_move);
+  before_last->current_length -= n_move;
+  lb->current_length += n_move;
+  if (before_last == b)
+    b->total_length_not_including_first_buffer += n_move;
+
+  return lb;
+}
+
+/* trim bytes off the end of a chain, freeing the buffers left empty */
+static_always_inline void
+esp_decrypt_remove_chain_tail (vlib_main_t * vm, vlib_buffer_t * b, u16 tail)
+{
+  u32 len = vlib_buffer_length_in_chain (vm, b) - tail;
+  vlib_buffer_t *cb = b;
+
+  b->total_length_not_including_first_buffer =
+    len > b->current_length ? len - b->current_length : 0;
+
+  while (cb->current_length < len &&
+	 (cb->flags & VLIB_BUFFER_NEXT_PRESENT))
+    {
+      len -= cb->current_length;
+      cb = vlib_get_buffer (vm, cb->next_buffer);
+    }
+
+  cb->current_length = len;
+  if (cb->flags & VLIB_BUFFER_NEXT_PRESENT)
+    {
+      vlib_buffer_free_one (vm, cb->next_buffer);
+      cb->flags &= ~VLIB_BUFFER_NEXT_PRESENT;
+    }
+}
+
 always_inline uword
 esp_decrypt_inline (vlib_main_t * vm,
 		    vlib_node_runtime_t * node, vlib_frame_t * from_frame,
@@ -133,15 +202,20 @@ esp_decrypt_inline (vlib_main_t * vm,
   u32 current_sa_index = ~0, current_sa_bytes = 0, current_sa_pkts = 0;
   const u8 esp_sz = sizeof (esp_header_t);
   ipsec_sa_t *sa0 = 0;
+  vlib_buffer_t *lb;
 
   vlib_get_buffers (vm, from, b, n_left);
   vec_reset_length (ptd->crypto_ops);
   vec_reset_length (ptd->integ_ops);
+  vec_reset_length (ptd->chained_crypto_ops);
+  vec_reset_length (ptd->chained_integ_ops);
+  vec_reset_length (ptd->chunks);
   clib_memset_u16 (nexts, -1, n_left);
 
   while (n_left > 0)
     {
       u8 *payload;
+      u32 pkt_len;
 
       if (n_left > 2)
 	{
@@ -153,13 +227,6 @@ esp_decrypt_inline (vlib_main_t * vm,
 	  CLIB_PREFETCH (p, CLIB_CACHE_LINE_BYTES, LOAD);
 	}
 
-      if (vlib_buffer_chain_linearize (vm, b[0]) != 1)
-	{
-	  b[0]->error = node->errors[ESP_DECRYPT_ERROR_CHAINED_BUFFER];
-	  next[0] = ESP_DECRYPT_NEXT_DROP;
-	  goto next;
-	}
-
       if (vnet_buffer (b[0])->ipsec.sad_index != current_sa_index)
 	{
 	  if (current_sa_pkts)
@@ -179,6 +246,23 @@ esp_decrypt_inline (vlib_main_t * vm,
 
       /* store packet data for next round for easier prefetch */
       pd->sa_data = cpd.sa_data;
+      pd->is_chain = 0;
+      lb = b[0];
+
+      if (PREDICT_FALSE (b[0]->flags & VLIB_BUFFER_NEXT_PRESENT))
+	{
+	  /* headers must be in the first buffer, ICV in the last one */
+	  lb = esp_decrypt_prepare_chain (vm, b[0], cpd.icv_sz,
+					  buffer_data_size);
+	  if (!lb || b[0]->current_length < esp_sz + cpd.iv_sz)
+	    {
+	      b[0]->error = node->errors[ESP_DECRYPT_ERROR_CHAINED_BUFFER];
+	      next[0] = ESP_DECRYPT_NEXT_DROP;
+	      goto next;
+	    }
+	  pd->is_chain = 1;
+	}
+
       pd->current_data = b[0]->current_data;
       pd->current_length = b[0]->current_length;
       pd->hdr_sz = pd->current_data - vnet_buffer (b[0])->l3_hdr_offset;
@@ -187,7 +271,7 @@ esp_decrypt_inline (vlib_main_t * vm,
 
       /* we need 4 extra bytes for HMAC calculation when ESN are used */
       if (ipsec_sa_is_set_USE_ESN (sa0) && pd->icv_sz &&
-	  (pd->current_data + pd->current_length + 4 > buffer_data_size))
+	  (lb->current_data + lb->current_length + 4 > buffer_data_size))
 	{
 	  b[0]->error = node->errors[ESP_DECRYPT_ERROR_NO_TAIL_SPACE];
 	  next[0] = ESP_DECRYPT_NEXT_DROP;
@@ -195,25 +279,58 @@ esp_decrypt_inline (vlib_main_t * vm,
 	}
 
       /* anti-reply check */
-      if (ipsec_sa_anti_replay_check (sa0, pd->seq))
+      if (ipsec_sa_in_seq_check (sa0, pd->seq, &pd->seq_hi))
 	{
 	  b[0]->error = node->errors[ESP_DECRYPT_ERROR_REPLAY];
 	  next[0] = ESP_DECRYPT_NEXT_DROP;
 	  goto next;
 	}
 
-      if (pd->current_length < cpd.icv_sz + esp_sz + cpd.iv_sz)
+      pkt_len = vlib_buffer_length_in_chain (vm, b[0]);
+      if (pkt_len < cpd.icv_sz + esp_sz + cpd.iv_sz)
 	{
 	  b[0]->error = node->errors[ESP_DECRYPT_ERROR_RUNT];
 	  next[0] = ESP_DECRYPT_NEXT_DROP;
 	  goto next;
 	}
 
-      len = pd->current_length - cpd.icv_sz;
+      len = pkt_len - cpd.icv_sz;
       current_sa_pkts += 1;
-      current_sa_bytes += pd->current_length;
+      current_sa_bytes += pkt_len;
 
-      if (PREDICT_TRUE (sa0->integ_op_id != VNET_CRYPTO_OP_NONE))
+      if (PREDICT_FALSE (pd->is_chain))
+	{
+	  if (sa0->integ_op_id != VNET_CRYPTO_OP_NONE)
+	    {
+	      vnet_crypto_op_t *op;
+	      vec_add2_aligned (ptd->chained_integ_ops, op, 1,
+				CLIB_CACHE_LINE_BYTES);
+	      vnet_crypto_op_init (op, sa0->integ_op_id);
+	      op->key_index = sa0->integ_key_index;
+	      op->flags = VNET_CRYPTO_OP_FLAG_HMAC_CHECK |
+		VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS;
+	      op->user_data = b - bufs;
+	      op->digest = vlib_buffer_get_tail (lb) - cpd.icv_sz;
+	      op->digest_len = cpd.icv_sz;
+	      op->len = len;
+	      op->chunk_index = esp_add_chain_chunks (vm, ptd, b[0], payload,
+						      cpd.icv_sz,
+						      &op->n_chunks);
+	      if (ipsec_sa_is_set_USE_ESN (sa0))
+		{
+		  /* the ESN is hashed from the tail room after the ICV */
+		  vnet_crypto_op_chunk_t *ch;
+		  u32 seq_hi = clib_host_to_net_u32 (pd->seq_hi);
+		  vec_add2 (ptd->chunks, ch, 1);
+		  ch->src = ch->dst = op->digest + cpd.icv_sz;
+		  ch->len = sizeof (seq_hi);
+		  clib_memcpy_fast (ch->src, &seq_hi, sizeof (seq_hi));
+		  op->len += sizeof (seq_hi);
+		  op->n_chunks += 1;
+		}
+	    }
+	}
+      else if (PREDICT_TRUE (sa0->integ_op_id != VNET_CRYPTO_OP_NONE))
 	{
 	  vnet_crypto_op_t *op;
 	  vec_add2_aligned (ptd->integ_ops, op, 1, CLIB_CACHE_LINE_BYTES);
@@ -229,8 +346,8 @@ esp_decrypt_inline (vlib_main_t * vm,
 	  if (ipsec_sa_is_set_USE_ESN (sa0))
 	    {
 	      /* shift ICV by 4 bytes to insert ESN */
-	      u32 seq_hi = clib_host_to_net_u32 (sa0->seq_hi);
-	      u8 tmp[ESP_MAX_ICV_SIZE], sz = sizeof (sa0->seq_hi);
+	      u32 seq_hi = clib_host_to_net_u32 (pd->seq_hi);
+	      u8 tmp[ESP_MAX_ICV_SIZE], sz = sizeof (seq_hi);
 	      clib_memcpy_fast (tmp, payload + len, ESP_MAX_ICV_SIZE);
 	      clib_memcpy_fast (payload + len, &seq_hi, sz);
 	      clib_memcpy_fast (payload + len + sz, tmp, ESP_MAX_ICV_SIZE);
@@ -245,7 +362,11 @@ esp_decrypt_inline (vlib_main_t * vm,
       if (sa0->crypto_enc_op_id != VNET_CRYPTO_OP_NONE)
 	{
 	  vnet_crypto_op_t *op;
-	  vec_add2_aligned (ptd->crypto_ops, op, 1, CLIB_CACHE_LINE_BYTES);
+	  if (PREDICT_FALSE (pd->is_chain))
+	    vec_add2_aligned (ptd->chained_crypto_ops, op, 1,
+			      CLIB_CACHE_LINE_BYTES);
+	  else
+	    vec_add2_aligned (ptd->crypto_ops, op, 1, CLIB_CACHE_LINE_BYTES);
 	  vnet_crypto_op_init (op, sa0->crypto_dec_op_id);
 	  op->key_index = sa0->crypto_key_index;
 	  op->iv = payload;
@@ -266,7 +387,7 @@ esp_decrypt_inline (vlib_main_t * vm,
 	      scratch -= (sizeof (*aad) + pd->hdr_sz);
 	      op->aad = scratch;
 
-	      esp_aad_fill (op, esp0, sa0);
+	      esp_aad_fill (op, esp0, sa0, pd->seq_hi);
 
 	      /*
 	       * we don't need to refer to the ESP header anymore so we
@@ -276,12 +397,20 @@ esp_decrypt_inline (vlib_main_t * vm,
 	      op->iv -= sizeof (sa0->salt);
 	      clib_memcpy_fast (op->iv, &sa0->salt, sizeof (sa0->salt));
 
-	      op->tag = payload + len;
+	      op->tag = vlib_buffer_get_tail (lb) - cpd.icv_sz;
 	      op->tag_len = 16;
 	    }
 	  op->src = op->dst = payload += cpd.iv_sz;
 	  op->len = len - cpd.iv_sz;
 	  op->user_data = b - bufs;
+
+	  if (PREDICT_FALSE (pd->is_chain))
+	    {
+	      op->flags |= VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS;
+	      op->chunk_index = esp_add_chain_chunks (vm, ptd, b[0], payload,
+						      cpd.icv_sz,
+						      &op->n_chunks);
+	    }
 	}
 
       /* next */
@@ -343,6 +472,15 @@ esp_decrypt_inline (vlib_main_t * vm,
 	}
     }
 
+  esp_process_chained_ops (vm, node, ptd->chained_integ_ops, ptd->chunks,
+			   bufs, nexts, ESP_DECRYPT_NEXT_DROP,
+			   ESP_DECRYPT_ERROR_INTEG_ERROR,
+			   ESP_DECRYPT_ERROR_CRYPTO_ENGINE_ERROR);
+  esp_process_chained_ops (vm, node, ptd->chained_crypto_ops, ptd->chunks,
+			   bufs, nexts, ESP_DECRYPT_NEXT_DROP,
+			   ESP_DECRYPT_ERROR_DECRYPTION_FAILED,
+			   ESP_DECRYPT_ERROR_CRYPTO_ENGINE_ERROR);
+
   /* Post decryption ronud - adjust packet data start and length and next
      node */
 
@@ -399,20 +537,36 @@ esp_decrypt_inline (vlib_main_t * vm,
        * a sequence s, s+1, s+2, s+3, ... s+n and nothing will prevent any
        * implementation, sequential or batching, from decrypting these.
        */
-      if (ipsec_sa_anti_replay_check (sa0, pd->seq))
+      if (ipsec_sa_in_seq_advance (sa0, pd->seq, pd->seq_hi))
 	{
 	  b[0]->error = node->errors[ESP_DECRYPT_ERROR_REPLAY];
 	  next[0] = ESP_DECRYPT_NEXT_DROP;
 	  goto trace;
 	}
 
-      ipsec_sa_anti_replay_advance (sa0, pd->seq);
-
-      esp_footer_t *f = (esp_footer_t *) (b[0]->data + pd->current_data +
-					  pd->current_length - sizeof (*f) -
-					  pd->icv_sz);
+      esp_footer_t *f, f_copy;
       u16 adv = pd->iv_sz + esp_sz;
-      u16 tail = sizeof (esp_footer_t) + f->pad_length + pd->icv_sz;
+      u16 tail, b0_tail;
+
+      if (PREDICT_FALSE (pd->is_chain))
+	{
+	  lb = b[0];
+	  while (lb->flags & VLIB_BUFFER_NEXT_PRESENT)
+	    lb = vlib_get_buffer (vm, lb->next_buffer);
+	  f = (esp_footer_t *) ((u8 *) vlib_buffer_get_tail (lb) -
+				sizeof (*f) - pd->icv_sz);
+	  tail = sizeof (esp_footer_t) + f->pad_length + pd->icv_sz;
+	  /* trimmed off the chain once the headers are fixed */
+	  b0_tail = 0;
+	}
+      else
+	{
+	  f = (esp_footer_t *) (b[0]->data + pd->current_data +
+				pd->current_length - sizeof (*f) -
+				pd->icv_sz);
+	  tail = b0_tail = sizeof (esp_footer_t) + f->pad_length +
+	    pd->icv_sz;
+	}
 
       if ((pd->flags & tun_flags) == 0 && !is_tun)	/* transport mode */
 	{
@@ -428,7 +582,8 @@ esp_decrypt_inline (vlib_main_t * vm,
 	    clib_memcpy_le64 (ip, old_ip, ip_hdr_sz);
 
 	  b[0]->current_data = pd->current_data + adv - ip_hdr_sz;
-	  b[0]->current_length = pd->current_length + ip_hdr_sz - tail - adv;
+	  b[0]->current_length = pd->current_length + ip_hdr_sz - b0_tail -
+	    adv;
 
 	  if (is_ip6)
 	    {
@@ -457,17 +612,41 @@ esp_decrypt_inline (vlib_main_t * vm,
 	}
       else
 	{
+	  if (PREDICT_FALSE (pd->is_chain))
+	    {
+	      u16 inner_sz = f->next_header == IP_PROTOCOL_IPV6 ?
+		sizeof (ip6_header_t) : sizeof (ip4_header_t);
+
+	      /* the inner header is read in place, pull it into the first
+	         buffer when it straddles a buffer boundary; this moves the
+	         footer, so keep a copy of it */
+	      if (pd->current_length < adv + inner_sz)
+		{
+		  f_copy = *f;
+		  f = &f_copy;
+		  if (vlib_buffer_chain_linearize (vm, b[0]) == 0 ||
+		      b[0]->current_length < adv + inner_sz)
+		    {
+		      next[0] = ESP_DECRYPT_NEXT_DROP;
+		      b[0]->error =
+			node->errors[ESP_DECRYPT_ERROR_CHAINED_BUFFER];
+		      goto trace;
+		    }
+		  pd->current_length = b[0]->current_length;
+		}
+	    }
+
 	  if (PREDICT_TRUE (f->next_header == IP_PROTOCOL_IP_IN_IP))
 	    {
 	      next[0] = ESP_DECRYPT_NEXT_IP4_INPUT;
 	      b[0]->current_data = pd->current_data + adv;
-	      b[0]->current_length = pd->current_length - adv - tail;
+	      b[0]->current_length = pd->current_length - adv - b0_tail;
 	    }
 	  else if (f->next_header == IP_PROTOCOL_IPV6)
 	    {
 	      next[0] = ESP_DECRYPT_NEXT_IP6_INPUT;
 	      b[0]->current_data = pd->current_data + adv;
-	      b[0]->current_length = pd->current_length - adv - tail;
+	      b[0]->current_length = pd->current_length - adv - b0_tail;
 	    }
 	  else
 	    {
@@ -524,6 +703,9 @@ esp_decrypt_inline (vlib_main_t * vm,
 	    }
 	}
 
+      if (PREDICT_FALSE (pd->is_chain))
+	esp_decrypt_remove_chain_tail (vm, b[0], tail);
+
     trace:
       if (PREDICT_FALSE (b[0]->flags & VLIB_BUFFER_IS_TRACED))
 	{
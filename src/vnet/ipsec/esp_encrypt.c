@@ -24,6 +24,7 @@
 
 #include <vnet/ipsec/ipsec.h>
 #include <vnet/ipsec/esp.h>
+#include <vnet/ipsec/ipsec_tun.h>
 
 #define foreach_esp_encrypt_next                   \
 _(DROP, "error-drop")                              \
@@ -43,8 +44,8 @@ typedef enum
  _(RX_PKTS, "ESP pkts received")                                \
  _(SEQ_CYCLED, "sequence number cycled (packet dropped)")       \
  _(CRYPTO_ENGINE_ERROR, "crypto engine error (packet dropped)") \
- _(CHAINED_BUFFER, "chained buffers (packet dropped)")          \
- _(NO_TRAILER_SPACE, "no trailer space (packet dropped)")
+ _(NO_BUFFERS, "no buffers (packet dropped)")                  \
+ _(CRYPTO_QUEUE_FULL, "crypto queue full (packet dropped)")
 
 typedef enum
 {
@@ -89,9 +90,11 @@ format_esp_encrypt_trace (u8 * s, va_list * args)
   return s;
 }
 
-/* pad packet in input buffer */
+/* pad packet in the last buffer of the chain, if that one is full the
+   trailer goes to a new buffer appended to the chain */
 static_always_inline u8 *
-esp_add_footer_and_icv (vlib_buffer_t * b, u8 block_size, u8 icv_sz,
+esp_add_footer_and_icv (vlib_main_t * vm, vlib_buffer_t * b,
+			vlib_buffer_t ** last, u8 block_size, u8 icv_sz,
 			u16 * next, vlib_node_runtime_t * node,
 			u16 buffer_data_size)
 {
@@ -100,24 +103,47 @@ esp_add_footer_and_icv (vlib_buffer_t * b, u8 block_size, u8 icv_sz,
     0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x00, 0x00,
   };
 
-  u16 min_length = b->current_length + sizeof (esp_footer_t);
-  u16 new_length = round_pow2 (min_length, block_size);
+  vlib_buffer_t *lb = last[0];
+  u32 min_length = vlib_buffer_length_in_chain (vm, b) +
+    sizeof (esp_footer_t);
+  u32 new_length = round_pow2 (min_length, block_size);
   u8 pad_bytes = new_length - min_length;
-  esp_footer_t *f = (esp_footer_t *) (vlib_buffer_get_current (b) +
-				      new_length - sizeof (esp_footer_t));
+  u16 tail_sz = pad_bytes + sizeof (esp_footer_t) + icv_sz;
+  esp_footer_t *f;
 
-  if (b->current_data + new_length + icv_sz > buffer_data_size)
+  if (PREDICT_FALSE (lb->current_data + lb->current_length + tail_sz >
+		     buffer_data_size))
     {
-      b->error = node->errors[ESP_ENCRYPT_ERROR_NO_TRAILER_SPACE];
-      next[0] = ESP_ENCRYPT_NEXT_DROP;
-      return 0;
+      u32 bi;
+
+      if (vlib_buffer_alloc (vm, &bi, 1) != 1)
+	{
+	  b->error = node->errors[ESP_ENCRYPT_ERROR_NO_BUFFERS];
+	  next[0] = ESP_ENCRYPT_NEXT_DROP;
+	  return 0;
+	}
+      if (lb == b)
+	{
+	  b->total_length_not_including_first_buffer = 0;
+	  b->flags |= VLIB_BUFFER_TOTAL_LENGTH_VALID;
+	}
+      lb->next_buffer = bi;
+      lb->flags |= VLIB_BUFFER_NEXT_PRESENT;
+      lb = last[0] = vlib_get_buffer (vm, bi);
+      lb->current_data = 0;
+      lb->current_length = 0;
+      lb->flags &= ~VLIB_BUFFER_NEXT_PRESENT;
     }
 
+  f = (esp_footer_t *) ((u8 *) vlib_buffer_get_tail (lb) + pad_bytes);
+
   if (pad_bytes)
     clib_memcpy_fast ((u8 *) f - pad_bytes, pad_data, pad_bytes);
 
   f->pad_length = pad_bytes;
-  b->current_length = new_length + icv_sz;
+  lb->current_length += tail_sz;
+  if (lb != b)
+    b->total_length_not_including_first_buffer += tail_sz;
   return &f->next_header;
 }
 
@@ -232,6 +258,26 @@ typedef struct
 
 STATIC_ASSERT_SIZEOF (esp_gcm_nonce_t, 12);
 
+static_always_inline void
+esp_async_submit (vlib_main_t * vm, vlib_node_runtime_t * node,
+		  vnet_crypto_async_frame_t * f)
+{
+  if (f->n_elts == 0)
+    {
+      vnet_crypto_async_free_frame (vm, f);
+      return;
+    }
+
+  if (PREDICT_FALSE (vnet_crypto_async_submit_open_frame (vm, f) < 0))
+    {
+      vlib_node_increment_counter (vm, node->node_index,
+				   ESP_ENCRYPT_ERROR_CRYPTO_QUEUE_FULL,
+				   f->n_elts);
+      vlib_buffer_free (vm, f->buffer_indices, f->n_elts);
+      vnet_crypto_async_free_frame (vm, f);
+    }
+}
+
 always_inline uword
 esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 		    vlib_frame_t * frame, int is_ip6, int is_tun)
@@ -249,10 +295,23 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   u32 current_sa_bytes = 0, spi = 0;
   u8 block_sz = 0, iv_sz = 0, icv_sz = 0;
   ipsec_sa_t *sa0 = 0;
+  int is_async = im->async_mode && vnet_crypto_async_is_enabled ();
+  vnet_crypto_async_frame_t *async_frame = 0;
+  u32 sync_bi[VLIB_FRAME_SIZE], n_sync = 0;
+  u16 sync_nexts[VLIB_FRAME_SIZE], async_next = 0;
+  vlib_buffer_t *lb;
+
+  if (is_async)
+    async_next = is_ip6 ?
+      (is_tun ? im->esp6_enc_tun_post_next : im->esp6_enc_post_next) :
+      (is_tun ? im->esp4_enc_tun_post_next : im->esp4_enc_post_next);
 
   vlib_get_buffers (vm, from, b, n_left);
   vec_reset_length (ptd->crypto_ops);
   vec_reset_length (ptd->integ_ops);
+  vec_reset_length (ptd->chained_crypto_ops);
+  vec_reset_length (ptd->chained_integ_ops);
+  vec_reset_length (ptd->chunks);
 
   while (n_left > 0)
     {
@@ -262,6 +321,8 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
       u8 *payload, *next_hdr_ptr;
       u16 payload_len;
       u32 hdr_len;
+      i32 async_elt = -1;
+      u64 seq = 0;
 
       if (n_left > 2)
 	{
@@ -275,11 +336,12 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 
       if (is_tun)
 	{
-	  /* we are on a ipsec tunnel's feature arc */
-	  u32 next0;
-	  sa_index0 = *(u32 *) vnet_feature_next_with_data (&next0, b[0],
-							    sizeof
-							    (sa_index0));
+	  /* we are on a ipsec tunnel's feature arc, the feature data is
+	     the tunnel protection whose output SA a rekey swaps */
+	  u32 next0, itpi0;
+	  itpi0 = *(u32 *) vnet_feature_next_with_data (&next0, b[0],
+							sizeof (itpi0));
+	  sa_index0 = ipsec_tun_protect_get_sa_out (itpi0);
 	  next[0] = next0;
 	}
       else
@@ -302,14 +364,12 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 	  iv_sz = sa0->crypto_iv_size;
 	}
 
-      if (vlib_buffer_chain_linearize (vm, b[0]) != 1)
-	{
-	  b[0]->error = node->errors[ESP_ENCRYPT_ERROR_CHAINED_BUFFER];
-	  next[0] = ESP_ENCRYPT_NEXT_DROP;
-	  goto trace;
-	}
+      /* the trailer goes to the last buffer of a chain */
+      lb = b[0];
+      while (lb->flags & VLIB_BUFFER_NEXT_PRESENT)
+	lb = vlib_get_buffer (vm, lb->next_buffer);
 
-      if (PREDICT_FALSE (esp_seq_advance (sa0)))
+      if (PREDICT_FALSE (esp_seq_next (sa0, sa_index0, ptd, &seq)))
 	{
 	  b[0]->error = node->errors[ESP_ENCRYPT_ERROR_SEQ_CYCLED];
 	  next[0] = ESP_ENCRYPT_NEXT_DROP;
@@ -322,12 +382,12 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
       if (ipsec_sa_is_set_IS_TUNNEL (sa0))
 	{
 	  payload = vlib_buffer_get_current (b[0]);
-	  next_hdr_ptr = esp_add_footer_and_icv (b[0], block_sz, icv_sz,
-						 next, node,
+	  next_hdr_ptr = esp_add_footer_and_icv (vm, b[0], &lb, block_sz,
+						 icv_sz, next, node,
 						 buffer_data_size);
 	  if (!next_hdr_ptr)
 	    goto trace;
-	  payload_len = b[0]->current_length;
+	  payload_len = vlib_buffer_length_in_chain (vm, b[0]);
 
 	  /* ESP header */
 	  hdr_len += sizeof (*esp);
@@ -386,12 +446,12 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 
 	  vlib_buffer_advance (b[0], ip_len);
 	  payload = vlib_buffer_get_current (b[0]);
-	  next_hdr_ptr = esp_add_footer_and_icv (b[0], block_sz, icv_sz,
-						 next, node,
+	  next_hdr_ptr = esp_add_footer_and_icv (vm, b[0], &lb, block_sz,
+						 icv_sz, next, node,
 						 buffer_data_size);
 	  if (!next_hdr_ptr)
 	    goto trace;
-	  payload_len = b[0]->current_length;
+	  payload_len = vlib_buffer_length_in_chain (vm, b[0]);
 
 	  /* ESP header */
 	  hdr_len += sizeof (*esp);
@@ -452,17 +512,50 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 	}
 
       esp->spi = spi;
-      esp->seq = clib_net_to_host_u32 (sa0->seq);
+      esp->seq = clib_net_to_host_u32 ((u32) seq);
+
+      /* chained packets are always processed synchronously */
+      if (is_async && lb == b[0] &&
+	  (sa0->crypto_enc_op_id || sa0->integ_op_id))
+	{
+	  if (!async_frame || vnet_crypto_async_frame_is_full (async_frame))
+	    {
+	      if (async_frame)
+		esp_async_submit (vm, node, async_frame);
+	      async_frame = vnet_crypto_async_get_frame (vm);
+	    }
+	  if (PREDICT_FALSE (!async_frame))
+	    {
+	      b[0]->error = node->errors[ESP_ENCRYPT_ERROR_CRYPTO_QUEUE_FULL];
+	      next[0] = ESP_ENCRYPT_NEXT_DROP;
+	      goto trace;
+	    }
+	  /* the post node resumes the packet where it would have gone */
+	  esp_post_data (b[0])->next_index = next[0];
+	  async_elt = vnet_crypto_async_add_elt (async_frame, from[b - bufs],
+						 async_next);
+	}
 
       if (sa0->crypto_enc_op_id)
 	{
 	  vnet_crypto_op_t *op;
-	  vec_add2_aligned (ptd->crypto_ops, op, 1, CLIB_CACHE_LINE_BYTES);
-	  vnet_crypto_op_init (op, sa0->crypto_enc_op_id);
+	  if (async_elt >= 0)
+	    op = vnet_crypto_async_add_op (async_frame, 0,
+					   sa0->crypto_enc_op_id, async_elt);
+	  else
+	    {
+	      if (PREDICT_FALSE (lb != b[0]))
+		vec_add2_aligned (ptd->chained_crypto_ops, op, 1,
+				  CLIB_CACHE_LINE_BYTES);
+	      else
+		vec_add2_aligned (ptd->crypto_ops, op, 1,
+				  CLIB_CACHE_LINE_BYTES);
+	      vnet_crypto_op_init (op, sa0->crypto_enc_op_id);
+	      op->user_data = b - bufs;
+	    }
 	  op->src = op->dst = payload;
 	  op->key_index = sa0->crypto_key_index;
 	  op->len = payload_len - icv_sz;
-	  op->user_data = b - bufs;
 
 	  if (ipsec_sa_is_set_IS_AEAD (sa0))
 	    {
@@ -472,41 +565,80 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 	       */
 	      op->aad = payload - hdr_len - sizeof (esp_aead_t);
 
-	      esp_aad_fill (op, esp, sa0);
+	      esp_aad_fill (op, esp, sa0, seq >> 32);
 
-	      op->tag = payload + op->len;
+	      op->tag = vlib_buffer_get_tail (lb) - icv_sz;
 	      op->tag_len = 16;
 
 	      u64 *iv = (u64 *) (payload - iv_sz);
-	      nonce->salt = sa0->salt;
-	      nonce->iv = *iv = clib_host_to_net_u64 (sa0->gcm_iv_counter++);
-	      op->iv = (u8 *) nonce;
-	      nonce++;
+	      esp_gcm_nonce_t *n;
+
+	      /* async ops outlive this frame, keep the nonce in the buffer */
+	      if (async_elt >= 0)
+		n = (esp_gcm_nonce_t *) (op->aad - sizeof (*n));
+	      else
+		n = nonce++;
+
+	      n->salt = sa0->salt;
+	      /* the counter is not shared safely between workers, while
+	         the sequence numbers are unique to each packet */
+	      n->iv = *iv = clib_host_to_net_u64 (im->sa_multi_worker ? seq :
+						  sa0->gcm_iv_counter++);
+	      op->iv = (u8 *) n;
 	    }
 	  else
 	    {
 	      op->iv = payload - iv_sz;
 	      op->flags = VNET_CRYPTO_OP_FLAG_INIT_IV;
 	    }
+
+	  if (PREDICT_FALSE (lb != b[0]))
+	    {
+	      op->flags |= VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS;
+	      op->chunk_index = esp_add_chain_chunks (vm, ptd, b[0], payload,
+						      icv_sz, &op->n_chunks);
+	    }
 	}
 
       if (sa0->integ_op_id)
 	{
 	  vnet_crypto_op_t *op;
-	  vec_add2_aligned (ptd->integ_ops, op, 1, CLIB_CACHE_LINE_BYTES);
-	  vnet_crypto_op_init (op, sa0->integ_op_id);
+	  if (async_elt >= 0)
+	    op = vnet_crypto_async_add_op (async_frame, 1, sa0->integ_op_id,
+					   async_elt);
+	  else
+	    {
+	      if (PREDICT_FALSE (lb != b[0]))
+		vec_add2_aligned (ptd->chained_integ_ops, op, 1,
+				  CLIB_CACHE_LINE_BYTES);
+	      else
+		vec_add2_aligned (ptd->integ_ops, op, 1,
+				  CLIB_CACHE_LINE_BYTES);
+	      vnet_crypto_op_init (op, sa0->integ_op_id);
+	      op->user_data = b - bufs;
+	    }
 	  op->src = payload - iv_sz - sizeof (esp_header_t);
-	  op->digest = payload + payload_len - icv_sz;
+	  op->digest = vlib_buffer_get_tail (lb) - icv_sz;
 	  op->key_index = sa0->integ_key_index;
 	  op->digest_len = icv_sz;
 	  op->len = payload_len - icv_sz + iv_sz + sizeof (esp_header_t);
-	  op->user_data = b - bufs;
 	  if (ipsec_sa_is_set_USE_ESN (sa0))
 	    {
-	      u32 seq_hi = clib_net_to_host_u32 (sa0->seq_hi);
+	      u32 seq_hi = clib_net_to_host_u32 (seq >> 32);
 	      clib_memcpy_fast (op->digest, &seq_hi, sizeof (seq_hi));
 	      op->len += sizeof (seq_hi);
 	    }
+
+	  if (PREDICT_FALSE (lb != b[0]))
+	    {
+	      /* the ESN is hashed from where the digest goes */
+	      i16 tail_sz = icv_sz;
+	      if (ipsec_sa_is_set_USE_ESN (sa0))
+		tail_sz -= sizeof (u32);
+	      op->flags |= VNET_CRYPTO_OP_FLAG_CHAINED_BUFFERS;
+	      op->chunk_index = esp_add_chain_chunks (vm, ptd, b[0], op->src,
+						      tail_sz, &op->n_chunks);
+	    }
 	}
 
       vlib_buffer_advance (b[0], 0LL - hdr_len);
@@ -521,12 +653,15 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 						    sizeof (*tr));
 	  tr->sa_index = sa_index0;
 	  tr->spi = sa0->spi;
-	  tr->seq = sa0->seq;
-	  tr->sa_seq_hi = sa0->seq_hi;
+	  tr->seq = seq;
+	  tr->sa_seq_hi = seq >> 32;
 	  tr->udp_encap = ipsec_sa_is_set_UDP_ENCAP (sa0);
 	  tr->crypto_alg = sa0->crypto_alg;
 	  tr->integ_alg = sa0->integ_alg;
 	}
+
+      if (is_async && async_elt < 0)
+	sync_bi[n_sync++] = b - bufs;
       /* next */
       n_left -= 1;
       next += 1;
@@ -536,12 +671,82 @@ esp_encrypt_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   vlib_increment_combined_counter (&ipsec_sa_counters, thread_index,
 				   current_sa_index, current_sa_packets,
 				   current_sa_bytes);
-  esp_process_ops (vm, node, ptd->crypto_ops, bufs, nexts);
-  esp_process_ops (vm, node, ptd->integ_ops, bufs, nexts);
 
   vlib_node_increment_counter (vm, node->node_index,
 			       ESP_ENCRYPT_ERROR_RX_PKTS, frame->n_vectors);
 
+  esp_process_chained_ops (vm, node, ptd->chained_crypto_ops, ptd->chunks,
+			   bufs, nexts, ESP_ENCRYPT_NEXT_DROP,
+			   ESP_ENCRYPT_ERROR_CRYPTO_ENGINE_ERROR,
+			   ESP_ENCRYPT_ERROR_CRYPTO_ENGINE_ERROR);
+  esp_process_chained_ops (vm, node, ptd->chained_integ_ops, ptd->chunks,
+			   bufs, nexts, ESP_ENCRYPT_NEXT_DROP,
+			   ESP_ENCRYPT_ERROR_CRYPTO_ENGINE_ERROR,
+			   ESP_ENCRYPT_ERROR_CRYPTO_ENGINE_ERROR);
+
+  if (is_async)
+    {
+      u32 i;
+
+      if (async_frame)
+	esp_async_submit (vm, node, async_frame);
+      for (i = 0; i < n_sync; i++)
+	{
+	  sync_nexts[i] = nexts[sync_bi[i]];
+	  sync_bi[i] = from[sync_bi[i]];
+	}
+      if (n_sync)
+	vlib_buffer_enqueue_to_next (vm, node, sync_bi, sync_nexts, n_sync);
+      return frame->n_vectors;
+    }
+
+  esp_process_ops (vm, node, ptd->crypto_ops, bufs, nexts);
+  esp_process_ops (vm, node, ptd->integ_ops, bufs, nexts);
+
+  vlib_buffer_enqueue_to_next (vm, node, from, nexts, frame->n_vectors);
+  return frame->n_vectors;
+}
+
+/* packets leaving async crypto continue where esp-encrypt sent them */
+always_inline uword
+esp_encrypt_post_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
+			 vlib_frame_t * frame)
+{
+  u32 *from = vlib_frame_vector_args (frame);
+  u32 n_left = frame->n_vectors;
+  vlib_buffer_t *bufs[VLIB_FRAME_SIZE], **b = bufs;
+  u16 nexts[VLIB_FRAME_SIZE], *next = nexts;
+
+  vlib_get_buffers (vm, from, b, n_left);
+
+  while (n_left >= 4)
+    {
+      if (n_left >= 8)
+	{
+	  vlib_prefetch_buffer_header (b[4], LOAD);
+	  vlib_prefetch_buffer_header (b[5], LOAD);
+	  vlib_prefetch_buffer_header (b[6], LOAD);
+	  vlib_prefetch_buffer_header (b[7], LOAD);
+	}
+
+      next[0] = esp_post_data (b[0])->next_index;
+      next[1] = esp_post_data (b[1])->next_index;
+      next[2] = esp_post_data (b[2])->next_index;
+      next[3] = esp_post_data (b[3])->next_index;
+
+      next += 4;
+      b += 4;
+      n_left -= 4;
+    }
+
+  while (n_left > 0)
+    {
+      next[0] = esp_post_data (b[0])->next_index;
+      next += 1;
+      b += 1;
+      n_left -= 1;
+    }
+
   vlib_buffer_enqueue_to_next (vm, node, from, nexts, frame->n_vectors);
   return frame->n_vectors;
 }
@@ -572,6 +777,22 @@ VLIB_REGISTER_NODE (esp4_encrypt_node) = {
 };
 /* *INDENT-ON* */
 
+VLIB_NODE_FN (esp4_encrypt_post_node) (vlib_main_t * vm,
+				       vlib_node_runtime_t * node,
+				       vlib_frame_t * from_frame)
+{
+  return esp_encrypt_post_inline (vm, node, from_frame);
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (esp4_encrypt_post_node) = {
+  .name = "esp4-encrypt-post",
+  .vector_size = sizeof (u32),
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .sibling_of = "esp4-encrypt",
+};
+/* *INDENT-ON* */
+
 VLIB_NODE_FN (esp6_encrypt_node) (vlib_main_t * vm,
 				  vlib_node_runtime_t * node,
 				  vlib_frame_t * from_frame)
@@ -598,6 +819,22 @@ VLIB_REGISTER_NODE (esp6_encrypt_node) = {
 };
 /* *INDENT-ON* */
 
+VLIB_NODE_FN (esp6_encrypt_post_node) (vlib_main_t * vm,
+				       vlib_node_runtime_t * node,
+				       vlib_frame_t * from_frame)
+{
+  return esp_encrypt_post_inline (vm, node, from_frame);
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (esp6_encrypt_post_node) = {
+  .name = "esp6-encrypt-post",
+  .vector_size = sizeof (u32),
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .sibling_of = "esp6-encrypt",
+};
+/* *INDENT-ON* */
+
 VLIB_NODE_FN (esp4_encrypt_tun_node) (vlib_main_t * vm,
 				      vlib_node_runtime_t * node,
 				      vlib_frame_t * from_frame)
@@ -643,6 +880,22 @@ VNET_FEATURE_INIT (esp4_ethernet_encrypt_tun_feat_node, static) =
 };
 /* *INDENT-ON* */
 
+VLIB_NODE_FN (esp4_encrypt_tun_post_node) (vlib_main_t * vm,
+					   vlib_node_runtime_t * node,
+					   vlib_frame_t * from_frame)
+{
+  return esp_encrypt_post_inline (vm, node, from_frame);
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (esp4_encrypt_tun_post_node) = {
+  .name = "esp4-encrypt-tun-post",
+  .vector_size = sizeof (u32),
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .sibling_of = "esp4-encrypt-tun",
+};
+/* *INDENT-ON* */
+
 VLIB_NODE_FN (esp6_encrypt_tun_node) (vlib_main_t * vm,
 				      vlib_node_runtime_t * node,
 				      vlib_frame_t * from_frame)
@@ -682,6 +935,22 @@ VNET_FEATURE_INIT (esp4o6_encrypt_tun_feat_node, static) =
 
 /* *INDENT-ON* */
 
+VLIB_NODE_FN (esp6_encrypt_tun_post_node) (vlib_main_t * vm,
+					   vlib_node_runtime_t * node,
+					   vlib_frame_t * from_frame)
+{
+  return esp_encrypt_post_inline (vm, node, from_frame);
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (esp6_encrypt_tun_post_node) = {
+  .name = "esp6-encrypt-tun-post",
+  .vector_size = sizeof (u32),
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .sibling_of = "esp6-encrypt-tun",
+};
+/* *INDENT-ON* */
+
 typedef struct
 {
   u32 sa_index;
@@ -727,12 +996,13 @@ esp_no_crypto_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 
   while (n_left > 0)
     {
-      u32 next0;
+      u32 next0, itpi0;
       u32 sa_index0;
 
       /* packets are always going to be dropped, but get the sa_index */
-      sa_index0 = *(u32 *) vnet_feature_next_with_data (&next0, b[0],
-							sizeof (sa_index0));
+      itpi0 = *(u32 *) vnet_feature_next_with_data (&next0, b[0],
+						    sizeof (itpi0));
+      sa_index0 = ipsec_tun_protect_get_sa_out (itpi0);
 
       next[0] = ESP_NO_CRYPTO_NEXT_DROP;
 
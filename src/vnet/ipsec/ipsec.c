@@ -24,6 +24,7 @@
 #include <vnet/ipsec/ipsec.h>
 #include <vnet/ipsec/esp.h>
 #include <vnet/ipsec/ah.h>
+#include <vnet/ipsec/ipsec_spd_lookup.h>
 
 ipsec_main_t ipsec_main;
 
@@ -258,6 +259,23 @@ ipsec_select_esp_backend (ipsec_main_t * im, u32 backend_idx)
   return 0;
 }
 
+/**
+ * @brief Have the ESP encrypt nodes submit their crypto work to the async
+ * crypto engine instead of processing it inline.
+ */
+void
+ipsec_set_async_mode (u32 is_enabled)
+{
+  ipsec_main_t *im = &ipsec_main;
+
+  is_enabled = ! !is_enabled;
+  if (im->async_mode == is_enabled)
+    return;
+
+  im->async_mode = is_enabled;
+  vnet_crypto_request_async_mode (is_enabled);
+}
+
 static clib_error_t *
 ipsec_init (vlib_main_t * vm)
 {
@@ -307,6 +325,15 @@ ipsec_init (vlib_main_t * vm)
   ASSERT (0 == rv);
   (void) (rv);			// avoid warning
 
+  im->esp4_enc_post_next =
+    vnet_crypto_register_post_node (vm, "esp4-encrypt-post");
+  im->esp6_enc_post_next =
+    vnet_crypto_register_post_node (vm, "esp6-encrypt-post");
+  im->esp4_enc_tun_post_next =
+    vnet_crypto_register_post_node (vm, "esp4-encrypt-tun-post");
+  im->esp6_enc_tun_post_next =
+    vnet_crypto_register_post_node (vm, "esp6-encrypt-tun-post");
+
   if ((error = vlib_call_init_function (vm, ipsec_cli_init)))
     return error;
 
@@ -410,6 +437,71 @@ ipsec_init (vlib_main_t * vm)
 
 VLIB_INIT_FUNCTION (ipsec_init);
 
+static clib_error_t *
+ipsec_config (vlib_main_t * vm, unformat_input_t * input)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_per_thread_data_t *ptd;
+  uword memory_size;
+  f64 overlap;
+  u32 tmp;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "spd-flow-cache"))
+	im->spd_flow_cache_enabled = 1;
+      else if (unformat (input, "spd-flow-cache-hash-buckets %d", &tmp))
+	im->spd_flow_cache_hash_buckets = tmp;
+      else if (unformat (input, "spd-flow-cache-hash-memory %U",
+			 unformat_memory_size, &memory_size))
+	im->spd_flow_cache_hash_memory = memory_size;
+      else if (unformat (input, "spd-flow-cache-max-entries %d", &tmp))
+	im->spd_flow_cache_max_entries = tmp;
+      else if (unformat (input, "sa-multi-worker"))
+	im->sa_multi_worker = 1;
+      else if (unformat (input, "sa-seq-block-size %d", &tmp))
+	{
+	  if (tmp == 0)
+	    return clib_error_return (0, "invalid sa-seq-block-size");
+	  im->sa_seq_block_size = tmp;
+	}
+      else if (unformat (input, "tun-protect-overlap %f", &overlap))
+	{
+	  if (overlap < 0)
+	    return clib_error_return (0, "invalid tun-protect-overlap");
+	  im->tun_protect_overlap = overlap;
+	}
+      else
+	return clib_error_return (0, "unknown input '%U'",
+				  format_unformat_error, input);
+    }
+
+  if (im->spd_flow_cache_enabled)
+    {
+      vec_foreach (ptd, im->ptd) ipsec_spd_flow_cache_init (ptd);
+    }
+
+  if (im->sa_multi_worker)
+    {
+      u32 n_workers = clib_max (1, vlib_num_workers ());
+
+      /* by default the workers share the window evenly */
+      if (0 == im->sa_seq_block_size)
+	im->sa_seq_block_size =
+	  clib_max (1, IPSEC_SA_ANTI_REPLAY_WINDOW_SIZE / n_workers);
+      else if ((u64) im->sa_seq_block_size * n_workers >
+	       IPSEC_SA_ANTI_REPLAY_WINDOW_SIZE)
+	return clib_error_return (0, "sa-seq-block-size %u with %u workers "
+				  "exceeds the anti-replay window of %u",
+				  im->sa_seq_block_size, n_workers,
+				  IPSEC_SA_ANTI_REPLAY_WINDOW_SIZE);
+    }
+
+  return 0;
+}
+
+VLIB_CONFIG_FUNCTION (ipsec_config, "ipsec");
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
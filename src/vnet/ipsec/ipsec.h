@@ -21,6 +21,9 @@
 
 #include <vppinfra/types.h>
 #include <vppinfra/cache.h>
+#include <vppinfra/bihash_16_8.h>
+#include <vppinfra/bihash_24_8.h>
+#include <vppinfra/bihash_40_8.h>
 
 #include <vnet/ipsec/ipsec_spd.h>
 #include <vnet/ipsec/ipsec_spd_policy.h>
@@ -82,12 +85,50 @@ typedef struct
   u8 icv_size;
 } ipsec_main_integ_alg_t;
 
+/**
+ * @brief A block of outbound sequence numbers reserved by a worker,
+ * from next up to, not including, end.
+ */
+typedef struct
+{
+  u64 next;
+  u64 end;
+} ipsec_sa_seq_block_t;
+
 typedef struct
 {
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
   vnet_crypto_op_t *crypto_ops;
   vnet_crypto_op_t *integ_ops;
+  /* ops on packets spanning a buffer chain, and their chunks */
+  vnet_crypto_op_t *chained_crypto_ops;
+  vnet_crypto_op_t *chained_integ_ops;
+  vnet_crypto_op_chunk_t *chunks;
+
+  /* per-flow cache of outbound SPD lookup results; entries stored in an
+     older epoch are stale */
+  clib_bihash_16_8_t spd4_flow_cache;
+  clib_bihash_40_8_t spd6_flow_cache;
+  u32 spd4_flow_cache_n_entries;
+  u32 spd6_flow_cache_n_entries;
+  u32 spd4_flow_cache_epoch;
+  u32 spd6_flow_cache_epoch;
+  /* the SPD generation the current epochs belong to */
+  u32 spd_flow_cache_generation;
+
+  /* multi-worker mode sequence number blocks, indexed by SA */
+  ipsec_sa_seq_block_t *seq_blocks;
 } ipsec_per_thread_data_t;
 
+/**
+ * @brief The policies that share one key in the SPD lookup hashes,
+ * sorted in SPD order.
+ */
+typedef struct ipsec_spd_bucket_t_
+{
+  u32 *policies;
+} ipsec_spd_bucket_t;
+
 typedef struct
 {
   /* pool of tunnel instances */
@@ -96,6 +137,26 @@ typedef struct
   ipsec_sa_t *sad;
   /* pool of policies */
   ipsec_policy_t *policies;
+  /* pool of SPD lookup buckets */
+  ipsec_spd_bucket_t *spd_buckets;
+
+  /* compiled SPD lookup hashes */
+  clib_bihash_16_8_t spd4_lookup;
+  clib_bihash_40_8_t spd6_lookup;
+
+  /* inbound SA lookup hashes, keyed on tunnel destination, SPI and
+     protocol */
+  clib_bihash_16_8_t sa4_in_lookup;
+  clib_bihash_24_8_t sa6_in_lookup;
+
+  /* bumped on each policy change, invalidates the SPD flow caches */
+  u32 spd_generation;
+
+  /* SPD flow cache config */
+  u8 spd_flow_cache_enabled;
+  u32 spd_flow_cache_hash_buckets;
+  uword spd_flow_cache_hash_memory;
+  u32 spd_flow_cache_max_entries;
 
   uword *tunnel_index_by_key;
 
@@ -142,6 +203,25 @@ typedef struct
   u32 esp4_no_crypto_tun_feature_index;
   u32 esp6_no_crypto_tun_feature_index;
 
+  /* multi-worker SA mode: workers reserve outbound sequence numbers in
+     blocks of sa_seq_block_size and share a lock-free replay window.
+     The blocks of all workers fit in the anti-replay window, so that a
+     peer does not drop the numbers of a worker that fell behind. */
+  u8 sa_multi_worker;
+  u32 sa_seq_block_size;
+
+  /* seconds the input SAs replaced by a tunnel protection update are
+     still accepted */
+  f64 tun_protect_overlap;
+
+  /* async crypto mode, and crypto-dispatch next indices of the post nodes
+     where encrypted packets resume */
+  u8 async_mode;
+  u16 esp4_enc_post_next;
+  u16 esp6_enc_post_next;
+  u16 esp4_enc_tun_post_next;
+  u16 esp6_enc_tun_post_next;
+
   /* pool of ah backends */
   ipsec_ah_backend_t *ah_backends;
   /* pool of esp backends */
@@ -179,6 +259,8 @@ clib_error_t *ipsec_add_del_sa_sess_cb (ipsec_main_t * im, u32 sa_index,
 
 clib_error_t *ipsec_check_support_cb (ipsec_main_t * im, ipsec_sa_t * sa);
 
+void ipsec_set_async_mode (u32 is_enabled);
+
 extern vlib_node_registration_t esp4_encrypt_node;
 extern vlib_node_registration_t esp4_decrypt_node;
 extern vlib_node_registration_t ah4_encrypt_node;
@@ -245,6 +327,141 @@ ipsec_sa_get (u32 sa_index)
 void ipsec_add_feature (const char *arc_name, const char *node_name,
 			u32 * out_feature_index);
 
+/**
+ * @brief Anti-replay check of a received packet, before it is decrypted.
+ *  seq is in host byte order.
+ * @param seq_hi returns the ESN high sequence number to authenticate the
+ * packet with
+ * @return 1 if the packet is a replay
+ */
+always_inline int
+ipsec_sa_in_seq_check (ipsec_sa_t * sa, u32 seq, u32 * seq_hi)
+{
+  int rv;
+
+  if (PREDICT_FALSE (ipsec_main.sa_multi_worker))
+    return (ipsec_sa_mw_anti_replay_check (sa, seq, seq_hi));
+
+  rv = ipsec_sa_anti_replay_check (sa, seq);
+  *seq_hi = sa->seq_hi;
+
+  return (rv);
+}
+
+/**
+ * @brief Anti-replay check again, once the packet is authenticated, and
+ * advance the window.
+ * @return 1 if the packet is a replay
+ */
+always_inline int
+ipsec_sa_in_seq_advance (ipsec_sa_t * sa, u32 seq, u32 seq_hi)
+{
+  if (PREDICT_FALSE (ipsec_main.sa_multi_worker))
+    return (ipsec_sa_mw_anti_replay_advance (sa, seq, seq_hi));
+
+  if (ipsec_sa_anti_replay_check (sa, seq))
+    return 1;
+
+  ipsec_sa_anti_replay_advance (sa, seq);
+
+  return 0;
+}
+
+/**
+ * @brief Inbound SA lookup hit and fallback counters, indexed by is_ipv6
+ */
+extern vlib_simple_counter_main_t ipsec_sa_in_lookup_hits;
+extern vlib_simple_counter_main_t ipsec_sa_in_lookup_fallbacks;
+
+extern u8 *format_ipsec_sa_in_lookup (u8 * s, va_list * args);
+
+/**
+ * @brief Build the inbound SA lookup keys.
+ * Addresses and SPI are in network byte order, proto is the IP protocol
+ * that carries the SA (ESP or AH).
+ */
+always_inline void
+ipsec_sa_in_mk_key4 (clib_bihash_kv_16_8_t * kv,
+		     const ip4_address_t * da, u32 spi, u8 proto)
+{
+  kv->key[0] = (u64) da->as_u32 << 32 | spi;
+  kv->key[1] = proto;
+}
+
+always_inline void
+ipsec_sa_in_mk_key6 (clib_bihash_kv_24_8_t * kv,
+		     const ip6_address_t * da, u32 spi, u8 proto)
+{
+  kv->key[0] = da->as_u64[0];
+  kv->key[1] = da->as_u64[1];
+  kv->key[2] = (u64) spi << 8 | proto;
+}
+
+/**
+ * @brief Whether a hit in the inbound SA lookup can be used for a packet
+ * received on an interface bound to the SPD: the SA must be used by one of
+ * the SPD's inbound protect policies, and not by a tunnel protection.
+ */
+always_inline int
+ipsec_sa_in_lookup_is_valid (const ipsec_spd_t * spd, index_t sai,
+			     const ipsec_sa_t * s)
+{
+  return (sai < vec_len (spd->in_protect_sa_refs) &&
+	  spd->in_protect_sa_refs[sai] && !ipsec_sa_is_set_IS_PROTECT (s));
+}
+
+/**
+ * @brief Find the tunnel mode SA a received packet belongs to, from its
+ * addresses and SPI, without walking the SPD.
+ * @param policy_index set to the SPD policy the packet matches on a hit
+ * @return the SA index, or INDEX_INVALID to fall back to the SPD lookup
+ */
+always_inline index_t
+ipsec_sa_in_lookup_ip4 (const ipsec_spd_t * spd, const ip4_address_t * sa,
+			const ip4_address_t * da, u32 spi, u8 proto,
+			u32 * policy_index)
+{
+  clib_bihash_kv_16_8_t kv;
+  ipsec_sa_t *s;
+
+  ipsec_sa_in_mk_key4 (&kv, da, spi, proto);
+
+  if (clib_bihash_search_inline_16_8 (&ipsec_main.sa4_in_lookup, &kv))
+    return (INDEX_INVALID);
+
+  s = ipsec_sa_get (kv.value);
+
+  if (sa->as_u32 != s->tunnel_src_addr.ip4.as_u32 ||
+      !ipsec_sa_in_lookup_is_valid (spd, kv.value, s))
+    return (INDEX_INVALID);
+
+  *policy_index = spd->in_protect_sa_policy[kv.value];
+  return (kv.value);
+}
+
+always_inline index_t
+ipsec_sa_in_lookup_ip6 (const ipsec_spd_t * spd, const ip6_address_t * sa,
+			const ip6_address_t * da, u32 spi, u8 proto,
+			u32 * policy_index)
+{
+  clib_bihash_kv_24_8_t kv;
+  ipsec_sa_t *s;
+
+  ipsec_sa_in_mk_key6 (&kv, da, spi, proto);
+
+  if (clib_bihash_search_inline_24_8 (&ipsec_main.sa6_in_lookup, &kv))
+    return (INDEX_INVALID);
+
+  s = ipsec_sa_get (kv.value);
+
+  if (!ip6_address_is_equal (sa, &s->tunnel_src_addr.ip6) ||
+      !ipsec_sa_in_lookup_is_valid (spd, kv.value, s))
+    return (INDEX_INVALID);
+
+  *policy_index = spd->in_protect_sa_policy[kv.value];
+  return (kv.value);
+}
+
 #endif /* __IPSEC_H__ */
 
 /*
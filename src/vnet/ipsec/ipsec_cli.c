@@ -24,6 +24,7 @@
 
 #include <vnet/ipsec/ipsec.h>
 #include <vnet/ipsec/ipsec_tun.h>
+#include <vnet/ipsec/ipsec_spd_lookup.h>
 
 static clib_error_t *
 set_interface_spd_command_fn (vlib_main_t * vm,
@@ -534,6 +535,73 @@ VLIB_CLI_COMMAND (show_ipsec_spd_command, static) = {
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+show_ipsec_spd_lookup_command_fn (vlib_main_t * vm,
+				  unformat_input_t * input,
+				  vlib_cli_command_t * cmd)
+{
+  ipsec_main_t *im = &ipsec_main;
+  u32 spdi = ~0, verbose = 0;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "%u", &spdi))
+	;
+      else if (unformat (input, "verbose"))
+	verbose = 1;
+      else
+	break;
+    }
+
+  if (~0 != spdi)
+    vlib_cli_output (vm, "%U", format_ipsec_spd_lookup, spdi);
+  else
+    {
+      /* *INDENT-OFF* */
+      pool_foreach_index (spdi, im->spds, ({
+        vlib_cli_output (vm, "%U", format_ipsec_spd_lookup, spdi);
+      }));
+      /* *INDENT-ON* */
+    }
+
+  vlib_cli_output (vm, "%U", format_bihash_16_8, &im->spd4_lookup, verbose);
+  vlib_cli_output (vm, "%U", format_bihash_40_8, &im->spd6_lookup, verbose);
+  vlib_cli_output (vm, "%U", format_ipsec_spd_flow_cache);
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_ipsec_spd_lookup_command, static) = {
+    .path = "show ipsec spd-lookup",
+    .short_help = "show ipsec spd-lookup [index] [verbose]",
+    .function = show_ipsec_spd_lookup_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+show_ipsec_sa_lookup_command_fn (vlib_main_t * vm,
+				 unformat_input_t * input,
+				 vlib_cli_command_t * cmd)
+{
+  int verbose = 0;
+
+  if (unformat (input, "verbose"))
+    verbose = 1;
+
+  vlib_cli_output (vm, "%U", format_ipsec_sa_in_lookup, verbose);
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_ipsec_sa_lookup_command, static) = {
+    .path = "show ipsec sa-lookup",
+    .short_help = "show ipsec sa-lookup [verbose]",
+    .function = show_ipsec_sa_lookup_command_fn,
+};
+/* *INDENT-ON* */
+
 static clib_error_t *
 show_ipsec_tunnel_command_fn (vlib_main_t * vm,
 			      unformat_input_t * input,
@@ -969,6 +1037,35 @@ VLIB_CLI_COMMAND (ipsec_tun_protect_show_node, static) =
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+ipsec_tun_protect_overlap_cmd (vlib_main_t * vm,
+			       unformat_input_t * input,
+			       vlib_cli_command_t * cmd)
+{
+  f64 overlap;
+
+  if (!unformat (input, "%f", &overlap) || overlap < 0)
+    return clib_error_return (0, "expected overlap in seconds, got '%U'",
+			      format_unformat_error, input);
+
+  ipsec_tun_protect_set_overlap (overlap);
+
+  return NULL;
+}
+
+/**
+ * Set how long the input SAs replaced by a tunnel protection update
+ * are still accepted
+ */
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (ipsec_tun_protect_overlap_node, static) =
+{
+  .path = "set ipsec tun-protect overlap",
+  .function = ipsec_tun_protect_overlap_cmd,
+  .short_help =  "set ipsec tun-protect overlap <seconds>",
+};
+/* *INDENT-ON* */
+
 static clib_error_t *
 ipsec_tun_protect_hash_show (vlib_main_t * vm,
 			     unformat_input_t * input,
@@ -1021,6 +1118,62 @@ VLIB_CLI_COMMAND (ipsec_tun_protect_hash_show_node, static) =
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+set_async_mode_command_fn (vlib_main_t * vm, unformat_input_t * input,
+			   vlib_cli_command_t * cmd)
+{
+  unformat_input_t _line_input, *line_input = &_line_input;
+  clib_error_t *error = 0;
+  int async_enable = -1;
+
+  if (!unformat_user (input, unformat_line_input, line_input))
+    return 0;
+
+  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (line_input, "on"))
+	async_enable = 1;
+      else if (unformat (line_input, "off"))
+	async_enable = 0;
+      else
+	{
+	  error = clib_error_return (0, "unknown input '%U'",
+				     format_unformat_error, line_input);
+	  goto done;
+	}
+    }
+
+  if (async_enable < 0)
+    {
+      error = clib_error_return (0, "missing on|off");
+      goto done;
+    }
+
+  if (async_enable && crypto_main.enqueue_handler == 0)
+    {
+      error = clib_error_return (0, "no async crypto engine registered");
+      goto done;
+    }
+
+  ipsec_set_async_mode (async_enable);
+
+done:
+  unformat_free (line_input);
+  return error;
+}
+
+/**
+ * submit ESP encrypt work to the async crypto engine
+ */
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (set_async_mode_command, static) =
+{
+  .path = "set ipsec async mode",
+  .short_help = "set ipsec async mode on|off",
+  .function = set_async_mode_command_fn,
+};
+/* *INDENT-ON* */
+
 clib_error_t *
 ipsec_cli_init (vlib_main_t * vm)
 {
@@ -293,9 +293,13 @@ format_ipsec_sa (u8 * s, va_list * args)
   s = format (s, "\n   locks %d", sa->node.fn_locks);
   s = format (s, "\n   salt 0x%x", clib_net_to_host_u32 (sa->salt));
   s = format (s, "\n   seq %u seq-hi %u", sa->seq, sa->seq_hi);
-  s = format (s, "\n   last-seq %u last-seq-hi %u window %U",
-	      sa->last_seq, sa->last_seq_hi,
-	      format_ipsec_replay_window, sa->replay_window);
+  if (ipsec_main.sa_multi_worker)
+    s = format (s, "\n   last-seq %u last-seq-hi %u (multi-worker)",
+		(u32) sa->mw_last_seq, (u32) (sa->mw_last_seq >> 32));
+  else
+    s = format (s, "\n   last-seq %u last-seq-hi %u window %U",
+		sa->last_seq, sa->last_seq_hi,
+		format_ipsec_replay_window, sa->replay_window);
   s = format (s, "\n   crypto alg %U",
 	      format_ipsec_crypto_alg, sa->crypto_alg);
   if (sa->crypto_alg && (flags & IPSEC_FORMAT_INSECURE))
@@ -364,6 +368,18 @@ format_ipsec_tun_protect (u8 * s, va_list * args)
   }));
   /* *INDENT-ON* */
 
+  if (itp->itp_n_sa_retiring)
+    {
+      u32 ii;
+
+      s = format (s, "\n retiring input-sa: (in %.2fs)",
+		  clib_max (itp->itp_retire_at -
+			    vlib_time_now (vlib_get_main ()), 0.0));
+      for (ii = 0; ii < itp->itp_n_sa_retiring; ii++)
+	s = format (s, "\n  %U", format_ipsec_sa, itp->itp_retiring_sas[ii],
+		    IPSEC_FORMAT_BRIEF);
+    }
+
 done:
   return (s);
 }
@@ -24,6 +24,7 @@
 #include <vnet/ipsec/esp.h>
 #include <vnet/ipsec/ah.h>
 #include <vnet/ipsec/ipsec_io.h>
+#include <vnet/ipsec/ipsec_spd_lookup.h>
 
 #define foreach_ipsec_input_error               \
 _(RX_PKTS, "IPSEC pkts received")		\
@@ -68,100 +69,6 @@ format_ipsec_input_trace (u8 * s, va_list * args)
   return s;
 }
 
-always_inline ipsec_policy_t *
-ipsec_input_protect_policy_match (ipsec_spd_t * spd, u32 sa, u32 da, u32 spi)
-{
-  ipsec_main_t *im = &ipsec_main;
-  ipsec_policy_t *p;
-  ipsec_sa_t *s;
-  u32 *i;
-
-  vec_foreach (i, spd->policies[IPSEC_SPD_POLICY_IP4_INBOUND_PROTECT])
-  {
-    p = pool_elt_at_index (im->policies, *i);
-    s = pool_elt_at_index (im->sad, p->sa_index);
-
-    if (spi != s->spi)
-      continue;
-
-    if (ipsec_sa_is_set_IS_TUNNEL (s))
-      {
-	if (da != clib_net_to_host_u32 (s->tunnel_dst_addr.ip4.as_u32))
-	  continue;
-
-	if (sa != clib_net_to_host_u32 (s->tunnel_src_addr.ip4.as_u32))
-	  continue;
-
-	return p;
-      }
-
-    if (da < clib_net_to_host_u32 (p->laddr.start.ip4.as_u32))
-      continue;
-
-    if (da > clib_net_to_host_u32 (p->laddr.stop.ip4.as_u32))
-      continue;
-
-    if (sa < clib_net_to_host_u32 (p->raddr.start.ip4.as_u32))
-      continue;
-
-    if (sa > clib_net_to_host_u32 (p->raddr.stop.ip4.as_u32))
-      continue;
-
-    return p;
-  }
-  return 0;
-}
-
-always_inline uword
-ip6_addr_match_range (ip6_address_t * a, ip6_address_t * la,
-		      ip6_address_t * ua)
-{
-  if ((memcmp (a->as_u64, la->as_u64, 2 * sizeof (u64)) >= 0) &&
-      (memcmp (a->as_u64, ua->as_u64, 2 * sizeof (u64)) <= 0))
-    return 1;
-  return 0;
-}
-
-always_inline ipsec_policy_t *
-ipsec6_input_protect_policy_match (ipsec_spd_t * spd,
-				   ip6_address_t * sa,
-				   ip6_address_t * da, u32 spi)
-{
-  ipsec_main_t *im = &ipsec_main;
-  ipsec_policy_t *p;
-  ipsec_sa_t *s;
-  u32 *i;
-
-  vec_foreach (i, spd->policies[IPSEC_SPD_POLICY_IP6_INBOUND_PROTECT])
-  {
-    p = pool_elt_at_index (im->policies, *i);
-    s = pool_elt_at_index (im->sad, p->sa_index);
-
-    if (spi != s->spi)
-      continue;
-
-    if (ipsec_sa_is_set_IS_TUNNEL (s))
-      {
-	if (!ip6_address_is_equal (sa, &s->tunnel_src_addr.ip6))
-	  continue;
-
-	if (!ip6_address_is_equal (da, &s->tunnel_dst_addr.ip6))
-	  continue;
-
-	return p;
-      }
-
-    if (!ip6_addr_match_range (sa, &p->raddr.start.ip6, &p->raddr.stop.ip6))
-      continue;
-
-    if (!ip6_addr_match_range (da, &p->laddr.start.ip6, &p->laddr.stop.ip6))
-      continue;
-
-    return p;
-  }
-  return 0;
-}
-
 extern vlib_node_registration_t ipsec4_input_node;
 
 VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
@@ -172,6 +79,7 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
   ipsec_main_t *im = &ipsec_main;
   u32 ipsec_unprocessed = 0;
   u32 ipsec_matched = 0;
+  u32 n_sa_hits = 0, n_sa_fallbacks = 0;
 
   from = vlib_frame_vector_args (from_frame);
   n_left_from = from_frame->n_vectors;
@@ -187,7 +95,7 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 
       while (n_left_from > 0 && n_left_to_next > 0)
 	{
-	  u32 bi0, next0, pi0;
+	  u32 bi0, next0, pi0, sai0;
 	  vlib_buffer_t *b0;
 	  ip4_header_t *ip0;
 	  esp_header_t *esp0;
@@ -232,21 +140,38 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 		    (esp_header_t *) ((u8 *) esp0 + sizeof (udp_header_t));
 		}
 
-	      p0 = ipsec_input_protect_policy_match (spd0,
-						     clib_net_to_host_u32
-						     (ip0->src_address.
-						      as_u32),
-						     clib_net_to_host_u32
-						     (ip0->dst_address.
-						      as_u32),
-						     clib_net_to_host_u32
-						     (esp0->spi));
-
 	      has_space0 =
 		vlib_buffer_has_space (b0,
 				       (clib_address_t) (esp0 + 1) -
 				       (clib_address_t) ip0);
 
+	      sai0 = ipsec_sa_in_lookup_ip4 (spd0, &ip0->src_address,
+					     &ip0->dst_address, esp0->spi,
+					     IP_PROTOCOL_IPSEC_ESP, &pi0);
+
+	      if (PREDICT_TRUE ((INDEX_INVALID != sai0) & (has_space0)))
+		{
+		  ipsec_matched += 1;
+		  n_sa_hits += 1;
+
+		  vlib_increment_combined_counter
+		    (&ipsec_spd_policy_counters,
+		     thread_index, pi0, 1,
+		     clib_net_to_host_u16 (ip0->length));
+
+		  vnet_buffer (b0)->ipsec.sad_index = sai0;
+		  next0 = im->esp4_decrypt_next_index;
+		  vlib_buffer_advance (b0, ((u8 *) esp0 - (u8 *) ip0));
+		  goto trace0;
+		}
+	      n_sa_fallbacks += 1;
+
+	      p0 = ipsec_spd_lookup_ip4_inbound_protect
+		(spd0,
+		 clib_net_to_host_u32 (ip0->src_address.as_u32),
+		 clib_net_to_host_u32 (ip0->dst_address.as_u32),
+		 clib_net_to_host_u32 (esp0->spi));
+
 	      if (PREDICT_TRUE ((p0 != NULL) & (has_space0)))
 		{
 		  ipsec_matched += 1;
@@ -257,7 +182,8 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 		     thread_index, pi0, 1,
 		     clib_net_to_host_u16 (ip0->length));
 
-		  vnet_buffer (b0)->ipsec.sad_index = p0->sa_index;
+		  sai0 = p0->sa_index;
+		  vnet_buffer (b0)->ipsec.sad_index = sai0;
 		  next0 = im->esp4_decrypt_next_index;
 		  vlib_buffer_advance (b0, ((u8 *) esp0 - (u8 *) ip0));
 		  goto trace0;
@@ -266,6 +192,7 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 		{
 		  p0 = 0;
 		  pi0 = ~0;
+		  sai0 = INDEX_INVALID;
 		};
 
 	      /* FIXME bypass and discard */
@@ -277,7 +204,8 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 		    vlib_add_trace (vm, node, b0, sizeof (*tr));
 
 		  tr->proto = ip0->protocol;
-		  tr->sa_id = p0 ? p0->sa_id : ~0;
+		  tr->sa_id = (INDEX_INVALID != sai0 ?
+			       ipsec_sa_get (sai0)->id : ~0);
 		  tr->spi =
 		    has_space0 ? clib_net_to_host_u32 (esp0->spi) : ~0;
 		  tr->seq =
@@ -289,21 +217,37 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 	  else if (ip0->protocol == IP_PROTOCOL_IPSEC_AH)
 	    {
 	      ah0 = (ah_header_t *) ((u8 *) ip0 + ip4_header_bytes (ip0));
-	      p0 = ipsec_input_protect_policy_match (spd0,
-						     clib_net_to_host_u32
-						     (ip0->src_address.
-						      as_u32),
-						     clib_net_to_host_u32
-						     (ip0->dst_address.
-						      as_u32),
-						     clib_net_to_host_u32
-						     (ah0->spi));
-
 	      has_space0 =
 		vlib_buffer_has_space (b0,
 				       (clib_address_t) (ah0 + 1) -
 				       (clib_address_t) ip0);
 
+	      sai0 = ipsec_sa_in_lookup_ip4 (spd0, &ip0->src_address,
+					     &ip0->dst_address, ah0->spi,
+					     IP_PROTOCOL_IPSEC_AH, &pi0);
+
+	      if (PREDICT_TRUE ((INDEX_INVALID != sai0) & (has_space0)))
+		{
+		  ipsec_matched += 1;
+		  n_sa_hits += 1;
+
+		  vlib_increment_combined_counter
+		    (&ipsec_spd_policy_counters,
+		     thread_index, pi0, 1,
+		     clib_net_to_host_u16 (ip0->length));
+
+		  vnet_buffer (b0)->ipsec.sad_index = sai0;
+		  next0 = im->ah4_decrypt_next_index;
+		  goto trace1;
+		}
+	      n_sa_fallbacks += 1;
+
+	      p0 = ipsec_spd_lookup_ip4_inbound_protect
+		(spd0,
+		 clib_net_to_host_u32 (ip0->src_address.as_u32),
+		 clib_net_to_host_u32 (ip0->dst_address.as_u32),
+		 clib_net_to_host_u32 (ah0->spi));
+
 	      if (PREDICT_TRUE ((p0 != NULL) & (has_space0)))
 		{
 		  ipsec_matched += 1;
@@ -314,7 +258,8 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 		     thread_index, pi0, 1,
 		     clib_net_to_host_u16 (ip0->length));
 
-		  vnet_buffer (b0)->ipsec.sad_index = p0->sa_index;
+		  sai0 = p0->sa_index;
+		  vnet_buffer (b0)->ipsec.sad_index = sai0;
 		  next0 = im->ah4_decrypt_next_index;
 		  goto trace1;
 		}
@@ -322,6 +267,7 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 		{
 		  p0 = 0;
 		  pi0 = ~0;
+		  sai0 = INDEX_INVALID;
 		}
 	      /* FIXME bypass and discard */
 	    trace1:
@@ -332,7 +278,8 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
 		    vlib_add_trace (vm, node, b0, sizeof (*tr));
 
 		  tr->proto = ip0->protocol;
-		  tr->sa_id = p0 ? p0->sa_id : ~0;
+		  tr->sa_id = (INDEX_INVALID != sai0 ?
+			       ipsec_sa_get (sai0)->id : ~0);
 		  tr->spi = has_space0 ? clib_net_to_host_u32 (ah0->spi) : ~0;
 		  tr->seq =
 		    has_space0 ? clib_net_to_host_u32 (ah0->seq_no) : ~0;
@@ -359,6 +306,11 @@ VLIB_NODE_FN (ipsec4_input_node) (vlib_main_t * vm,
   vlib_node_increment_counter (vm, ipsec4_input_node.index,
 			       IPSEC_INPUT_ERROR_RX_MATCH_PKTS,
 			       ipsec_matched);
+
+  vlib_increment_simple_counter (&ipsec_sa_in_lookup_hits, thread_index,
+				 0, n_sa_hits);
+  vlib_increment_simple_counter (&ipsec_sa_in_lookup_fallbacks,
+				 thread_index, 0, n_sa_fallbacks);
   return from_frame->n_vectors;
 }
 
@@ -391,6 +343,7 @@ VLIB_NODE_FN (ipsec6_input_node) (vlib_main_t * vm,
   ipsec_main_t *im = &ipsec_main;
   u32 ipsec_unprocessed = 0;
   u32 ipsec_matched = 0;
+  u32 n_sa_hits = 0, n_sa_fallbacks = 0;
 
   from = vlib_frame_vector_args (from_frame);
   n_left_from = from_frame->n_vectors;
@@ -406,7 +359,7 @@ VLIB_NODE_FN (ipsec6_input_node) (vlib_main_t * vm,
 
       while (n_left_from > 0 && n_left_to_next > 0)
 	{
-	  u32 bi0, next0, pi0;
+	  u32 bi0, next0, pi0, sai0 = INDEX_INVALID;
 	  vlib_buffer_t *b0;
 	  ip6_header_t *ip0;
 	  esp_header_t *esp0;
@@ -443,11 +396,33 @@ VLIB_NODE_FN (ipsec6_input_node) (vlib_main_t * vm,
 		 clib_net_to_host_u16 (ip0->payload_length) + header_size,
 		 spd0->id);
 #endif
-	      p0 = ipsec6_input_protect_policy_match (spd0,
-						      &ip0->src_address,
-						      &ip0->dst_address,
-						      clib_net_to_host_u32
-						      (esp0->spi));
+	      sai0 = ipsec_sa_in_lookup_ip6 (spd0, &ip0->src_address,
+					     &ip0->dst_address, esp0->spi,
+					     IP_PROTOCOL_IPSEC_ESP, &pi0);
+
+	      if (PREDICT_TRUE (INDEX_INVALID != sai0))
+		{
+		  ipsec_matched += 1;
+		  n_sa_hits += 1;
+
+		  vlib_increment_combined_counter
+		    (&ipsec_spd_policy_counters,
+		     thread_index, pi0, 1,
+		     clib_net_to_host_u16 (ip0->payload_length) +
+		     header_size);
+
+		  vnet_buffer (b0)->ipsec.sad_index = sai0;
+		  next0 = im->esp6_decrypt_next_index;
+		  vlib_buffer_advance (b0, header_size);
+		  goto trace0;
+		}
+	      n_sa_fallbacks += 1;
+
+	      p0 = ipsec_spd_lookup_ip6_inbound_protect (spd0,
+							 &ip0->src_address,
+							 &ip0->dst_address,
+							 clib_net_to_host_u32
+							 (esp0->spi));
 
 	      if (PREDICT_TRUE (p0 != 0))
 		{
@@ -460,7 +435,8 @@ VLIB_NODE_FN (ipsec6_input_node) (vlib_main_t * vm,
 		     clib_net_to_host_u16 (ip0->payload_length) +
 		     header_size);
 
-		  vnet_buffer (b0)->ipsec.sad_index = p0->sa_index;
+		  sai0 = p0->sa_index;
+		  vnet_buffer (b0)->ipsec.sad_index = sai0;
 		  next0 = im->esp6_decrypt_next_index;
 		  vlib_buffer_advance (b0, header_size);
 		  goto trace0;
@@ -472,11 +448,32 @@ VLIB_NODE_FN (ipsec6_input_node) (vlib_main_t * vm,
 	    }
 	  else if (ip0->protocol == IP_PROTOCOL_IPSEC_AH)
 	    {
-	      p0 = ipsec6_input_protect_policy_match (spd0,
-						      &ip0->src_address,
-						      &ip0->dst_address,
-						      clib_net_to_host_u32
-						      (ah0->spi));
+	      sai0 = ipsec_sa_in_lookup_ip6 (spd0, &ip0->src_address,
+					     &ip0->dst_address, ah0->spi,
+					     IP_PROTOCOL_IPSEC_AH, &pi0);
+
+	      if (PREDICT_TRUE (INDEX_INVALID != sai0))
+		{
+		  ipsec_matched += 1;
+		  n_sa_hits += 1;
+
+		  vlib_increment_combined_counter
+		    (&ipsec_spd_policy_counters,
+		     thread_index, pi0, 1,
+		     clib_net_to_host_u16 (ip0->payload_length) +
+		     header_size);
+
+		  vnet_buffer (b0)->ipsec.sad_index = sai0;
+		  next0 = im->ah6_decrypt_next_index;
+		  goto trace0;
+		}
+	      n_sa_fallbacks += 1;
+
+	      p0 = ipsec_spd_lookup_ip6_inbound_protect (spd0,
+							 &ip0->src_address,
+							 &ip0->dst_address,
+							 clib_net_to_host_u32
+							 (ah0->spi));
 
 	      if (PREDICT_TRUE (p0 != 0))
 		{
@@ -488,7 +485,8 @@ VLIB_NODE_FN (ipsec6_input_node) (vlib_main_t * vm,
 		     clib_net_to_host_u16 (ip0->payload_length) +
 		     header_size);
 
-		  vnet_buffer (b0)->ipsec.sad_index = p0->sa_index;
+		  sai0 = p0->sa_index;
+		  vnet_buffer (b0)->ipsec.sad_index = sai0;
 		  next0 = im->ah6_decrypt_next_index;
 		  goto trace0;
 		}
@@ -509,8 +507,8 @@ VLIB_NODE_FN (ipsec6_input_node) (vlib_main_t * vm,
 	      ipsec_input_trace_t *tr =
 		vlib_add_trace (vm, node, b0, sizeof (*tr));
 
-	      if (p0)
-		tr->sa_id = p0->sa_id;
+	      tr->sa_id = (INDEX_INVALID != sai0 ?
+			   ipsec_sa_get (sai0)->id : ~0);
 	      tr->proto = ip0->protocol;
 	      tr->spi = clib_net_to_host_u32 (esp0->spi);
 	      tr->seq = clib_net_to_host_u32 (esp0->seq);
@@ -531,6 +529,11 @@ VLIB_NODE_FN (ipsec6_input_node) (vlib_main_t * vm,
 			       IPSEC_INPUT_ERROR_RX_MATCH_PKTS,
 			       ipsec_matched);
 
+  vlib_increment_simple_counter (&ipsec_sa_in_lookup_hits, thread_index,
+				 1, n_sa_hits);
+  vlib_increment_simple_counter (&ipsec_sa_in_lookup_fallbacks,
+				 thread_index, 1, n_sa_fallbacks);
+
   return from_frame->n_vectors;
 }
 
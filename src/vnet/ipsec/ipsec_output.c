@@ -21,6 +21,7 @@
 
 #include <vnet/ipsec/ipsec.h>
 #include <vnet/ipsec/ipsec_io.h>
+#include <vnet/ipsec/ipsec_spd_lookup.h>
 
 #if WITH_LIBSSL > 0
 
@@ -65,114 +66,6 @@ format_ipsec_output_trace (u8 * s, va_list * args)
   return s;
 }
 
-always_inline ipsec_policy_t *
-ipsec_output_policy_match (ipsec_spd_t * spd, u8 pr, u32 la, u32 ra, u16 lp,
-			   u16 rp)
-{
-  ipsec_main_t *im = &ipsec_main;
-  ipsec_policy_t *p;
-  u32 *i;
-
-  if (!spd)
-    return 0;
-
-  vec_foreach (i, spd->policies[IPSEC_SPD_POLICY_IP4_OUTBOUND])
-  {
-    p = pool_elt_at_index (im->policies, *i);
-    if (PREDICT_FALSE (p->protocol && (p->protocol != pr)))
-      continue;
-
-    if (ra < clib_net_to_host_u32 (p->raddr.start.ip4.as_u32))
-      continue;
-
-    if (ra > clib_net_to_host_u32 (p->raddr.stop.ip4.as_u32))
-      continue;
-
-    if (la < clib_net_to_host_u32 (p->laddr.start.ip4.as_u32))
-      continue;
-
-    if (la > clib_net_to_host_u32 (p->laddr.stop.ip4.as_u32))
-      continue;
-
-    if (PREDICT_FALSE
-	((pr != IP_PROTOCOL_TCP) && (pr != IP_PROTOCOL_UDP)
-	 && (pr != IP_PROTOCOL_SCTP)))
-      return p;
-
-    if (lp < p->lport.start)
-      continue;
-
-    if (lp > p->lport.stop)
-      continue;
-
-    if (rp < p->rport.start)
-      continue;
-
-    if (rp > p->rport.stop)
-      continue;
-
-    return p;
-  }
-  return 0;
-}
-
-always_inline uword
-ip6_addr_match_range (ip6_address_t * a, ip6_address_t * la,
-		      ip6_address_t * ua)
-{
-  if ((memcmp (a->as_u64, la->as_u64, 2 * sizeof (u64)) >= 0) &&
-      (memcmp (a->as_u64, ua->as_u64, 2 * sizeof (u64)) <= 0))
-    return 1;
-  return 0;
-}
-
-always_inline ipsec_policy_t *
-ipsec6_output_policy_match (ipsec_spd_t * spd,
-			    ip6_address_t * la,
-			    ip6_address_t * ra, u16 lp, u16 rp, u8 pr)
-{
-  ipsec_main_t *im = &ipsec_main;
-  ipsec_policy_t *p;
-  u32 *i;
-
-  if (!spd)
-    return 0;
-
-  vec_foreach (i, spd->policies[IPSEC_SPD_POLICY_IP6_OUTBOUND])
-  {
-    p = pool_elt_at_index (im->policies, *i);
-    if (PREDICT_FALSE (p->protocol && (p->protocol != pr)))
-      continue;
-
-    if (!ip6_addr_match_range (ra, &p->raddr.start.ip6, &p->raddr.stop.ip6))
-      continue;
-
-    if (!ip6_addr_match_range (la, &p->laddr.start.ip6, &p->laddr.stop.ip6))
-      continue;
-
-    if (PREDICT_FALSE
-	((pr != IP_PROTOCOL_TCP) && (pr != IP_PROTOCOL_UDP)
-	 && (pr != IP_PROTOCOL_SCTP)))
-      return p;
-
-    if (lp < p->lport.start)
-      continue;
-
-    if (lp > p->lport.stop)
-      continue;
-
-    if (rp < p->rport.start)
-      continue;
-
-    if (rp > p->rport.stop)
-      continue;
-
-    return p;
-  }
-
-  return 0;
-}
-
 static inline uword
 ipsec_output_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 		     vlib_frame_t * from_frame, int is_ipv6)
@@ -187,10 +80,15 @@ ipsec_output_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   ipsec_spd_t *spd0 = 0;
   int bogus;
   u64 nc_protect = 0, nc_bypass = 0, nc_discard = 0, nc_nomatch = 0;
+  ipsec_per_thread_data_t *ptd;
+  u32 n_cache_hits = 0, n_cache_misses = 0;
+  u8 flow_cache;
 
   from = vlib_frame_vector_args (from_frame);
   n_left_from = from_frame->n_vectors;
   thread_index = vm->thread_index;
+  ptd = vec_elt_at_index (im->ptd, thread_index);
+  flow_cache = im->spd_flow_cache_enabled;
 
   while (n_left_from > 0)
     {
@@ -243,13 +141,21 @@ ipsec_output_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 	     spd0->id);
 #endif
 
-	  p0 = ipsec6_output_policy_match (spd0,
-					   &ip6_0->src_address,
-					   &ip6_0->dst_address,
-					   clib_net_to_host_u16
-					   (udp0->src_port),
-					   clib_net_to_host_u16
-					   (udp0->dst_port), ip6_0->protocol);
+	  if (flow_cache)
+	    p0 = ipsec_spd_flow_cache_lookup_ip6_outbound
+	      (ptd, spd0, &ip6_0->src_address, &ip6_0->dst_address,
+	       clib_net_to_host_u16 (udp0->src_port),
+	       clib_net_to_host_u16 (udp0->dst_port),
+	       ip6_0->protocol, &n_cache_hits, &n_cache_misses);
+	  else
+	    p0 = ipsec_spd_lookup_ip6_outbound (spd0,
+						&ip6_0->src_address,
+						&ip6_0->dst_address,
+						clib_net_to_host_u16
+						(udp0->src_port),
+						clib_net_to_host_u16
+						(udp0->dst_port),
+						ip6_0->protocol);
 	}
       else
 	{
@@ -264,15 +170,24 @@ ipsec_output_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 			sw_if_index0, spd_index0, spd0->id);
 #endif
 
-	  p0 = ipsec_output_policy_match (spd0, ip0->protocol,
-					  clib_net_to_host_u32
-					  (ip0->src_address.as_u32),
-					  clib_net_to_host_u32
-					  (ip0->dst_address.as_u32),
-					  clib_net_to_host_u16
-					  (udp0->src_port),
-					  clib_net_to_host_u16
-					  (udp0->dst_port));
+	  if (flow_cache)
+	    p0 = ipsec_spd_flow_cache_lookup_ip4_outbound
+	      (ptd, spd0, ip0->protocol,
+	       clib_net_to_host_u32 (ip0->src_address.as_u32),
+	       clib_net_to_host_u32 (ip0->dst_address.as_u32),
+	       clib_net_to_host_u16 (udp0->src_port),
+	       clib_net_to_host_u16 (udp0->dst_port), &n_cache_hits,
+	       &n_cache_misses);
+	  else
+	    p0 = ipsec_spd_lookup_ip4_outbound (spd0, ip0->protocol,
+						clib_net_to_host_u32
+						(ip0->src_address.as_u32),
+						clib_net_to_host_u32
+						(ip0->dst_address.as_u32),
+						clib_net_to_host_u16
+						(udp0->src_port),
+						clib_net_to_host_u16
+						(udp0->dst_port));
 	}
       tcp0 = (void *) udp0;
 
@@ -417,6 +332,13 @@ ipsec_output_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   vlib_node_increment_counter (vm, node->node_index,
 			       IPSEC_OUTPUT_ERROR_POLICY_NO_MATCH,
 			       nc_nomatch);
+  if (flow_cache)
+    {
+      vlib_increment_simple_counter (&ipsec_spd_flow_cache_hits,
+				     thread_index, is_ipv6, n_cache_hits);
+      vlib_increment_simple_counter (&ipsec_spd_flow_cache_misses,
+				     thread_index, is_ipv6, n_cache_misses);
+    }
   return from_frame->n_vectors;
 }
 
@@ -29,6 +29,20 @@ vlib_combined_counter_main_t ipsec_sa_counters = {
   .stat_segment_name = "/net/ipsec/sa",
 };
 
+/**
+ * @brief
+ * Inbound SA lookup hit & fallback counters
+ */
+vlib_simple_counter_main_t ipsec_sa_in_lookup_hits = {
+  .name = "sa-in-lookup-hits",
+  .stat_segment_name = "/net/ipsec/sa/in-lookup/hits",
+};
+
+vlib_simple_counter_main_t ipsec_sa_in_lookup_fallbacks = {
+  .name = "sa-in-lookup-fallbacks",
+  .stat_segment_name = "/net/ipsec/sa/in-lookup/fallbacks",
+};
+
 
 static clib_error_t *
 ipsec_call_add_del_callbacks (ipsec_main_t * im, ipsec_sa_t * sa,
@@ -123,6 +137,67 @@ ipsec_sa_set_integ_alg (ipsec_sa_t * sa, ipsec_integ_alg_t integ_alg)
   ASSERT (sa->integ_icv_size <= ESP_MAX_ICV_SIZE);
 }
 
+static u8
+ipsec_sa_ip_proto (const ipsec_sa_t * sa)
+{
+  return (IPSEC_PROTOCOL_ESP == sa->protocol ?
+	  IP_PROTOCOL_IPSEC_ESP : IP_PROTOCOL_IPSEC_AH);
+}
+
+/**
+ * Add a tunnel mode SA to, or remove it from, the inbound SA lookup.
+ * Should two SAs share a key, the first one added owns the entry and
+ * packets for the other are matched by the SPD walk. SAs of a tunnel
+ * protection are not matched through the SPD and are left out.
+ */
+static void
+ipsec_sa_in_lookup_add_del (ipsec_sa_t * sa, u32 sa_index, int is_add)
+{
+  ipsec_main_t *im = &ipsec_main;
+
+  if (!ipsec_sa_is_set_IS_TUNNEL (sa) || ipsec_sa_is_set_IS_PROTECT (sa))
+    return;
+
+  if (ipsec_sa_is_set_IS_TUNNEL_V6 (sa))
+    {
+      clib_bihash_kv_24_8_t kv;
+
+      ipsec_sa_in_mk_key6 (&kv, &sa->tunnel_dst_addr.ip6,
+			   clib_host_to_net_u32 (sa->spi),
+			   ipsec_sa_ip_proto (sa));
+
+      if (clib_bihash_search_24_8 (&im->sa6_in_lookup, &kv, &kv))
+	{
+	  if (is_add)
+	    {
+	      kv.value = sa_index;
+	      clib_bihash_add_del_24_8 (&im->sa6_in_lookup, &kv, 1);
+	    }
+	}
+      else if (!is_add && kv.value == sa_index)
+	clib_bihash_add_del_24_8 (&im->sa6_in_lookup, &kv, 0);
+    }
+  else
+    {
+      clib_bihash_kv_16_8_t kv;
+
+      ipsec_sa_in_mk_key4 (&kv, &sa->tunnel_dst_addr.ip4,
+			   clib_host_to_net_u32 (sa->spi),
+			   ipsec_sa_ip_proto (sa));
+
+      if (clib_bihash_search_16_8 (&im->sa4_in_lookup, &kv, &kv))
+	{
+	  if (is_add)
+	    {
+	      kv.value = sa_index;
+	      clib_bihash_add_del_16_8 (&im->sa4_in_lookup, &kv, 1);
+	    }
+	}
+      else if (!is_add && kv.value == sa_index)
+	clib_bihash_add_del_16_8 (&im->sa4_in_lookup, &kv, 0);
+    }
+}
+
 int
 ipsec_sa_add_and_lock (u32 id,
 		       u32 spi,
@@ -154,6 +229,20 @@ ipsec_sa_add_and_lock (u32 id,
   fib_node_lock (&sa->node);
   sa_index = sa - im->sad;
 
+  if (im->sa_multi_worker)
+    {
+      ipsec_per_thread_data_t *ptd;
+
+      /* drop the blocks reserved from a previous SA at this index */
+      vec_foreach (ptd, im->ptd)
+      {
+	vec_validate_aligned (ptd->seq_blocks, sa_index,
+			      CLIB_CACHE_LINE_BYTES);
+	clib_memset (vec_elt_at_index (ptd->seq_blocks, sa_index), 0,
+		     sizeof (ipsec_sa_seq_block_t));
+      }
+    }
+
   vlib_validate_combined_counter (&ipsec_sa_counters, sa_index);
   vlib_zero_combined_counter (&ipsec_sa_counters, sa_index);
 
@@ -272,6 +361,7 @@ ipsec_sa_add_and_lock (u32 id,
     }
 
   hash_set (im->sa_index_by_sa_id, sa->id, sa_index);
+  ipsec_sa_in_lookup_add_del (sa, sa_index, 1);
 
   if (sa_out_index)
     *sa_out_index = sa_index;
@@ -288,6 +378,7 @@ ipsec_sa_del (ipsec_sa_t * sa)
 
   sa_index = sa - im->sad;
   hash_unset (im->sa_index_by_sa_id, sa->id);
+  ipsec_sa_in_lookup_add_del (sa, sa_index, 0);
 
   /* no recovery possible when deleting an SA */
   (void) ipsec_call_add_del_callbacks (im, sa, sa_index, 0);
@@ -445,12 +536,64 @@ const static fib_node_vft_t ipsec_sa_vft = {
   .fnv_back_walk = ipsec_sa_back_walk,
 };
 
+u8 *
+format_ipsec_sa_in_lookup (u8 * s, va_list * args)
+{
+  ipsec_main_t *im = &ipsec_main;
+  int verbose = va_arg (*args, int);
+  vlib_simple_counter_main_t *hits, *fallbacks;
+  u32 thread_index;
+
+  hits = &ipsec_sa_in_lookup_hits;
+  fallbacks = &ipsec_sa_in_lookup_fallbacks;
+
+  s = format (s, "inbound SA lookup:");
+  s = format (s, "\n ip4 hits:%lld fallbacks:%lld",
+	      vlib_get_simple_counter (hits, 0),
+	      vlib_get_simple_counter (fallbacks, 0));
+  s = format (s, "\n ip6 hits:%lld fallbacks:%lld",
+	      vlib_get_simple_counter (hits, 1),
+	      vlib_get_simple_counter (fallbacks, 1));
+
+  vec_foreach_index (thread_index, hits->counters)
+  {
+    s = format (s, "\n thread:%d ip4 hits:%lld fallbacks:%lld"
+		" ip6 hits:%lld fallbacks:%lld", thread_index,
+		hits->counters[thread_index][0],
+		fallbacks->counters[thread_index][0],
+		hits->counters[thread_index][1],
+		fallbacks->counters[thread_index][1]);
+  }
+
+  s = format (s, "\n%U", format_bihash_16_8, &im->sa4_in_lookup, verbose);
+  s = format (s, "\n%U", format_bihash_24_8, &im->sa6_in_lookup, verbose);
+
+  return (s);
+}
+
 /* force inclusion from application's main.c */
 clib_error_t *
 ipsec_sa_interface_init (vlib_main_t * vm)
 {
+  ipsec_main_t *im = &ipsec_main;
+
   fib_node_register_type (FIB_NODE_TYPE_IPSEC_SA, &ipsec_sa_vft);
 
+  clib_bihash_init_16_8 (&im->sa4_in_lookup, "ipsec sa4 in lookup",
+			 IPSEC_SA_IN_LOOKUP_DEFAULT_HASH_NUM_BUCKETS,
+			 IPSEC_SA_IN_LOOKUP_DEFAULT_HASH_MEMORY_SIZE);
+  clib_bihash_init_24_8 (&im->sa6_in_lookup, "ipsec sa6 in lookup",
+			 IPSEC_SA_IN_LOOKUP_DEFAULT_HASH_NUM_BUCKETS,
+			 IPSEC_SA_IN_LOOKUP_DEFAULT_HASH_MEMORY_SIZE);
+
+  /* one counter per address family */
+  vlib_validate_simple_counter (&ipsec_sa_in_lookup_hits, 1);
+  vlib_zero_simple_counter (&ipsec_sa_in_lookup_hits, 0);
+  vlib_zero_simple_counter (&ipsec_sa_in_lookup_hits, 1);
+  vlib_validate_simple_counter (&ipsec_sa_in_lookup_fallbacks, 1);
+  vlib_zero_simple_counter (&ipsec_sa_in_lookup_fallbacks, 0);
+  vlib_zero_simple_counter (&ipsec_sa_in_lookup_fallbacks, 1);
+
   return 0;
 }
 
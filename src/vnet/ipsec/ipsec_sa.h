@@ -104,6 +104,14 @@ typedef enum ipsec_sad_flags_t_
 
 STATIC_ASSERT (sizeof (ipsec_sa_flags_t) == 1, "IPSEC SA flags > 1 byte");
 
+/**
+ * @brief
+ * Size, in 32 bit blocks, of the anti-replay ring used in multi-worker
+ * mode. It must span more than the window, see
+ * ipsec_sa_mw_anti_replay_advance.
+ */
+#define IPSEC_SA_MW_REPLAY_N_SLOTS 4
+
 typedef struct
 {
   CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
@@ -115,8 +123,15 @@ typedef struct
   u8 crypto_block_size;
   u8 integ_icv_size;
   u32 spi;
-  u32 seq;
-  u32 seq_hi;
+  union
+  {
+    struct
+    {
+      u32 seq;
+      u32 seq_hi;
+    };
+    u64 seq64;
+  };
   u32 last_seq;
   u32 last_seq_hi;
   u64 replay_window;
@@ -162,9 +177,15 @@ typedef struct
   /* Salt used in GCM modes - stored in network byte order */
   u32 salt;
   u64 gcm_iv_counter;
+
+  /* inbound state in multi-worker mode, updated by all workers */
+    CLIB_CACHE_LINE_ALIGN_MARK (cacheline2);
+  u64 mw_last_seq;
+  u64 mw_replay_ring[IPSEC_SA_MW_REPLAY_N_SLOTS];
 } ipsec_sa_t;
 
 STATIC_ASSERT_OFFSET_OF (ipsec_sa_t, cacheline1, CLIB_CACHE_LINE_BYTES);
+STATIC_ASSERT_OFFSET_OF (ipsec_sa_t, seq64, 8);
 
 #define _(a,v,s)                                                        \
   always_inline int                                                     \
@@ -193,6 +214,14 @@ foreach_ipsec_sa_flags
  */
 extern vlib_combined_counter_main_t ipsec_sa_counters;
 
+/**
+ * @brief
+ * Size of the inbound SA lookup hashes. Every tunnel mode SA is added,
+ * keyed on its tunnel destination, SPI and protocol.
+ */
+#define IPSEC_SA_IN_LOOKUP_DEFAULT_HASH_NUM_BUCKETS (64 * 1024)
+#define IPSEC_SA_IN_LOOKUP_DEFAULT_HASH_MEMORY_SIZE (32 << 20)
+
 extern void ipsec_mk_key (ipsec_key_t * key, const u8 * data, u8 len);
 
 extern int ipsec_sa_add_and_lock (u32 id,
@@ -436,6 +465,133 @@ ipsec_sa_anti_replay_advance (ipsec_sa_t * sa, u32 seq)
     }
 }
 
+/*
+ * Anti replay in multi-worker mode.
+ *
+ * The SA is then used by all workers at once, so the window is kept in a
+ * form that can be updated without a lock. mw_last_seq is the highest
+ * (64 bit) sequence number received. The received sequence numbers are
+ * recorded in a ring of 32 bit blocks. Each slot holds the number of the
+ * block it currently records in its upper half and the block's bits in
+ * its lower half, so that claiming a slot and setting a bit are each a
+ * single compare-and-swap. The ring spans more than the window, so a slot
+ * is only claimed by a block that moves its previous one out of the
+ * window.
+ */
+STATIC_ASSERT ((IPSEC_SA_MW_REPLAY_N_SLOTS - 1) * 32 >=
+	       IPSEC_SA_ANTI_REPLAY_WINDOW_SIZE,
+	       "anti-replay ring smaller than the window");
+
+/*
+ * The 64 bit sequence number of a received packet, inferred from the
+ * highest one received as per RFC4303 Appendix A.
+ */
+always_inline u64
+ipsec_sa_mw_anti_replay_seq (const ipsec_sa_t * sa, u32 seq, u64 last)
+{
+  u32 tl = last, th = last >> 32;
+
+  if (!ipsec_sa_is_set_USE_ESN (sa))
+    return (seq);
+
+  if (tl >= IPSEC_SA_ANTI_REPLAY_WINDOW_MAX_INDEX)
+    {
+      /* Case A, the high sequence number wrapped */
+      if (seq < IPSEC_SA_ANTI_REPLAY_WINDOW_LOWER_BOUND (tl))
+	th += 1;
+    }
+  else
+    {
+      /* Case B, the packet precedes the last high sequence number wrap */
+      if (seq >= IPSEC_SA_ANTI_REPLAY_WINDOW_LOWER_BOUND (tl) && th)
+	th -= 1;
+    }
+
+  return ((u64) th << 32 | seq);
+}
+
+/*
+ * Anti replay check in multi-worker mode, before decryption.
+ *  seq is in host byte order, the inferred high sequence number is
+ *  returned in seq_hi.
+ */
+always_inline int
+ipsec_sa_mw_anti_replay_check (ipsec_sa_t * sa, u32 seq, u32 * seq_hi)
+{
+  u64 last, s, slot;
+  u32 block;
+
+  last = clib_atomic_load_relax_n (&sa->mw_last_seq);
+  s = ipsec_sa_mw_anti_replay_seq (sa, seq, last);
+  *seq_hi = s >> 32;
+
+  if ((sa->flags & IPSEC_SA_FLAG_USE_ANTI_REPLAY) == 0)
+    return 0;
+
+  if (s > last)
+    return 0;
+
+  if (last - s >= IPSEC_SA_ANTI_REPLAY_WINDOW_SIZE)
+    return 1;
+
+  block = s / 32;
+  slot = clib_atomic_load_relax_n
+    (&sa->mw_replay_ring[block % IPSEC_SA_MW_REPLAY_N_SLOTS]);
+
+  /* the slot records a later block, this one left the window */
+  if ((u32) (slot >> 32) != block)
+    return ((i32) ((u32) (slot >> 32) - block) > 0);
+
+  return ((slot >> (s % 32)) & 1);
+}
+
+/*
+ * Anti replay window advance in multi-worker mode, after decryption.
+ *  Checks the packet again, since other workers may have received it
+ *  in the meantime, and returns 1 if it is a replay.
+ */
+always_inline int
+ipsec_sa_mw_anti_replay_advance (ipsec_sa_t * sa, u32 seq, u32 seq_hi)
+{
+  u64 s = (u64) seq_hi << 32 | seq;
+  u64 last, old, new, *slot;
+  u32 block = s / 32, tag;
+  u32 bit = 1 << (s % 32);
+
+  if (sa->flags & IPSEC_SA_FLAG_USE_ANTI_REPLAY)
+    {
+      last = clib_atomic_load_relax_n (&sa->mw_last_seq);
+      if (s <= last && last - s >= IPSEC_SA_ANTI_REPLAY_WINDOW_SIZE)
+	return 1;
+
+      slot = &sa->mw_replay_ring[block % IPSEC_SA_MW_REPLAY_N_SLOTS];
+      old = clib_atomic_load_relax_n (slot);
+      do
+	{
+	  tag = old >> 32;
+	  if (tag == block)
+	    {
+	      if (old & bit)
+		return 1;
+	      new = old | bit;
+	    }
+	  else if ((i32) (tag - block) > 0)
+	    return 1;
+	  else
+	    new = (u64) block << 32 | bit;
+	}
+      while (!clib_atomic_cmp_and_swap_acq_relax_n (slot, &old, new, 0));
+    }
+
+  last = clib_atomic_load_relax_n (&sa->mw_last_seq);
+  while (s > last &&
+	 !clib_atomic_cmp_and_swap_acq_relax_n (&sa->mw_last_seq, &last, s,
+						0))
+    ;
+
+  return 0;
+}
+
 #endif /* __IPSEC_SPD_SA_H__ */
 
 /*
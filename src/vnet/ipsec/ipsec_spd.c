@@ -15,6 +15,7 @@
 
 #include <vnet/ipsec/ipsec.h>
 #include <vnet/ipsec/ipsec_io.h>
+#include <vnet/ipsec/ipsec_spd_lookup.h>
 
 int
 ipsec_add_del_spd (vlib_main_t * vm, u32 spd_id, int is_add)
@@ -30,6 +31,9 @@ ipsec_add_del_spd (vlib_main_t * vm, u32 spd_id, int is_add)
   if (!p && !is_add)
     return VNET_API_ERROR_NO_SUCH_ENTRY;
 
+  /* the SPD's index may be reused, flush the results cached for it */
+  im->spd_generation++;
+
   if (!is_add)			/* delete */
     {
       spd_index = p[0];
@@ -43,6 +47,9 @@ ipsec_add_del_spd (vlib_main_t * vm, u32 spd_id, int is_add)
       }));
       /* *INDENT-ON* */
       hash_unset (im->spd_index_by_spd_id, spd_id);
+      ipsec_spd_lookup_flush (spd);
+      vec_free (spd->in_protect_sa_refs);
+      vec_free (spd->in_protect_sa_policy);
 #define _(s,v) vec_free(spd->policies[IPSEC_SPD_POLICY_##s]);
       foreach_ipsec_spd_policy_type
 #undef _
@@ -38,6 +38,37 @@ typedef enum ipsec_spd_policy_t_
 
 extern u8 *format_ipsec_policy_type (u8 * s, va_list * args);
 
+/**
+ * @brief A set of policies in an SPD whose local and remote address
+ * ranges are prefixes of the same length. All the policies in a tuple
+ * are found with one hash probe on the masked packet addresses.
+ */
+typedef struct ipsec_spd_tuple_t_
+{
+  /** the local and remote prefix lengths */
+  u8 laddr_len;
+  u8 raddr_len;
+  /** the highest priority of all the policies in the tuple */
+  i32 max_priority;
+  /** the number of policies in the tuple */
+  u32 n_policies;
+  /** the number of distinct keys of the policies in the tuple */
+  u32 n_buckets;
+} ipsec_spd_tuple_t;
+
+/**
+ * @brief The compiled form of one policy type's vector in an SPD
+ */
+typedef struct ipsec_spd_lookup_t_
+{
+  /** tuples, sorted by descending max priority */
+  ipsec_spd_tuple_t *tuples;
+  /** policies whose address ranges are not prefixes, in SPD order */
+  u32 *residual;
+  /** the number of hash buckets used by this policy type */
+  u32 n_buckets;
+} ipsec_spd_lookup_t;
+
 /**
  * @brief A Secruity Policy Database
  */
@@ -47,6 +78,12 @@ typedef struct
   u32 id;
   /** vectors for each of the policy types */
   u32 *policies[IPSEC_SPD_POLICY_N_TYPES];
+  /** compiled lookup state for each of the policy types */
+  ipsec_spd_lookup_t lookup[IPSEC_SPD_POLICY_N_TYPES];
+  /** per SA index, the number of inbound protect policies using the SA */
+  u32 *in_protect_sa_refs;
+  /** per SA index, the first inbound protect policy using the SA */
+  u32 *in_protect_sa_policy;
 } ipsec_spd_t;
 
 /**
@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2020 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vnet/ipsec/ipsec_spd_lookup.h>
+
+/**
+ * @brief
+ * SPD flow cache hit and miss counters
+ */
+vlib_simple_counter_main_t ipsec_spd_flow_cache_hits = {
+  .name = "spd-flow-cache-hits",
+  .stat_segment_name = "/net/ipsec/spd/flow-cache/hits",
+};
+
+vlib_simple_counter_main_t ipsec_spd_flow_cache_misses = {
+  .name = "spd-flow-cache-misses",
+  .stat_segment_name = "/net/ipsec/spd/flow-cache/misses",
+};
+
+static int
+ipsec_spd_policy_type_is_protect (ipsec_spd_policy_type_t type)
+{
+  return (type == IPSEC_SPD_POLICY_IP4_INBOUND_PROTECT ||
+	  type == IPSEC_SPD_POLICY_IP6_INBOUND_PROTECT);
+}
+
+/**
+ * @brief If the range is a prefix return its length, else -1
+ */
+static int
+ipsec_spd_range_len4 (const ip46_address_range_t * r)
+{
+  u32 start, x;
+
+  start = clib_net_to_host_u32 (r->start.ip4.as_u32);
+  x = start ^ clib_net_to_host_u32 (r->stop.ip4.as_u32);
+
+  if ((x & (x + 1)) || (start & x))
+    return (-1);
+
+  return (32 - count_set_bits (x));
+}
+
+static int
+ipsec_spd_range_len6 (const ip46_address_range_t * r)
+{
+  u64 start[2], x[2];
+  int i;
+
+  for (i = 0; i < 2; i++)
+    {
+      start[i] = clib_net_to_host_u64 (r->start.ip6.as_u64[i]);
+      x[i] = start[i] ^ clib_net_to_host_u64 (r->stop.ip6.as_u64[i]);
+      if (start[i] & x[i])
+	return (-1);
+    }
+
+  if (x[0] && (x[1] != ~0ULL || (x[0] & (x[0] + 1))))
+    return (-1);
+  if (x[1] & (x[1] + 1))
+    return (-1);
+
+  return (128 - count_set_bits (x[0]) - count_set_bits (x[1]));
+}
+
+/**
+ * @brief The tuple a policy belongs to. Returns 0 if the policy's
+ * address ranges are not prefixes.
+ */
+static int
+ipsec_policy_get_tuple (const ipsec_policy_t * p, u8 * llen, u8 * rlen)
+{
+  int l, r;
+
+  if (p->is_ipv6)
+    {
+      l = ipsec_spd_range_len6 (&p->laddr);
+      r = ipsec_spd_range_len6 (&p->raddr);
+    }
+  else
+    {
+      l = ipsec_spd_range_len4 (&p->laddr);
+      r = ipsec_spd_range_len4 (&p->raddr);
+    }
+
+  if (l < 0 || r < 0)
+    return (0);
+
+  *llen = l;
+  *rlen = r;
+
+  return (1);
+}
+
+static void
+ipsec_spd_policies_insert (u32 ** policies, u32 policy_index)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_policy_t *p;
+  u32 ii;
+
+  p = pool_elt_at_index (im->policies, policy_index);
+
+  vec_foreach_index (ii, *policies)
+  {
+    if (ipsec_policy_precedes (p, pool_elt_at_index (im->policies,
+						     (*policies)[ii])))
+      break;
+  }
+  vec_insert_elts (*policies, &policy_index, 1, ii);
+}
+
+static void
+ipsec_spd_policies_remove (u32 ** policies, u32 policy_index)
+{
+  u32 ii;
+
+  ii = vec_search (*policies, policy_index);
+
+  if (~0 != ii)
+    vec_delete (*policies, 1, ii);
+}
+
+/**
+ * @brief Add a policy to the bucket for the key, creating the bucket
+ * if this is the first policy. Returns 1 if the bucket was created.
+ */
+static int
+ipsec_spd_bucket_add4 (clib_bihash_kv_16_8_t * kv, u32 policy_index)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_bucket_t *bkt;
+  int created = 0;
+
+  if (clib_bihash_search_16_8 (&im->spd4_lookup, kv, kv))
+    {
+      pool_get_zero (im->spd_buckets, bkt);
+      kv->value = bkt - im->spd_buckets;
+      clib_bihash_add_del_16_8 (&im->spd4_lookup, kv, 1);
+      created = 1;
+    }
+  bkt = pool_elt_at_index (im->spd_buckets, kv->value);
+  ipsec_spd_policies_insert (&bkt->policies, policy_index);
+
+  return (created);
+}
+
+static int
+ipsec_spd_bucket_add6 (clib_bihash_kv_40_8_t * kv, u32 policy_index)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_bucket_t *bkt;
+  int created = 0;
+
+  if (clib_bihash_search_40_8 (&im->spd6_lookup, kv, kv))
+    {
+      pool_get_zero (im->spd_buckets, bkt);
+      kv->value = bkt - im->spd_buckets;
+      clib_bihash_add_del_40_8 (&im->spd6_lookup, kv, 1);
+      created = 1;
+    }
+  bkt = pool_elt_at_index (im->spd_buckets, kv->value);
+  ipsec_spd_policies_insert (&bkt->policies, policy_index);
+
+  return (created);
+}
+
+/**
+ * @brief Remove a policy from the bucket for the key, deleting the bucket
+ * if it is now empty. Returns 1 if the bucket was deleted.
+ */
+static int
+ipsec_spd_bucket_del4 (clib_bihash_kv_16_8_t * kv, u32 policy_index)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_bucket_t *bkt;
+
+  if (clib_bihash_search_16_8 (&im->spd4_lookup, kv, kv))
+    return (0);
+
+  bkt = pool_elt_at_index (im->spd_buckets, kv->value);
+  ipsec_spd_policies_remove (&bkt->policies, policy_index);
+
+  if (0 != vec_len (bkt->policies))
+    return (0);
+
+  clib_bihash_add_del_16_8 (&im->spd4_lookup, kv, 0);
+  vec_free (bkt->policies);
+  pool_put (im->spd_buckets, bkt);
+
+  return (1);
+}
+
+static int
+ipsec_spd_bucket_del6 (clib_bihash_kv_40_8_t * kv, u32 policy_index)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_bucket_t *bkt;
+
+  if (clib_bihash_search_40_8 (&im->spd6_lookup, kv, kv))
+    return (0);
+
+  bkt = pool_elt_at_index (im->spd_buckets, kv->value);
+  ipsec_spd_policies_remove (&bkt->policies, policy_index);
+
+  if (0 != vec_len (bkt->policies))
+    return (0);
+
+  clib_bihash_add_del_40_8 (&im->spd6_lookup, kv, 0);
+  vec_free (bkt->policies);
+  pool_put (im->spd_buckets, bkt);
+
+  return (1);
+}
+
+static int
+ipsec_spd_bucket_add_del (ipsec_spd_t * spd,
+			  const ipsec_policy_t * p,
+			  u32 policy_index, u8 llen, u8 rlen, int is_add)
+{
+  ipsec_main_t *im = &ipsec_main;
+  clib_bihash_kv_16_8_t kv4;
+  clib_bihash_kv_40_8_t kv6;
+  u32 spd_index, spi;
+
+  spd_index = spd - im->spds;
+
+  if (ipsec_spd_policy_type_is_protect (p->type))
+    {
+      spi = ipsec_sa_get (p->sa_index)->spi;
+
+      if (p->is_ipv6)
+	ipsec_spd_lookup_mk_spi_key6 (&kv6, spd_index, p->type, spi);
+      else
+	ipsec_spd_lookup_mk_spi_key4 (&kv4, spd_index, p->type, spi);
+    }
+  else
+    {
+      if (p->is_ipv6)
+	ipsec_spd_lookup_mk_key6 (&kv6, spd_index, p->type,
+				  &p->laddr.start.ip6,
+				  &p->raddr.start.ip6, llen, rlen);
+      else
+	ipsec_spd_lookup_mk_key4 (&kv4, spd_index, p->type,
+				  clib_net_to_host_u32 (p->laddr.start.
+							ip4.as_u32),
+				  clib_net_to_host_u32 (p->raddr.start.
+							ip4.as_u32), llen,
+				  rlen);
+    }
+
+  if (p->is_ipv6)
+    return (is_add ?
+	    ipsec_spd_bucket_add6 (&kv6, policy_index) :
+	    ipsec_spd_bucket_del6 (&kv6, policy_index));
+  else
+    return (is_add ?
+	    ipsec_spd_bucket_add4 (&kv4, policy_index) :
+	    ipsec_spd_bucket_del4 (&kv4, policy_index));
+}
+
+static int
+ipsec_spd_tuple_sort (void *a1, void *a2)
+{
+  ipsec_spd_tuple_t *t1 = a1, *t2 = a2;
+
+  if (t1->max_priority > t2->max_priority)
+    return (-1);
+  if (t1->max_priority < t2->max_priority)
+    return (1);
+  return (0);
+}
+
+static ipsec_spd_tuple_t *
+ipsec_spd_tuple_find (ipsec_spd_lookup_t * lk, u8 llen, u8 rlen)
+{
+  ipsec_spd_tuple_t *t;
+
+  vec_foreach (t, lk->tuples)
+  {
+    if (t->laddr_len == llen && t->raddr_len == rlen)
+      return (t);
+  }
+  return (NULL);
+}
+
+void
+ipsec_spd_lookup_add_policy (ipsec_spd_t * spd, u32 policy_index)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_lookup_t *lk;
+  ipsec_spd_tuple_t *t;
+  ipsec_policy_t *p;
+  u8 llen, rlen;
+
+  p = pool_elt_at_index (im->policies, policy_index);
+  lk = &spd->lookup[p->type];
+
+  if (ipsec_spd_policy_type_is_protect (p->type))
+    {
+      lk->n_buckets +=
+	ipsec_spd_bucket_add_del (spd, p, policy_index, 0, 0, 1);
+      return;
+    }
+
+  if (!ipsec_policy_get_tuple (p, &llen, &rlen))
+    {
+      ipsec_spd_policies_insert (&lk->residual, policy_index);
+      return;
+    }
+
+  t = ipsec_spd_tuple_find (lk, llen, rlen);
+
+  if (NULL == t)
+    {
+      vec_add2 (lk->tuples, t, 1);
+      t->laddr_len = llen;
+      t->raddr_len = rlen;
+      t->max_priority = p->priority;
+    }
+  else
+    t->max_priority = clib_max (t->max_priority, p->priority);
+
+  t->n_policies++;
+  if (ipsec_spd_bucket_add_del (spd, p, policy_index, llen, rlen, 1))
+    {
+      t->n_buckets++;
+      lk->n_buckets++;
+    }
+
+  vec_sort_with_function (lk->tuples, ipsec_spd_tuple_sort);
+}
+
+/**
+ * @brief Remove a policy from the compiled lookup. The policy must
+ * already have been removed from the SPD's policy vector.
+ */
+void
+ipsec_spd_lookup_del_policy (ipsec_spd_t * spd, u32 policy_index)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_lookup_t *lk;
+  ipsec_spd_tuple_t *t;
+  ipsec_policy_t *p, *vp;
+  u8 llen, rlen, l, r;
+  u32 *i;
+
+  p = pool_elt_at_index (im->policies, policy_index);
+  lk = &spd->lookup[p->type];
+
+  if (ipsec_spd_policy_type_is_protect (p->type))
+    {
+      lk->n_buckets -=
+	ipsec_spd_bucket_add_del (spd, p, policy_index, 0, 0, 0);
+      return;
+    }
+
+  if (!ipsec_policy_get_tuple (p, &llen, &rlen))
+    {
+      ipsec_spd_policies_remove (&lk->residual, policy_index);
+      return;
+    }
+
+  t = ipsec_spd_tuple_find (lk, llen, rlen);
+
+  if (NULL == t)
+    return;
+
+  if (ipsec_spd_bucket_add_del (spd, p, policy_index, llen, rlen, 0))
+    {
+      t->n_buckets--;
+      lk->n_buckets--;
+    }
+
+  if (0 == --t->n_policies)
+    {
+      vec_delete (lk->tuples, 1, t - lk->tuples);
+      return;
+    }
+
+  /*
+   * the SPD's vector is sorted, so the first remaining policy in the
+   * tuple has its highest priority
+   */
+  vec_foreach (i, spd->policies[p->type])
+  {
+    vp = pool_elt_at_index (im->policies, *i);
+
+    if (ipsec_policy_get_tuple (vp, &l, &r) && l == llen && r == rlen)
+      {
+	t->max_priority = vp->priority;
+	break;
+      }
+  }
+
+  vec_sort_with_function (lk->tuples, ipsec_spd_tuple_sort);
+}
+
+void
+ipsec_spd_lookup_flush (ipsec_spd_t * spd)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_policy_type_t type;
+  ipsec_policy_t *p;
+  u8 llen, rlen;
+  u32 *i;
+
+  FOR_EACH_IPSEC_SPD_POLICY_TYPE (type)
+  {
+    vec_foreach (i, spd->policies[type])
+    {
+      p = pool_elt_at_index (im->policies, *i);
+
+      if (ipsec_spd_policy_type_is_protect (type))
+	ipsec_spd_bucket_add_del (spd, p, *i, 0, 0, 0);
+      else if (ipsec_policy_get_tuple (p, &llen, &rlen))
+	ipsec_spd_bucket_add_del (spd, p, *i, llen, rlen, 0);
+    }
+    vec_free (spd->lookup[type].tuples);
+    vec_free (spd->lookup[type].residual);
+    spd->lookup[type].n_buckets = 0;
+  }
+}
+
+u8 *
+format_ipsec_spd_lookup (u8 * s, va_list * args)
+{
+  u32 si = va_arg (*args, u32);
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_spd_policy_type_t type;
+  ipsec_spd_lookup_t *lk;
+  ipsec_spd_tuple_t *t;
+  ipsec_spd_t *spd;
+  u32 n_policies;
+
+  if (pool_is_free_index (im->spds, si))
+    return (format (s, "No such SPD index: %d", si));
+
+  spd = pool_elt_at_index (im->spds, si);
+
+  s = format (s, "spd %u", spd->id);
+
+  FOR_EACH_IPSEC_SPD_POLICY_TYPE (type)
+  {
+    lk = &spd->lookup[type];
+    n_policies = vec_len (spd->policies[type]);
+
+    if (0 == n_policies)
+      continue;
+
+    s = format (s, "\n %U: %d policies", format_ipsec_policy_type, type,
+		n_policies);
+
+    if (ipsec_spd_policy_type_is_protect (type))
+      {
+	s = format (s, "\n  spi buckets:%d probes:1 avg-compares:%.2f",
+		    lk->n_buckets, (f64) n_policies / lk->n_buckets);
+	continue;
+      }
+
+    /*
+     * the cost of a lookup that does not stop early; one probe per
+     * tuple, plus the compares in the bucket found and the residual
+     */
+    s = format (s, "\n  tuples:%d residual:%d buckets:%d",
+		vec_len (lk->tuples), vec_len (lk->residual), lk->n_buckets);
+    s = format (s, "\n  max-probes:%d avg-compares:%.2f (linear:%d)",
+		vec_len (lk->tuples),
+		(lk->n_buckets ?
+		 (f64) (n_policies - vec_len (lk->residual)) / lk->n_buckets :
+		 0) + vec_len (lk->residual), n_policies);
+
+    vec_foreach (t, lk->tuples)
+    {
+      s = format (s, "\n   local:/%d remote:/%d policies:%d buckets:%d "
+		  "max-priority:%d",
+		  t->laddr_len, t->raddr_len, t->n_policies, t->n_buckets,
+		  t->max_priority);
+    }
+  }
+
+  return (s);
+}
+
+void
+ipsec_spd_flow_cache_init (ipsec_per_thread_data_t * ptd)
+{
+  ipsec_main_t *im = &ipsec_main;
+
+  clib_bihash_init_16_8 (&ptd->spd4_flow_cache, "ipsec spd4 flow cache",
+			 im->spd_flow_cache_hash_buckets,
+			 im->spd_flow_cache_hash_memory);
+  clib_bihash_init_40_8 (&ptd->spd6_flow_cache, "ipsec spd6 flow cache",
+			 im->spd_flow_cache_hash_buckets,
+			 im->spd_flow_cache_hash_memory);
+  ptd->spd4_flow_cache_n_entries = 0;
+  ptd->spd6_flow_cache_n_entries = 0;
+  ptd->spd4_flow_cache_epoch = 0;
+  ptd->spd6_flow_cache_epoch = 0;
+  ptd->spd_flow_cache_generation = im->spd_generation;
+}
+
+int
+ipsec_spd_flow_cache_is_stale4 (clib_bihash_kv_16_8_t * kv, void *arg)
+{
+  ipsec_per_thread_data_t *ptd = arg;
+
+  return ((kv->value >> 32) != ptd->spd4_flow_cache_epoch);
+}
+
+int
+ipsec_spd_flow_cache_is_stale6 (clib_bihash_kv_40_8_t * kv, void *arg)
+{
+  ipsec_per_thread_data_t *ptd = arg;
+
+  return ((kv->value >> 32) != ptd->spd6_flow_cache_epoch);
+}
+
+u8 *
+format_ipsec_spd_flow_cache (u8 * s, va_list * args)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_per_thread_data_t *ptd;
+  u32 thread_index;
+
+  if (!im->spd_flow_cache_enabled)
+    return (format (s, "spd flow cache: disabled"));
+
+  s = format (s, "spd flow cache: generation:%d max-entries:%d",
+	      im->spd_generation, im->spd_flow_cache_max_entries);
+  s = format (s, "\n ip4 hits:%lld misses:%lld",
+	      vlib_get_simple_counter (&ipsec_spd_flow_cache_hits, 0),
+	      vlib_get_simple_counter (&ipsec_spd_flow_cache_misses, 0));
+  s = format (s, "\n ip6 hits:%lld misses:%lld",
+	      vlib_get_simple_counter (&ipsec_spd_flow_cache_hits, 1),
+	      vlib_get_simple_counter (&ipsec_spd_flow_cache_misses, 1));
+
+  vec_foreach_index (thread_index, im->ptd)
+  {
+    ptd = vec_elt_at_index (im->ptd, thread_index);
+    s = format (s, "\n thread:%d ip4-entries:%d ip6-entries:%d",
+		thread_index, ptd->spd4_flow_cache_n_entries,
+		ptd->spd6_flow_cache_n_entries);
+  }
+
+  return (s);
+}
+
+static clib_error_t *
+ipsec_spd_lookup_init (vlib_main_t * vm)
+{
+  ipsec_main_t *im = &ipsec_main;
+
+  clib_bihash_init_16_8 (&im->spd4_lookup, "ipsec spd4 lookup",
+			 IPSEC_SPD_LOOKUP_DEFAULT_HASH_NUM_BUCKETS,
+			 IPSEC_SPD_LOOKUP_DEFAULT_HASH_MEMORY_SIZE);
+  clib_bihash_init_40_8 (&im->spd6_lookup, "ipsec spd6 lookup",
+			 IPSEC_SPD_LOOKUP_DEFAULT_HASH_NUM_BUCKETS,
+			 IPSEC_SPD_LOOKUP_DEFAULT_HASH_MEMORY_SIZE);
+
+  im->spd_flow_cache_hash_buckets =
+    IPSEC_SPD_FLOW_CACHE_DEFAULT_HASH_NUM_BUCKETS;
+  im->spd_flow_cache_hash_memory =
+    IPSEC_SPD_FLOW_CACHE_DEFAULT_HASH_MEMORY_SIZE;
+  im->spd_flow_cache_max_entries = IPSEC_SPD_FLOW_CACHE_DEFAULT_MAX_ENTRIES;
+
+  /* one counter per address family */
+  vlib_validate_simple_counter (&ipsec_spd_flow_cache_hits, 1);
+  vlib_zero_simple_counter (&ipsec_spd_flow_cache_hits, 0);
+  vlib_zero_simple_counter (&ipsec_spd_flow_cache_hits, 1);
+  vlib_validate_simple_counter (&ipsec_spd_flow_cache_misses, 1);
+  vlib_zero_simple_counter (&ipsec_spd_flow_cache_misses, 0);
+  vlib_zero_simple_counter (&ipsec_spd_flow_cache_misses, 1);
+
+  return (NULL);
+}
+
+VLIB_INIT_FUNCTION (ipsec_spd_lookup_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,652 @@
+/*
+ * Copyright (c) 2020 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __IPSEC_SPD_LOOKUP_H__
+#define __IPSEC_SPD_LOOKUP_H__
+
+#include <vnet/ipsec/ipsec.h>
+
+/**
+ * The compiled SPD lookup.
+ *
+ * Each policy whose local and remote address ranges are both prefixes
+ * is added to a bucket in the lookup hash, keyed on the SPD, the policy
+ * type, the masked addresses and the prefix lengths. Policies with the
+ * same prefix lengths form a tuple, and a lookup does one hash probe per
+ * tuple, visiting the tuples in descending order of their highest
+ * priority so that the walk stops as soon as no better match can be
+ * found. Policies with arbitrary ranges are kept on a residual vector
+ * that is walked as before.
+ *
+ * Inbound protect policies are matched on the SPI of their SA, so they
+ * are kept in buckets keyed on the SPI alone.
+ *
+ * The buckets and the residual vector are sorted in SPD order; by
+ * descending priority, then ascending policy index. The result is the
+ * same policy that a linear walk of the SPD would have found.
+ */
+
+/**
+ * The prefix length used in the key of the SPI buckets
+ */
+#define IPSEC_SPD_LOOKUP_SPI_LEN 0xff
+
+#define IPSEC_SPD_LOOKUP_DEFAULT_HASH_NUM_BUCKETS (4 * 1024)
+#define IPSEC_SPD_LOOKUP_DEFAULT_HASH_MEMORY_SIZE (32 << 20)
+
+/**
+ * The SPD flow cache.
+ *
+ * An optional per-thread cache of the outbound lookup result for each
+ * 5-tuple, so the SPD is searched only on the first packet of a flow.
+ * The cached value carries the SPD generation at the time of the lookup;
+ * every policy change bumps the generation, so all cached results become
+ * stale at once. A thread flushes its cache when it holds the maximum
+ * number of entries.
+ */
+#define IPSEC_SPD_FLOW_CACHE_DEFAULT_HASH_NUM_BUCKETS (64 * 1024)
+#define IPSEC_SPD_FLOW_CACHE_DEFAULT_HASH_MEMORY_SIZE (128 << 20)
+#define IPSEC_SPD_FLOW_CACHE_DEFAULT_MAX_ENTRIES (512 * 1024)
+
+/**
+ * The SPD index is stored in 24 bits of the flow key; larger
+ * indices are not cached.
+ */
+#define IPSEC_SPD_FLOW_CACHE_MAX_SPD_INDEX (1 << 24)
+
+/**
+ * Flow cache hit and miss counters, indexed by is_ipv6
+ */
+extern vlib_simple_counter_main_t ipsec_spd_flow_cache_hits;
+extern vlib_simple_counter_main_t ipsec_spd_flow_cache_misses;
+
+extern void ipsec_spd_lookup_add_policy (ipsec_spd_t * spd, u32 policy_index);
+extern void ipsec_spd_lookup_del_policy (ipsec_spd_t * spd, u32 policy_index);
+extern void ipsec_spd_lookup_flush (ipsec_spd_t * spd);
+
+extern void ipsec_spd_flow_cache_init (ipsec_per_thread_data_t * ptd);
+extern int ipsec_spd_flow_cache_is_stale4 (clib_bihash_kv_16_8_t * kv,
+					   void *arg);
+extern int ipsec_spd_flow_cache_is_stale6 (clib_bihash_kv_40_8_t * kv,
+					   void *arg);
+extern u8 *format_ipsec_spd_flow_cache (u8 * s, va_list * args);
+
+extern u8 *format_ipsec_spd_lookup (u8 * s, va_list * args);
+
+always_inline u32
+ipsec_spd_ip4_mask (u8 len)
+{
+  return (len ? ((u32) ~0 << (32 - len)) : 0);
+}
+
+always_inline void
+ipsec_spd_lookup_mk_key4 (clib_bihash_kv_16_8_t * kv,
+			  u32 spd_index,
+			  ipsec_spd_policy_type_t type,
+			  u32 la, u32 ra, u8 llen, u8 rlen)
+{
+  kv->key[0] = ((u64) la << 32) | ra;
+  kv->key[1] = (((u64) spd_index << 32) |
+		(type << 16) | (llen << 8) | rlen);
+  kv->value = ~0ULL;
+}
+
+always_inline void
+ipsec_spd_lookup_mk_spi_key4 (clib_bihash_kv_16_8_t * kv,
+			      u32 spd_index,
+			      ipsec_spd_policy_type_t type, u32 spi)
+{
+  ipsec_spd_lookup_mk_key4 (kv, spd_index, type, spi, 0,
+			    IPSEC_SPD_LOOKUP_SPI_LEN,
+			    IPSEC_SPD_LOOKUP_SPI_LEN);
+}
+
+always_inline void
+ipsec_spd_lookup_mk_key6 (clib_bihash_kv_40_8_t * kv,
+			  u32 spd_index,
+			  ipsec_spd_policy_type_t type,
+			  const ip6_address_t * la,
+			  const ip6_address_t * ra, u8 llen, u8 rlen)
+{
+  const ip6_address_t *lm, *rm;
+
+  lm = &ip6_main.fib_masks[llen];
+  rm = &ip6_main.fib_masks[rlen];
+
+  kv->key[0] = la->as_u64[0] & lm->as_u64[0];
+  kv->key[1] = la->as_u64[1] & lm->as_u64[1];
+  kv->key[2] = ra->as_u64[0] & rm->as_u64[0];
+  kv->key[3] = ra->as_u64[1] & rm->as_u64[1];
+  kv->key[4] = (((u64) spd_index << 32) |
+		(type << 16) | (llen << 8) | rlen);
+  kv->value = ~0ULL;
+}
+
+always_inline void
+ipsec_spd_lookup_mk_spi_key6 (clib_bihash_kv_40_8_t * kv,
+			      u32 spd_index,
+			      ipsec_spd_policy_type_t type, u32 spi)
+{
+  kv->key[0] = spi;
+  kv->key[1] = kv->key[2] = kv->key[3] = 0;
+  kv->key[4] = (((u64) spd_index << 32) | (type << 16) |
+		(IPSEC_SPD_LOOKUP_SPI_LEN << 8) | IPSEC_SPD_LOOKUP_SPI_LEN);
+  kv->value = ~0ULL;
+}
+
+/**
+ * @brief Does policy p1 come before policy p2 in the SPD.
+ * Both are elements of the policy pool, so comparing the pointers
+ * compares the indices.
+ */
+always_inline int
+ipsec_policy_precedes (const ipsec_policy_t * p1, const ipsec_policy_t * p2)
+{
+  return ((p1->priority > p2->priority) ||
+	  (p1->priority == p2->priority && p1 < p2));
+}
+
+always_inline uword
+ip6_addr_match_range (ip6_address_t * a, ip6_address_t * la,
+		      ip6_address_t * ua)
+{
+  if ((memcmp (a->as_u64, la->as_u64, 2 * sizeof (u64)) >= 0) &&
+      (memcmp (a->as_u64, ua->as_u64, 2 * sizeof (u64)) <= 0))
+    return 1;
+  return 0;
+}
+
+always_inline int
+ipsec_proto_has_ports (u8 pr)
+{
+  return ((pr == IP_PROTOCOL_TCP) || (pr == IP_PROTOCOL_UDP)
+	  || (pr == IP_PROTOCOL_SCTP));
+}
+
+always_inline int
+ipsec_policy_match_ports (const ipsec_policy_t * p, u8 pr, u16 lp, u16 rp)
+{
+  if (PREDICT_FALSE (!ipsec_proto_has_ports (pr)))
+    return 1;
+
+  if (lp < p->lport.start)
+    return 0;
+
+  if (lp > p->lport.stop)
+    return 0;
+
+  if (rp < p->rport.start)
+    return 0;
+
+  if (rp > p->rport.stop)
+    return 0;
+
+  return 1;
+}
+
+always_inline int
+ipsec_policy_match_ip4_outbound (const ipsec_policy_t * p,
+				 u8 pr, u32 la, u32 ra, u16 lp, u16 rp)
+{
+  if (PREDICT_FALSE (p->protocol && (p->protocol != pr)))
+    return 0;
+
+  if (ra < clib_net_to_host_u32 (p->raddr.start.ip4.as_u32))
+    return 0;
+
+  if (ra > clib_net_to_host_u32 (p->raddr.stop.ip4.as_u32))
+    return 0;
+
+  if (la < clib_net_to_host_u32 (p->laddr.start.ip4.as_u32))
+    return 0;
+
+  if (la > clib_net_to_host_u32 (p->laddr.stop.ip4.as_u32))
+    return 0;
+
+  return (ipsec_policy_match_ports (p, pr, lp, rp));
+}
+
+always_inline int
+ipsec_policy_match_ip6_outbound (ipsec_policy_t * p,
+				 ip6_address_t * la,
+				 ip6_address_t * ra, u16 lp, u16 rp, u8 pr)
+{
+  if (PREDICT_FALSE (p->protocol && (p->protocol != pr)))
+    return 0;
+
+  if (!ip6_addr_match_range (ra, &p->raddr.start.ip6, &p->raddr.stop.ip6))
+    return 0;
+
+  if (!ip6_addr_match_range (la, &p->laddr.start.ip6, &p->laddr.stop.ip6))
+    return 0;
+
+  return (ipsec_policy_match_ports (p, pr, lp, rp));
+}
+
+always_inline int
+ipsec_policy_match_ip4_inbound_protect (const ipsec_policy_t * p,
+					u32 sa, u32 da, u32 spi)
+{
+  ipsec_sa_t *s;
+
+  s = pool_elt_at_index (ipsec_main.sad, p->sa_index);
+
+  if (spi != s->spi)
+    return 0;
+
+  if (ipsec_sa_is_set_IS_TUNNEL (s))
+    {
+      if (da != clib_net_to_host_u32 (s->tunnel_dst_addr.ip4.as_u32))
+	return 0;
+
+      if (sa != clib_net_to_host_u32 (s->tunnel_src_addr.ip4.as_u32))
+	return 0;
+
+      return 1;
+    }
+
+  if (da < clib_net_to_host_u32 (p->laddr.start.ip4.as_u32))
+    return 0;
+
+  if (da > clib_net_to_host_u32 (p->laddr.stop.ip4.as_u32))
+    return 0;
+
+  if (sa < clib_net_to_host_u32 (p->raddr.start.ip4.as_u32))
+    return 0;
+
+  if (sa > clib_net_to_host_u32 (p->raddr.stop.ip4.as_u32))
+    return 0;
+
+  return 1;
+}
+
+always_inline int
+ipsec_policy_match_ip6_inbound_protect (ipsec_policy_t * p,
+					ip6_address_t * sa,
+					ip6_address_t * da, u32 spi)
+{
+  ipsec_sa_t *s;
+
+  s = pool_elt_at_index (ipsec_main.sad, p->sa_index);
+
+  if (spi != s->spi)
+    return 0;
+
+  if (ipsec_sa_is_set_IS_TUNNEL (s))
+    {
+      if (!ip6_address_is_equal (sa, &s->tunnel_src_addr.ip6))
+	return 0;
+
+      if (!ip6_address_is_equal (da, &s->tunnel_dst_addr.ip6))
+	return 0;
+
+      return 1;
+    }
+
+  if (!ip6_addr_match_range (sa, &p->raddr.start.ip6, &p->raddr.stop.ip6))
+    return 0;
+
+  if (!ip6_addr_match_range (da, &p->laddr.start.ip6, &p->laddr.stop.ip6))
+    return 0;
+
+  return 1;
+}
+
+/**
+ * @brief Walk a vector of policies, sorted in SPD order, for the first
+ * one that matches and that precedes the best match so far.
+ */
+always_inline ipsec_policy_t *
+ipsec_spd_walk_ip4_outbound (u32 * policies, ipsec_policy_t * best,
+			     u8 pr, u32 la, u32 ra, u16 lp, u16 rp)
+{
+  ipsec_policy_t *p;
+  u32 *i;
+
+  vec_foreach (i, policies)
+  {
+    p = pool_elt_at_index (ipsec_main.policies, *i);
+
+    if (best && !ipsec_policy_precedes (p, best))
+      break;
+    if (ipsec_policy_match_ip4_outbound (p, pr, la, ra, lp, rp))
+      return (p);
+  }
+  return (best);
+}
+
+always_inline ipsec_policy_t *
+ipsec_spd_walk_ip6_outbound (u32 * policies, ipsec_policy_t * best,
+			     ip6_address_t * la, ip6_address_t * ra,
+			     u16 lp, u16 rp, u8 pr)
+{
+  ipsec_policy_t *p;
+  u32 *i;
+
+  vec_foreach (i, policies)
+  {
+    p = pool_elt_at_index (ipsec_main.policies, *i);
+
+    if (best && !ipsec_policy_precedes (p, best))
+      break;
+    if (ipsec_policy_match_ip6_outbound (p, la, ra, lp, rp, pr))
+      return (p);
+  }
+  return (best);
+}
+
+always_inline ipsec_policy_t *
+ipsec_spd_lookup_ip4_outbound (ipsec_spd_t * spd, u8 pr,
+			       u32 la, u32 ra, u16 lp, u16 rp)
+{
+  ipsec_main_t *im = &ipsec_main;
+  clib_bihash_kv_16_8_t kv;
+  ipsec_spd_lookup_t *lk;
+  ipsec_policy_t *best;
+  ipsec_spd_tuple_t *t;
+  u32 spd_index;
+
+  if (!spd)
+    return 0;
+
+  best = NULL;
+  spd_index = spd - im->spds;
+  lk = &spd->lookup[IPSEC_SPD_POLICY_IP4_OUTBOUND];
+
+  vec_foreach (t, lk->tuples)
+  {
+    if (best && t->max_priority < best->priority)
+      break;
+
+    ipsec_spd_lookup_mk_key4 (&kv, spd_index,
+			      IPSEC_SPD_POLICY_IP4_OUTBOUND,
+			      la & ipsec_spd_ip4_mask (t->laddr_len),
+			      ra & ipsec_spd_ip4_mask (t->raddr_len),
+			      t->laddr_len, t->raddr_len);
+
+    if (clib_bihash_search_inline_16_8 (&im->spd4_lookup, &kv))
+      continue;
+
+    best = ipsec_spd_walk_ip4_outbound
+      (pool_elt_at_index (im->spd_buckets, kv.value)->policies,
+       best, pr, la, ra, lp, rp);
+  }
+
+  return (ipsec_spd_walk_ip4_outbound (lk->residual, best,
+				       pr, la, ra, lp, rp));
+}
+
+always_inline ipsec_policy_t *
+ipsec_spd_lookup_ip6_outbound (ipsec_spd_t * spd,
+			       ip6_address_t * la,
+			       ip6_address_t * ra, u16 lp, u16 rp, u8 pr)
+{
+  ipsec_main_t *im = &ipsec_main;
+  clib_bihash_kv_40_8_t kv;
+  ipsec_spd_lookup_t *lk;
+  ipsec_policy_t *best;
+  ipsec_spd_tuple_t *t;
+  u32 spd_index;
+
+  if (!spd)
+    return 0;
+
+  best = NULL;
+  spd_index = spd - im->spds;
+  lk = &spd->lookup[IPSEC_SPD_POLICY_IP6_OUTBOUND];
+
+  vec_foreach (t, lk->tuples)
+  {
+    if (best && t->max_priority < best->priority)
+      break;
+
+    ipsec_spd_lookup_mk_key6 (&kv, spd_index,
+			      IPSEC_SPD_POLICY_IP6_OUTBOUND,
+			      la, ra, t->laddr_len, t->raddr_len);
+
+    if (clib_bihash_search_inline_40_8 (&im->spd6_lookup, &kv))
+      continue;
+
+    best = ipsec_spd_walk_ip6_outbound
+      (pool_elt_at_index (im->spd_buckets, kv.value)->policies,
+       best, la, ra, lp, rp, pr);
+  }
+
+  return (ipsec_spd_walk_ip6_outbound (lk->residual, best,
+				       la, ra, lp, rp, pr));
+}
+
+always_inline ipsec_policy_t *
+ipsec_spd_lookup_ip4_inbound_protect (ipsec_spd_t * spd,
+				      u32 sa, u32 da, u32 spi)
+{
+  ipsec_main_t *im = &ipsec_main;
+  clib_bihash_kv_16_8_t kv;
+  ipsec_policy_t *p;
+  u32 *i;
+
+  ipsec_spd_lookup_mk_spi_key4 (&kv, spd - im->spds,
+				IPSEC_SPD_POLICY_IP4_INBOUND_PROTECT, spi);
+
+  if (clib_bihash_search_inline_16_8 (&im->spd4_lookup, &kv))
+    return 0;
+
+  vec_foreach (i, pool_elt_at_index (im->spd_buckets, kv.value)->policies)
+  {
+    p = pool_elt_at_index (im->policies, *i);
+
+    if (ipsec_policy_match_ip4_inbound_protect (p, sa, da, spi))
+      return p;
+  }
+  return 0;
+}
+
+always_inline ipsec_policy_t *
+ipsec_spd_lookup_ip6_inbound_protect (ipsec_spd_t * spd,
+				      ip6_address_t * sa,
+				      ip6_address_t * da, u32 spi)
+{
+  ipsec_main_t *im = &ipsec_main;
+  clib_bihash_kv_40_8_t kv;
+  ipsec_policy_t *p;
+  u32 *i;
+
+  ipsec_spd_lookup_mk_spi_key6 (&kv, spd - im->spds,
+				IPSEC_SPD_POLICY_IP6_INBOUND_PROTECT, spi);
+
+  if (clib_bihash_search_inline_40_8 (&im->spd6_lookup, &kv))
+    return 0;
+
+  vec_foreach (i, pool_elt_at_index (im->spd_buckets, kv.value)->policies)
+  {
+    p = pool_elt_at_index (im->policies, *i);
+
+    if (ipsec_policy_match_ip6_inbound_protect (p, sa, da, spi))
+      return p;
+  }
+  return 0;
+}
+
+always_inline u64
+ipsec_spd_flow_cache_mk_key_tail (u32 spd_index, u8 pr, u16 lp, u16 rp)
+{
+  /* the ports are not matched for other protocols */
+  if (!ipsec_proto_has_ports (pr))
+    lp = rp = 0;
+
+  return (((u64) lp << 48) | ((u64) rp << 32) | ((u64) pr << 24) | spd_index);
+}
+
+always_inline u64
+ipsec_spd_flow_cache_mk_value (u32 epoch, const ipsec_policy_t * p)
+{
+  return (((u64) epoch << 32) |
+	  (u32) (p ? p - ipsec_main.policies : ~0));
+}
+
+/**
+ * @brief Result of a flow cache hit; the cached result is valid only
+ * if it was stored in the current epoch.
+ */
+always_inline int
+ipsec_spd_flow_cache_result (u64 value, u32 epoch, ipsec_policy_t ** p)
+{
+  u32 pi;
+
+  if ((value >> 32) != epoch)
+    return (0);
+
+  pi = value & 0xffffffff;
+  *p = (~0 == pi ? NULL : pool_elt_at_index (ipsec_main.policies, pi));
+
+  return (1);
+}
+
+/**
+ * @brief Start new epochs once the SPDs have changed; the entries of the
+ * old ones are stale, and are overwritten as the buckets fill.
+ */
+always_inline void
+ipsec_spd_flow_cache_sync (ipsec_per_thread_data_t * ptd)
+{
+  u32 generation = ipsec_main.spd_generation;
+
+  if (PREDICT_TRUE (ptd->spd_flow_cache_generation == generation))
+    return;
+
+  ptd->spd_flow_cache_generation = generation;
+  ptd->spd4_flow_cache_epoch++;
+  ptd->spd4_flow_cache_n_entries = 0;
+  ptd->spd6_flow_cache_epoch++;
+  ptd->spd6_flow_cache_n_entries = 0;
+}
+
+always_inline ipsec_policy_t *
+ipsec_spd_flow_cache_lookup_ip4_outbound (ipsec_per_thread_data_t * ptd,
+					  ipsec_spd_t * spd, u8 pr,
+					  u32 la, u32 ra, u16 lp, u16 rp,
+					  u32 * n_hits, u32 * n_misses)
+{
+  ipsec_main_t *im = &ipsec_main;
+  clib_bihash_kv_16_8_t kv;
+  ipsec_policy_t *p;
+  u32 spd_index;
+
+  if (!spd)
+    return 0;
+
+  spd_index = spd - im->spds;
+
+  if (PREDICT_FALSE (spd_index >= IPSEC_SPD_FLOW_CACHE_MAX_SPD_INDEX))
+    return (ipsec_spd_lookup_ip4_outbound (spd, pr, la, ra, lp, rp));
+
+  ipsec_spd_flow_cache_sync (ptd);
+
+  kv.key[0] = ((u64) la << 32) | ra;
+  kv.key[1] = ipsec_spd_flow_cache_mk_key_tail (spd_index, pr, lp, rp);
+
+  if (!clib_bihash_search_inline_16_8 (&ptd->spd4_flow_cache, &kv) &&
+      ipsec_spd_flow_cache_result (kv.value, ptd->spd4_flow_cache_epoch, &p))
+    {
+      *n_hits += 1;
+      return (p);
+    }
+
+  *n_misses += 1;
+  p = ipsec_spd_lookup_ip4_outbound (spd, pr, la, ra, lp, rp);
+
+  /* full; make all entries stale rather than flush the hash */
+  if (PREDICT_FALSE (ptd->spd4_flow_cache_n_entries >=
+		     im->spd_flow_cache_max_entries))
+    {
+      ptd->spd4_flow_cache_epoch++;
+      ptd->spd4_flow_cache_n_entries = 0;
+    }
+
+  /* the key is new to this epoch: a missing key, or a stale entry */
+  kv.value = ipsec_spd_flow_cache_mk_value (ptd->spd4_flow_cache_epoch, p);
+  clib_bihash_add_or_overwrite_stale_16_8 (&ptd->spd4_flow_cache, &kv,
+					   ipsec_spd_flow_cache_is_stale4,
+					   ptd);
+  ptd->spd4_flow_cache_n_entries++;
+
+  return (p);
+}
+
+always_inline ipsec_policy_t *
+ipsec_spd_flow_cache_lookup_ip6_outbound (ipsec_per_thread_data_t * ptd,
+					  ipsec_spd_t * spd,
+					  ip6_address_t * la,
+					  ip6_address_t * ra,
+					  u16 lp, u16 rp, u8 pr, u32 * n_hits,
+					  u32 * n_misses)
+{
+  ipsec_main_t *im = &ipsec_main;
+  clib_bihash_kv_40_8_t kv;
+  ipsec_policy_t *p;
+  u32 spd_index;
+
+  if (!spd)
+    return 0;
+
+  spd_index = spd - im->spds;
+
+  if (PREDICT_FALSE (spd_index >= IPSEC_SPD_FLOW_CACHE_MAX_SPD_INDEX))
+    return (ipsec_spd_lookup_ip6_outbound (spd, la, ra, lp, rp, pr));
+
+  ipsec_spd_flow_cache_sync (ptd);
+
+  kv.key[0] = la->as_u64[0];
+  kv.key[1] = la->as_u64[1];
+  kv.key[2] = ra->as_u64[0];
+  kv.key[3] = ra->as_u64[1];
+  kv.key[4] = ipsec_spd_flow_cache_mk_key_tail (spd_index, pr, lp, rp);
+
+  if (!clib_bihash_search_inline_40_8 (&ptd->spd6_flow_cache, &kv) &&
+      ipsec_spd_flow_cache_result (kv.value, ptd->spd6_flow_cache_epoch, &p))
+    {
+      *n_hits += 1;
+      return (p);
+    }
+
+  *n_misses += 1;
+  p = ipsec_spd_lookup_ip6_outbound (spd, la, ra, lp, rp, pr);
+
+  /* full; make all entries stale rather than flush the hash */
+  if (PREDICT_FALSE (ptd->spd6_flow_cache_n_entries >=
+		     im->spd_flow_cache_max_entries))
+    {
+      ptd->spd6_flow_cache_epoch++;
+      ptd->spd6_flow_cache_n_entries = 0;
+    }
+
+  /* the key is new to this epoch: a missing key, or a stale entry */
+  kv.value = ipsec_spd_flow_cache_mk_value (ptd->spd6_flow_cache_epoch, p);
+  clib_bihash_add_or_overwrite_stale_40_8 (&ptd->spd6_flow_cache, &kv,
+					   ipsec_spd_flow_cache_is_stale6,
+					   ptd);
+  ptd->spd6_flow_cache_n_entries++;
+
+  return (p);
+}
+
+#endif /* __IPSEC_SPD_LOOKUP_H__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
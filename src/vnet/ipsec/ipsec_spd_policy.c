@@ -14,6 +14,7 @@
  */
 
 #include <vnet/ipsec/ipsec.h>
+#include <vnet/ipsec/ipsec_spd_lookup.h>
 
 /**
  * @brief
@@ -91,7 +92,12 @@ ipsec_spd_entry_sort (void *a1, void *a2)
   p1 = pool_elt_at_index (im->policies, *id1);
   p2 = pool_elt_at_index (im->policies, *id2);
   if (p1 && p2)
-    return p2->priority - p1->priority;
+    {
+      if (p1->priority != p2->priority)
+	return p2->priority - p1->priority;
+      /* ties are broken on index, the same as the compiled lookup */
+      return (*id1 < *id2 ? -1 : 1);
+    }
 
   return 0;
 }
@@ -132,6 +138,47 @@ ipsec_policy_mk_type (bool is_outbound,
   return (-1);
 }
 
+/**
+ * Count the inbound protect policies of an SPD that use each SA, so the
+ * inbound SA lookup accepts only SAs this SPD protects with. Also track the
+ * first policy, by priority, using each SA: the one the SPD lookup matches
+ * for the tunnel SAs the SA lookup handles, and so the one it counts.
+ */
+static void
+ipsec_spd_in_protect_sa_ref (ipsec_spd_t * spd, const ipsec_policy_t * p,
+			     int is_add)
+{
+  ipsec_main_t *im = &ipsec_main;
+  u32 *pi;
+
+  if (IPSEC_SPD_POLICY_IP4_INBOUND_PROTECT != p->type &&
+      IPSEC_SPD_POLICY_IP6_INBOUND_PROTECT != p->type)
+    return;
+
+  vec_validate (spd->in_protect_sa_refs, p->sa_index);
+  vec_validate_init_empty (spd->in_protect_sa_policy, p->sa_index, ~0);
+
+  if (is_add)
+    spd->in_protect_sa_refs[p->sa_index]++;
+  else
+    {
+      ASSERT (spd->in_protect_sa_refs[p->sa_index]);
+      spd->in_protect_sa_refs[p->sa_index]--;
+    }
+
+  /* the SPD's policies are sorted, and already include the added or
+     exclude the deleted policy */
+  spd->in_protect_sa_policy[p->sa_index] = ~0;
+  /* *INDENT-OFF* */
+  vec_foreach (pi, spd->policies[p->type])
+    if (pool_elt_at_index (im->policies, *pi)->sa_index == p->sa_index)
+      {
+	spd->in_protect_sa_policy[p->sa_index] = *pi;
+	break;
+      }
+  /* *INDENT-ON* */
+}
+
 int
 ipsec_add_del_policy (vlib_main_t * vm,
 		      ipsec_policy_t * policy, int is_add, u32 * stat_index)
@@ -152,6 +199,9 @@ ipsec_add_del_policy (vlib_main_t * vm,
   if (!spd)
     return VNET_API_ERROR_SYSCALL_ERROR_1;
 
+  /* invalidate the results cached for all flows */
+  im->spd_generation++;
+
   if (is_add)
     {
       u32 policy_index;
@@ -178,6 +228,8 @@ ipsec_add_del_policy (vlib_main_t * vm,
       vec_add1 (spd->policies[policy->type], policy_index);
       vec_sort_with_function (spd->policies[policy->type],
 			      ipsec_spd_entry_sort);
+      ipsec_spd_lookup_add_policy (spd, policy_index);
+      ipsec_spd_in_protect_sa_ref (spd, vp, 1);
       *stat_index = policy_index;
     }
   else
@@ -190,7 +242,10 @@ ipsec_add_del_policy (vlib_main_t * vm,
 				spd->policies[policy->type][ii]);
 	if (ipsec_policy_is_equal (vp, policy))
 	  {
-	    vec_del1 (spd->policies[policy->type], ii);
+	    /* preserve the order of those that remain */
+	    vec_delete (spd->policies[policy->type], 1, ii);
+	    ipsec_spd_lookup_del_policy (spd, vp - im->policies);
+	    ipsec_spd_in_protect_sa_ref (spd, vp, 0);
 	    ipsec_sa_unlock (vp->sa_index);
 	    pool_put (im->policies, vp);
 	    break;
@@ -35,10 +35,18 @@ typedef struct ipsec_protect_db_t_
 
 static ipsec_protect_db_t ipsec_protect_db;
 
+/**
+ * Number of protections with input SAs waiting to be retired
+ */
+static u32 ipsec_protect_n_retiring;
+
+vlib_node_registration_t ipsec_tun_protect_retire_node;
+
 static int
 ipsec_tun_protect_feature_set (ipsec_tun_protect_t * itp, u8 enable)
 {
-  u32 sai = itp->itp_out_sa;
+  /* the encrypt node finds the output SA through the protection */
+  u32 itpi = itp - ipsec_protect_pool;
   int rv;
 
   const char *enc_node = (ip46_address_is_ip4 (&itp->itp_tun.src) ?
@@ -49,63 +57,119 @@ ipsec_tun_protect_feature_set (ipsec_tun_protect_t * itp, u8 enable)
       rv = vnet_feature_enable_disable ("ethernet-output",
 					enc_node,
 					itp->itp_sw_if_index, enable,
-					&sai, sizeof (sai));
+					&itpi, sizeof (itpi));
     }
   else
     {
       rv = vnet_feature_enable_disable ("ip4-output",
 					enc_node,
 					itp->itp_sw_if_index, enable,
-					&sai, sizeof (sai));
+					&itpi, sizeof (itpi));
       rv = vnet_feature_enable_disable ("ip6-output",
 					enc_node,
 					itp->itp_sw_if_index, enable,
-					&sai, sizeof (sai));
+					&itpi, sizeof (itpi));
     }
   ASSERT (!rv);
   return (rv);
 }
 
 static void
-ipsec_tun_protect_db_add (ipsec_main_t * im, const ipsec_tun_protect_t * itp)
+ipsec_tun_protect_db_add_one (ipsec_main_t * im,
+			      const ipsec_tun_protect_t * itp,
+			      const ip46_address_t * dst, index_t sai)
+{
+  const ipsec_sa_t *sa;
+
+  sa = ipsec_sa_get (sai);
+
+  ipsec_tun_lkup_result_t res = {
+    .tun_index = itp - ipsec_protect_pool,
+    .sa_index = sai,
+  };
+
+  /*
+   * The key is formed from the tunnel's destination
+   * as the packet lookup is done from the packet's source
+   */
+  if (ip46_address_is_ip4 (dst))
+    {
+      ipsec4_tunnel_key_t key = {
+	.remote_ip = dst->ip4,
+	.spi = clib_host_to_net_u32 (sa->spi),
+      };
+      hash_set (im->tun4_protect_by_key, key.as_u64, res.as_u64);
+      if (1 == hash_elts (im->tun4_protect_by_key))
+	udp_register_dst_port (vlib_get_main (),
+			       UDP_DST_PORT_ipsec,
+			       ipsec4_tun_input_node.index, 1);
+    }
+  else
+    {
+      ipsec6_tunnel_key_t key = {
+	.remote_ip = dst->ip6,
+	.spi = clib_host_to_net_u32 (sa->spi),
+      };
+      hash_set_mem_alloc (&im->tun6_protect_by_key, &key, res.as_u64);
+    }
+}
+
+/**
+ * Remove the DB entry of an input SA, unless it has since been taken over
+ * by a different SA or protection with the same key
+ */
+static void
+ipsec_tun_protect_db_remove_one (ipsec_main_t * im,
+				 const ipsec_tun_protect_t * itp,
+				 const ip46_address_t * dst, index_t sai)
 {
   const ipsec_sa_t *sa;
+  ipsec_tun_lkup_result_t res;
+  uword *p;
+
+  sa = ipsec_sa_get (sai);
+
+  if (ip46_address_is_ip4 (dst))
+    {
+      ipsec4_tunnel_key_t key = {
+	.remote_ip = dst->ip4,
+	.spi = clib_host_to_net_u32 (sa->spi),
+      };
+      p = hash_get (im->tun4_protect_by_key, key.as_u64);
+      if (!p)
+	return;
+      res.as_u64 = p[0];
+      if (res.sa_index != sai || res.tun_index != itp - ipsec_protect_pool)
+	return;
+      hash_unset (im->tun4_protect_by_key, key.as_u64);
+      if (0 == hash_elts (im->tun4_protect_by_key))
+	udp_unregister_dst_port (vlib_get_main (), UDP_DST_PORT_ipsec, 1);
+    }
+  else
+    {
+      ipsec6_tunnel_key_t key = {
+	.remote_ip = dst->ip6,
+	.spi = clib_host_to_net_u32 (sa->spi),
+      };
+      p = hash_get_mem (im->tun6_protect_by_key, &key);
+      if (!p)
+	return;
+      res.as_u64 = p[0];
+      if (res.sa_index != sai || res.tun_index != itp - ipsec_protect_pool)
+	return;
+      hash_unset_mem_free (&im->tun6_protect_by_key, &key);
+    }
+}
+
+static void
+ipsec_tun_protect_db_add (ipsec_main_t * im, const ipsec_tun_protect_t * itp)
+{
   u32 sai;
 
   /* *INDENT-OFF* */
   FOR_EACH_IPSEC_PROTECT_INPUT_SAI(itp, sai,
   ({
-      sa = ipsec_sa_get (sai);
-
-      ipsec_tun_lkup_result_t res = {
-        .tun_index = itp - ipsec_protect_pool,
-        .sa_index = sai,
-      };
-
-      /*
-       * The key is formed from the tunnel's destination
-       * as the packet lookup is done from the packet's source
-       */
-      if (ip46_address_is_ip4 (&itp->itp_crypto.dst))
-        {
-          ipsec4_tunnel_key_t key = {
-            .remote_ip = itp->itp_crypto.dst.ip4,
-            .spi = clib_host_to_net_u32 (sa->spi),
-          };
-          hash_set (im->tun4_protect_by_key, key.as_u64, res.as_u64);
-          if (1 == hash_elts(im->tun4_protect_by_key))
-            udp_register_dst_port (vlib_get_main(),
-                                   UDP_DST_PORT_ipsec,
-                                   ipsec4_tun_input_node.index, 1);
-        }
-      else
-        {
-          ipsec6_tunnel_key_t key = {
-            .remote_ip = itp->itp_crypto.dst.ip6,
-            .spi = clib_host_to_net_u32 (sa->spi),
-          };
-          hash_set_mem_alloc (&im->tun6_protect_by_key, &key, res.as_u64);
-        }
+    ipsec_tun_protect_db_add_one (im, itp, &itp->itp_crypto.dst, sai);
   }))
   /* *INDENT-ON* */
 }
@@ -114,55 +178,46 @@ static void
 ipsec_tun_protect_db_remove (ipsec_main_t * im,
 			     const ipsec_tun_protect_t * itp)
 {
-  const ipsec_sa_t *sa;
+  u32 sai;
 
   /* *INDENT-OFF* */
-  FOR_EACH_IPSEC_PROTECT_INPUT_SA(itp, sa,
+  FOR_EACH_IPSEC_PROTECT_INPUT_SAI(itp, sai,
   ({
-      if (ip46_address_is_ip4 (&itp->itp_crypto.dst))
-        {
-          ipsec4_tunnel_key_t key = {
-            .remote_ip = itp->itp_crypto.dst.ip4,
-            .spi = clib_host_to_net_u32 (sa->spi),
-          };
-          hash_unset (im->tun4_protect_by_key, key.as_u64);
-          if (0 == hash_elts(im->tun4_protect_by_key))
-            udp_unregister_dst_port (vlib_get_main(),
-                                     UDP_DST_PORT_ipsec,
-                                     1);
-        }
-      else
-        {
-          ipsec6_tunnel_key_t key = {
-            .remote_ip = itp->itp_crypto.dst.ip6,
-            .spi = clib_host_to_net_u32 (sa->spi),
-          };
-          hash_unset_mem_free (&im->tun6_protect_by_key, &key);
-        }
+    ipsec_tun_protect_db_remove_one (im, itp, &itp->itp_crypto.dst, sai);
   }))
   /* *INDENT-ON* */
 }
 
+/**
+ * Stop accepting the input SAs replaced by the last update
+ */
 static void
-ipsec_tun_protect_config (ipsec_main_t * im,
-			  ipsec_tun_protect_t * itp, u32 sa_out, u32 * sas_in)
+ipsec_tun_protect_retire (ipsec_main_t * im, ipsec_tun_protect_t * itp)
 {
-  ipsec_sa_t *sa;
   index_t sai;
   u32 ii;
 
-  itp->itp_n_sa_in = vec_len (sas_in);
-  for (ii = 0; ii < itp->itp_n_sa_in; ii++)
-    itp->itp_in_sas[ii] = sas_in[ii];
-  itp->itp_out_sa = sa_out;
+  if (0 == itp->itp_n_sa_retiring)
+    return;
 
-  ipsec_sa_lock (itp->itp_out_sa);
+  for (ii = 0; ii < itp->itp_n_sa_retiring; ii++)
+    {
+      sai = itp->itp_retiring_sas[ii];
+      ipsec_tun_protect_db_remove_one (im, itp, &itp->itp_retiring_dst, sai);
+      ipsec_sa_unset_IS_PROTECT (ipsec_sa_get (sai));
+      ipsec_sa_unlock (sai);
+    }
+
+  itp->itp_n_sa_retiring = 0;
+  ipsec_protect_n_retiring--;
+}
+
+static void
+ipsec_tun_protect_set_crypto (ipsec_tun_protect_t * itp)
+{
+  ipsec_sa_t *sa;
 
   /* *INDENT-OFF* */
-  FOR_EACH_IPSEC_PROTECT_INPUT_SAI(itp, sai,
-  ({
-    ipsec_sa_lock(sai);
-  }));
   FOR_EACH_IPSEC_PROTECT_INPUT_SA(itp, sa,
   ({
     if (ipsec_sa_is_set_IS_TUNNEL (sa))
@@ -180,6 +235,30 @@ ipsec_tun_protect_config (ipsec_main_t * im,
       }
   }));
   /* *INDENT-ON* */
+}
+
+static void
+ipsec_tun_protect_config (ipsec_main_t * im,
+			  ipsec_tun_protect_t * itp, u32 sa_out, u32 * sas_in)
+{
+  index_t sai;
+  u32 ii;
+
+  itp->itp_n_sa_in = vec_len (sas_in);
+  for (ii = 0; ii < itp->itp_n_sa_in; ii++)
+    itp->itp_in_sas[ii] = sas_in[ii];
+  itp->itp_out_sa = sa_out;
+
+  ipsec_sa_lock (itp->itp_out_sa);
+
+  /* *INDENT-OFF* */
+  FOR_EACH_IPSEC_PROTECT_INPUT_SAI(itp, sai,
+  ({
+    ipsec_sa_lock(sai);
+  }));
+  /* *INDENT-ON* */
+
+  ipsec_tun_protect_set_crypto (itp);
 
   /*
    * add to the DB against each SA
@@ -200,6 +279,8 @@ ipsec_tun_protect_unconfig (ipsec_main_t * im, ipsec_tun_protect_t * itp)
 
   ipsec_tun_protect_feature_set (itp, 0);
 
+  ipsec_tun_protect_retire (im, itp);
+
   /* *INDENT-OFF* */
   FOR_EACH_IPSEC_PROTECT_INPUT_SA(itp, sa,
   ({
@@ -217,6 +298,74 @@ ipsec_tun_protect_unconfig (ipsec_main_t * im, ipsec_tun_protect_t * itp)
   /* *INDENT-ON* */
 }
 
+/**
+ * Make-before-break update of the SAs of a protection:
+ *  - the new input SAs are added to the DB alongside the current ones
+ *  - the output SA is swapped with a single store
+ *  - the input SAs no longer used are retired once the overlap window
+ *    has passed, or straight away if there is none
+ * The encrypt feature stays configured throughout.
+ */
+static void
+ipsec_tun_protect_swap (ipsec_main_t * im,
+			ipsec_tun_protect_t * itp, u32 sa_out, u32 * sas_in)
+{
+  index_t old_out, old_in[ARRAY_LEN (itp->itp_in_sas)];
+  ip46_address_t old_dst;
+  u32 ii, jj, n_old_in;
+
+  /* SAs replaced by a previous update have had their overlap */
+  ipsec_tun_protect_retire (im, itp);
+
+  old_out = itp->itp_out_sa;
+  old_dst = itp->itp_crypto.dst;
+  n_old_in = itp->itp_n_sa_in;
+  clib_memcpy_fast (old_in, itp->itp_in_sas, sizeof (old_in));
+
+  itp->itp_n_sa_in = vec_len (sas_in);
+  for (ii = 0; ii < itp->itp_n_sa_in; ii++)
+    {
+      itp->itp_in_sas[ii] = sas_in[ii];
+      ipsec_sa_lock (sas_in[ii]);
+    }
+  ipsec_tun_protect_set_crypto (itp);
+  ipsec_tun_protect_db_add (im, itp);
+
+  ipsec_sa_lock (sa_out);
+  clib_atomic_store_rel_n (&itp->itp_out_sa, sa_out);
+  ipsec_sa_unlock (old_out);
+
+  for (ii = 0; ii < n_old_in; ii++)
+    {
+      for (jj = 0; jj < itp->itp_n_sa_in; jj++)
+	if (old_in[ii] == itp->itp_in_sas[jj])
+	  break;
+
+      if (jj < itp->itp_n_sa_in)
+	/* still in use, it was locked again above */
+	ipsec_sa_unlock (old_in[ii]);
+      else
+	itp->itp_retiring_sas[itp->itp_n_sa_retiring++] = old_in[ii];
+    }
+
+  if (0 == itp->itp_n_sa_retiring)
+    return;
+
+  itp->itp_retiring_dst = old_dst;
+  ipsec_protect_n_retiring++;
+
+  if (im->tun_protect_overlap > 0)
+    {
+      vlib_main_t *vm = vlib_get_main ();
+
+      itp->itp_retire_at = vlib_time_now (vm) + im->tun_protect_overlap;
+      vlib_process_signal_event (vm, ipsec_tun_protect_retire_node.index,
+				 0, 0);
+    }
+  else
+    ipsec_tun_protect_retire (im, itp);
+}
+
 index_t
 ipsec_tun_protect_find (u32 sw_if_index)
 {
@@ -277,8 +426,7 @@ ipsec_tun_protect_update_out (u32 sw_if_index, u32 sa_out)
       goto out;
     }
 
-  ipsec_tun_protect_unconfig (im, itp);
-  ipsec_tun_protect_config (im, itp, sa_out, sas_in);
+  ipsec_tun_protect_swap (im, itp, sa_out, sas_in);
 
   ipsec_sa_unlock (sa_out);
   vec_foreach (saip, sas_in) ipsec_sa_unlock (*saip);
@@ -322,8 +470,7 @@ ipsec_tun_protect_update_in (u32 sw_if_index, u32 sa_in)
 
   ipsec_sa_lock (sa_out);
 
-  ipsec_tun_protect_unconfig (im, itp);
-  ipsec_tun_protect_config (im, itp, sa_out, sas_in);
+  ipsec_tun_protect_swap (im, itp, sa_out, sas_in);
 
   ipsec_sa_unlock (sa_out);
   ipsec_sa_unlock (sa_in);
@@ -438,8 +585,7 @@ ipsec_tun_protect_update (u32 sw_if_index, u32 sa_out, u32 * sas_in)
       /* updating SAs only */
       itp = pool_elt_at_index (ipsec_protect_pool, itpi);
 
-      ipsec_tun_protect_unconfig (im, itp);
-      ipsec_tun_protect_config (im, itp, sa_out, sas_in);
+      ipsec_tun_protect_swap (im, itp, sa_out, sas_in);
     }
 
   ipsec_sa_unlock (sa_out);
@@ -494,6 +640,69 @@ ipsec_tun_protect_walk (ipsec_tun_protect_walk_cb_t fn, void *ctx)
   /* *INDENT-ON* */
 }
 
+void
+ipsec_tun_protect_set_overlap (f64 overlap)
+{
+  ipsec_main.tun_protect_overlap = overlap;
+}
+
+static uword
+ipsec_tun_protect_retire_process (vlib_main_t * vm,
+				  vlib_node_runtime_t * rt, vlib_frame_t * f)
+{
+  ipsec_main_t *im = &ipsec_main;
+  ipsec_tun_protect_t *itp;
+  index_t *itpis = NULL, *itpi;
+  f64 now, timeout;
+
+  timeout = 1e9;
+
+  while (1)
+    {
+      if (ipsec_protect_n_retiring)
+	vlib_process_wait_for_event_or_clock (vm, timeout);
+      else
+	vlib_process_wait_for_event (vm);
+      vlib_process_get_events (vm, NULL);
+
+      now = vlib_time_now (vm);
+      timeout = 1e9;
+
+      /* *INDENT-OFF* */
+      pool_foreach (itp, ipsec_protect_pool,
+      ({
+        if (0 == itp->itp_n_sa_retiring)
+          continue;
+        if (itp->itp_retire_at <= now)
+          vec_add1 (itpis, itp - ipsec_protect_pool);
+        else
+          timeout = clib_min (timeout, itp->itp_retire_at - now);
+      }));
+      /* *INDENT-ON* */
+
+      if (0 == vec_len (itpis))
+	continue;
+
+      /* the tunnel DB is read by the workers */
+      vlib_worker_thread_barrier_sync (vm);
+      vec_foreach (itpi, itpis)
+	ipsec_tun_protect_retire (im, ipsec_tun_protect_get (*itpi));
+      vlib_worker_thread_barrier_release (vm);
+
+      vec_reset_length (itpis);
+    }
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (ipsec_tun_protect_retire_node) = {
+  .function = ipsec_tun_protect_retire_process,
+  .type = VLIB_NODE_TYPE_PROCESS,
+  .name = "ipsec-tun-protect-retire",
+};
+/* *INDENT-ON* */
+
 clib_error_t *
 ipsec_tunnel_protect_init (vlib_main_t * vm)
 {
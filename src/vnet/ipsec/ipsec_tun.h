@@ -77,6 +77,13 @@ typedef struct ipsec_tun_protect_t_
 
   ipsec_ep_t itp_tun;
 
+  /* input SAs replaced by the last update; still accepted until
+   * itp_retire_at so the peer can move to the new SAs at its own pace */
+  u32 itp_n_sa_retiring;
+  index_t itp_retiring_sas[4];
+  ip46_address_t itp_retiring_dst;
+  f64 itp_retire_at;
+
 } ipsec_tun_protect_t;
 
 #define FOR_EACH_IPSEC_PROTECT_INPUT_SAI(_itp, _sai, body) \
@@ -105,6 +112,8 @@ extern int ipsec_tun_protect_update_out (u32 sw_if_index, u32 sa_out);
 
 extern int ipsec_tun_protect_del (u32 sw_if_index);
 
+extern void ipsec_tun_protect_set_overlap (f64 overlap);
+
 typedef walk_rc_t (*ipsec_tun_protect_walk_cb_t) (index_t itpi, void *arg);
 extern void ipsec_tun_protect_walk (ipsec_tun_protect_walk_cb_t fn,
 				    void *cttx);
@@ -140,6 +149,18 @@ ipsec_tun_protect_get (u32 index)
   return (pool_elt_at_index (ipsec_protect_pool, index));
 }
 
+/**
+ * @brief The output SA of a protected tunnel.
+ * The tunnel's encrypt feature is configured with the protection's index
+ * rather than the SA's, so that a rekey swaps the output SA with this one
+ * store instead of a feature reconfiguration.
+ */
+always_inline index_t
+ipsec_tun_protect_get_sa_out (u32 index)
+{
+  return (clib_atomic_load_acq_n (&ipsec_protect_pool[index].itp_out_sa));
+}
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
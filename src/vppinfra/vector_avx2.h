@@ -224,6 +224,16 @@ u32x8_gather (void *p0, void *p1, void *p2, void *p3, void *p4, void *p5,
   return r;
 }
 
+/* gather the u32 at base[indices[i]] into each lane whose mask has the
+   most significant bit set, lanes not set are taken from src */
+static_always_inline u32x8
+u32x8_mask_gather_u32 (u32x8 src, u32x8 mask, void *base, u32x8 indices)
+{
+  return (u32x8) _mm256_mask_i32gather_epi32 ((__m256i) src, base,
+					      (__m256i) indices,
+					      (__m256i) mask, 4);
+}
+
 
 static_always_inline void
 u64x4_scatter (u64x4 r, void *p0, void *p1, void *p2, void *p3)
@@ -291,6 +301,14 @@ u32x8_min_scalar (u32x8 v)
 				      u32x8_extract_hi (v)));
 }
 
+/* load the 32-bit lanes whose mask has the top bit set, the others are
+   zero; the lanes not loaded do not fault */
+static_always_inline u32x8
+u32x8_mask_load (void *p, u32x8 mask)
+{
+  return (u32x8) _mm256_maskload_epi32 ((int *) p, (__m256i) mask);
+}
+
 static_always_inline void
 u32x8_transpose (u32x8 a[8])
 {
@@ -120,6 +120,14 @@ u32x16_min_scalar (u32x16 v)
 				      u32x16_extract_hi (v)));
 }
 
+/* load the 32-bit lanes set in the mask, the others are zero; the
+   lanes not loaded do not fault */
+static_always_inline u32x16
+u32x16_mask_load_zero (void *p, u16 mask)
+{
+  return (u32x16) _mm512_maskz_loadu_epi32 (mask, p);
+}
+
 static_always_inline u32x16
 u32x16_insert_lo (u32x16 r, u32x8 v)
 {
@@ -132,6 +140,15 @@ u32x16_insert_hi (u32x16 r, u32x8 v)
   return (u32x16) _mm512_inserti64x4 ((__m512i) r, (__m256i) v, 1);
 }
 
+/* gather the u32 at base[indices[i]] into each lane set in mask,
+   lanes not set are taken from src */
+static_always_inline u32x16
+u32x16_mask_gather_u32 (u32x16 src, u16 mask, void *base, u32x16 indices)
+{
+  return (u32x16) _mm512_mask_i32gather_epi32 ((__m512i) src, mask,
+					       (__m512i) indices, base, 4);
+}
+
 static_always_inline u64x8
 u64x8_permute (u64x8 a, u64x8 b, u64x8 mask)
 {
@@ -862,5 +862,85 @@ class TestClassifierPBR(TestClassifier):
         # and the table should be gone.
         self.assertFalse(self.verify_vrf(self.pbr_vrfid))
 
+
+class TestClassifierChain(TestClassifier):
+    """ Classifier chain-lookup Test Case """
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestClassifierChain, cls).setUpClass()
+
+    @classmethod
+    def tearDownClass(cls):
+        super(TestClassifierChain, cls).tearDownClass()
+
+    def tearDown(self):
+        self.vapi.cli("set classify chain-lookup disable")
+        super(TestClassifierChain, self).tearDown()
+
+    def test_chain_unit(self):
+        """ Chain-lookup unit test """
+        reply = self.vapi.cli("test classify chain tables 4 iterations 1")
+        self.logger.info(reply)
+        self.assertIn("passed", reply)
+
+    def test_iacl_src_ip_chain(self):
+        """ Source IP iACL test with chain-lookup
+
+        Test scenario for IP ACL with a chain of two tables, searched in
+        one pass
+            - Create IPv4 stream for pg0 -> pg1 interface.
+            - Create iACL chain, the first table on destination IP, which
+              the stream misses, the second on source IP, which it hits.
+            - Send and verify received packets on pg1 interface, all hits
+              after the walk of the chain.
+        """
+        self.vapi.cli("set classify chain-lookup enable")
+
+        pkts = self.create_stream(self.pg0, self.pg1, self.pg_if_packet_sizes)
+        self.pg0.add_stream(pkts)
+
+        key = 'ip_src'
+        self.create_classify_table(key, self.build_ip_mask(src_ip='ffffffff'))
+        self.create_classify_session(
+            self.acl_tbl_idx.get(key),
+            self.build_ip_match(src_ip=self.pg0.remote_ip4))
+
+        mask = self.build_ip_mask(dst_ip='ffffffff')
+        r = self.vapi.classify_add_del_table(
+            is_add=1,
+            mask=binascii.unhexlify(mask),
+            match_n_vectors=(len(mask) - 1) // 32 + 1,
+            next_table_index=self.acl_tbl_idx.get(key),
+            miss_next_index=0,
+            current_data_flag=1,
+            current_data_offset=0)
+        self.assertIsNotNone(r, 'No response msg for add_del_table')
+        self.acl_tbl_idx['ip_dst'] = r.new_table_index
+        self.create_classify_session(
+            self.acl_tbl_idx.get('ip_dst'),
+            self.build_ip_match(dst_ip=self.pg2.remote_ip4))
+
+        key = 'ip_dst'
+        self.input_acl_set_interface(self.pg0, self.acl_tbl_idx.get(key))
+        self.acl_active_table = key
+
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+
+        pkts = self.pg1.get_capture(len(pkts))
+        self.verify_capture(self.pg1, pkts)
+        self.pg0.assert_nothing_captured(remark="packets forwarded")
+        self.pg2.assert_nothing_captured(remark="packets forwarded")
+        self.pg3.assert_nothing_captured(remark="packets forwarded")
+
+        self.assert_error_counter_equal(
+            "/err/ip4-inacl/input ACL hits", len(pkts))
+        self.assert_error_counter_equal(
+            "/err/ip4-inacl/input ACL hits after chain walk", len(pkts))
+        self.assert_error_counter_equal(
+            "/err/ip4-inacl/input ACL misses", 0)
+
+
 if __name__ == '__main__':
     unittest.main(testRunner=VppTestRunner)
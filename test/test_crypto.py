@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 
+import re
 import unittest
 
 from framework import VppTestCase, VppTestRunner
@@ -24,5 +25,48 @@ class TestCrypto(VppTestCase):
             self.logger.critical(error)
         self.assertNotIn("FAIL", error)
 
+    def test_crypto_chained_per_engine(self):
+        """ Crypto chained buffer tests on every engine """
+        reply = self.vapi.cli("test crypto")
+        self.assertNotIn("FAIL", reply)
+
+        engines = self.vapi.cli("show crypto engines")
+        # engines that implement chained AES-GCM
+        for e in ["ia32", "ipsecmb", "openssl"]:
+            if not re.search(r"^%s\s" % e, engines, re.M):
+                continue
+            for op in ["aead-encrypt-aes-128-gcm", "aead-decrypt-aes-128-gcm",
+                       "aead-encrypt-aes-256-gcm", "aead-decrypt-aes-256-gcm"]:
+                self.assertIn("(%s, chained %s)" % (op, e), reply)
+
+    def test_crypto_perf_per_engine(self):
+        """ Crypto per-engine perf report """
+        reply = self.vapi.cli("test crypto perf aes-128-gcm per-engine "
+                              "size 64 size 1500 buffers 8 rounds 1 "
+                              "warmup-rounds 1")
+
+        self.logger.info(reply)
+        self.assertIn("ticks/byte", reply)
+
+        # <engine> <size> <enc ticks/byte> <enc ticks/pkt>
+        #                 <dec ticks/byte> <dec ticks/pkt>
+        rows = re.findall(r"^(\S+)\s+(\d+)\s+([\d.]+)\s+([\d.]+)"
+                          r"\s+([\d.]+)\s+([\d.]+)\s*$", reply, re.M)
+        ticks = {}
+        for engine, size, eb, ep, db, dp in rows:
+            eb, ep, db, dp = float(eb), float(ep), float(db), float(dp)
+            self.assertGreater(eb, 0)
+            self.assertGreater(ep, 0)
+            self.assertGreater(db, 0)
+            self.assertGreater(dp, 0)
+            ticks[(engine, int(size))] = ep
+        engines = set(e for e, _ in ticks)
+        self.assertTrue(engines)
+        for e in engines:
+            self.assertIn((e, 64), ticks)
+            self.assertIn((e, 1500), ticks)
+            # a bigger packet costs more cycles
+            self.assertGreater(ticks[(e, 1500)], ticks[(e, 64)])
+
 if __name__ == '__main__':
     unittest.main(testRunner=VppTestRunner)
@@ -988,6 +988,162 @@ class TestIPSubNets(VppTestCase):
         rx = self.pg1.get_capture(1)
 
 
+class TestIPRouteBatch(VppTestCase):
+    """ IPv4 Route Batch """
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestIPRouteBatch, cls).setUpClass()
+
+    @classmethod
+    def tearDownClass(cls):
+        super(TestIPRouteBatch, cls).tearDownClass()
+
+    def setUp(self):
+        super(TestIPRouteBatch, self).setUp()
+
+        self.create_pg_interfaces(range(2))
+
+        for i in self.pg_interfaces:
+            i.admin_up()
+            i.config_ip4()
+            i.resolve_arp()
+
+    def tearDown(self):
+        super(TestIPRouteBatch, self).tearDown()
+        for i in self.pg_interfaces:
+            i.unconfig_ip4()
+            i.admin_down()
+
+    def test_ip_route_batch(self):
+        """ IP Route Batch """
+
+        N_ROUTES = 64
+        table = {'table_id': 0, 'is_ip6': 0}
+
+        def pkt(dst):
+            return (Ether(src=self.pg0.remote_mac,
+                          dst=self.pg0.local_mac) /
+                    IP(dst=dst, src=self.pg0.remote_ip4) /
+                    UDP(sport=1234, dport=1234) /
+                    Raw(b'\xa5' * 100))
+
+        #
+        # a cover and its more specifics programmed in one batch,
+        # with a nested batch that does not commit
+        #
+        self.vapi.ip_route_batch_begin(table=table)
+
+        routes = [VppIpRoute(self, "10.0.0.0", 8,
+                             [VppRoutePath(self.pg1.remote_ip4,
+                                           self.pg1.sw_if_index)])]
+        for ii in range(N_ROUTES):
+            routes.append(VppIpRoute(self, "10.0.0.%d" % (ii + 1), 32,
+                                     [VppRoutePath(self.pg1.remote_ip4,
+                                                   self.pg1.sw_if_index)]))
+
+        self.vapi.ip_route_batch_begin(table=table)
+        for r in routes:
+            r.add_vpp_config()
+        rv = self.vapi.ip_route_batch_end(table=table)
+        self.assertEqual(rv.committed, 0)
+
+        #
+        # the routes are in the table, but not yet forwarding
+        #
+        for r in routes:
+            self.assertTrue(r.query_vpp_config())
+        self.send_and_assert_no_replies(self.pg0, pkt("10.0.0.1"),
+                                        "uncommitted batch")
+
+        rv = self.vapi.ip_route_batch_end(table=table)
+        self.assertEqual(rv.committed, 1)
+        self.assertEqual(rv.n_routes, N_ROUTES + 1)
+        self.assertEqual(rv.n_fwd_updates, N_ROUTES + 1)
+
+        self.send_and_expect(self.pg0,
+                             [pkt("10.0.0.%d" % (ii + 1))
+                              for ii in range(N_ROUTES)] +
+                             [pkt("10.1.1.1")],
+                             self.pg1)
+
+        #
+        # ending a batch that was not begun is an error
+        #
+        with self.vapi.assert_negative_api_retval():
+            self.vapi.ip_route_batch_end(table=table)
+
+        #
+        # remove them all in a batch
+        #
+        self.vapi.ip_route_batch_begin(table=table)
+        for r in routes:
+            r.remove_vpp_config()
+        rv = self.vapi.ip_route_batch_end(table=table)
+        self.assertEqual(rv.committed, 1)
+        self.assertEqual(rv.n_routes, N_ROUTES + 1)
+
+        for r in routes:
+            self.assertFalse(r.query_vpp_config())
+        self.send_and_assert_no_replies(self.pg0, pkt("10.0.0.1"),
+                                        "removed")
+
+    def test_ip_route_batch_release(self):
+        """ IP Route Batch released on table delete and timeout """
+
+        def pkt(dst):
+            return (Ether(src=self.pg0.remote_mac,
+                          dst=self.pg0.local_mac) /
+                    IP(dst=dst, src=self.pg0.remote_ip4) /
+                    UDP(sport=1234, dport=1234) /
+                    Raw(b'\xa5' * 100))
+
+        def resolves_after_walk(via):
+            #
+            # a recursive route only resolves through a route added
+            # later once the back-walk from its cover has run
+            #
+            rec = VppIpRoute(self, "11.0.0.0", 8,
+                             [VppRoutePath(via, 0xffffffff)])
+            rec.add_vpp_config()
+            host = VppIpRoute(self, via, 32,
+                              [VppRoutePath(self.pg1.remote_ip4,
+                                            self.pg1.sw_if_index)])
+            host.add_vpp_config()
+            try:
+                self.send_and_expect(self.pg0, [pkt("11.1.1.1")], self.pg1)
+            finally:
+                rec.remove_vpp_config()
+                host.remove_vpp_config()
+
+        #
+        # a batch on a table that is then deleted
+        #
+        table = VppIpTable(self, 10)
+        table.add_vpp_config()
+        api_table = {'table_id': 10, 'is_ip6': 0}
+
+        self.vapi.ip_route_batch_begin(table=api_table)
+        self.vapi.ip_route_batch_begin(table=api_table)
+
+        # the batch defers only the walks of its own table
+        resolves_after_walk("20.0.0.1")
+
+        table.remove_vpp_config()
+        with self.vapi.assert_negative_api_retval():
+            self.vapi.ip_route_batch_end(table=api_table)
+
+        #
+        # a batch the client does not end times out
+        #
+        api_table = {'table_id': 0, 'is_ip6': 0}
+        self.vapi.ip_route_batch_begin(table=api_table, timeout=1)
+        self.sleep(3, "batch timeout")
+        resolves_after_walk("20.0.0.2")
+        with self.vapi.assert_negative_api_retval():
+            self.vapi.ip_route_batch_end(table=api_table)
+
+
 class TestIPLoadBalance(VppTestCase):
     """ IPv4 Load-Balancing """
 
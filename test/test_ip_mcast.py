@@ -127,6 +127,10 @@ class TestIPMcast(VppTestCase):
                     capture.remove(p)
         return capture
 
+    def mroute_replicas(self):
+        counters = self.statistics.get_counter('/net/mroute/replicas')
+        return sum(c['packets'] for t in counters for c in t)
+
     def verify_capture_ip4(self, rx_if, sent, dst_mac=None):
         rxd = rx_if.get_capture(len(sent))
 
@@ -378,6 +382,7 @@ class TestIPMcast(VppTestCase):
         self.vapi.cli("clear trace")
         tx = self.create_stream_ip4(self.pg0, "1.1.1.2", "232.1.1.1")
         self.pg0.add_stream(tx)
+        replicas = self.mroute_replicas()
 
         self.pg_enable_capture(self.pg_interfaces)
         self.pg_start()
@@ -391,6 +396,9 @@ class TestIPMcast(VppTestCase):
         self.verify_capture_ip4(self.pg6, tx)
         self.verify_capture_ip4(self.pg7, tx)
 
+        # and the fan-out is counted
+        self.assertEqual(self.mroute_replicas() - replicas, 7 * len(tx))
+
         # no replications on Pg0
         self.pg0.assert_nothing_captured(
             remark="IP multicast packets forwarded on PG0")
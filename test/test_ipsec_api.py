@@ -2,6 +2,7 @@ import unittest
 
 from framework import VppTestCase, VppTestRunner
 from template_ipsec import TemplateIpsec, IPsecIPv4Params
+from vpp_ipsec import VppIpsecSpd, VppIpsecSpdEntry
 from vpp_papi import VppEnum
 
 
@@ -58,6 +59,57 @@ class IpsecApiTestCase(VppTestCase):
         with self.vapi.assert_negative_api_retval():
             self.vapi.ipsec_select_backend(self.vpp_esp_protocol, 200)
 
+    def test_spd_lookup(self):
+        """ SPD compiled lookup """
+        spd = VppIpsecSpd(self, 1)
+        spd.add_vpp_config()
+
+        #
+        # two policies in the /24 tuple, one in the /32 tuple and
+        # one whose remote range is not a prefix
+        #
+        policies = [VppIpsecSpdEntry(self, spd, 0,
+                                     "10.0.0.0", "10.0.0.255",
+                                     "20.0.0.0", "20.0.0.255",
+                                     0, priority=10),
+                    VppIpsecSpdEntry(self, spd, 0,
+                                     "10.0.1.0", "10.0.1.255",
+                                     "20.0.1.0", "20.0.1.255",
+                                     0, priority=10),
+                    VppIpsecSpdEntry(self, spd, 0,
+                                     "10.0.0.1", "10.0.0.1",
+                                     "20.0.0.1", "20.0.0.1",
+                                     0, priority=20),
+                    VppIpsecSpdEntry(self, spd, 0,
+                                     "10.0.0.0", "10.0.0.255",
+                                     "20.0.0.1", "20.0.0.9",
+                                     0, priority=5)]
+        for p in policies:
+            p.add_vpp_config()
+
+        out = self.vapi.cli("show ipsec spd-lookup")
+        self.logger.info(out)
+        self.assertIn("tuples:2 residual:1 buckets:3", out)
+        self.assertIn("local:/32 remote:/32 policies:1 buckets:1 "
+                      "max-priority:20", out)
+        self.assertIn("local:/24 remote:/24 policies:2 buckets:2 "
+                      "max-priority:10", out)
+
+        #
+        # removing the highest priority policy removes its tuple
+        #
+        policies[2].remove_vpp_config()
+        out = self.vapi.cli("show ipsec spd-lookup")
+        self.assertIn("tuples:1 residual:1 buckets:2", out)
+        self.assertNotIn("local:/32 remote:/32", out)
+
+        for p in policies[:2] + policies[3:]:
+            p.remove_vpp_config()
+        out = self.vapi.cli("show ipsec spd-lookup")
+        self.assertNotIn("tuples:", out)
+
+        spd.remove_vpp_config()
+
     def test_select_backend_in_use(self):
         """ attempt to change backend while sad configured """
         params = self.ipv4_params
@@ -140,14 +140,24 @@ class ConfigIpsecESP(TemplateIpsec):
         objs.append(params.spd_policy_out_any)
         objs.append(params.spd_policy_in_any)
 
-        objs.append(VppIpsecSpdEntry(self, self.tun_spd, vpp_tun_sa_id,
-                                     remote_tun_if_host, remote_tun_if_host,
-                                     self.pg1.remote_addr[addr_type],
-                                     self.pg1.remote_addr[addr_type],
-                                     0,
-                                     priority=10,
-                                     policy=e.IPSEC_API_SPD_ACTION_PROTECT,
-                                     is_outbound=0))
+        params.spd_policy_in_protect = [
+            VppIpsecSpdEntry(self, self.tun_spd, vpp_tun_sa_id,
+                             remote_tun_if_host, remote_tun_if_host,
+                             self.pg1.remote_addr[addr_type],
+                             self.pg1.remote_addr[addr_type],
+                             0,
+                             priority=10,
+                             policy=e.IPSEC_API_SPD_ACTION_PROTECT,
+                             is_outbound=0),
+            VppIpsecSpdEntry(self, self.tun_spd, vpp_tun_sa_id,
+                             remote_tun_if_host, remote_tun_if_host,
+                             self.pg0.local_addr[addr_type],
+                             self.pg0.local_addr[addr_type],
+                             0,
+                             priority=20,
+                             policy=e.IPSEC_API_SPD_ACTION_PROTECT,
+                             is_outbound=0)]
+        objs.extend(params.spd_policy_in_protect)
         objs.append(VppIpsecSpdEntry(self, self.tun_spd, scapy_tun_sa_id,
                                      self.pg1.remote_addr[addr_type],
                                      self.pg1.remote_addr[addr_type],
@@ -155,14 +165,6 @@ class ConfigIpsecESP(TemplateIpsec):
                                      0,
                                      policy=e.IPSEC_API_SPD_ACTION_PROTECT,
                                      priority=10))
-        objs.append(VppIpsecSpdEntry(self, self.tun_spd, vpp_tun_sa_id,
-                                     remote_tun_if_host, remote_tun_if_host,
-                                     self.pg0.local_addr[addr_type],
-                                     self.pg0.local_addr[addr_type],
-                                     0,
-                                     priority=20,
-                                     policy=e.IPSEC_API_SPD_ACTION_PROTECT,
-                                     is_outbound=0))
         objs.append(VppIpsecSpdEntry(self, self.tun_spd, scapy_tun_sa_id,
                                      self.pg0.local_addr[addr_type],
                                      self.pg0.local_addr[addr_type],
@@ -287,7 +289,129 @@ class TemplateIpsecEsp(ConfigIpsecESP):
 
 class TestIpsecEsp1(TemplateIpsecEsp, IpsecTra46Tests, IpsecTun46Tests):
     """ Ipsec ESP - TUN & TRA tests """
-    pass
+
+    def sa_in_lookup_hits(self, af):
+        hits = self.statistics.get_counter('/net/ipsec/sa/in-lookup/hits')
+        return sum(t[af] for t in hits)
+
+    def test_tun_sa_in_lookup(self):
+        """ ipsec tunnel inbound SA lookup """
+        for af, verify in [(0, self.verify_tun_44), (1, self.verify_tun_66)]:
+            p = self.params[socket.AF_INET6 if af else socket.AF_INET]
+            before = self.sa_in_lookup_hits(af)
+            verify(p, count=17)
+            self.assertEqual(self.sa_in_lookup_hits(af) - before, 17)
+            # SA lookup hits are counted against the matching policy
+            pkts = sum(sp.get_stats()['packets']
+                       for sp in p.spd_policy_in_protect)
+            self.assertEqual(pkts, 17)
+        self.logger.info(self.vapi.cli("show ipsec sa-lookup"))
+
+
+class TestIpsecEsp1FlowCache(TestIpsecEsp1):
+    """ Ipsec ESP - TUN & TRA tests with the SPD flow cache """
+
+    @classmethod
+    def setUpConstants(cls):
+        cls.extra_vpp_punt_config = ["ipsec", "{", "spd-flow-cache", "}"]
+        super(TestIpsecEsp1FlowCache, cls).setUpConstants()
+
+    def spd_flow_cache_stats(self):
+        hits = self.statistics.get_counter('/net/ipsec/spd/flow-cache/hits')
+        misses = self.statistics.get_counter(
+            '/net/ipsec/spd/flow-cache/misses')
+        return sum(t[0] for t in hits), sum(t[0] for t in misses)
+
+    def test_tun_spd_flow_cache(self):
+        """ ipsec SPD flow cache hits and misses """
+        p = self.params[socket.AF_INET]
+        hits, misses = self.spd_flow_cache_stats()
+        self.verify_tun_44(p, count=17)
+        hits1, misses1 = self.spd_flow_cache_stats()
+        # one flow; the first packet misses, the rest hit
+        self.assertGreaterEqual(misses1 - misses, 1)
+        self.assertGreaterEqual(hits1 - hits, 16)
+
+        # no SPD change, so the flow is still cached
+        self.verify_tun_44(p, count=17)
+        hits2, misses2 = self.spd_flow_cache_stats()
+        self.assertEqual(misses2 - misses1, 0)
+        self.assertEqual(hits2 - hits1, 17)
+        self.logger.info(self.vapi.cli("show ipsec spd-lookup"))
+
+
+class TestIpsecEsp1MultiWorker(TestIpsecEsp1):
+    """ Ipsec ESP - TUN & TRA tests with multi-worker SAs """
+    worker_config = "workers 2"
+
+    @classmethod
+    def setUpConstants(cls):
+        cls.extra_vpp_punt_config = ["ipsec", "{", "sa-multi-worker", "}"]
+        super(TestIpsecEsp1MultiWorker, cls).setUpConstants()
+
+    def test_tun_multi_worker_seq(self):
+        """ ipsec multi-worker SA numbers fit a peer's replay window """
+        p = self.params[socket.AF_INET]
+        seqs = []
+
+        # encrypt with the same SA on both workers in turn
+        for worker in [0, 1, 0, 1, 0]:
+            pkts = self.gen_pkts(self.pg1, src=self.pg1.remote_ip4,
+                                 dst=p.remote_tun_if_host, count=20)
+            self.pg1.add_stream(pkts, worker=worker)
+            self.pg_enable_capture(self.pg_interfaces)
+            self.pg_start()
+            rxs = self.tun_if.get_capture(20)
+            self.verify_encrypted(p, p.vpp_tun_sa, rxs)
+            seqs += [rx[ESP].seq for rx in rxs]
+
+        # a peer with a 64 packet anti-replay window accepts all of them
+        highest = 0
+        for seq in seqs:
+            self.assertGreater(seq + 64, highest)
+            highest = max(highest, seq)
+        self.assertEqual(len(set(seqs)), len(seqs))
+        self.logger.info(self.vapi.cli("show ipsec sa detail"))
+
+
+class TestIpsecEsp1Async(TestIpsecEsp1):
+    """ Ipsec ESP - TUN & TRA tests with async crypto """
+
+    def setUp(self):
+        super(TestIpsecEsp1Async, self).setUp()
+        self.vapi.cli("set ipsec async mode on")
+
+    def tearDown(self):
+        self.vapi.cli("set ipsec async mode off")
+        super(TestIpsecEsp1Async, self).tearDown()
+
+    def async_frames(self):
+        frames = self.statistics.get_counter('/net/crypto/async/frames')
+        sched = self.statistics.get_counter('/crypto/sw_scheduler/frames')
+        # submitted, completed, failed; processed by the engine, handoff
+        return ([sum(t[i] for t in frames) for i in range(3)] +
+                [sum(t[i] for t in sched) for i in range(2)])
+
+    def test_tun_async_counters(self):
+        """ ipsec ESP encrypt takes the async path """
+        p = self.params[socket.AF_INET]
+        before = self.async_frames()
+        self.verify_tun_44(p, count=17)
+        after = self.async_frames()
+        submitted, completed, failed, processed, handoff = \
+            [a - b for a, b in zip(after, before)]
+        self.assertGreater(submitted, 0)
+        self.assertEqual(completed, submitted)
+        self.assertEqual(failed, 0)
+        self.assertEqual(processed, submitted)
+        # a single thread processes its own frames
+        self.assertEqual(handoff, 0)
+        self.logger.info(self.vapi.cli("show crypto async status"))
+
+    def show_commands_at_teardown(self):
+        super(TestIpsecEsp1Async, self).show_commands_at_teardown()
+        self.logger.info(self.vapi.cli("show crypto async status"))
+        self.logger.info(self.vapi.cli("show sw_scheduler workers"))
 
 
 class TestIpsecEsp2(TemplateIpsecEsp, IpsecTcpTests):
@@ -497,6 +621,13 @@ class RunTestIpsecEspAll(ConfigIpsecESP,
         self.verify_tun_44(self.params[socket.AF_INET],
                            count=NUM_PKTS)
 
+        #
+        # packets that do not fit in a single buffer are
+        # encrypted and decrypted as buffer chains
+        #
+        self.verify_tra_basic6(count=NUM_PKTS, payload_size=1970)
+        self.verify_tra_basic4(count=NUM_PKTS, payload_size=1970)
+
         #
         # remove the SPDs, SAs, etc
         #
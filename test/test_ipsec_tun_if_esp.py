@@ -1219,6 +1219,58 @@ class TestIpsec6TunProtect(TemplateIpsec,
         self.unconfig_sa(np3)
         self.unconfig_network(p)
 
+    def test_tun_66_overlap(self):
+        """IPSEC tunnel protect make-before-break rekey"""
+
+        p = self.ipv6_params
+
+        self.config_network(p)
+        self.config_sa_tra(p)
+        self.config_protect(p)
+
+        self.verify_tun_66(p, count=127)
+
+        # rekey with an overlap window; the replaced input SA is still
+        # accepted while the output uses the new SA straight away
+        self.vapi.cli("set ipsec tun-protect overlap 600")
+
+        np = copy.copy(p)
+        np.crypt_key = b'X' + p.crypt_key[1:]
+        np.scapy_tun_spi += 100
+        np.scapy_tun_sa_id += 1
+        np.vpp_tun_spi += 100
+        np.vpp_tun_sa_id += 1
+        np.tun_if.local_spi = p.vpp_tun_spi
+        np.tun_if.remote_spi = p.scapy_tun_spi
+
+        self.config_sa_tra(np)
+        p.tun_protect.update_vpp_config(np.tun_sa_out, [np.tun_sa_in])
+
+        self.verify_tun_66(p, np, count=127)
+        self.verify_tun_66(np, np, count=127)
+        self.assertIn("retiring input-sa",
+                      self.vapi.cli("show ipsec protect"))
+
+        # the next update retires the SAs the previous one replaced
+        self.vapi.cli("set ipsec tun-protect overlap 0")
+        p.tun_protect.update_vpp_config(np.tun_sa_out, [np.tun_sa_in])
+        self.assertNotIn("retiring input-sa",
+                         self.vapi.cli("show ipsec protect"))
+        self.unconfig_sa(p)
+
+        self.verify_tun_66(np, np, count=127)
+        self.verify_drop_tun_66(p, count=127)
+
+        c = p.tun_if.get_rx_stats()
+        self.assertEqual(c['packets'], 127*4)
+        c = p.tun_if.get_tx_stats()
+        self.assertEqual(c['packets'], 127*4)
+
+        # teardown
+        p.tun_protect.remove_vpp_config()
+        self.unconfig_sa(np)
+        self.unconfig_network(p)
+
     def test_tun_46(self):
         """IPSEC tunnel protect"""
 